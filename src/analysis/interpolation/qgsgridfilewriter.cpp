@@ -21,6 +21,36 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QProgressDialog>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+/// @cond
+
+//! row of the grid interpolated by one thread
+struct QgsGridFileRow
+{
+  QgsInterpolator* interpolator;
+  double y;
+  double xMin;
+  double cellSizeX;
+  int nCols;
+  QVector<double> values;
+  QVector<bool> valid;
+};
+
+static void interpolateRow( QgsGridFileRow& row )
+{
+  row.values.resize( row.nCols );
+  row.valid.resize( row.nCols );
+  double currentXValue = row.xMin + row.cellSizeX / 2.0; //calculate value in the center of the cell
+  for ( int j = 0; j < row.nCols; ++j )
+  {
+    row.valid[j] = row.interpolator->interpolatePoint( currentXValue, row.y, row.values[j] ) == 0;
+    currentXValue += row.cellSizeX;
+  }
+}
+
+/// @endcond
 
 QgsGridFileWriter::QgsGridFileWriter( QgsInterpolator* i, const QString& outputPath, const QgsRectangle& extent, int nCols, int nRows, double cellSizeX, double cellSizeY )
     : mInterpolator( i )
@@ -69,8 +99,6 @@ int QgsGridFileWriter::writeFile( bool showProgressDialog )
   writeHeader( outStream );
 
   double currentYValue = mInterpolationExtent.yMaximum() - mCellSizeY / 2.0; //calculate value in the center of the cell
-  double currentXValue;
-  double interpolatedValue;
 
   QProgressDialog* progressDialog = 0;
   if ( showProgressDialog )
@@ -79,32 +107,59 @@ int QgsGridFileWriter::writeFile( bool showProgressDialog )
     progressDialog->setWindowModality( Qt::WindowModal );
   }
 
-  for ( int i = 0; i < mNumRows; ++i )
+  //rows are interpolated in parallel by the threads of the global pool if the interpolator supports it
+  int nThreads = QThreadPool::globalInstance()->maxThreadCount();
+  int batchRows = nThreads > 1 && mInterpolator->prepareConcurrentInterpolation() ? nThreads * 4 : 1;
+
+  for ( int i = 0; i < mNumRows; )
   {
-    currentXValue = mInterpolationExtent.xMinimum() + mCellSizeX / 2.0; //calculate value in the center of the cell
-    for ( int j = 0; j < mNumColumns; ++j )
+    QList<QgsGridFileRow> rows;
+    for ( int batchRow = 0; batchRow < batchRows && i + batchRow < mNumRows; ++batchRow )
     {
-      if ( mInterpolator->interpolatePoint( currentXValue, currentYValue, interpolatedValue ) == 0 )
-      {
-        outStream << interpolatedValue << ' ';
-      }
-      else
-      {
-        outStream << "-9999 ";
-      }
-      currentXValue += mCellSizeX;
+      QgsGridFileRow row;
+      row.interpolator = mInterpolator;
+      row.y = currentYValue;
+      row.xMin = mInterpolationExtent.xMinimum();
+      row.cellSizeX = mCellSizeX;
+      row.nCols = mNumColumns;
+      rows << row;
+      currentYValue -= mCellSizeY;
+    }
+
+    if ( rows.size() > 1 )
+    {
+      QtConcurrent::blockingMap( rows, interpolateRow );
+    }
+    else
+    {
+      interpolateRow( rows[0] );
     }
-    outStream << endl;
-    currentYValue -= mCellSizeY;
 
-    if ( showProgressDialog )
+    Q_FOREACH ( const QgsGridFileRow& row, rows )
     {
-      if ( progressDialog->wasCanceled() )
+      for ( int j = 0; j < mNumColumns; ++j )
+      {
+        if ( row.valid.at( j ) )
+        {
+          outStream << row.values.at( j ) << ' ';
+        }
+        else
+        {
+          outStream << "-9999 ";
+        }
+      }
+      outStream << endl;
+
+      if ( showProgressDialog )
       {
-        outputFile.remove();
-        return 3;
+        if ( progressDialog->wasCanceled() )
+        {
+          outputFile.remove();
+          return 3;
+        }
+        progressDialog->setValue( i );
       }
-      progressDialog->setValue( i );
+      ++i;
     }
   }
 
@@ -32,7 +32,8 @@ class ANALYSIS_EXPORT QgsGridFileWriter
     QgsGridFileWriter( QgsInterpolator* i, const QString& outputPath, const QgsRectangle& extent, int nCols, int nRows, double cellSizeX, double cellSizeY );
     ~QgsGridFileWriter();
 
-    /** Writes the grid file.
+    /** Writes the grid file. Rows are interpolated in parallel if the interpolator supports
+     concurrent interpolation (see QgsInterpolator::prepareConcurrentInterpolation()).
      @param showProgressDialog shows a dialog with the possibility to cancel
     @return 0 in case of success*/
 
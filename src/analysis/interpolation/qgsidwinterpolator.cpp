@@ -16,15 +16,37 @@
  ***************************************************************************/
 
 #include "qgsidwinterpolator.h"
+#include <QPair>
+#include <QtAlgorithms>
 #include <cmath>
 #include <limits>
 
-QgsIDWInterpolator::QgsIDWInterpolator( const QList<LayerData>& layerData ): QgsInterpolator( layerData ), mDistanceCoefficient( 2.0 )
+QgsIDWInterpolator::QgsIDWInterpolator( const QList<LayerData>& layerData )
+    : QgsInterpolator( layerData )
+    , mDistanceCoefficient( 2.0 )
+    , mSearchRadius( 0 )
+    , mMaxDataPoints( 0 )
+    , mIndexBuilt( false )
+    , mIndexXMin( 0 )
+    , mIndexYMin( 0 )
+    , mIndexCellSize( 0 )
+    , mIndexColumns( 0 )
+    , mIndexRows( 0 )
 {
 
 }
 
-QgsIDWInterpolator::QgsIDWInterpolator(): QgsInterpolator( QList<LayerData>() ), mDistanceCoefficient( 2.0 )
+QgsIDWInterpolator::QgsIDWInterpolator()
+    : QgsInterpolator( QList<LayerData>() )
+    , mDistanceCoefficient( 2.0 )
+    , mSearchRadius( 0 )
+    , mMaxDataPoints( 0 )
+    , mIndexBuilt( false )
+    , mIndexXMin( 0 )
+    , mIndexYMin( 0 )
+    , mIndexCellSize( 0 )
+    , mIndexColumns( 0 )
+    , mIndexRows( 0 )
 {
 
 }
@@ -41,6 +63,15 @@ int QgsIDWInterpolator::interpolatePoint( double x, double y, double& result )
     cacheBaseData();
   }
 
+  if ( mSearchRadius > 0 || mMaxDataPoints > 0 )
+  {
+    if ( !mIndexBuilt )
+    {
+      buildIndex();
+    }
+    return interpolateFromIndex( x, y, result );
+  }
+
   double currentWeight;
   double distance;
 
@@ -70,3 +101,188 @@ int QgsIDWInterpolator::interpolatePoint( double x, double y, double& result )
   result = sumCounter / sumDenominator;
   return 0;
 }
+
+bool QgsIDWInterpolator::prepareConcurrentInterpolation()
+{
+  //interpolatePoint() must not cache the data from several threads
+  if ( !mDataIsCached && cacheBaseData() != 0 )
+  {
+    return false;
+  }
+  if ( !mIndexBuilt )
+  {
+    buildIndex();
+  }
+  return true;
+}
+
+void QgsIDWInterpolator::buildIndex()
+{
+  mIndexBuilt = true;
+  mIndexCellStart.clear();
+  mIndexPoints.clear();
+  mIndexColumns = 0;
+  mIndexRows = 0;
+
+  int nPoints = mCachedBaseData.size();
+  if ( nPoints == 0 )
+  {
+    return;
+  }
+
+  double xMin = std::numeric_limits<double>::max();
+  double yMin = std::numeric_limits<double>::max();
+  double xMax = -std::numeric_limits<double>::max();
+  double yMax = -std::numeric_limits<double>::max();
+  QVector<vertexData>::const_iterator vertex_it = mCachedBaseData.constBegin();
+  for ( ; vertex_it != mCachedBaseData.constEnd(); ++vertex_it )
+  {
+    xMin = qMin( xMin, vertex_it->x );
+    yMin = qMin( yMin, vertex_it->y );
+    xMax = qMax( xMax, vertex_it->x );
+    yMax = qMax( yMax, vertex_it->y );
+  }
+
+  //about two data points per cell, at most as many columns / rows as data points
+  double width = xMax - xMin;
+  double height = yMax - yMin;
+  mIndexCellSize = qMax( sqrt( 2.0 * width * height / nPoints ), qMax( width, height ) / nPoints );
+  if ( mIndexCellSize <= 0 )
+  {
+    mIndexCellSize = 1.0;
+  }
+  mIndexXMin = xMin;
+  mIndexYMin = yMin;
+  mIndexColumns = static_cast<int>( width / mIndexCellSize ) + 1;
+  mIndexRows = static_cast<int>( height / mIndexCellSize ) + 1;
+
+  //sort the data points by cell
+  QVector<int> pointCells( nPoints );
+  mIndexCellStart.fill( 0, mIndexColumns * mIndexRows + 1 );
+  for ( int i = 0; i < nPoints; ++i )
+  {
+    const vertexData& v = mCachedBaseData.at( i );
+    int column = qMin( static_cast<int>(( v.x - xMin ) / mIndexCellSize ), mIndexColumns - 1 );
+    int row = qMin( static_cast<int>(( v.y - yMin ) / mIndexCellSize ), mIndexRows - 1 );
+    pointCells[i] = row * mIndexColumns + column;
+    ++mIndexCellStart[pointCells[i] + 1];
+  }
+  for ( int i = 1; i < mIndexCellStart.size(); ++i )
+  {
+    mIndexCellStart[i] += mIndexCellStart[i - 1];
+  }
+
+  QVector<int> next = mIndexCellStart;
+  mIndexPoints.resize( nPoints );
+  for ( int i = 0; i < nPoints; ++i )
+  {
+    mIndexPoints[next[pointCells[i]]++] = i;
+  }
+}
+
+int QgsIDWInterpolator::interpolateFromIndex( double x, double y, double& result ) const
+{
+  if ( mIndexColumns == 0 )
+  {
+    return 1;
+  }
+
+  //cell of the point or the nearest cell if the point is outside of the index
+  double columnPos = floor(( x - mIndexXMin ) / mIndexCellSize );
+  double rowPos = floor(( y - mIndexYMin ) / mIndexCellSize );
+  int column = static_cast<int>( qBound( 0.0, columnPos, mIndexColumns - 1.0 ) );
+  int row = static_cast<int>( qBound( 0.0, rowPos, mIndexRows - 1.0 ) );
+
+  double maxDistance = mSearchRadius > 0 ? mSearchRadius : std::numeric_limits<double>::max();
+  bool nearestOnly = mMaxDataPoints > 0;
+
+  double sumCounter = 0;
+  double sumDenominator = 0;
+  //nearest data points (distance, index) sorted by distance
+  QVector< QPair<double, int> > nearest;
+
+  //visit the cells in rings around the cell of the point
+  for ( int ring = 0; ; ++ring )
+  {
+    //points in the cells of a ring are at least ring - 1 cells away
+    double ringDistance = ( ring - 1 ) * mIndexCellSize;
+    if ( ringDistance > maxDistance )
+    {
+      break;
+    }
+    if ( nearestOnly && nearest.size() >= mMaxDataPoints && ringDistance > nearest.last().first )
+    {
+      break;
+    }
+
+    for ( int r = row - ring; r <= row + ring; ++r )
+    {
+      if ( r < 0 || r >= mIndexRows )
+      {
+        continue;
+      }
+      bool fullRow = ( r == row - ring || r == row + ring );
+      int step = fullRow || ring == 0 ? 1 : 2 * ring;
+      for ( int c = column - ring; c <= column + ring; c += step )
+      {
+        if ( c < 0 || c >= mIndexColumns )
+        {
+          continue;
+        }
+
+        int cell = r * mIndexColumns + c;
+        for ( int i = mIndexCellStart.at( cell ); i < mIndexCellStart.at( cell + 1 ); ++i )
+        {
+          int pointIndex = mIndexPoints.at( i );
+          const vertexData& v = mCachedBaseData.at( pointIndex );
+          double distance = sqrt(( v.x - x ) * ( v.x - x ) + ( v.y - y ) * ( v.y - y ) );
+          if (( distance - 0 ) < std::numeric_limits<double>::min() )
+          {
+            result = v.z;
+            return 0;
+          }
+          if ( distance > maxDistance )
+          {
+            continue;
+          }
+
+          if ( !nearestOnly )
+          {
+            double currentWeight = weight( distance );
+            sumCounter += ( currentWeight * v.z );
+            sumDenominator += currentWeight;
+          }
+          else if ( nearest.size() < mMaxDataPoints || distance < nearest.last().first )
+          {
+            QPair<double, int> entry( distance, pointIndex );
+            nearest.insert( qUpperBound( nearest.begin(), nearest.end(), entry ), entry );
+            if ( nearest.size() > mMaxDataPoints )
+            {
+              nearest.remove( nearest.size() - 1 );
+            }
+          }
+        }
+      }
+    }
+
+    if ( row - ring <= 0 && row + ring >= mIndexRows - 1 && column - ring <= 0 && column + ring >= mIndexColumns - 1 )
+    {
+      break; //all cells visited
+    }
+  }
+
+  for ( int i = 0; i < nearest.size(); ++i )
+  {
+    double currentWeight = weight( nearest.at( i ).first );
+    sumCounter += ( currentWeight * mCachedBaseData.at( nearest.at( i ).second ).z );
+    sumDenominator += currentWeight;
+  }
+
+  if ( sumDenominator == 0.0 )
+  {
+    return 1;
+  }
+
+  result = sumCounter / sumDenominator;
+  return 0;
+}
@@ -19,6 +19,7 @@
 #define QGSIDWINTERPOLATOR_H
 
 #include "qgsinterpolator.h"
+#include <cmath>
 
 class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
 {
@@ -35,6 +36,28 @@ class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
 
     void setDistanceCoefficient( double p ) {mDistanceCoefficient = p;}
 
+    /** Sets the maximum distance of the data points used to interpolate a point. Points without
+       data points within the radius are not interpolated.
+       @param radius search radius in map units, 0 (the default) to use data points at any distance
+       @note added in QGIS 2.14*/
+    void setSearchRadius( double radius ) { mSearchRadius = radius; }
+
+    /** Returns the maximum distance of the data points used to interpolate a point, 0 if not limited
+       @note added in QGIS 2.14*/
+    double searchRadius() const { return mSearchRadius; }
+
+    /** Sets the maximum number of data points used to interpolate a point. Only the nearest
+       data points are used.
+       @param count number of nearest data points, 0 (the default) to use all data points
+       @note added in QGIS 2.14*/
+    void setMaxDataPoints( int count ) { mMaxDataPoints = count; }
+
+    /** Returns the maximum number of data points used to interpolate a point, 0 if not limited
+       @note added in QGIS 2.14*/
+    int maxDataPoints() const { return mMaxDataPoints; }
+
+    bool prepareConcurrentInterpolation() override;
+
   private:
 
     QgsIDWInterpolator(); //forbidden
@@ -43,6 +66,32 @@ class ANALYSIS_EXPORT QgsIDWInterpolator: public QgsInterpolator
        Smaller values mean sharper peaks at the data points. The default is a
        value of 2*/
     double mDistanceCoefficient;
+
+    /** Maximum distance of the data points, 0 if not limited*/
+    double mSearchRadius;
+    /** Maximum number of nearest data points, 0 if not limited*/
+    int mMaxDataPoints;
+
+    /** Builds the grid index of the cached data points*/
+    void buildIndex();
+
+    /** Interpolates a point from the data points within the search radius or the nearest data points,
+       found with the grid index*/
+    int interpolateFromIndex( double x, double y, double& result ) const;
+
+    /** Returns the weight of a data point at a distance*/
+    double weight( double distance ) const { return 1 / ( pow( distance, mDistanceCoefficient ) ); }
+
+    /** Grid index of the cached data points. The data points of cell i (in row major order) are
+       mIndexPoints[mIndexCellStart[i]] to mIndexPoints[mIndexCellStart[i + 1] - 1]*/
+    bool mIndexBuilt;
+    double mIndexXMin;
+    double mIndexYMin;
+    double mIndexCellSize;
+    int mIndexColumns;
+    int mIndexRows;
+    QVector<int> mIndexCellStart;
+    QVector<int> mIndexPoints;
 };
 
 #endif
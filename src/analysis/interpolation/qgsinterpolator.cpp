@@ -43,6 +43,7 @@ int QgsInterpolator::cacheBaseData()
 {
   if ( mLayerData.size() < 1 )
   {
+    mDataIsCached = true;
     return 0;
   }
 
@@ -101,6 +102,8 @@ int QgsInterpolator::cacheBaseData()
     }
   }
 
+  //also if the layers contained no vertices, they are not read again
+  mDataIsCached = true;
   return 0;
 }
 
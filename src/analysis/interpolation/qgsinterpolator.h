@@ -64,6 +64,12 @@ class ANALYSIS_EXPORT QgsInterpolator
        @return 0 in case of success*/
     virtual int interpolatePoint( double x, double y, double& result ) = 0;
 
+    /** Prepares the interpolator for calls of interpolatePoint() from several threads at the same time,
+     e.g. by caching the base data. The default implementation returns false.
+     @return true if interpolatePoint() may be called concurrently after this call
+     @note added in QGIS 2.14*/
+    virtual bool prepareConcurrentInterpolation() { return false; }
+
     // @note not available in python bindings
     const QList<LayerData>& layerData() const { return mLayerData; }
 
@@ -0,0 +1,539 @@
+/***************************************************************************
+    qgscompactgraph.cpp
+    --------------------------------------
+    Date                 : November 2015
+    Copyright            : (C) 2015 by the QGIS Development Team
+    Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgscompactgraph.h"
+#include "qgsgraph.h"
+
+#include <QHash>
+#include <QPair>
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+/// @cond
+
+// witness searches of the contraction stop after this number of settled vertices
+static const int WITNESS_SEARCH_LIMIT = 500;
+
+static const double INF_COST = std::numeric_limits<double>::infinity();
+
+// priority queue of ( key, vertex ), smallest key first
+typedef QPair<double, int> QgsGraphQueueEntry;
+typedef std::priority_queue< QgsGraphQueueEntry, std::vector<QgsGraphQueueEntry>, std::greater<QgsGraphQueueEntry> > QgsGraphQueue;
+
+struct QgsGraphSearchLabel
+{
+  QgsGraphSearchLabel() : cost( INF_COST ), arc( -1 ) {}
+
+  double cost;
+  //! arc by which the vertex was reached, -1 for the start vertex of the search
+  int arc;
+};
+
+typedef QHash<int, QgsGraphSearchLabel> QgsGraphSearchLabels;
+
+// the arcs of a path found by a search in each direction which met at a vertex
+static void collectPath( const QgsGraphSearchLabels& forward, const QgsGraphSearchLabels& backward, int meet,
+                         const QVector<int>& arcFrom, const QVector<int>& arcTo, QVector<int>& arcs )
+{
+  QVector<int> forwardArcs;
+  for ( int v = meet; forward.value( v ).arc >= 0; v = arcFrom.at( forward.value( v ).arc ) )
+    forwardArcs << forward.value( v ).arc;
+  for ( int i = forwardArcs.size() - 1; i >= 0; --i )
+    arcs << forwardArcs.at( i );
+
+  for ( int v = meet; backward.value( v ).arc >= 0; v = arcTo.at( backward.value( v ).arc ) )
+    arcs << backward.value( v ).arc;
+}
+
+// Contracts the vertices of a graph one by one, the least important vertex first.
+// Shortcuts are added between the neighbors of a contracted vertex unless a path
+// which does not pass the vertex (a witness) is as short.
+class QgsContractionHierarchyBuilder
+{
+  public:
+    explicit QgsContractionHierarchyBuilder( QgsCompactGraph& graph )
+        : mGraph( graph )
+    {}
+
+    void build()
+    {
+      int n = mGraph.vertexCount();
+      mGraph.mChArcs.clear();
+      mOut = QVector< QHash<int, int> >( n );
+      mIn = QVector< QHash<int, int> >( n );
+      mDeletedNeighbors = QVector<int>( n, 0 );
+      QVector< QVector<int> > up( n );
+      QVector< QVector<int> > down( n );
+
+      for ( int arc = 0; arc < mGraph.arcCount(); ++arc )
+        addArc( mGraph.mArcFrom.at( arc ), mGraph.mArcTo.at( arc ), mGraph.mArcCost.at( arc ), arc, -1, -1 );
+
+      QgsGraphQueue queue;
+      for ( int v = 0; v < n; ++v )
+        queue.push( QgsGraphQueueEntry( priority( v ), v ) );
+
+      while ( !queue.empty() )
+      {
+        int v = queue.top().second;
+        queue.pop();
+
+        // lazy update: the priority may have changed since the vertex was queued
+        double p = priority( v );
+        if ( !queue.empty() && p > queue.top().first )
+        {
+          queue.push( QgsGraphQueueEntry( p, v ) );
+          continue;
+        }
+
+        contract( v, false );
+
+        // the remaining arcs of the vertex lead to more important vertices
+        for ( QHash<int, int>::const_iterator it = mOut[v].constBegin(); it != mOut[v].constEnd(); ++it )
+        {
+          up[v] << it.value();
+          mIn[it.key()].remove( v );
+          ++mDeletedNeighbors[it.key()];
+        }
+        for ( QHash<int, int>::const_iterator it = mIn[v].constBegin(); it != mIn[v].constEnd(); ++it )
+        {
+          down[v] << it.value();
+          mOut[it.key()].remove( v );
+          ++mDeletedNeighbors[it.key()];
+        }
+        mOut[v].clear();
+        mIn[v].clear();
+      }
+
+      toCsr( up, mGraph.mChUpStart, mGraph.mChUpArcs );
+      toCsr( down, mGraph.mChDownStart, mGraph.mChDownArcs );
+      mGraph.mHasContractionHierarchy = true;
+    }
+
+  private:
+    QgsCompactGraph& mGraph;
+    //! arcs between vertices which are not contracted yet: vertex -> ( neighbor -> hierarchy arc )
+    QVector< QHash<int, int> > mOut;
+    QVector< QHash<int, int> > mIn;
+    QVector<int> mDeletedNeighbors;
+
+    double arcCost( int chArc ) const { return mGraph.mChArcs.at( chArc ).cost; }
+
+    // adds an arc unless there is a cheaper one between the vertices
+    void addArc( int from, int to, double cost, int arc, int first, int second )
+    {
+      if ( from == to )
+        return;
+
+      QHash<int, int>::const_iterator it = mOut[from].constFind( to );
+      if ( it != mOut[from].constEnd() && arcCost( it.value() ) <= cost )
+        return;
+
+      QgsCompactGraph::ChArc chArc;
+      chArc.from = from;
+      chArc.to = to;
+      chArc.cost = cost;
+      chArc.arc = arc;
+      chArc.first = first;
+      chArc.second = second;
+      mGraph.mChArcs << chArc;
+      mOut[from][to] = mGraph.mChArcs.size() - 1;
+      mIn[to][from] = mGraph.mChArcs.size() - 1;
+    }
+
+    // edge difference and number of contracted neighbors, contracting vertices spread over the graph first
+    double priority( int v )
+    {
+      return contract( v, true ) - mIn.at( v ).size() - mOut.at( v ).size() + mDeletedNeighbors.at( v );
+    }
+
+    // returns the number of shortcuts needed to contract a vertex, adds them if not simulated
+    int contract( int v, bool simulate )
+    {
+      int shortcuts = 0;
+      for ( QHash<int, int>::const_iterator inIt = mIn[v].constBegin(); inIt != mIn[v].constEnd(); ++inIt )
+      {
+        int u = inIt.key();
+        double inCost = arcCost( inIt.value() );
+
+        double maxCost = -1;
+        for ( QHash<int, int>::const_iterator outIt = mOut[v].constBegin(); outIt != mOut[v].constEnd(); ++outIt )
+        {
+          if ( outIt.key() != u )
+            maxCost = qMax( maxCost, inCost + arcCost( outIt.value() ) );
+        }
+        if ( maxCost < 0 )
+          continue;
+
+        QHash<int, double> witnessCost;
+        witnessSearch( u, v, maxCost, witnessCost );
+
+        for ( QHash<int, int>::const_iterator outIt = mOut[v].constBegin(); outIt != mOut[v].constEnd(); ++outIt )
+        {
+          int w = outIt.key();
+          if ( w == u )
+            continue;
+
+          double viaCost = inCost + arcCost( outIt.value() );
+          QHash<int, double>::const_iterator witness = witnessCost.constFind( w );
+          if ( witness != witnessCost.constEnd() && witness.value() <= viaCost )
+            continue;
+
+          ++shortcuts;
+          if ( !simulate )
+            addArc( u, w, viaCost, -1, inIt.value(), outIt.value() );
+        }
+      }
+      return shortcuts;
+    }
+
+    // costs of the paths from a vertex to its neighborhood, not passing the excluded vertex
+    void witnessSearch( int source, int excluded, double maxCost, QHash<int, double>& cost ) const
+    {
+      QgsGraphQueue queue;
+      cost[source] = 0;
+      queue.push( QgsGraphQueueEntry( 0, source ) );
+      int settled = 0;
+      while ( !queue.empty() && settled < WITNESS_SEARCH_LIMIT )
+      {
+        QgsGraphQueueEntry entry = queue.top();
+        queue.pop();
+        if ( entry.first > maxCost )
+          break;
+        if ( entry.first > cost.value( entry.second, INF_COST ) )
+          continue;
+        ++settled;
+
+        const QHash<int, int>& out = mOut.at( entry.second );
+        for ( QHash<int, int>::const_iterator it = out.constBegin(); it != out.constEnd(); ++it )
+        {
+          if ( it.key() == excluded )
+            continue;
+          double c = entry.first + arcCost( it.value() );
+          if ( c < cost.value( it.key(), INF_COST ) )
+          {
+            cost[it.key()] = c;
+            queue.push( QgsGraphQueueEntry( c, it.key() ) );
+          }
+        }
+      }
+    }
+
+    static void toCsr( const QVector< QVector<int> >& lists, QVector<int>& start, QVector<int>& items )
+    {
+      start.resize( lists.size() + 1 );
+      items.clear();
+      for ( int i = 0; i < lists.size(); ++i )
+      {
+        start[i] = items.size();
+        items += lists.at( i );
+      }
+      start[lists.size()] = items.size();
+    }
+};
+
+/// @endcond
+
+QgsCompactGraph::QgsCompactGraph( const QgsGraph* graph, int criterionNum )
+    : mCostPerDistance( 0 )
+    , mHasContractionHierarchy( false )
+{
+  int nVertices = graph->vertexCount();
+  int nArcs = graph->arcCount();
+
+  mX.resize( nVertices );
+  mY.resize( nVertices );
+  for ( int i = 0; i < nVertices; ++i )
+  {
+    QgsPoint pt = graph->vertex( i ).point();
+    mX[i] = pt.x();
+    mY[i] = pt.y();
+  }
+
+  mArcFrom.resize( nArcs );
+  mArcTo.resize( nArcs );
+  mArcCost.resize( nArcs );
+  mOutStart.fill( 0, nVertices + 1 );
+  mInStart.fill( 0, nVertices + 1 );
+  double costPerDistance = INF_COST;
+  for ( int i = 0; i < nArcs; ++i )
+  {
+    const QgsGraphArc& arc = graph->arc( i );
+    mArcFrom[i] = arc.outVertex();
+    mArcTo[i] = arc.inVertex();
+    mArcCost[i] = arc.property( criterionNum ).toDouble();
+    ++mOutStart[mArcFrom[i] + 1];
+    ++mInStart[mArcTo[i] + 1];
+
+    double dx = mX.at( mArcTo[i] ) - mX.at( mArcFrom[i] );
+    double dy = mY.at( mArcTo[i] ) - mY.at( mArcFrom[i] );
+    double distance = sqrt( dx * dx + dy * dy );
+    if ( distance > 0 )
+      costPerDistance = qMin( costPerDistance, mArcCost[i] / distance );
+  }
+  // the heuristic of A* must not overestimate the cost of any arc
+  mCostPerDistance = costPerDistance == INF_COST || costPerDistance < 0 ? 0 : costPerDistance;
+
+  for ( int i = 0; i < nVertices; ++i )
+  {
+    mOutStart[i + 1] += mOutStart[i];
+    mInStart[i + 1] += mInStart[i];
+  }
+
+  mOutArcs.resize( nArcs );
+  mInArcs.resize( nArcs );
+  QVector<int> nextOut = mOutStart;
+  QVector<int> nextIn = mInStart;
+  for ( int i = 0; i < nArcs; ++i )
+  {
+    mOutArcs[nextOut[mArcFrom[i]]++] = i;
+    mInArcs[nextIn[mArcTo[i]]++] = i;
+  }
+}
+
+double QgsCompactGraph::shortestPath( int fromVertexIdx, int toVertexIdx, QVector<int>* arcs, SearchAlgorithm algorithm ) const
+{
+  if ( arcs )
+    arcs->clear();
+
+  if ( fromVertexIdx < 0 || fromVertexIdx >= vertexCount() || toVertexIdx < 0 || toVertexIdx >= vertexCount() )
+    return INF_COST;
+
+  if ( fromVertexIdx == toVertexIdx )
+    return 0.0;
+
+  switch ( algorithm )
+  {
+    case AStar:
+      return aStar( fromVertexIdx, toVertexIdx, arcs );
+    case ContractionHierarchy:
+      if ( mHasContractionHierarchy )
+        return contractionHierarchyQuery( fromVertexIdx, toVertexIdx, arcs );
+      break;
+    case BidirectionalDijkstra:
+      break;
+  }
+  return bidirectionalDijkstra( fromVertexIdx, toVertexIdx, arcs );
+}
+
+void QgsCompactGraph::buildContractionHierarchy()
+{
+  QgsContractionHierarchyBuilder builder( *this );
+  builder.build();
+}
+
+double QgsCompactGraph::bidirectionalDijkstra( int from, int to, QVector<int>* arcs ) const
+{
+  QgsGraphSearchLabels forward;
+  QgsGraphSearchLabels backward;
+  QgsGraphQueue forwardQueue;
+  QgsGraphQueue backwardQueue;
+  forward[from].cost = 0;
+  backward[to].cost = 0;
+  forwardQueue.push( QgsGraphQueueEntry( 0, from ) );
+  backwardQueue.push( QgsGraphQueueEntry( 0, to ) );
+
+  double best = INF_COST;
+  int meet = -1;
+  while ( !forwardQueue.empty() || !backwardQueue.empty() )
+  {
+    double forwardMin = forwardQueue.empty() ? INF_COST : forwardQueue.top().first;
+    double backwardMin = backwardQueue.empty() ? INF_COST : backwardQueue.top().first;
+    if ( forwardMin + backwardMin >= best )
+      break;
+
+    // continue the search with the smaller radius
+    bool isForward = forwardMin <= backwardMin;
+    QgsGraphQueue& queue = isForward ? forwardQueue : backwardQueue;
+    QgsGraphSearchLabels& labels = isForward ? forward : backward;
+    const QgsGraphSearchLabels& otherLabels = isForward ? backward : forward;
+    const QVector<int>& start = isForward ? mOutStart : mInStart;
+    const QVector<int>& vertexArcs = isForward ? mOutArcs : mInArcs;
+    const QVector<int>& arcEnd = isForward ? mArcTo : mArcFrom;
+
+    QgsGraphQueueEntry entry = queue.top();
+    queue.pop();
+    int u = entry.second;
+    if ( entry.first > labels.value( u ).cost )
+      continue;
+
+    for ( int i = start.at( u ); i < start.at( u + 1 ); ++i )
+    {
+      int arc = vertexArcs.at( i );
+      int v = arcEnd.at( arc );
+      double cost = entry.first + mArcCost.at( arc );
+      QgsGraphSearchLabel& label = labels[v];
+      if ( cost >= label.cost )
+        continue;
+
+      label.cost = cost;
+      label.arc = arc;
+      queue.push( QgsGraphQueueEntry( cost, v ) );
+
+      QgsGraphSearchLabels::const_iterator other = otherLabels.constFind( v );
+      if ( other != otherLabels.constEnd() && cost + other.value().cost < best )
+      {
+        best = cost + other.value().cost;
+        meet = v;
+      }
+    }
+  }
+
+  if ( arcs && meet >= 0 )
+    collectPath( forward, backward, meet, mArcFrom, mArcTo, *arcs );
+  return best;
+}
+
+double QgsCompactGraph::aStar( int from, int to, QVector<int>* arcs ) const
+{
+  double toX = mX.at( to );
+  double toY = mY.at( to );
+
+  QgsGraphSearchLabels labels;
+  QgsGraphQueue queue;
+  labels[from].cost = 0;
+  queue.push( QgsGraphQueueEntry( mCostPerDistance * sqrt(( mX.at( from ) - toX ) * ( mX.at( from ) - toX ) + ( mY.at( from ) - toY ) * ( mY.at( from ) - toY ) ), from ) );
+
+  while ( !queue.empty() )
+  {
+    QgsGraphQueueEntry entry = queue.top();
+    queue.pop();
+    int u = entry.second;
+    if ( u == to )
+      break;
+
+    double uCost = labels.value( u ).cost;
+    double uEstimate = mCostPerDistance * sqrt(( mX.at( u ) - toX ) * ( mX.at( u ) - toX ) + ( mY.at( u ) - toY ) * ( mY.at( u ) - toY ) );
+    if ( entry.first > uCost + uEstimate )
+      continue;
+
+    for ( int i = mOutStart.at( u ); i < mOutStart.at( u + 1 ); ++i )
+    {
+      int arc = mOutArcs.at( i );
+      int v = mArcTo.at( arc );
+      double cost = uCost + mArcCost.at( arc );
+      QgsGraphSearchLabel& label = labels[v];
+      if ( cost >= label.cost )
+        continue;
+
+      label.cost = cost;
+      label.arc = arc;
+      double estimate = mCostPerDistance * sqrt(( mX.at( v ) - toX ) * ( mX.at( v ) - toX ) + ( mY.at( v ) - toY ) * ( mY.at( v ) - toY ) );
+      queue.push( QgsGraphQueueEntry( cost + estimate, v ) );
+    }
+  }
+
+  QgsGraphSearchLabels::const_iterator target = labels.constFind( to );
+  if ( target == labels.constEnd() )
+    return INF_COST;
+
+  if ( arcs )
+    collectPath( labels, QgsGraphSearchLabels(), to, mArcFrom, mArcTo, *arcs );
+  return target.value().cost;
+}
+
+double QgsCompactGraph::contractionHierarchyQuery( int from, int to, QVector<int>* arcs ) const
+{
+  // both searches only follow arcs towards more important vertices
+  QgsGraphSearchLabels forward;
+  QgsGraphSearchLabels backward;
+  QgsGraphQueue forwardQueue;
+  QgsGraphQueue backwardQueue;
+  forward[from].cost = 0;
+  backward[to].cost = 0;
+  forwardQueue.push( QgsGraphQueueEntry( 0, from ) );
+  backwardQueue.push( QgsGraphQueueEntry( 0, to ) );
+
+  double best = INF_COST;
+  int meet = -1;
+  for ( ;; )
+  {
+    // a search is finished when it cannot find a shorter path
+    double forwardMin = forwardQueue.empty() ? INF_COST : forwardQueue.top().first;
+    double backwardMin = backwardQueue.empty() ? INF_COST : backwardQueue.top().first;
+    if ( forwardMin >= best && backwardMin >= best )
+      break;
+
+    bool isForward = forwardMin <= backwardMin;
+    QgsGraphQueue& queue = isForward ? forwardQueue : backwardQueue;
+    QgsGraphSearchLabels& labels = isForward ? forward : backward;
+    const QgsGraphSearchLabels& otherLabels = isForward ? backward : forward;
+    const QVector<int>& start = isForward ? mChUpStart : mChDownStart;
+    const QVector<int>& vertexArcs = isForward ? mChUpArcs : mChDownArcs;
+
+    QgsGraphQueueEntry entry = queue.top();
+    queue.pop();
+    int u = entry.second;
+    if ( entry.first > labels.value( u ).cost )
+      continue;
+
+    for ( int i = start.at( u ); i < start.at( u + 1 ); ++i )
+    {
+      const ChArc& chArc = mChArcs.at( vertexArcs.at( i ) );
+      int v = isForward ? chArc.to : chArc.from;
+      double cost = entry.first + chArc.cost;
+      QgsGraphSearchLabel& label = labels[v];
+      if ( cost >= label.cost )
+        continue;
+
+      label.cost = cost;
+      label.arc = vertexArcs.at( i );
+      queue.push( QgsGraphQueueEntry( cost, v ) );
+
+      QgsGraphSearchLabels::const_iterator other = otherLabels.constFind( v );
+      if ( other != otherLabels.constEnd() && cost + other.value().cost < best )
+      {
+        best = cost + other.value().cost;
+        meet = v;
+      }
+    }
+  }
+
+  if ( arcs && meet >= 0 )
+  {
+    QVector<int> chPath;
+    for ( int v = meet; forward.value( v ).arc >= 0; v = mChArcs.at( forward.value( v ).arc ).from )
+      chPath.prepend( forward.value( v ).arc );
+    for ( int v = meet; backward.value( v ).arc >= 0; v = mChArcs.at( backward.value( v ).arc ).to )
+      chPath << backward.value( v ).arc;
+
+    Q_FOREACH ( int chArc, chPath )
+      unpackChArc( chArc, *arcs );
+  }
+  return best;
+}
+
+void QgsCompactGraph::unpackChArc( int chArc, QVector<int>& arcs ) const
+{
+  QVector<int> stack;
+  stack << chArc;
+  while ( !stack.isEmpty() )
+  {
+    const ChArc& arc = mChArcs.at( stack.last() );
+    stack.remove( stack.size() - 1 );
+    if ( arc.arc >= 0 )
+    {
+      arcs << arc.arc;
+    }
+    else
+    {
+      // replaced arcs in reverse order, the first one is unpacked first
+      stack << arc.second << arc.first;
+    }
+  }
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+    qgscompactgraph.h
+    --------------------------------------
+    Date                 : November 2015
+    Copyright            : (C) 2015 by the QGIS Development Team
+    Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSCOMPACTGRAPH_H
+#define QGSCOMPACTGRAPH_H
+
+#include <QVector>
+
+class QgsGraph;
+
+/**
+ * \ingroup networkanalysis
+ * \class QgsCompactGraph
+ * \brief A read-only copy of a QgsGraph for fast point to point shortest path queries.
+ *
+ * The arcs are stored in compressed sparse row form: the arcs of all vertices in one array,
+ * ordered by vertex, with the cost of one arc property as a number. Vertex and arc indexes
+ * are the ones of the source graph.
+ *
+ * Queries do not modify the graph, so several threads can run queries at the same time.
+ * Costs must not be negative.
+ *
+ * \note added in QGIS 2.14
+ */
+class ANALYSIS_EXPORT QgsCompactGraph
+{
+  public:
+    //! Algorithms for shortest path queries
+    enum SearchAlgorithm
+    {
+      BidirectionalDijkstra, //!< Dijkstra's algorithm searching from both ends of the path
+      AStar, //!< A* search with the straight line distance to the end vertex as lower bound of the cost
+      ContractionHierarchy //!< Search in the contraction hierarchy, see buildContractionHierarchy()
+    };
+
+    /**
+     * Creates a compact copy of a graph
+     * @param graph source graph
+     * @param criterionNum index of the arc property used as cost
+     */
+    QgsCompactGraph( const QgsGraph* graph, int criterionNum );
+
+    /** Returns the number of vertices */
+    int vertexCount() const { return mX.size(); }
+
+    /** Returns the number of arcs */
+    int arcCount() const { return mArcCost.size(); }
+
+    /** Returns the cost of an arc */
+    double arcCost( int arcIdx ) const { return mArcCost.at( arcIdx ); }
+
+    /**
+     * Finds the shortest path between two vertices
+     * @param fromVertexIdx index of the start vertex
+     * @param toVertexIdx index of the end vertex
+     * @param arcs if not null, set to the indexes of the arcs of the path from the start to the end vertex
+     * @param algorithm search algorithm. ContractionHierarchy falls back to BidirectionalDijkstra
+     * if the hierarchy has not been built.
+     * @returns cost of the path, infinity if the end vertex cannot be reached
+     */
+    double shortestPath( int fromVertexIdx, int toVertexIdx, QVector<int>* arcs = 0, SearchAlgorithm algorithm = BidirectionalDijkstra ) const;
+
+    /**
+     * Builds a contraction hierarchy of the graph. Vertices are contracted in order of importance and
+     * shortcut arcs are added, so that queries only have to search towards more important vertices.
+     * Building the hierarchy takes time, but queries are much faster than with the other algorithms.
+     */
+    void buildContractionHierarchy();
+
+    /** Returns true if buildContractionHierarchy() has been called */
+    bool hasContractionHierarchy() const { return mHasContractionHierarchy; }
+
+  private:
+    double bidirectionalDijkstra( int from, int to, QVector<int>* arcs ) const;
+    double aStar( int from, int to, QVector<int>* arcs ) const;
+    double contractionHierarchyQuery( int from, int to, QVector<int>* arcs ) const;
+
+    /** Adds the original arcs of a hierarchy arc to a path */
+    void unpackChArc( int chArc, QVector<int>& arcs ) const;
+
+    //! vertex coordinates
+    QVector<double> mX;
+    QVector<double> mY;
+
+    //! outgoing arcs of vertex v are mOutArcs[mOutStart[v]] to mOutArcs[mOutStart[v + 1] - 1]
+    QVector<int> mOutStart;
+    QVector<int> mOutArcs;
+    //! incoming arcs of vertex v are mInArcs[mInStart[v]] to mInArcs[mInStart[v + 1] - 1]
+    QVector<int> mInStart;
+    QVector<int> mInArcs;
+
+    //! start vertex, end vertex and cost of each arc, by arc index of the source graph
+    QVector<int> mArcFrom;
+    QVector<int> mArcTo;
+    QVector<double> mArcCost;
+
+    //! lower bound of the cost of a path per unit of straight line distance, for A*
+    double mCostPerDistance;
+
+    //! arcs of the contraction hierarchy: original arcs and shortcuts
+    struct ChArc
+    {
+      int from;
+      int to;
+      double cost;
+      //! index of the original arc or -1 for shortcuts
+      int arc;
+      //! the two hierarchy arcs a shortcut replaces
+      int first;
+      int second;
+    };
+    bool mHasContractionHierarchy;
+    QVector<ChArc> mChArcs;
+    //! hierarchy arcs from vertex v to more important vertices: mChUpArcs[mChUpStart[v]] to mChUpArcs[mChUpStart[v + 1] - 1]
+    QVector<int> mChUpStart;
+    QVector<int> mChUpArcs;
+    //! hierarchy arcs to vertex v from more important vertices
+    QVector<int> mChDownStart;
+    QVector<int> mChDownArcs;
+
+    friend class QgsContractionHierarchyBuilder;
+};
+
+#endif // QGSCOMPACTGRAPH_H
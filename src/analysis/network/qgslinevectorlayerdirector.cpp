@@ -23,80 +23,233 @@
 #include <qgspoint.h>
 #include <qgsgeometry.h>
 #include <qgsdistancearea.h>
+#include <qgsrectangle.h>
 
 // QT includes
+#include <QHash>
+#include <QMap>
 #include <QString>
 #include <QtAlgorithms>
+#include <QtConcurrentMap>
 
 //standard includes
 #include <limits>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 
-class QgsPointCompare
+struct TiePointInfo
+{
+  QgsPoint mTiedPoint;
+  double mLength;
+  QgsPoint mFirstPoint;
+  QgsPoint mLastPoint;
+};
+
+struct TieSegment
+{
+  QgsPoint mFirstPoint;
+  QgsPoint mLastPoint;
+};
+
+// key of a graph vertex: the cell of the topology tolerance grid or the exact coordinates
+typedef QPair< qint64, qint64 > VertexKey;
+
+static VertexKey vertexKey( const QgsPoint& pt, double tolerance )
+{
+  if ( tolerance > 0 )
+    return VertexKey( static_cast< qint64 >( ceil( pt.x() / tolerance ) ), static_cast< qint64 >( ceil( pt.y() / tolerance ) ) );
+
+  // adding 0.0 turns -0.0 into 0.0, which are the same coordinate
+  double x = pt.x() + 0.0;
+  double y = pt.y() + 0.0;
+  qint64 kx, ky;
+  memcpy( &kx, &x, sizeof( double ) );
+  memcpy( &ky, &y, sizeof( double ) );
+  return VertexKey( kx, ky );
+}
+
+// key of a segment for finding the tie points on it
+typedef QPair< QPair< double, double >, QPair< double, double > > TieSegmentKey;
+
+static TieSegmentKey tieSegmentKey( const QgsPoint& pt1, const QgsPoint& pt2 )
+{
+  return TieSegmentKey( qMakePair( pt1.x(), pt1.y() ), qMakePair( pt2.x(), pt2.y() ) );
+}
+
+/**
+ * Uniform grid over the segments of the layer, each segment is in the cells of its bounding box.
+ * Tie points are projected to the closest segment by searching rings of cells around the point.
+ */
+class TieSegmentIndex
 {
   public:
-    explicit QgsPointCompare( double tolerance )
-        : mTolerance( tolerance )
-    {  }
+    explicit TieSegmentIndex( const QVector< TieSegment >& segments )
+        : mSegments( segments )
+        , mCellSize( 1.0 )
+        , mCols( 1 )
+        , mRows( 1 )
+    {
+      if ( segments.isEmpty() )
+        return;
+
+      mExtent = segmentRect( segments.at( 0 ) );
+      for ( int i = 1; i < segments.size(); ++i )
+        mExtent.unionRect( segmentRect( segments.at( i ) ) );
+
+      // about one cell per segment
+      int n = segments.size();
+      double width = mExtent.width();
+      double height = mExtent.height();
+      if ( width > 0 && height > 0 )
+        mCellSize = sqrt( width * height / n );
+      else if ( width > 0 || height > 0 )
+        mCellSize = qMax( width, height ) / n;
+      mCols = qBound( 1, static_cast< int >( ceil( width / mCellSize ) ), n );
+      mRows = qBound( 1, static_cast< int >( ceil( height / mCellSize ) ), n );
+
+      mCellStart.fill( 0, mCols * mRows + 1 );
+      for ( int pass = 0; pass < 2; ++pass )
+      {
+        QVector< int > next = mCellStart;
+        for ( int i = 0; i < n; ++i )
+        {
+          QgsRectangle rect = segmentRect( segments.at( i ) );
+          int col1 = col( rect.xMinimum() ), col2 = col( rect.xMaximum() );
+          int row1 = row( rect.yMinimum() ), row2 = row( rect.yMaximum() );
+          for ( int r = row1; r <= row2; ++r )
+          {
+            for ( int c = col1; c <= col2; ++c )
+            {
+              if ( pass == 0 )
+                ++mCellStart[ r * mCols + c + 1 ];
+              else
+                mCellSegments[ next[ r * mCols + c ]++ ] = i;
+            }
+          }
+        }
+
+        if ( pass == 0 )
+        {
+          for ( int i = 0; i < mCols * mRows; ++i )
+            mCellStart[ i + 1 ] += mCellStart[ i ];
+          mCellSegments.resize( mCellStart.last() );
+        }
+      }
+    }
 
-    bool operator()( const QgsPoint& p1, const QgsPoint& p2 ) const
+    // finds the closest segment to a point, the first one in layer order if several are as close
+    void tie( const QgsPoint& point, TiePointInfo& info ) const
     {
-      if ( mTolerance <= 0 )
-        return p1.x() == p2.x() ? p1.y() < p2.y() : p1.x() < p2.x();
-
-      double tx1 = ceil( p1.x() / mTolerance );
-      double tx2 = ceil( p2.x() / mTolerance );
-      if ( tx1 == tx2 )
-        return ceil( p1.y() / mTolerance ) < ceil( p2.y() / mTolerance );
-      return tx1 < tx2;
+      info.mLength = std::numeric_limits<double>::infinity();
+      if ( mSegments.isEmpty() )
+        return;
+
+      int bestSegment = -1;
+      int pc = col( point.x() );
+      int pr = row( point.y() );
+      for ( int ring = 0; ; ++ring )
+      {
+        for ( int r = qMax( 0, pr - ring ); r <= qMin( mRows - 1, pr + ring ); ++r )
+        {
+          if ( r == pr - ring || r == pr + ring )
+          {
+            for ( int c = qMax( 0, pc - ring ); c <= qMin( mCols - 1, pc + ring ); ++c )
+              tieInCell( r * mCols + c, point, info, bestSegment );
+          }
+          else
+          {
+            if ( pc - ring >= 0 )
+              tieInCell( r * mCols + pc - ring, point, info, bestSegment );
+            if ( pc + ring < mCols )
+              tieInCell( r * mCols + pc + ring, point, info, bestSegment );
+          }
+        }
+
+        // segments which are not in the searched cells are at least this far from the point
+        double bound = std::numeric_limits<double>::infinity();
+        if ( pc - ring > 0 )
+          bound = qMin( bound, point.x() - ( mExtent.xMinimum() + ( pc - ring ) * mCellSize ) );
+        if ( pc + ring < mCols - 1 )
+          bound = qMin( bound, mExtent.xMinimum() + ( pc + ring + 1 ) * mCellSize - point.x() );
+        if ( pr - ring > 0 )
+          bound = qMin( bound, point.y() - ( mExtent.yMinimum() + ( pr - ring ) * mCellSize ) );
+        if ( pr + ring < mRows - 1 )
+          bound = qMin( bound, mExtent.yMinimum() + ( pr + ring + 1 ) * mCellSize - point.y() );
+
+        if ( bound == std::numeric_limits<double>::infinity() )
+          return; // all cells searched
+        if ( bound > 0 && info.mLength < bound * bound )
+          return;
+      }
     }
 
   private:
-    double mTolerance;
-};
+    const QVector< TieSegment >& mSegments;
+    QgsRectangle mExtent;
+    double mCellSize;
+    int mCols;
+    int mRows;
+    //! segments of cell i are mCellSegments[mCellStart[i]] to mCellSegments[mCellStart[i + 1] - 1]
+    QVector< int > mCellStart;
+    QVector< int > mCellSegments;
+
+    void tieInCell( int cell, const QgsPoint& point, TiePointInfo& info, int& bestSegment ) const
+    {
+      for ( int i = mCellStart.at( cell ); i < mCellStart.at( cell + 1 ); ++i )
+      {
+        int segment = mCellSegments.at( i );
+        const TieSegment& s = mSegments.at( segment );
+        QgsPoint tiedPoint;
+        double length;
+        if ( s.mFirstPoint == s.mLastPoint )
+        {
+          length = point.sqrDist( s.mFirstPoint );
+          tiedPoint = s.mFirstPoint;
+        }
+        else
+        {
+          length = point.sqrDistToSegment( s.mFirstPoint.x(), s.mFirstPoint.y(),
+                                           s.mLastPoint.x(), s.mLastPoint.y(), tiedPoint );
+        }
 
-template <typename RandIter, typename Type, typename CompareOp > RandIter my_binary_search( RandIter begin, RandIter end, Type val, CompareOp comp )
-{
-  // result if not found
-  RandIter not_found = end;
+        if ( length < info.mLength || ( length == info.mLength && segment < bestSegment ) )
+        {
+          info.mLength = length;
+          info.mTiedPoint = tiedPoint;
+          info.mFirstPoint = s.mFirstPoint;
+          info.mLastPoint = s.mLastPoint;
+          bestSegment = segment;
+        }
+      }
+    }
 
-  while ( true )
-  {
-    RandIter avg = begin + ( end - begin ) / 2;
-    if ( begin == avg || end == avg )
+    static QgsRectangle segmentRect( const TieSegment& s )
     {
-      if ( !comp( *begin, val ) && !comp( val, *begin ) )
-        return begin;
-      if ( !comp( *end, val ) && !comp( val, *end ) )
-        return end;
+      return QgsRectangle( s.mFirstPoint, s.mLastPoint );
+    }
 
-      return not_found;
+    int col( double x ) const
+    {
+      return qBound( 0, static_cast< int >( floor(( x - mExtent.xMinimum() ) / mCellSize ) ), mCols - 1 );
     }
-    if ( comp( val, *avg ) )
-      end = avg;
-    else if ( comp( *avg, val ) )
-      begin = avg;
-    else
-      return avg;
-  }
 
-  return not_found;
-}
+    int row( double y ) const
+    {
+      return qBound( 0, static_cast< int >( floor(( y - mExtent.yMinimum() ) / mCellSize ) ), mRows - 1 );
+    }
+};
 
-struct TiePointInfo
+struct TiePointTask
 {
-  QgsPoint mTiedPoint;
-  double mLength;
-  QgsPoint mFirstPoint;
-  QgsPoint mLastPoint;
+  const TieSegmentIndex* mIndex;
+  QgsPoint mPoint;
+  TiePointInfo mInfo;
 };
 
-bool TiePointInfoCompare( const TiePointInfo& a, const TiePointInfo& b )
+static void tiePoint( TiePointTask& task )
 {
-  if ( a.mFirstPoint == b.mFirstPoint )
-    return a.mLastPoint.x() == b.mLastPoint.x() ? a.mLastPoint.y() < b.mLastPoint.y() : a.mLastPoint.x() < b.mLastPoint.x();
-
-  return a.mFirstPoint.x() == b.mFirstPoint.x() ? a.mFirstPoint.y() < b.mFirstPoint.y() : a.mFirstPoint.x() < b.mFirstPoint.x();
+  task.mIndex->tie( task.mPoint, task.mInfo );
 }
 
 QgsLineVectorLayerDirector::QgsLineVectorLayerDirector( QgsVectorLayer *myLayer,
@@ -149,18 +302,17 @@ void QgsLineVectorLayerDirector::makeGraph( QgsGraphBuilderInterface *builder, c
 
   tiedPoint = QVector< QgsPoint >( additionalPoints.size(), QgsPoint( 0.0, 0.0 ) );
 
-  TiePointInfo tmpInfo;
-  tmpInfo.mLength = std::numeric_limits<double>::infinity();
-
-  QVector< TiePointInfo > pointLengthMap( additionalPoints.size(), tmpInfo );
-  QVector< TiePointInfo >::iterator pointLengthIt;
+  double tolerance = builder->topologyTolerance();
 
-  //Graph's points;
+  //Graph's points, points closer than the topology tolerance are merged
   QVector< QgsPoint > points;
+  QHash< VertexKey, int > pointIndexes;
+
+  // segments of the layer, only needed for tying points
+  QVector< TieSegment > segments;
 
   QgsFeatureIterator fit = vl->getFeatures( QgsFeatureRequest().setSubsetOfAttributes( QgsAttributeList() ) );
 
-  // begin: tie points to the graph
   QgsAttributeList la;
   QgsFeature feature;
   while ( fit.nextFeature( feature ) )
@@ -180,35 +332,20 @@ void QgsLineVectorLayerDirector::makeGraph( QgsGraphBuilderInterface *builder, c
       for ( pointIt = mplIt->begin(); pointIt != mplIt->end(); ++pointIt )
       {
         pt2 = ct.transform( *pointIt );
-        points.push_back( pt2 );
 
-        if ( !isFirstPoint )
+        VertexKey key = vertexKey( pt2, tolerance );
+        if ( !pointIndexes.contains( key ) )
         {
-          int i = 0;
-          for ( i = 0; i != additionalPoints.size(); ++i )
-          {
-            TiePointInfo info;
-            if ( pt1 == pt2 )
-            {
-              info.mLength = additionalPoints[ i ].sqrDist( pt1 );
-              info.mTiedPoint = pt1;
-            }
-            else
-            {
-              info.mLength = additionalPoints[ i ].sqrDistToSegment( pt1.x(), pt1.y(),
-                             pt2.x(), pt2.y(), info.mTiedPoint );
-            }
-
-            if ( pointLengthMap[ i ].mLength > info.mLength )
-            {
-              Q_UNUSED( info.mTiedPoint );
-              info.mFirstPoint = pt1;
-              info.mLastPoint = pt2;
+          pointIndexes.insert( key, points.size() );
+          points.push_back( pt2 );
+        }
 
-              pointLengthMap[ i ] = info;
-              tiedPoint[ i ] = info.mTiedPoint;
-            }
-          }
+        if ( !isFirstPoint && !additionalPoints.isEmpty() )
+        {
+          TieSegment segment;
+          segment.mFirstPoint = pt1;
+          segment.mLastPoint = pt2;
+          segments.push_back( segment );
         }
         pt1 = pt2;
         isFirstPoint = false;
@@ -216,6 +353,31 @@ void QgsLineVectorLayerDirector::makeGraph( QgsGraphBuilderInterface *builder, c
     }
     emit buildProgress( ++step, featureCount );
   }
+
+  // begin: tie points to the graph
+  QMultiMap< TieSegmentKey, QgsPoint > tiedPointsOnSegment;
+  if ( !additionalPoints.isEmpty() )
+  {
+    TieSegmentIndex index( segments );
+    QVector< TiePointTask > tasks( additionalPoints.size() );
+    for ( int i = 0; i < additionalPoints.size(); ++i )
+    {
+      tasks[ i ].mIndex = &index;
+      tasks[ i ].mPoint = additionalPoints[ i ];
+    }
+    QtConcurrent::blockingMap( tasks, tiePoint );
+
+    for ( int i = 0; i < tasks.size(); ++i )
+    {
+      const TiePointInfo& info = tasks[ i ].mInfo;
+      if ( info.mLength == std::numeric_limits<double>::infinity() )
+        continue;
+
+      tiedPoint[ i ] = info.mTiedPoint;
+      tiedPointsOnSegment.insert( tieSegmentKey( info.mFirstPoint, info.mLastPoint ), info.mTiedPoint );
+    }
+  }
+  segments.clear();
   // end: tie points to graph
 
   // add tied point to graph
@@ -224,24 +386,19 @@ void QgsLineVectorLayerDirector::makeGraph( QgsGraphBuilderInterface *builder, c
   {
     if ( tiedPoint[ i ] != QgsPoint( 0.0, 0.0 ) )
     {
-      points.push_back( tiedPoint [ i ] );
+      VertexKey key = vertexKey( tiedPoint[ i ], tolerance );
+      if ( !pointIndexes.contains( key ) )
+      {
+        pointIndexes.insert( key, points.size() );
+        points.push_back( tiedPoint[ i ] );
+      }
+      tiedPoint[ i ] = points[ pointIndexes.value( key )];
     }
   }
 
-  QgsPointCompare pointCompare( builder->topologyTolerance() );
-
-  qSort( points.begin(), points.end(), pointCompare );
-  QVector< QgsPoint >::iterator tmp = std::unique( points.begin(), points.end() );
-  points.resize( tmp - points.begin() );
-
   for ( i = 0;i < points.size();++i )
     builder->addVertex( i, points[ i ] );
 
-  for ( i = 0; i < tiedPoint.size() ; ++i )
-    tiedPoint[ i ] = *( my_binary_search( points.begin(), points.end(), tiedPoint[ i ], pointCompare ) );
-
-  qSort( pointLengthMap.begin(), pointLengthMap.end(), TiePointInfoCompare );
-
   {
     // fill attribute list 'la'
     QgsAttributeList tmpAttr;
@@ -322,29 +479,11 @@ void QgsLineVectorLayerDirector::makeGraph( QgsGraphBuilderInterface *builder, c
           pointsOnArc[ 0.0 ] = pt1;
           pointsOnArc[ pt1.sqrDist( pt2 )] = pt2;
 
-          TiePointInfo t;
-          t.mFirstPoint = pt1;
-          t.mLastPoint  = pt2;
-          t.mLength = 0.0;
-          pointLengthIt = my_binary_search( pointLengthMap.begin(), pointLengthMap.end(), t, TiePointInfoCompare );
-
-          if ( pointLengthIt != pointLengthMap.end() )
+          TieSegmentKey segmentKey = tieSegmentKey( pt1, pt2 );
+          QMultiMap< TieSegmentKey, QgsPoint >::const_iterator tieIt = tiedPointsOnSegment.constFind( segmentKey );
+          for ( ; tieIt != tiedPointsOnSegment.constEnd() && tieIt.key() == segmentKey; ++tieIt )
           {
-            QVector< TiePointInfo >::iterator it;
-            for ( it = pointLengthIt; it - pointLengthMap.begin() >= 0; --it )
-            {
-              if ( it->mFirstPoint == pt1 && it->mLastPoint == pt2 )
-              {
-                pointsOnArc[ pt1.sqrDist( it->mTiedPoint )] = it->mTiedPoint;
-              }
-            }
-            for ( it = pointLengthIt + 1; it != pointLengthMap.end(); ++it )
-            {
-              if ( it->mFirstPoint == pt1 && it->mLastPoint == pt2 )
-              {
-                pointsOnArc[ pt1.sqrDist( it->mTiedPoint )] = it->mTiedPoint;
-              }
-            }
+            pointsOnArc[ pt1.sqrDist( tieIt.value() )] = tieIt.value();
           }
 
           std::map< double, QgsPoint >::iterator pointsIt;
@@ -354,10 +493,8 @@ void QgsLineVectorLayerDirector::makeGraph( QgsGraphBuilderInterface *builder, c
           bool isFirstPoint = true;
           for ( pointsIt = pointsOnArc.begin(); pointsIt != pointsOnArc.end(); ++pointsIt )
           {
-            pt2 = pointsIt->second;
-            tmp = my_binary_search( points.begin(), points.end(), pt2, pointCompare );
-            pt2 = *tmp;
-            pt2idx = tmp - points.begin();
+            pt2idx = pointIndexes.value( vertexKey( pointsIt->second, tolerance ) );
+            pt2 = points[ pt2idx ];
 
             if ( !isFirstPoint && pt1 != pt2 )
             {
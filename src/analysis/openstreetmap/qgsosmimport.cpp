@@ -14,10 +14,135 @@
  ***************************************************************************/
 
 #include "qgsosmimport.h"
+#include "qgsosmpbfreader.h"
 #include "qgsslconnect.h"
 
 #include <QStringList>
+#include <QThread>
 #include <QXmlStreamReader>
+#include <QtConcurrentMap>
+
+// rows inserted by one statement, within the default limit of 999 parameters of SQLite
+static const int BULK_INSERT_ROWS = 100;
+
+/// @cond
+
+// Inserts rows into a table with statements of many rows. Values are kept until the rows are inserted.
+class QgsOSMBulkInsert
+{
+  public:
+    QgsOSMBulkInsert( sqlite3* database, const QString& table, int columnCount )
+        : mDatabase( database )
+        , mTable( table )
+        , mColumnCount( columnCount )
+        , mStmtRow( 0 )
+        , mStmtBulk( 0 )
+        , mRowCount( 0 )
+        , mOk( true )
+    {
+      QStringList params;
+      for ( int i = 0; i < columnCount; ++i )
+        params << "?";
+      QString row = QString( "(%1)" ).arg( params.join( "," ) );
+      QString sql = QString( "INSERT INTO %1 VALUES " ).arg( table );
+      mOk = sqlite3_prepare_v2( mDatabase, ( sql + row ).toUtf8().constData(), -1, &mStmtRow, 0 ) == SQLITE_OK;
+
+      // multi-row inserts need SQLite 3.7.11, otherwise rows are inserted one by one
+      QStringList rows;
+      for ( int i = 0; i < BULK_INSERT_ROWS; ++i )
+        rows << row;
+      if ( sqlite3_prepare_v2( mDatabase, ( sql + rows.join( "," ) ).toUtf8().constData(), -1, &mStmtBulk, 0 ) != SQLITE_OK )
+        mStmtBulk = 0;
+
+      mValues.reserve( BULK_INSERT_ROWS * columnCount );
+    }
+
+    ~QgsOSMBulkInsert()
+    {
+      sqlite3_finalize( mStmtRow );
+      sqlite3_finalize( mStmtBulk );
+    }
+
+    void addInt64( qint64 value ) { Value v; v.type = Value::Int64; v.i = value; mValues << v; }
+    void addDouble( double value ) { Value v; v.type = Value::Double; v.d = value; mValues << v; }
+    void addText( const QByteArray& value ) { Value v; v.type = Value::Text; v.text = value; mValues << v; }
+
+    //! to be called after the values of each row have been added
+    bool endRow()
+    {
+      if ( ++mRowCount == BULK_INSERT_ROWS )
+        flush();
+      return mOk;
+    }
+
+    //! inserts the remaining rows
+    bool flush()
+    {
+      if ( mRowCount == BULK_INSERT_ROWS && mStmtBulk )
+      {
+        execute( mStmtBulk, 0, mValues.size() );
+      }
+      else
+      {
+        for ( int i = 0; i < mRowCount; ++i )
+          execute( mStmtRow, i * mColumnCount, mColumnCount );
+      }
+      mValues.resize( 0 );
+      mRowCount = 0;
+      return mOk;
+    }
+
+    QString errorString() const
+    {
+      return QString( "Storing %1 failed: %2" ).arg( mTable, QString::fromUtf8( sqlite3_errmsg( mDatabase ) ) );
+    }
+
+  private:
+    struct Value
+    {
+      enum Type { Int64, Double, Text };
+      Type type;
+      qint64 i;
+      double d;
+      QByteArray text;
+    };
+
+    sqlite3* mDatabase;
+    QString mTable;
+    int mColumnCount;
+    sqlite3_stmt* mStmtRow;
+    sqlite3_stmt* mStmtBulk;
+    QVector<Value> mValues;
+    int mRowCount;
+    bool mOk;
+
+    void execute( sqlite3_stmt* stmt, int first, int count )
+    {
+      if ( !mOk )
+        return;
+
+      for ( int i = 0; i < count; ++i )
+      {
+        const Value& value = mValues.at( first + i );
+        switch ( value.type )
+        {
+          case Value::Int64:
+            sqlite3_bind_int64( stmt, i + 1, value.i );
+            break;
+          case Value::Double:
+            sqlite3_bind_double( stmt, i + 1, value.d );
+            break;
+          case Value::Text:
+            sqlite3_bind_text( stmt, i + 1, value.text.constData(), value.text.size(), SQLITE_STATIC );
+            break;
+        }
+      }
+      mOk = sqlite3_step( stmt ) == SQLITE_DONE;
+      sqlite3_reset( stmt );
+    }
+};
+
+/// @endcond
 
 
 QgsOSMXmlImport::QgsOSMXmlImport( const QString& xmlFilename, const QString& dbFilename )
@@ -70,21 +195,30 @@ bool QgsOSMXmlImport::import()
 
   // start parsing
 
-  QXmlStreamReader xml( &mInputFile );
-
-  while ( !xml.atEnd() )
+  QXmlStreamReader xml;
+  bool pbfRes = true;
+  if ( isPbf() )
   {
-    xml.readNext();
-
-    if ( xml.isEndDocument() )
-      break;
+    pbfRes = readPbf();
+  }
+  else
+  {
+    xml.setDevice( &mInputFile );
 
-    if ( xml.isStartElement() )
+    while ( !xml.atEnd() )
     {
-      if ( xml.name() == "osm" )
-        readRoot( xml );
-      else
-        xml.raiseError( "Invalid root tag" );
+      xml.readNext();
+
+      if ( xml.isEndDocument() )
+        break;
+
+      if ( xml.isStartElement() )
+      {
+        if ( xml.name() == "osm" )
+          readRoot( xml );
+        else
+          xml.raiseError( "Invalid root tag" );
+      }
     }
   }
 
@@ -94,6 +228,12 @@ bool QgsOSMXmlImport::import()
 
   createIndexes();
 
+  if ( !pbfRes )
+  {
+    // mError is set in readPbf()
+    return false;
+  }
+
   if ( xml.hasError() )
   {
     mError = QString( "XML error: %1" ).arg( xml.errorString() );
@@ -399,3 +539,134 @@ void QgsOSMXmlImport::readWay( QXmlStreamReader& xml )
     }
   }
 }
+
+
+bool QgsOSMXmlImport::isPbf() const
+{
+  return mXmlFileName.endsWith( ".pbf", Qt::CaseInsensitive );
+}
+
+
+bool QgsOSMXmlImport::readPbf()
+{
+  QgsOSMPbfReader reader( &mInputFile );
+
+  QgsOSMBulkInsert insertNode( mDatabase, "nodes ( id, lat, lon )", 3 );
+  QgsOSMBulkInsert insertNodeTag( mDatabase, "nodes_tags ( id, k, v )", 3 );
+  QgsOSMBulkInsert insertWay( mDatabase, "ways ( id )", 1 );
+  QgsOSMBulkInsert insertWayNode( mDatabase, "ways_nodes ( way_id, node_id, way_pos )", 3 );
+  QgsOSMBulkInsert insertWayTag( mDatabase, "ways_tags ( id, k, v )", 3 );
+
+  // blocks are decoded by all threads at once, only this number of blocks is in memory
+  int maxBlocks = qMax( 1, QThread::idealThreadCount() ) * 2;
+  int percent = -1;
+  bool atEnd = false;
+  while ( !atEnd )
+  {
+    QList<QgsOSMPbfReader::Block> blocks;
+    while ( blocks.count() < maxBlocks )
+    {
+      QgsOSMPbfReader::Block block;
+      if ( !reader.readBlock( block ) )
+      {
+        atEnd = true;
+        break;
+      }
+      blocks << block;
+    }
+    if ( reader.hasError() )
+    {
+      mError = reader.errorString();
+      return false;
+    }
+
+    QtConcurrent::blockingMap( blocks, QgsOSMPbfReader::decode );
+
+    // rows are inserted in the order of the file
+    Q_FOREACH ( const QgsOSMPbfReader::Block& block, blocks )
+    {
+      if ( !block.error.isEmpty() )
+      {
+        mError = block.error;
+        return false;
+      }
+
+      Q_FOREACH ( const QgsOSMPbfReader::Node& node, block.nodes )
+      {
+        insertNode.addInt64( node.id );
+        insertNode.addDouble( node.lat );
+        insertNode.addDouble( node.lon );
+        if ( !insertNode.endRow() )
+        {
+          mError = insertNode.errorString();
+          return false;
+        }
+      }
+
+      Q_FOREACH ( const QgsOSMPbfReader::Tag& tag, block.nodeTags )
+      {
+        insertNodeTag.addInt64( tag.id );
+        insertNodeTag.addText( tag.key );
+        insertNodeTag.addText( tag.value );
+        if ( !insertNodeTag.endRow() )
+        {
+          mError = insertNodeTag.errorString();
+          return false;
+        }
+      }
+
+      Q_FOREACH ( QgsOSMId id, block.ways )
+      {
+        insertWay.addInt64( id );
+        if ( !insertWay.endRow() )
+        {
+          mError = insertWay.errorString();
+          return false;
+        }
+      }
+
+      Q_FOREACH ( const QgsOSMPbfReader::WayNode& wayNode, block.wayNodes )
+      {
+        insertWayNode.addInt64( wayNode.wayId );
+        insertWayNode.addInt64( wayNode.nodeId );
+        insertWayNode.addInt64( wayNode.pos );
+        if ( !insertWayNode.endRow() )
+        {
+          mError = insertWayNode.errorString();
+          return false;
+        }
+      }
+
+      Q_FOREACH ( const QgsOSMPbfReader::Tag& tag, block.wayTags )
+      {
+        insertWayTag.addInt64( tag.id );
+        insertWayTag.addText( tag.key );
+        insertWayTag.addText( tag.value );
+        if ( !insertWayTag.endRow() )
+        {
+          mError = insertWayTag.errorString();
+          return false;
+        }
+      }
+    }
+
+    int newPercent = mInputFile.size() > 0 ? 100 * mInputFile.pos() / mInputFile.size() : 100;
+    if ( newPercent > percent )
+    {
+      emit progress( newPercent );
+      percent = newPercent;
+    }
+  }
+
+  QgsOSMBulkInsert* inserts[] = { &insertNode, &insertNodeTag, &insertWay, &insertWayNode, &insertWayTag };
+  for ( int i = 0; i < 5; ++i )
+  {
+    if ( !inserts[i]->flush() )
+    {
+      mError = inserts[i]->errorString();
+      return false;
+    }
+  }
+
+  return true;
+}
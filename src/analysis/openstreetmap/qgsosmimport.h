@@ -27,6 +27,9 @@ class QXmlStreamReader;
  * @brief The QgsOSMXmlImport class imports OpenStreetMap XML format to our topological representation
  * in a SQLite database (see QgsOSMDatabase for details).
  *
+ * Input files with the .pbf extension are read as OpenStreetMap PBF format (since QGIS 2.14). Their
+ * blocks are decoded in parallel and the rows are inserted with statements of many rows.
+ *
  * How to use the classs:
  * 1. set input XML file name and output DB file name (in constructor or with respective functions)
  * 2. run import()
@@ -69,6 +72,14 @@ class ANALYSIS_EXPORT QgsOSMXmlImport : public QObject
     void readWay( QXmlStreamReader& xml );
     void readTag( bool way, QgsOSMId id, QXmlStreamReader& xml );
 
+    //! Returns true if the input file is in PBF format
+    //! @note added in QGIS 2.14
+    bool isPbf() const;
+
+    //! Reads the input file in PBF format, returns false on error
+    //! @note added in QGIS 2.14
+    bool readPbf();
+
   private:
     QString mXmlFileName;
     QString mDbFileName;
@@ -0,0 +1,572 @@
+/***************************************************************************
+  qgsosmpbfreader.cpp
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsosmpbfreader.h"
+
+#include <QIODevice>
+#include <QObject>
+
+// limits of the format specification
+static const int MAX_BLOB_HEADER_SIZE = 64 * 1024;
+static const int MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+/// @cond
+
+// signed integers are zigzag coded: 0, -1, 1, -2, ...
+static qint64 zigzag( quint64 value )
+{
+  return static_cast<qint64>( value >> 1 ) ^ -static_cast<qint64>( value & 1 );
+}
+
+// Reader of the fields of a protocol buffer message
+class QgsPbfMessage
+{
+  public:
+    enum WireType
+    {
+      Varint = 0,
+      Fixed64 = 1,
+      LengthDelimited = 2,
+      Fixed32 = 5
+    };
+
+    QgsPbfMessage( const char* data, int size )
+        : mPos( reinterpret_cast<const uchar*>( data ) )
+        , mEnd( reinterpret_cast<const uchar*>( data ) + size )
+        , mOk( true )
+        , mField( 0 )
+        , mWireType( 0 )
+    {}
+
+    explicit QgsPbfMessage( const QByteArray& data )
+        : mPos( reinterpret_cast<const uchar*>( data.constData() ) )
+        , mEnd( reinterpret_cast<const uchar*>( data.constData() ) + data.size() )
+        , mOk( true )
+        , mField( 0 )
+        , mWireType( 0 )
+    {}
+
+    //! moves to the next field, returns false at the end of the message or on error
+    bool next()
+    {
+      if ( !mOk || mPos >= mEnd )
+        return false;
+
+      quint64 key = varint();
+      mField = static_cast<int>( key >> 3 );
+      mWireType = static_cast<int>( key & 7 );
+      return mOk;
+    }
+
+    bool atEnd() const { return !mOk || mPos >= mEnd; }
+    bool ok() const { return mOk; }
+    int field() const { return mField; }
+    int wireType() const { return mWireType; }
+
+    quint64 varint()
+    {
+      quint64 value = 0;
+      for ( int shift = 0; shift < 64; shift += 7 )
+      {
+        if ( mPos >= mEnd )
+          break;
+        uchar byte = *mPos++;
+        value |= static_cast<quint64>( byte & 0x7f ) << shift;
+        if ( !( byte & 0x80 ) )
+          return value;
+      }
+      mOk = false;
+      return 0;
+    }
+
+    qint64 svarint()
+    {
+      return zigzag( varint() );
+    }
+
+    //! contents of a length delimited field
+    QgsPbfMessage message()
+    {
+      quint64 size = varint();
+      if ( !mOk || size > static_cast<quint64>( mEnd - mPos ) )
+      {
+        mOk = false;
+        return QgsPbfMessage( 0, 0 );
+      }
+      QgsPbfMessage msg( reinterpret_cast<const char*>( mPos ), static_cast<int>( size ) );
+      mPos += size;
+      return msg;
+    }
+
+    QByteArray bytes()
+    {
+      QgsPbfMessage msg = message();
+      return QByteArray( reinterpret_cast<const char*>( msg.mPos ), static_cast<int>( msg.mEnd - msg.mPos ) );
+    }
+
+    //! values of a repeated varint field, packed or not
+    void varints( QVector<quint64>& values )
+    {
+      if ( mWireType != LengthDelimited )
+      {
+        values << varint();
+        return;
+      }
+
+      QgsPbfMessage packed = message();
+      while ( !packed.atEnd() )
+        values << packed.varint();
+      if ( !packed.ok() )
+        mOk = false;
+    }
+
+    void skip()
+    {
+      switch ( mWireType )
+      {
+        case Varint:
+          varint();
+          break;
+        case Fixed64:
+          advance( 8 );
+          break;
+        case LengthDelimited:
+          message();
+          break;
+        case Fixed32:
+          advance( 4 );
+          break;
+        default:
+          mOk = false;
+      }
+    }
+
+  private:
+    const uchar* mPos;
+    const uchar* mEnd;
+    bool mOk;
+    int mField;
+    int mWireType;
+
+    void advance( int size )
+    {
+      if ( mEnd - mPos < size )
+        mOk = false;
+      else
+        mPos += size;
+    }
+};
+
+// decompressed data of a Blob message
+static bool blobData( const QByteArray& blob, QByteArray& data, QString& error )
+{
+  QgsPbfMessage msg( blob );
+  QByteArray zlibData;
+  quint64 rawSize = 0;
+  bool raw = false;
+  while ( msg.next() )
+  {
+    switch ( msg.field() )
+    {
+      case 1: // raw
+        data = msg.bytes();
+        raw = true;
+        break;
+      case 2: // raw_size
+        rawSize = msg.varint();
+        break;
+      case 3: // zlib_data
+        zlibData = msg.bytes();
+        break;
+      case 4: // lzma_data
+      case 5: // OBSOLETE_bzip2_data
+      case 6: // lz4_data
+      case 7: // zstd_data
+        error = QObject::tr( "Unsupported compression of PBF blocks" );
+        return false;
+      default:
+        msg.skip();
+    }
+  }
+  if ( !msg.ok() || rawSize > static_cast<quint64>( MAX_BLOB_SIZE ) )
+  {
+    error = QObject::tr( "Invalid PBF block" );
+    return false;
+  }
+  if ( raw )
+    return true;
+
+  // qUncompress() expects the size of the uncompressed data in front of the zlib stream
+  QByteArray compressed( 4, 0 );
+  compressed[0] = static_cast<char>(( rawSize >> 24 ) & 0xff );
+  compressed[1] = static_cast<char>(( rawSize >> 16 ) & 0xff );
+  compressed[2] = static_cast<char>(( rawSize >> 8 ) & 0xff );
+  compressed[3] = static_cast<char>( rawSize & 0xff );
+  compressed += zlibData;
+  data = qUncompress( compressed );
+  if ( data.size() != static_cast<int>( rawSize ) )
+  {
+    error = QObject::tr( "Decompressing PBF block failed" );
+    return false;
+  }
+  return true;
+}
+
+// state of a PrimitiveBlock needed to decode its groups
+struct QgsPbfBlockContext
+{
+  QVector<QByteArray> strings;
+  qint64 granularity;
+  qint64 latOffset;
+  qint64 lonOffset;
+
+  double lat( qint64 value ) const { return ( latOffset + granularity * value ) / 1000000000.0; }
+  double lon( qint64 value ) const { return ( lonOffset + granularity * value ) / 1000000000.0; }
+  bool hasString( quint64 index ) const { return index < static_cast<quint64>( strings.size() ); }
+};
+
+static bool addTags( const QgsPbfBlockContext& context, QgsOSMId id, const QVector<quint64>& keys, const QVector<quint64>& values, QVector<QgsOSMPbfReader::Tag>& tags )
+{
+  if ( keys.size() != values.size() )
+    return false;
+
+  for ( int i = 0; i < keys.size(); ++i )
+  {
+    if ( !context.hasString( keys[i] ) || !context.hasString( values[i] ) )
+      return false;
+
+    QgsOSMPbfReader::Tag tag;
+    tag.id = id;
+    tag.key = context.strings[ keys[i] ];
+    tag.value = context.strings[ values[i] ];
+    tags << tag;
+  }
+  return true;
+}
+
+static bool decodeNode( const QgsPbfBlockContext& context, QgsPbfMessage msg, QgsOSMPbfReader::Block& block )
+{
+  QgsOSMPbfReader::Node node;
+  node.id = 0;
+  qint64 lat = 0, lon = 0;
+  QVector<quint64> keys, values;
+  while ( msg.next() )
+  {
+    switch ( msg.field() )
+    {
+      case 1:
+        node.id = msg.svarint();
+        break;
+      case 2:
+        msg.varints( keys );
+        break;
+      case 3:
+        msg.varints( values );
+        break;
+      case 8:
+        lat = msg.svarint();
+        break;
+      case 9:
+        lon = msg.svarint();
+        break;
+      default:
+        msg.skip();
+    }
+  }
+  node.lat = context.lat( lat );
+  node.lon = context.lon( lon );
+  block.nodes << node;
+  return msg.ok() && addTags( context, node.id, keys, values, block.nodeTags );
+}
+
+static bool decodeDenseNodes( const QgsPbfBlockContext& context, QgsPbfMessage msg, QgsOSMPbfReader::Block& block )
+{
+  QVector<quint64> ids, lats, lons, keysVals;
+  while ( msg.next() )
+  {
+    switch ( msg.field() )
+    {
+      case 1:
+        msg.varints( ids );
+        break;
+      case 8:
+        msg.varints( lats );
+        break;
+      case 9:
+        msg.varints( lons );
+        break;
+      case 10:
+        msg.varints( keysVals );
+        break;
+      default:
+        msg.skip();
+    }
+  }
+  if ( !msg.ok() || lats.size() != ids.size() || lons.size() != ids.size() )
+    return false;
+
+  // ids and coordinates are delta coded, the tags of all nodes are in one list with 0 after the tags of each node
+  qint64 id = 0, lat = 0, lon = 0;
+  int kv = 0;
+  block.nodes.reserve( block.nodes.size() + ids.size() );
+  for ( int i = 0; i < ids.size(); ++i )
+  {
+    id += zigzag( ids[i] );
+    lat += zigzag( lats[i] );
+    lon += zigzag( lons[i] );
+
+    QgsOSMPbfReader::Node node;
+    node.id = id;
+    node.lat = context.lat( lat );
+    node.lon = context.lon( lon );
+    block.nodes << node;
+
+    while ( kv < keysVals.size() && keysVals[kv] != 0 )
+    {
+      if ( kv + 1 >= keysVals.size() || !context.hasString( keysVals[kv] ) || !context.hasString( keysVals[kv + 1] ) )
+        return false;
+
+      QgsOSMPbfReader::Tag tag;
+      tag.id = id;
+      tag.key = context.strings[ keysVals[kv] ];
+      tag.value = context.strings[ keysVals[kv + 1] ];
+      block.nodeTags << tag;
+      kv += 2;
+    }
+    ++kv; // skip the 0
+  }
+  return true;
+}
+
+static bool decodeWay( const QgsPbfBlockContext& context, QgsPbfMessage msg, QgsOSMPbfReader::Block& block )
+{
+  QgsOSMId id = 0;
+  QVector<quint64> keys, values, refs;
+  while ( msg.next() )
+  {
+    switch ( msg.field() )
+    {
+      case 1:
+        id = static_cast<QgsOSMId>( msg.varint() );
+        break;
+      case 2:
+        msg.varints( keys );
+        break;
+      case 3:
+        msg.varints( values );
+        break;
+      case 8:
+        msg.varints( refs );
+        break;
+      default:
+        msg.skip();
+    }
+  }
+  if ( !msg.ok() )
+    return false;
+
+  block.ways << id;
+
+  // node references are delta coded
+  qint64 nodeId = 0;
+  for ( int i = 0; i < refs.size(); ++i )
+  {
+    nodeId += zigzag( refs[i] );
+    QgsOSMPbfReader::WayNode wayNode;
+    wayNode.wayId = id;
+    wayNode.nodeId = nodeId;
+    wayNode.pos = i;
+    block.wayNodes << wayNode;
+  }
+  return addTags( context, id, keys, values, block.wayTags );
+}
+
+static bool decodeGroup( const QgsPbfBlockContext& context, QgsPbfMessage msg, QgsOSMPbfReader::Block& block )
+{
+  while ( msg.next() )
+  {
+    bool ok = true;
+    switch ( msg.field() )
+    {
+      case 1:
+        ok = decodeNode( context, msg.message(), block );
+        break;
+      case 2:
+        ok = decodeDenseNodes( context, msg.message(), block );
+        break;
+      case 3:
+        ok = decodeWay( context, msg.message(), block );
+        break;
+      default: // relations and changesets are not imported
+        msg.skip();
+    }
+    if ( !ok )
+      return false;
+  }
+  return msg.ok();
+}
+
+/// @endcond
+
+
+QgsOSMPbfReader::QgsOSMPbfReader( QIODevice* device )
+    : mDevice( device )
+{
+}
+
+bool QgsOSMPbfReader::readBlock( Block& block )
+{
+  for ( ;; )
+  {
+    // each blob is preceded by its header and the size of the header
+    QByteArray headerSize = mDevice->read( 4 );
+    if ( headerSize.isEmpty() )
+      return false;
+
+    quint32 size = 0;
+    if ( headerSize.size() == 4 )
+    {
+      const uchar* s = reinterpret_cast<const uchar*>( headerSize.constData() );
+      size = ( static_cast<quint32>( s[0] ) << 24 ) | ( static_cast<quint32>( s[1] ) << 16 ) | ( static_cast<quint32>( s[2] ) << 8 ) | s[3];
+    }
+    if ( headerSize.size() != 4 || size > static_cast<quint32>( MAX_BLOB_HEADER_SIZE ) )
+    {
+      mError = QObject::tr( "Invalid PBF block header" );
+      return false;
+    }
+
+    QByteArray header = mDevice->read( size );
+    QgsPbfMessage msg( header );
+    QByteArray type;
+    quint64 dataSize = 0;
+    while ( msg.next() )
+    {
+      if ( msg.field() == 1 )
+        type = msg.bytes();
+      else if ( msg.field() == 3 )
+        dataSize = msg.varint();
+      else
+        msg.skip();
+    }
+    if ( header.size() != static_cast<int>( size ) || !msg.ok() || dataSize > static_cast<quint64>( MAX_BLOB_SIZE ) )
+    {
+      mError = QObject::tr( "Invalid PBF block header" );
+      return false;
+    }
+
+    QByteArray blob = mDevice->read( static_cast<int>( dataSize ) );
+    if ( blob.size() != static_cast<int>( dataSize ) )
+    {
+      mError = QObject::tr( "Unexpected end of PBF file" );
+      return false;
+    }
+
+    if ( type == "OSMData" )
+    {
+      block.blob = blob;
+      return true;
+    }
+
+    if ( type == "OSMHeader" )
+    {
+      QByteArray data;
+      if ( !blobData( blob, data, mError ) )
+        return false;
+
+      // features needed to read the file
+      QgsPbfMessage headerBlock( data );
+      while ( headerBlock.next() )
+      {
+        if ( headerBlock.field() != 4 )
+        {
+          headerBlock.skip();
+          continue;
+        }
+
+        QByteArray feature = headerBlock.bytes();
+        if ( feature != "OsmSchema-V0.6" && feature != "DenseNodes" )
+        {
+          mError = QObject::tr( "Unsupported feature of PBF file: %1" ).arg( QString::fromUtf8( feature ) );
+          return false;
+        }
+      }
+      if ( !headerBlock.ok() )
+      {
+        mError = QObject::tr( "Invalid PBF file header" );
+        return false;
+      }
+    }
+    // blocks of other types are skipped
+  }
+}
+
+void QgsOSMPbfReader::decode( Block& block )
+{
+  QByteArray data;
+  bool ok = blobData( block.blob, data, block.error );
+  block.blob.clear();
+  if ( !ok )
+    return;
+
+  // the groups are decoded once the string table and the coordinate transformation are known
+  QgsPbfBlockContext context;
+  context.granularity = 100;
+  context.latOffset = 0;
+  context.lonOffset = 0;
+  QList<QgsPbfMessage> groups;
+  ok = true;
+
+  QgsPbfMessage msg( data );
+  while ( msg.next() )
+  {
+    switch ( msg.field() )
+    {
+      case 1:
+      {
+        QgsPbfMessage stringTable = msg.message();
+        while ( stringTable.next() )
+        {
+          if ( stringTable.field() == 1 )
+            context.strings << stringTable.bytes();
+          else
+            stringTable.skip();
+        }
+        ok = ok && stringTable.ok();
+        break;
+      }
+      case 2:
+        groups << msg.message();
+        break;
+      case 17:
+        context.granularity = static_cast<qint64>( msg.varint() );
+        break;
+      case 19:
+        context.latOffset = static_cast<qint64>( msg.varint() );
+        break;
+      case 20:
+        context.lonOffset = static_cast<qint64>( msg.varint() );
+        break;
+      default:
+        msg.skip();
+    }
+  }
+
+  ok = ok && msg.ok();
+  for ( int i = 0; ok && i < groups.size(); ++i )
+    ok = decodeGroup( context, groups[i], block );
+
+  if ( !ok )
+    block.error = QObject::tr( "Invalid PBF data block" );
+}
@@ -0,0 +1,98 @@
+/***************************************************************************
+  qgsosmpbfreader.h
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef OSMPBFREADER_H
+#define OSMPBFREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "qgsosmbase.h"
+
+class QIODevice;
+
+/**
+ * @brief The QgsOSMPbfReader class reads the OpenStreetMap PBF format (the binary format of planet
+ * and extract files).
+ *
+ * A PBF file is a sequence of independently compressed blocks. readBlock() only reads the raw data
+ * of the next block from the file, decode() decompresses and decodes it. Blocks do not depend on
+ * each other, so several blocks can be decoded in parallel by different threads.
+ *
+ * Nodes (including dense nodes), ways and their tags are decoded, relations and metadata are skipped.
+ *
+ * @note added in QGIS 2.14
+ * @note not available in Python bindings
+ */
+class ANALYSIS_EXPORT QgsOSMPbfReader
+{
+  public:
+    struct Node
+    {
+      QgsOSMId id;
+      double lat;
+      double lon;
+    };
+
+    struct WayNode
+    {
+      QgsOSMId wayId;
+      QgsOSMId nodeId;
+      int pos;
+    };
+
+    struct Tag
+    {
+      QgsOSMId id;
+      QByteArray key;
+      QByteArray value;
+    };
+
+    //! A data block of the file, with its primitives once decoded
+    struct Block
+    {
+      //! compressed data as read from the file, released by decode()
+      QByteArray blob;
+      //! set by decode() if the block is not valid
+      QString error;
+
+      QVector<Node> nodes;
+      QVector<Tag> nodeTags;
+      QVector<QgsOSMId> ways;
+      QVector<WayNode> wayNodes;
+      QVector<Tag> wayTags;
+    };
+
+    explicit QgsOSMPbfReader( QIODevice* device );
+
+    /**
+     * Reads the next data block. The file header is checked on the way.
+     * @return false at the end of the file or on error (see hasError())
+     */
+    bool readBlock( Block& block );
+
+    /** Decodes the primitives of a block read by readBlock(). Sets the error of the block on failure. */
+    static void decode( Block& block );
+
+    bool hasError() const { return !mError.isEmpty(); }
+    QString errorString() const { return mError; }
+
+  private:
+    QIODevice* mDevice;
+    QString mError;
+};
+
+#endif // OSMPBFREADER_H
@@ -48,3 +48,11 @@ float QgsAspectFilter::processNineCellWindow(
   }
 }
 
+void QgsAspectFilter::processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize )
+{
+  for ( int j = 0; j < xSize; ++j )
+  {
+    resultLine[j] = QgsAspectFilter::processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
+                    &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
+  }
+}
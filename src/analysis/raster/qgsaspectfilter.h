@@ -33,6 +33,10 @@ class ANALYSIS_EXPORT QgsAspectFilter: public QgsDerivativeFilter
                                  float* x12, float* x22, float* x32,
                                  float* x13, float* x23, float* x33 ) override;
 
+  protected:
+    /** Calculates the output values of a row without a virtual call per cell*/
+    void processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize ) override;
+    bool canProcessRowsInParallel() const override { return true; }
 };
 
 #endif // QGSASPECTFILTER_H
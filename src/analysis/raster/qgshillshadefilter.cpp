@@ -55,3 +55,12 @@ float QgsHillshadeFilter::processNineCellWindow( float* x11, float* x21, float*
   }
   return qMax( 0.0, 255.0 * (( cos( zenith_rad ) * cos( slope_rad ) ) + ( sin( zenith_rad ) * sin( slope_rad ) * cos( azimuth_rad - aspect_rad ) ) ) );
 }
+
+void QgsHillshadeFilter::processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize )
+{
+  for ( int j = 0; j < xSize; ++j )
+  {
+    resultLine[j] = QgsHillshadeFilter::processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
+                    &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
+  }
+}
@@ -38,6 +38,11 @@ class ANALYSIS_EXPORT QgsHillshadeFilter: public QgsDerivativeFilter
     float lightAngle() const { return mLightAngle; }
     void setLightAngle( float angle ) { mLightAngle = angle; }
 
+  protected:
+    /** Calculates the output values of a row without a virtual call per cell*/
+    void processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize ) override;
+    bool canProcessRowsInParallel() const override { return true; }
+
   private:
     float mLightAzimuth;
     float mLightAngle;
@@ -19,6 +19,30 @@
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentMap>
+
+//! Minimum number of rows read, processed and written at once
+#define MIN_STRIP_ROWS 128
+//! Maximum number of cells of a strip, unless MIN_STRIP_ROWS are larger
+#define MAX_STRIP_CELLS ( 16 * 1024 * 1024 )
+//! Number of rows processed by one task when processing rows in parallel
+#define ROWS_PER_TASK 16
+
+/// @cond PRIVATE
+struct QgsNineCellFilter::RowRange
+{
+  QgsNineCellFilter* filter;
+  //! first cell of the row above the first row of the range
+  float* input;
+  //! distance between two rows of input
+  int inputStride;
+  float* output;
+  int rowCount;
+  int xSize;
+};
+/// @endcond
 
 #if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
 #define TO8F(x) (x).toUtf8().constData()
@@ -106,24 +130,35 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
     return 6;
   }
 
-  //keep only three scanlines in memory at a time
-  float* scanLine1 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-  float* scanLine2 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
-  float* scanLine3 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+  //read, process and write strips of several rows. The input buffer has one row above and below the strip
+  //and one column left and right of the raster, values outside the layer extent are sent to the processing method
+  //as (input) nodata values
+  int blockXSize, blockYSize;
+  GDALGetBlockSize( rasterBand, &blockXSize, &blockYSize );
+  int stripRows = qMax( blockYSize, 1 );
+  if ( stripRows < MIN_STRIP_ROWS )
+  {
+    stripRows *= ( MIN_STRIP_ROWS + stripRows - 1 ) / stripRows;
+  }
+  stripRows = qMin( stripRows, qMax( MAX_STRIP_CELLS / xSize, MIN_STRIP_ROWS ) );
+  stripRows = qMin( stripRows, ySize );
+
+  int stride = xSize + 2;
+  QVector<float> inputBuffer( stride * ( stripRows + 2 ), mInputNodataValue );
+  QVector<float> outputBuffer( xSize * stripRows );
 
-  float* resultLine = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+  bool parallel = canProcessRowsInParallel() && QThread::idealThreadCount() > 1;
 
   if ( p )
   {
     p->setMaximum( ySize );
   }
 
-  //values outside the layer extent (if the 3x3 window is on the border) are sent to the processing method as (input) nodata values
-  for ( int i = 0; i < ySize; ++i )
+  for ( int stripStart = 0; stripStart < ySize; stripStart += stripRows )
   {
     if ( p )
     {
-      p->setValue( i );
+      p->setValue( stripStart );
     }
 
     if ( p && p->wasCanceled() )
@@ -131,56 +166,48 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
       break;
     }
 
-    if ( i == 0 )
-    {
-      //fill scanline 1 with (input) nodata for the values above the first row and feed scanline2 with the first row
-      for ( int a = 0; a < xSize; ++a )
-      {
-        scanLine1[a] = mInputNodataValue;
-      }
-      GDALRasterIO( rasterBand, GF_Read, 0, 0, xSize, 1, scanLine2, xSize, 1, GDT_Float32, 0, 0 );
-    }
-    else
+    int rows = qMin( stripRows, ySize - stripStart );
+
+    //rows stripStart - 1 to stripStart + rows, where they are inside of the raster
+    int firstRow = qMax( stripStart - 1, 0 );
+    int lastRow = qMin( stripStart + rows, ySize - 1 );
+    float* firstCell = inputBuffer.data() + ( firstRow - stripStart + 1 ) * stride + 1;
+    if ( stripStart == 0 || stripStart + rows == ySize )
     {
-      //normally fetch only scanLine3 and release scanline 1 if we move forward one row
-      CPLFree( scanLine1 );
-      scanLine1 = scanLine2;
-      scanLine2 = scanLine3;
-      scanLine3 = ( float * ) CPLMalloc( sizeof( float ) * xSize );
+      inputBuffer.fill( mInputNodataValue );
     }
+    GDALRasterIO( rasterBand, GF_Read, 0, firstRow, xSize, lastRow - firstRow + 1, firstCell, xSize, lastRow - firstRow + 1,
+                  GDT_Float32, 0, static_cast<int>( stride * sizeof( float ) ) );
 
-    if ( i == ySize - 1 ) //fill the row below the bottom with nodata values
+    if ( parallel && rows > ROWS_PER_TASK )
     {
-      for ( int a = 0; a < xSize; ++a )
+      QVector<RowRange> ranges;
+      for ( int row = 0; row < rows; row += ROWS_PER_TASK )
       {
-        scanLine3[a] = mInputNodataValue;
+        RowRange range;
+        range.filter = this;
+        range.input = inputBuffer.data() + row * stride + 1;
+        range.inputStride = stride;
+        range.output = outputBuffer.data() + row * xSize;
+        range.rowCount = qMin( ROWS_PER_TASK, rows - row );
+        range.xSize = xSize;
+        ranges << range;
       }
+      QtConcurrent::blockingMap( ranges, processRowRange );
     }
     else
     {
-      GDALRasterIO( rasterBand, GF_Read, 0, i + 1, xSize, 1, scanLine3, xSize, 1, GDT_Float32, 0, 0 );
-    }
-
-    for ( int j = 0; j < xSize; ++j )
-    {
-      if ( j == 0 )
-      {
-        resultLine[j] = processNineCellWindow( &mInputNodataValue, &scanLine1[j], &scanLine1[j+1], &mInputNodataValue, &scanLine2[j],
-                                               &scanLine2[j+1], &mInputNodataValue, &scanLine3[j], &scanLine3[j+1] );
-      }
-      else if ( j == xSize - 1 )
-      {
-        resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &mInputNodataValue, &scanLine2[j-1], &scanLine2[j],
-                                               &mInputNodataValue, &scanLine3[j-1], &scanLine3[j], &mInputNodataValue );
-      }
-      else
-      {
-        resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
-                                               &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
-      }
+      RowRange range;
+      range.filter = this;
+      range.input = inputBuffer.data() + 1;
+      range.inputStride = stride;
+      range.output = outputBuffer.data();
+      range.rowCount = rows;
+      range.xSize = xSize;
+      processRowRange( range );
     }
 
-    GDALRasterIO( outputRasterBand, GF_Write, 0, i, xSize, 1, resultLine, xSize, 1, GDT_Float32, 0, 0 );
+    GDALRasterIO( outputRasterBand, GF_Write, 0, stripStart, xSize, rows, outputBuffer.data(), xSize, rows, GDT_Float32, 0, 0 );
   }
 
   if ( p )
@@ -188,11 +215,6 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
     p->setValue( ySize );
   }
 
-  CPLFree( resultLine );
-  CPLFree( scanLine1 );
-  CPLFree( scanLine2 );
-  CPLFree( scanLine3 );
-
   GDALClose( inputDataset );
 
   if ( p && p->wasCanceled() )
@@ -206,6 +228,25 @@ int QgsNineCellFilter::processRaster( QProgressDialog* p )
   return 0;
 }
 
+void QgsNineCellFilter::processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize )
+{
+  for ( int j = 0; j < xSize; ++j )
+  {
+    resultLine[j] = processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
+                                           &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
+  }
+}
+
+void QgsNineCellFilter::processRowRange( RowRange& range )
+{
+  for ( int i = 0; i < range.rowCount; ++i )
+  {
+    float* scanLine1 = range.input + i * range.inputStride;
+    range.filter->processNineCellRow( scanLine1, scanLine1 + range.inputStride, scanLine1 + 2 * range.inputStride,
+                                      range.output + i * range.xSize, range.xSize );
+  }
+}
+
 GDALDatasetH QgsNineCellFilter::openInputFile( int& nCellsX, int& nCellsY )
 {
   GDALDatasetH inputDataset = GDALOpen( TO8F( mInputFile ), GA_ReadOnly );
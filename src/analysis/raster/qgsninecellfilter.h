@@ -57,6 +57,21 @@ class ANALYSIS_EXPORT QgsNineCellFilter
                                          float* x12, float* x22, float* x32,
                                          float* x13, float* x23, float* x33 ) = 0;
 
+  protected:
+    /** Calculates the output values of a row. scanLine1, scanLine2 and scanLine3 point to the first cell of
+      the row above, the row itself and the row below. The cells at index -1 and xSize of the three lines are
+      set to the input nodata value. The default implementation calls processNineCellWindow() for each cell,
+      subclasses may reimplement it to avoid a virtual call per cell.
+      @note added in QGIS 2.14
+      @note not available in Python bindings*/
+    virtual void processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize );
+
+    /** Returns true if processNineCellRow() may be called for several rows at the same time from
+      different threads. The default implementation returns false.
+      @note added in QGIS 2.14
+      @note not available in Python bindings*/
+    virtual bool canProcessRowsInParallel() const { return false; }
+
   private:
     //default constructor forbidden. We need input file, output file and format obligatory
     QgsNineCellFilter();
@@ -70,6 +85,10 @@ class ANALYSIS_EXPORT QgsNineCellFilter
       @return the output dataset or NULL in case of error*/
     GDALDatasetH openOutputFile( GDALDatasetH inputDataset, GDALDriverH outputDriver );
 
+    struct RowRange;
+    /** Processes a range of rows of the current strip (used from worker threads)*/
+    static void processRowRange( RowRange& range );
+
   protected:
 
     QString mInputFile;
@@ -103,6 +103,8 @@ class ANALYSIS_EXPORT QgsRasterCalcNode
     QString mRasterName;
     QgsRasterMatrix* mMatrix;
     Operator mOperator;
+
+    friend class QgsRasterCalcProgram;
 };
 
 
@@ -0,0 +1,305 @@
+/***************************************************************************
+    qgsrastercalcprogram.cpp
+    ---------------------
+    begin                : November 2015
+    copyright            : (C) 2015 by the QGIS Development Team
+    email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsrastercalcprogram.h"
+
+#include <QVarLengthArray>
+#include <qmath.h>
+
+/// @cond
+
+// Kernels of the operators. Each operator has its own loop without branches on the operator,
+// simple enough to be vectorized by the compiler. The handling of no data and invalid
+// arguments is the same as in QgsRasterMatrix.
+
+struct QgsRasterCalcOpPlus { static inline double apply( double a, double b, double ) { return a + b; } };
+struct QgsRasterCalcOpMinus { static inline double apply( double a, double b, double ) { return a - b; } };
+struct QgsRasterCalcOpMul { static inline double apply( double a, double b, double ) { return a * b; } };
+struct QgsRasterCalcOpDiv { static inline double apply( double a, double b, double nodata ) { return b == 0 ? nodata : a / b; } };
+struct QgsRasterCalcOpPow
+{
+  static inline double apply( double a, double b, double nodata )
+  {
+    if (( a == 0 && b < 0 ) || ( a < 0 && ( b - floor( b ) ) > 0 ) )
+      return nodata;
+    return qPow( a, b );
+  }
+};
+struct QgsRasterCalcOpEq { static inline double apply( double a, double b, double ) { return a == b ? 1.0 : 0.0; } };
+struct QgsRasterCalcOpNe { static inline double apply( double a, double b, double ) { return a == b ? 0.0 : 1.0; } };
+struct QgsRasterCalcOpGt { static inline double apply( double a, double b, double ) { return a > b ? 1.0 : 0.0; } };
+struct QgsRasterCalcOpLt { static inline double apply( double a, double b, double ) { return a < b ? 1.0 : 0.0; } };
+struct QgsRasterCalcOpGe { static inline double apply( double a, double b, double ) { return a >= b ? 1.0 : 0.0; } };
+struct QgsRasterCalcOpLe { static inline double apply( double a, double b, double ) { return a <= b ? 1.0 : 0.0; } };
+struct QgsRasterCalcOpAnd { static inline double apply( double a, double b, double ) { return a != 0 && b != 0 ? 1.0 : 0.0; } };
+struct QgsRasterCalcOpOr { static inline double apply( double a, double b, double ) { return a != 0 || b != 0 ? 1.0 : 0.0; } };
+
+struct QgsRasterCalcOpSqrt { static inline double apply( double a, double nodata ) { return a < 0 ? nodata : sqrt( a ); } };
+struct QgsRasterCalcOpSin { static inline double apply( double a, double ) { return sin( a ); } };
+struct QgsRasterCalcOpCos { static inline double apply( double a, double ) { return cos( a ); } };
+struct QgsRasterCalcOpTan { static inline double apply( double a, double ) { return tan( a ); } };
+struct QgsRasterCalcOpAsin { static inline double apply( double a, double ) { return asin( a ); } };
+struct QgsRasterCalcOpAcos { static inline double apply( double a, double ) { return acos( a ); } };
+struct QgsRasterCalcOpAtan { static inline double apply( double a, double ) { return atan( a ); } };
+struct QgsRasterCalcOpSign { static inline double apply( double a, double ) { return -a; } };
+struct QgsRasterCalcOpLog { static inline double apply( double a, double nodata ) { return a <= 0 ? nodata : log( a ); } };
+struct QgsRasterCalcOpLog10 { static inline double apply( double a, double nodata ) { return a <= 0 ? nodata : log10( a ); } };
+
+// operations with no data always result in no data
+template <typename Op>
+static void binaryKernel( const double* a, const double* b, double* result, int count, double nodata )
+{
+  for ( int i = 0; i < count; ++i )
+  {
+    double va = a[i];
+    double vb = b[i];
+    result[i] = ( va == nodata || vb == nodata ) ? nodata : Op::apply( va, vb, nodata );
+  }
+}
+
+template <typename Op>
+static void unaryKernel( const double* a, double* result, int count, double nodata )
+{
+  for ( int i = 0; i < count; ++i )
+  {
+    double va = a[i];
+    result[i] = va == nodata ? nodata : Op::apply( va, nodata );
+  }
+}
+
+static bool isUnaryOperator( QgsRasterCalcNode::Operator op )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opSQRT:
+    case QgsRasterCalcNode::opSIN:
+    case QgsRasterCalcNode::opCOS:
+    case QgsRasterCalcNode::opTAN:
+    case QgsRasterCalcNode::opASIN:
+    case QgsRasterCalcNode::opACOS:
+    case QgsRasterCalcNode::opATAN:
+    case QgsRasterCalcNode::opSIGN:
+    case QgsRasterCalcNode::opLOG:
+    case QgsRasterCalcNode::opLOG10:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static void evaluateBinary( QgsRasterCalcNode::Operator op, const double* a, const double* b, double* result, int count, double nodata )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opPLUS:
+      binaryKernel<QgsRasterCalcOpPlus>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opMINUS:
+      binaryKernel<QgsRasterCalcOpMinus>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opMUL:
+      binaryKernel<QgsRasterCalcOpMul>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opDIV:
+      binaryKernel<QgsRasterCalcOpDiv>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opPOW:
+      binaryKernel<QgsRasterCalcOpPow>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opEQ:
+      binaryKernel<QgsRasterCalcOpEq>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opNE:
+      binaryKernel<QgsRasterCalcOpNe>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opGT:
+      binaryKernel<QgsRasterCalcOpGt>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opLT:
+      binaryKernel<QgsRasterCalcOpLt>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opGE:
+      binaryKernel<QgsRasterCalcOpGe>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opLE:
+      binaryKernel<QgsRasterCalcOpLe>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opAND:
+      binaryKernel<QgsRasterCalcOpAnd>( a, b, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opOR:
+      binaryKernel<QgsRasterCalcOpOr>( a, b, result, count, nodata );
+      break;
+    default:
+      break;
+  }
+}
+
+static void evaluateUnary( QgsRasterCalcNode::Operator op, const double* a, double* result, int count, double nodata )
+{
+  switch ( op )
+  {
+    case QgsRasterCalcNode::opSQRT:
+      unaryKernel<QgsRasterCalcOpSqrt>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opSIN:
+      unaryKernel<QgsRasterCalcOpSin>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opCOS:
+      unaryKernel<QgsRasterCalcOpCos>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opTAN:
+      unaryKernel<QgsRasterCalcOpTan>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opASIN:
+      unaryKernel<QgsRasterCalcOpAsin>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opACOS:
+      unaryKernel<QgsRasterCalcOpAcos>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opATAN:
+      unaryKernel<QgsRasterCalcOpAtan>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opSIGN:
+      unaryKernel<QgsRasterCalcOpSign>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opLOG:
+      unaryKernel<QgsRasterCalcOpLog>( a, result, count, nodata );
+      break;
+    case QgsRasterCalcNode::opLOG10:
+      unaryKernel<QgsRasterCalcOpLog10>( a, result, count, nodata );
+      break;
+    default:
+      break;
+  }
+}
+
+/// @endcond
+
+QgsRasterCalcProgram::QgsRasterCalcProgram( const QgsRasterCalcNode* node, const QStringList& inputNames, double nodataValue )
+    : mRegisterCount( 0 )
+    , mNodataValue( nodataValue )
+    , mValid( false )
+{
+  mValid = node && compile( node, inputNames, 0 );
+  if ( !mValid )
+  {
+    mInstructions.clear();
+    mRegisterCount = 0;
+  }
+}
+
+bool QgsRasterCalcProgram::compile( const QgsRasterCalcNode* node, const QStringList& inputNames, int depth )
+{
+  // instructions are in postfix order, the result of a node is in the register of its depth
+  mRegisterCount = qMax( mRegisterCount, depth + 1 );
+
+  Instruction instruction;
+  instruction.op = node->mOperator;
+  instruction.input = -1;
+  instruction.number = 0;
+
+  switch ( node->mType )
+  {
+    case QgsRasterCalcNode::tRasterRef:
+      instruction.type = LoadInput;
+      instruction.input = inputNames.indexOf( node->mRasterName );
+      if ( instruction.input < 0 )
+        return false;
+      break;
+
+    case QgsRasterCalcNode::tNumber:
+      instruction.type = LoadNumber;
+      instruction.number = node->mNumber;
+      break;
+
+    case QgsRasterCalcNode::tOperator:
+      if ( !node->mLeft || !compile( node->mLeft, inputNames, depth ) )
+        return false;
+      if ( isUnaryOperator( node->mOperator ) )
+      {
+        instruction.type = Unary;
+      }
+      else
+      {
+        if ( node->mOperator == QgsRasterCalcNode::opNONE || !node->mRight || !compile( node->mRight, inputNames, depth + 1 ) )
+          return false;
+        instruction.type = Binary;
+      }
+      break;
+
+    default:
+      return false;
+  }
+
+  mInstructions << instruction;
+  return true;
+}
+
+void QgsRasterCalcProgram::evaluate( const double* const* inputs, int count, double* scratch, float* result ) const
+{
+  if ( !mValid )
+    return;
+
+  // operands of the instructions, pointing to the inputs or to registers in the scratch buffer
+  QVarLengthArray<const double*, 16> stack( mRegisterCount );
+
+  for ( int offset = 0; offset < count; offset += CHUNK_SIZE )
+  {
+    int n = qMin( CHUNK_SIZE, count - offset );
+    int depth = 0;
+
+    Q_FOREACH ( const Instruction& instruction, mInstructions )
+    {
+      switch ( instruction.type )
+      {
+        case LoadInput:
+          stack[depth++] = inputs[instruction.input] + offset;
+          break;
+
+        case LoadNumber:
+        {
+          double* reg = scratch + depth * CHUNK_SIZE;
+          for ( int i = 0; i < n; ++i )
+            reg[i] = instruction.number;
+          stack[depth++] = reg;
+          break;
+        }
+
+        case Unary:
+        {
+          double* reg = scratch + ( depth - 1 ) * CHUNK_SIZE;
+          evaluateUnary( instruction.op, stack[depth - 1], reg, n, mNodataValue );
+          stack[depth - 1] = reg;
+          break;
+        }
+
+        case Binary:
+        {
+          double* reg = scratch + ( depth - 2 ) * CHUNK_SIZE;
+          evaluateBinary( instruction.op, stack[depth - 2], stack[depth - 1], reg, n, mNodataValue );
+          stack[depth - 2] = reg;
+          --depth;
+          break;
+        }
+      }
+    }
+
+    const double* values = stack[0];
+    float* out = result + offset;
+    for ( int i = 0; i < n; ++i )
+      out[i] = static_cast<float>( values[i] );
+  }
+}
@@ -0,0 +1,94 @@
+/***************************************************************************
+    qgsrastercalcprogram.h
+    ---------------------
+    begin                : November 2015
+    copyright            : (C) 2015 by the QGIS Development Team
+    email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSRASTERCALCPROGRAM_H
+#define QGSRASTERCALCPROGRAM_H
+
+#include "qgsrastercalcnode.h"
+
+#include <QStringList>
+#include <QVector>
+
+/** \ingroup analysis
+ * \class QgsRasterCalcProgram
+ * \brief A raster calculator expression compiled to a list of elementwise instructions.
+ *
+ * The instructions of a QgsRasterCalcNode tree are evaluated for chunks of CHUNK_SIZE cells,
+ * all operators of the expression one after the other on the same chunk, so that intermediate
+ * results stay in a small scratch buffer instead of being allocated as raster matrices. The results are
+ * identical to the ones of QgsRasterCalcNode::calculate().
+ *
+ * A program is not modified by evaluate(), the same program can be evaluated by several threads,
+ * each with its own scratch buffer.
+ *
+ * \note added in QGIS 2.14
+ * \note not available in Python bindings
+ */
+class ANALYSIS_EXPORT QgsRasterCalcProgram
+{
+  public:
+    //! number of cells evaluated by each instruction at once
+    static const int CHUNK_SIZE = 256;
+
+    /** Compiles an expression
+     * @param node root node of the parsed expression
+     * @param inputNames names of the rasters referenced by the expression, the index in this list
+     * is the index of the input in evaluate()
+     * @param nodataValue no data value of the inputs and the result
+     */
+    QgsRasterCalcProgram( const QgsRasterCalcNode* node, const QStringList& inputNames, double nodataValue );
+
+    /** Returns false if the expression contains nodes which cannot be compiled (matrices, unknown
+     * operators or rasters which are not in the input names)
+     */
+    bool isValid() const { return mValid; }
+
+    /** Returns the size of the scratch buffer needed by evaluate(), in number of doubles */
+    int scratchSize() const { return mRegisterCount * CHUNK_SIZE; }
+
+    /** Evaluates the expression
+     * @param inputs values of the inputs, with no data cells set to the no data value of the program
+     * @param count number of cells of each input
+     * @param scratch buffer of scratchSize() doubles
+     * @param result destination for count values
+     */
+    void evaluate( const double* const* inputs, int count, double* scratch, float* result ) const;
+
+  private:
+    enum InstructionType
+    {
+      LoadInput,
+      LoadNumber,
+      Unary,
+      Binary
+    };
+
+    struct Instruction
+    {
+      InstructionType type;
+      QgsRasterCalcNode::Operator op;
+      int input;
+      double number;
+    };
+
+    bool compile( const QgsRasterCalcNode* node, const QStringList& inputNames, int depth );
+
+    QVector<Instruction> mInstructions;
+    int mRegisterCount;
+    double mNodataValue;
+    bool mValid;
+};
+
+#endif // QGSRASTERCALCPROGRAM_H
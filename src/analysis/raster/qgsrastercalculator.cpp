@@ -17,11 +17,17 @@
 
 #include "qgsrastercalculator.h"
 #include "qgsrastercalcnode.h"
+#include "qgsrastercalcprogram.h"
+#include "qgsrasterblock.h"
 #include "qgsrasterlayer.h"
 #include "qgsrastermatrix.h"
+#include "qgsrasterprojector.h"
 
 #include <QProgressDialog>
 #include <QFile>
+#include <QThread>
+#include <QVarLengthArray>
+#include <QtConcurrentMap>
 
 #include <cpl_string.h>
 #include <gdalwarper.h>
@@ -34,6 +40,38 @@
 #define TO8F(x)  QFile::encodeName( x ).constData()
 #endif
 
+//! number of cells of the strips of rows which are calculated at once by each thread
+static const int STRIP_CELLS = 256 * 1024;
+
+/// @cond
+
+//! inputs and buffers of one thread
+struct QgsRasterCalcWorker
+{
+  ~QgsRasterCalcWorker() { qDeleteAll( ownedInterfaces ); }
+
+  //! input of each raster entry (provider or projector)
+  QList<QgsRasterInterface*> inputs;
+  QList<int> bandNumbers;
+  //! cloned providers and projectors
+  QList<QgsRasterInterface*> ownedInterfaces;
+  QVector< QVector<double> > inputData;
+  QVector<double> scratch;
+  QVector<float> result;
+};
+
+//! rows calculated by one thread
+struct QgsRasterCalcStrip
+{
+  const QgsRasterCalculator* calculator;
+  const QgsRasterCalcProgram* program;
+  QgsRasterCalcWorker* worker;
+  int row;
+  int nRows;
+};
+
+/// @endcond
+
 QgsRasterCalculator::QgsRasterCalculator( const QString& formulaString, const QString& outputFile, const QString& outputFormat,
     const QgsRectangle& outputExtent, int nOutputColumns, int nOutputRows, const QVector<QgsRasterCalculatorEntry>& rasterEntries )
     : mFormulaString( formulaString )
@@ -77,31 +115,24 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
     return 4;
   }
 
-  QMap< QString, QgsRasterBlock* > inputBlocks;
+  QStringList inputNames;
   QVector<QgsRasterCalculatorEntry>::const_iterator it = mRasterEntries.constBegin();
   for ( ; it != mRasterEntries.constEnd(); ++it )
   {
     if ( !it->raster ) // no raster layer in entry
     {
+      delete calcNode;
       return 2;
     }
+    inputNames << it->ref;
+  }
 
-    QgsRasterBlock* block = 0;
-    // if crs transform needed
-    if ( it->raster->crs() != mOutputCrs )
-    {
-      QgsRasterProjector proj;
-      proj.setCRS( it->raster->crs(), mOutputCrs );
-      proj.setInput( it->raster->dataProvider() );
-      proj.setPrecision( QgsRasterProjector::Exact );
-
-      block = proj.block( it->bandNumber, mOutputRectangle, mNumOutputColumns, mNumOutputRows );
-    }
-    else
-    {
-      block = it->raster->dataProvider()->block( it->bandNumber, mOutputRectangle, mNumOutputColumns, mNumOutputRows );
-    }
-    inputBlocks.insert( it->ref, block );
+  float outputNodataValue = -FLT_MAX;
+  QgsRasterCalcProgram program( calcNode, inputNames, outputNodataValue );
+  delete calcNode;
+  if ( !program.isValid() )
+  {
+    return 4;
   }
 
   //open output dataset for writing
@@ -115,7 +146,6 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   GDALSetProjection( outputDataset, mOutputCrs.toWkt().toLocal8Bit().data() );
   GDALRasterBandH outputRasterBand = GDALGetRasterBand( outputDataset, 1 );
 
-  float outputNodataValue = -FLT_MAX;
   GDALSetRasterNoDataValue( outputRasterBand, outputNodataValue );
 
   if ( p )
@@ -123,15 +153,27 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
     p->setMaximum( mNumOutputRows );
   }
 
-  QgsRasterMatrix resultMatrix;
-  resultMatrix.setNodataValue( outputNodataValue );
+  //each thread reads and calculates strips of rows with its own inputs and buffers
+  QList<QgsRasterCalcWorker*> workers;
+  int nWorkers = qMax( 1, QThread::idealThreadCount() );
+  for ( int i = 0; i < nWorkers; ++i )
+  {
+    QgsRasterCalcWorker* worker = createWorker( program, i > 0 );
+    if ( !worker )
+    {
+      break; // the inputs cannot be cloned, fewer threads are used
+    }
+    workers << worker;
+  }
+
+  int stripRows = qBound( 1, STRIP_CELLS / qMax( 1, mNumOutputColumns ), qMax( 1, mNumOutputRows ) );
 
-  //read / write line by line
-  for ( int i = 0; i < mNumOutputRows; ++i )
+  //read / write strip by strip, the strips of a batch are calculated in parallel
+  for ( int row = 0; row < mNumOutputRows; )
   {
     if ( p )
     {
-      p->setValue( i );
+      p->setValue( row );
     }
 
     if ( p && p->wasCanceled() )
@@ -139,25 +181,36 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
       break;
     }
 
-    if ( calcNode->calculate( inputBlocks, resultMatrix, i ) )
+    QList<QgsRasterCalcStrip> strips;
+    for ( int i = 0; i < workers.size() && row < mNumOutputRows; ++i )
     {
-      bool resultIsNumber = resultMatrix.isNumber();
-      float* calcData = new float[mNumOutputColumns];
+      QgsRasterCalcStrip strip;
+      strip.calculator = this;
+      strip.program = &program;
+      strip.worker = workers.at( i );
+      strip.row = row;
+      strip.nRows = qMin( stripRows, mNumOutputRows - row );
+      strips << strip;
+      row += strip.nRows;
+    }
 
-      for ( int j = 0; j < mNumOutputColumns; ++j )
-      {
-        calcData[j] = ( float )( resultIsNumber ? resultMatrix.number() : resultMatrix.data()[j] );
-      }
+    if ( strips.size() > 1 )
+    {
+      QtConcurrent::blockingMap( strips, calculateStrip );
+    }
+    else
+    {
+      calculateStrip( strips[0] );
+    }
 
-      //write scanline to the dataset
-      if ( GDALRasterIO( outputRasterBand, GF_Write, 0, i, mNumOutputColumns, 1, calcData, mNumOutputColumns, 1, GDT_Float32, 0, 0 ) != CE_None )
+    Q_FOREACH ( const QgsRasterCalcStrip& strip, strips )
+    {
+      //write strip to the dataset
+      if ( GDALRasterIO( outputRasterBand, GF_Write, 0, strip.row, mNumOutputColumns, strip.nRows, strip.worker->result.data(), mNumOutputColumns, strip.nRows, GDT_Float32, 0, 0 ) != CE_None )
       {
         qWarning( "RasterIO error!" );
       }
-
-      delete[] calcData;
     }
-
   }
 
   if ( p )
@@ -166,9 +219,8 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   }
 
   //close datasets and release memory
-  delete calcNode;
-  qDeleteAll( inputBlocks );
-  inputBlocks.clear();
+  qDeleteAll( workers );
+  workers.clear();
 
   if ( p && p->wasCanceled() )
   {
@@ -181,6 +233,90 @@ int QgsRasterCalculator::processCalculation( QProgressDialog* p )
   return 0;
 }
 
+QgsRasterCalcWorker* QgsRasterCalculator::createWorker( const QgsRasterCalcProgram& program, bool cloneInputs ) const
+{
+  QgsRasterCalcWorker* worker = new QgsRasterCalcWorker();
+  QVector<QgsRasterCalculatorEntry>::const_iterator it = mRasterEntries.constBegin();
+  for ( ; it != mRasterEntries.constEnd(); ++it )
+  {
+    QgsRasterInterface* provider = it->raster->dataProvider();
+    if ( cloneInputs )
+    {
+      //providers are not thread safe, each thread reads from its own copy
+      provider = provider ? provider->clone() : 0;
+      if ( !provider )
+      {
+        delete worker;
+        return 0;
+      }
+      worker->ownedInterfaces << provider;
+    }
+
+    QgsRasterInterface* input = provider;
+    // if crs transform needed
+    if ( it->raster->crs() != mOutputCrs )
+    {
+      QgsRasterProjector* proj = new QgsRasterProjector;
+      proj->setCRS( it->raster->crs(), mOutputCrs );
+      proj->setInput( provider );
+      proj->setPrecision( QgsRasterProjector::Exact );
+      worker->ownedInterfaces << proj;
+      input = proj;
+    }
+    worker->inputs << input;
+    worker->bandNumbers << it->bandNumber;
+  }
+
+  worker->inputData.resize( worker->inputs.size() );
+  worker->scratch.resize( program.scratchSize() );
+  return worker;
+}
+
+void QgsRasterCalculator::calculateStrip( QgsRasterCalcStrip& strip )
+{
+  const QgsRasterCalculator* calc = strip.calculator;
+  QgsRasterCalcWorker* worker = strip.worker;
+  int nCols = calc->mNumOutputColumns;
+  int nCells = nCols * strip.nRows;
+  double nodataValue = -FLT_MAX;
+
+  //extent of the strip, the last strip ends exactly at the bottom of the output extent
+  double rowHeight = calc->mOutputRectangle.height() / calc->mNumOutputRows;
+  double yMax = calc->mOutputRectangle.yMaximum() - strip.row * rowHeight;
+  double yMin = strip.row + strip.nRows == calc->mNumOutputRows ? calc->mOutputRectangle.yMinimum() : yMax - strip.nRows * rowHeight;
+  QgsRectangle stripExtent( calc->mOutputRectangle.xMinimum(), yMin, calc->mOutputRectangle.xMaximum(), yMax );
+
+  QVarLengthArray<const double*, 16> inputs( worker->inputs.size() );
+  for ( int i = 0; i < worker->inputs.size(); ++i )
+  {
+    //convert input raster values to double, also convert input no data to result no data
+    QVector<double>& data = worker->inputData[i];
+    data.resize( nCells );
+    double* values = data.data();
+
+    QgsRasterBlock* block = worker->inputs.at( i )->block( worker->bandNumbers.at( i ), stripExtent, nCols, strip.nRows );
+    if ( block && block->isValid() && block->width() == nCols && block->height() == strip.nRows )
+    {
+      for ( int j = 0; j < nCells; ++j )
+      {
+        values[j] = block->isNoData( j ) ? nodataValue : block->value( j );
+      }
+    }
+    else
+    {
+      for ( int j = 0; j < nCells; ++j )
+      {
+        values[j] = nodataValue;
+      }
+    }
+    delete block;
+    inputs[i] = values;
+  }
+
+  worker->result.resize( nCells );
+  strip.program->evaluate( inputs.constData(), nCells, worker->scratch.data(), worker->result.data() );
+}
+
 QgsRasterCalculator::QgsRasterCalculator()
     : mNumOutputColumns( 0 )
     , mNumOutputRows( 0 )
@@ -26,7 +26,10 @@
 #include "gdal.h"
 
 class QgsRasterLayer;
+class QgsRasterCalcProgram;
 class QProgressDialog;
+struct QgsRasterCalcWorker;
+struct QgsRasterCalcStrip;
 
 
 struct ANALYSIS_EXPORT QgsRasterCalculatorEntry
@@ -69,7 +72,8 @@ class ANALYSIS_EXPORT QgsRasterCalculator
 
     ~QgsRasterCalculator();
 
-    /** Starts the calculation and writes new raster
+    /** Starts the calculation and writes new raster. The output is calculated in strips of rows,
+      several strips in parallel.
       @param p progress bar (or 0 if called from non-gui code)
       @return 0 in case of success*/
     int processCalculation( QProgressDialog* p = 0 );
@@ -90,6 +94,15 @@ class ANALYSIS_EXPORT QgsRasterCalculator
       @param transform double[6] array that receives the GDAL parameters*/
     void outputGeoTransform( double* transform ) const;
 
+    /** Creates the inputs and buffers of a calculation thread
+      @param program compiled formula
+      @param cloneInputs true if the thread reads from clones of the data providers
+      @return 0 if a data provider cannot be cloned*/
+    QgsRasterCalcWorker* createWorker( const QgsRasterCalcProgram& program, bool cloneInputs ) const;
+
+    /** Reads the inputs of a strip and calculates the strip into the result buffer of its worker*/
+    static void calculateStrip( QgsRasterCalcStrip& strip );
+
     QString mFormulaString;
     QString mOutputFile;
     QString mOutputFormat;
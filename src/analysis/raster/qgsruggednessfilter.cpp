@@ -92,3 +92,11 @@ float QgsRuggednessFilter::processNineCellWindow( float* x11, float* x21, float*
   return sqrt( sum );
 }
 
+void QgsRuggednessFilter::processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize )
+{
+  for ( int j = 0; j < xSize; ++j )
+  {
+    resultLine[j] = QgsRuggednessFilter::processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
+                    &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
+  }
+}
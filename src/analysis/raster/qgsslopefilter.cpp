@@ -42,3 +42,11 @@ float QgsSlopeFilter::processNineCellWindow( float* x11, float* x21, float* x31,
   return atan( sqrt( derX * derX + derY * derY ) ) * 180.0 / M_PI;
 }
 
+void QgsSlopeFilter::processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize )
+{
+  for ( int j = 0; j < xSize; ++j )
+  {
+    resultLine[j] = QgsSlopeFilter::processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
+                    &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
+  }
+}
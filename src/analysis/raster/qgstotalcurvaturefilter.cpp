@@ -46,3 +46,12 @@ float QgsTotalCurvatureFilter::processNineCellWindow( float* x11, float* x21, fl
 
   return dxx*dxx + 2*dxy*dxy + dyy*dyy;
 }
+
+void QgsTotalCurvatureFilter::processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize )
+{
+  for ( int j = 0; j < xSize; ++j )
+  {
+    resultLine[j] = QgsTotalCurvatureFilter::processNineCellWindow( &scanLine1[j-1], &scanLine1[j], &scanLine1[j+1], &scanLine2[j-1], &scanLine2[j],
+                    &scanLine2[j+1], &scanLine3[j-1], &scanLine3[j], &scanLine3[j+1] );
+  }
+}
@@ -20,6 +20,7 @@
 #include "qgsapplication.h"
 #include "qgsfield.h"
 #include "qgsfeature.h"
+#include "qgsgeometryengine.h"
 #include "qgslogger.h"
 #include "qgscoordinatereferencesystem.h"
 #include "qgsvectorfilewriter.h"
@@ -162,7 +163,17 @@ void QgsOverlayAnalyzer::intersectFeature( QgsFeature& f, QgsVectorFileWriter* v
       continue;
     }
 
-    if ( featureGeometry->intersects( overlayFeature.constGeometry() ) )
+    const QgsGeometry* overlayGeometry = overlayFeature.constGeometry();
+    if ( !overlayGeometry || !overlayGeometry->geometry() || !featureGeometry->geometry() )
+    {
+      continue;
+    }
+
+    // an overlay geometry is tested against all features overlapping it, its prepared geometry is
+    // shared between these tests
+    QScopedPointer<QgsGeometryEngine> overlayEngine( QgsGeometry::createGeometryEngine( overlayGeometry->geometry() ) );
+    overlayEngine->prepareGeometryShared();
+    if ( overlayEngine->intersects( *featureGeometry->geometry() ) )
     {
       intersectGeometry = featureGeometry->intersection( overlayFeature.constGeometry() );
 
@@ -24,6 +24,9 @@
 #include "cpl_string.h"
 #include <QProgressDialog>
 #include <QFile>
+#include <QLineF>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #if defined(GDAL_VERSION_NUM) && GDAL_VERSION_NUM >= 1800
 #define TO8F(x) (x).toUtf8().constData()
@@ -31,6 +34,65 @@
 #define TO8F(x) QFile::encodeName( x ).constData()
 #endif
 
+//! number of cells of the strips of rows which are read at once by each thread in single pass mode
+static const int STRIP_CELLS = 1024 * 1024;
+
+/// @cond
+
+//! polygon rasterized by a single pass over the raster
+struct QgsZonalStatistics::Zone
+{
+  QgsFeatureId id;
+  int firstRow;
+  int lastRow;
+  //! edges of all rings of the polygon
+  QVector<QLineF> edges;
+};
+
+//! rows of the raster processed by one thread
+struct QgsZonalStatistics::RasterStrip
+{
+  const QgsZonalStatistics* zonalStatistics;
+  const QVector<Zone>* zones;
+  void* band;
+  int row;
+  int nRows;
+  int nCols;
+  double xMin;
+  double yMax;
+  double cellSizeX;
+  double cellSizeY;
+  bool storeValues;
+  bool storeValueCounts;
+  //! indexes of the zones intersecting the strip
+  QVector<int> zoneIndexes;
+  //! statistics of the part of each zone inside the strip, by zone index
+  QHash<int, FeatureStats> stats;
+};
+
+static void addRingEdges( const QgsPolyline& ring, QVector<QLineF>& edges )
+{
+  for ( int i = 1; i < ring.size(); ++i )
+  {
+    edges << QLineF( ring.at( i - 1 ).x(), ring.at( i - 1 ).y(), ring.at( i ).x(), ring.at( i ).y() );
+  }
+  if ( ring.size() > 1 && ring.first() != ring.last() )
+  {
+    edges << QLineF( ring.last().x(), ring.last().y(), ring.first().x(), ring.first().y() );
+  }
+}
+
+static int clampedColumn( double column, int nCols )
+{
+  if ( column < 0 )
+    return 0;
+  if ( column > nCols - 1 )
+    return nCols - 1;
+  return static_cast<int>( column );
+}
+
+/// @endcond
+
 QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QString& rasterFile, const QString& attributePrefix, int rasterBand, const Statistics& stats )
     : mRasterFilePath( rasterFile )
     , mRasterBand( rasterBand )
@@ -38,6 +100,7 @@ QgsZonalStatistics::QgsZonalStatistics( QgsVectorLayer* polygonLayer, const QStr
     , mAttributePrefix( attributePrefix )
     , mInputNodataValue( -1 )
     , mStatistics( stats )
+    , mSinglePass( false )
 {
 
 }
@@ -47,6 +110,7 @@ QgsZonalStatistics::QgsZonalStatistics()
     , mPolygonLayer( 0 )
     , mInputNodataValue( -1 )
     , mStatistics( QgsZonalStatistics::All )
+    , mSinglePass( false )
 {
 
 }
@@ -224,6 +288,19 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
     return 8;
   }
 
+  QMap<int, int> fieldIndexes;
+  fieldIndexes.insert( QgsZonalStatistics::Count, countIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Sum, sumIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Mean, meanIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Median, medianIndex );
+  fieldIndexes.insert( QgsZonalStatistics::StDev, stdevIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Min, minIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Max, maxIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Range, rangeIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Minority, minorityIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Majority, majorityIndex );
+  fieldIndexes.insert( QgsZonalStatistics::Variety, varietyIndex );
+
   //progress dialog
   long featureCount = vectorProvider->featureCount();
   if ( p )
@@ -232,17 +309,24 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
   }
 
 
+  bool statsStoreValues = ( mStatistics & QgsZonalStatistics::Median ) ||
+                          ( mStatistics & QgsZonalStatistics::StDev );
+  bool statsStoreValueCount = ( mStatistics & QgsZonalStatistics::Minority ) ||
+                              ( mStatistics & QgsZonalStatistics::Majority );
+
+  //statistics of the cells with the center in the polygons, calculated for all polygons at once
+  QHash<QgsFeatureId, FeatureStats> zoneStats;
+  if ( mSinglePass )
+  {
+    statisticsFromRasterPass( rasterBand, nCellsXGDAL, nCellsYGDAL, cellsizeX, cellsizeY, rasterBBox, zoneStats, p );
+  }
+
   //iterate over each polygon
   QgsFeatureRequest request;
   request.setSubsetOfAttributes( QgsAttributeList() );
   QgsFeatureIterator fi = vectorProvider->getFeatures( request );
   QgsFeature f;
 
-  bool statsStoreValues = ( mStatistics & QgsZonalStatistics::Median ) ||
-                          ( mStatistics & QgsZonalStatistics::StDev );
-  bool statsStoreValueCount = ( mStatistics & QgsZonalStatistics::Minority ) ||
-                              ( mStatistics & QgsZonalStatistics::Majority );
-
   FeatureStats featureStats( statsStoreValues, statsStoreValueCount );
   int featureCounter = 0;
 
@@ -290,8 +374,21 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
       nCellsY = nCellsYGDAL - offsetY;
     }
 
-    statisticsFromMiddlePointTest( rasterBand, featureGeometry, offsetX, offsetY, nCellsX, nCellsY, cellsizeX, cellsizeY,
-                                   rasterBBox, featureStats );
+    if ( mSinglePass )
+    {
+      featureStats.reset();
+      QHash<QgsFeatureId, FeatureStats>::iterator zoneIt = zoneStats.find( f.id() );
+      if ( zoneIt != zoneStats.end() )
+      {
+        featureStats = zoneIt.value();
+        zoneStats.erase( zoneIt );
+      }
+    }
+    else
+    {
+      statisticsFromMiddlePointTest( rasterBand, featureGeometry, offsetX, offsetY, nCellsX, nCellsY, cellsizeX, cellsizeY,
+                                     rasterBBox, featureStats );
+    }
 
     if ( featureStats.count <= 1 )
     {
@@ -301,69 +398,7 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
     }
 
     //write the statistics value to the vector data provider
-    QgsAttributeMap changeAttributeMap;
-    if ( mStatistics & QgsZonalStatistics::Count )
-      changeAttributeMap.insert( countIndex, QVariant( featureStats.count ) );
-    if ( mStatistics & QgsZonalStatistics::Sum )
-      changeAttributeMap.insert( sumIndex, QVariant( featureStats.sum ) );
-    if ( featureStats.count > 0 )
-    {
-      double mean = featureStats.sum / featureStats.count;
-      if ( mStatistics & QgsZonalStatistics::Mean )
-        changeAttributeMap.insert( meanIndex, QVariant( mean ) );
-      if ( mStatistics & QgsZonalStatistics::Median )
-      {
-        qSort( featureStats.values.begin(), featureStats.values.end() );
-        int size =  featureStats.values.count();
-        bool even = ( size % 2 ) < 1;
-        double medianValue;
-        if ( even )
-        {
-          medianValue = ( featureStats.values[size / 2 - 1] + featureStats.values[size / 2] ) / 2;
-        }
-        else //odd
-        {
-          medianValue = featureStats.values[( size + 1 ) / 2 - 1];
-        }
-        changeAttributeMap.insert( medianIndex, QVariant( medianValue ) );
-      }
-      if ( mStatistics & QgsZonalStatistics::StDev )
-      {
-        double sumSquared = 0;
-        for ( int i = 0; i < featureStats.values.count(); ++i )
-        {
-          double diff = featureStats.values.at( i ) - mean;
-          sumSquared += diff * diff;
-        }
-        double stdev = qPow( sumSquared / featureStats.values.count(), 0.5 );
-        changeAttributeMap.insert( stdevIndex, QVariant( stdev ) );
-      }
-      if ( mStatistics & QgsZonalStatistics::Min )
-        changeAttributeMap.insert( minIndex, QVariant( featureStats.min ) );
-      if ( mStatistics & QgsZonalStatistics::Max )
-        changeAttributeMap.insert( maxIndex, QVariant( featureStats.max ) );
-      if ( mStatistics & QgsZonalStatistics::Range )
-        changeAttributeMap.insert( rangeIndex, QVariant( featureStats.max - featureStats.min ) );
-      if ( mStatistics & QgsZonalStatistics::Minority || mStatistics & QgsZonalStatistics::Majority )
-      {
-        QList<int> vals = featureStats.valueCount.values();
-        qSort( vals.begin(), vals.end() );
-        if ( mStatistics & QgsZonalStatistics::Minority )
-        {
-          float minorityKey = featureStats.valueCount.key( vals.first() );
-          changeAttributeMap.insert( minorityIndex, QVariant( minorityKey ) );
-        }
-        if ( mStatistics & QgsZonalStatistics::Majority )
-        {
-          float majKey = featureStats.valueCount.key( vals.last() );
-          changeAttributeMap.insert( majorityIndex, QVariant( majKey ) );
-        }
-      }
-      if ( mStatistics & QgsZonalStatistics::Variety )
-        changeAttributeMap.insert( varietyIndex, QVariant( featureStats.valueCount.count() ) );
-    }
-
-    changeMap.insert( f.id(), changeAttributeMap );
+    changeMap.insert( f.id(), statisticsAttributes( featureStats, fieldIndexes ) );
     ++featureCounter;
   }
 
@@ -385,6 +420,265 @@ int QgsZonalStatistics::calculateStatistics( QProgressDialog* p )
   return 0;
 }
 
+void QgsZonalStatistics::statisticsFromRasterPass( void* band, int nCellsX, int nCellsY, double cellSizeX, double cellSizeY,
+    const QgsRectangle& rasterBBox, QHash<QgsFeatureId, FeatureStats>& zoneStats, QProgressDialog* p )
+{
+  //rasterize all polygons to the rows covered by their bounding box
+  QVector<Zone> zones;
+  QgsFeatureRequest request;
+  request.setSubsetOfAttributes( QgsAttributeList() );
+  QgsFeatureIterator fi = mPolygonLayer->dataProvider()->getFeatures( request );
+  QgsFeature f;
+  while ( fi.nextFeature( f ) )
+  {
+    const QgsGeometry* featureGeometry = f.constGeometry();
+    if ( !featureGeometry )
+      continue;
+
+    QgsRectangle featureRect = featureGeometry->boundingBox().intersect( &rasterBBox );
+    if ( featureRect.isEmpty() )
+      continue;
+
+    int offsetX, offsetY, nCellsFeatureX, nCellsFeatureY;
+    if ( cellInfoForBBox( rasterBBox, featureRect, cellSizeX, cellSizeY, offsetX, offsetY, nCellsFeatureX, nCellsFeatureY ) != 0 )
+      continue;
+
+    nCellsFeatureY = qMin( nCellsFeatureY, nCellsY - offsetY );
+    if ( nCellsFeatureY <= 0 )
+      continue;
+
+    Zone zone;
+    zone.id = f.id();
+    zone.firstRow = offsetY;
+    zone.lastRow = offsetY + nCellsFeatureY - 1;
+    if ( featureGeometry->isMultipart() )
+    {
+      Q_FOREACH ( const QgsPolygon& polygon, featureGeometry->asMultiPolygon() )
+      {
+        Q_FOREACH ( const QgsPolyline& ring, polygon )
+          addRingEdges( ring, zone.edges );
+      }
+    }
+    else
+    {
+      Q_FOREACH ( const QgsPolyline& ring, featureGeometry->asPolygon() )
+        addRingEdges( ring, zone.edges );
+    }
+    zones << zone;
+  }
+
+  if ( zones.isEmpty() )
+    return;
+
+  //strips of whole raster blocks
+  int blockSizeX, blockSizeY;
+  GDALGetBlockSize( band, &blockSizeX, &blockSizeY );
+  int stripRows = qMax( 1, STRIP_CELLS / nCellsX );
+  if ( blockSizeY > 0 )
+    stripRows = qMax( blockSizeY, stripRows / blockSizeY * blockSizeY );
+  int nStrips = ( nCellsY + stripRows - 1 ) / stripRows;
+
+  QVector< QVector<int> > stripZones( nStrips );
+  for ( int i = 0; i < zones.size(); ++i )
+  {
+    for ( int strip = zones.at( i ).firstRow / stripRows; strip <= zones.at( i ).lastRow / stripRows; ++strip )
+      stripZones[strip] << i;
+  }
+
+  //each thread reads from its own dataset
+  QList<void*> bands;
+  QList<GDALDatasetH> datasets;
+  bands << band;
+  for ( int i = 1; i < QThread::idealThreadCount(); ++i )
+  {
+    GDALDatasetH dataset = GDALOpen( TO8F( mRasterFilePath ), GA_ReadOnly );
+    if ( !dataset )
+      break;
+    datasets << dataset;
+    bands << GDALGetRasterBand( dataset, mRasterBand );
+  }
+
+  bool storeValues = ( mStatistics & QgsZonalStatistics::Median ) || ( mStatistics & QgsZonalStatistics::StDev );
+  bool storeValueCounts = ( mStatistics & QgsZonalStatistics::Minority ) || ( mStatistics & QgsZonalStatistics::Majority );
+
+  for ( int stripIndex = 0; stripIndex < nStrips; )
+  {
+    if ( p && p->wasCanceled() )
+      break;
+
+    QList<RasterStrip> strips;
+    for ( int i = 0; i < bands.size() && stripIndex < nStrips; ++i, ++stripIndex )
+    {
+      RasterStrip strip;
+      strip.zonalStatistics = this;
+      strip.zones = &zones;
+      strip.band = bands.at( i );
+      strip.row = stripIndex * stripRows;
+      strip.nRows = qMin( stripRows, nCellsY - strip.row );
+      strip.nCols = nCellsX;
+      strip.xMin = rasterBBox.xMinimum();
+      strip.yMax = rasterBBox.yMaximum();
+      strip.cellSizeX = cellSizeX;
+      strip.cellSizeY = cellSizeY;
+      strip.storeValues = storeValues;
+      strip.storeValueCounts = storeValueCounts;
+      strip.zoneIndexes = stripZones.at( stripIndex );
+      strips << strip;
+    }
+
+    QtConcurrent::blockingMap( strips, statisticsFromStrip );
+
+    //merge the statistics of polygons in several strips
+    Q_FOREACH ( const RasterStrip& strip, strips )
+    {
+      for ( QHash<int, FeatureStats>::const_iterator it = strip.stats.constBegin(); it != strip.stats.constEnd(); ++it )
+      {
+        QgsFeatureId id = zones.at( it.key() ).id;
+        QHash<QgsFeatureId, FeatureStats>::iterator zoneIt = zoneStats.find( id );
+        if ( zoneIt == zoneStats.end() )
+          zoneStats.insert( id, it.value() );
+        else
+          zoneIt.value().merge( it.value() );
+      }
+    }
+  }
+
+  Q_FOREACH ( GDALDatasetH dataset, datasets )
+    GDALClose( dataset );
+}
+
+void QgsZonalStatistics::statisticsFromStrip( RasterStrip& strip )
+{
+  int nCols = strip.nCols;
+  QVector<float> data( nCols * strip.nRows );
+  if ( GDALRasterIO( strip.band, GF_Read, 0, strip.row, nCols, strip.nRows, data.data(), nCols, strip.nRows, GDT_Float32, 0, 0 )
+       != CPLE_None )
+  {
+    return;
+  }
+
+  double stripYMax = strip.yMax - strip.row * strip.cellSizeY;
+  double stripYMin = stripYMax - strip.nRows * strip.cellSizeY;
+
+  QVector<QLineF> edges;
+  QVector<double> crossings;
+  Q_FOREACH ( int zoneIndex, strip.zoneIndexes )
+  {
+    const Zone& zone = strip.zones->at( zoneIndex );
+
+    edges.clear();
+    Q_FOREACH ( const QLineF& edge, zone.edges )
+    {
+      if ( qMax( edge.y1(), edge.y2() ) >= stripYMin && qMin( edge.y1(), edge.y2() ) <= stripYMax )
+        edges << edge;
+    }
+
+    FeatureStats* stats = 0;
+    int firstRow = qMax( zone.firstRow, strip.row );
+    int lastRow = qMin( zone.lastRow, strip.row + strip.nRows - 1 );
+    for ( int row = firstRow; row <= lastRow; ++row )
+    {
+      //crossings of the rings with the line through the cell centers of the row
+      double cellCenterY = strip.yMax - ( row + 0.5 ) * strip.cellSizeY;
+      crossings.clear();
+      Q_FOREACH ( const QLineF& edge, edges )
+      {
+        if (( edge.y1() > cellCenterY ) != ( edge.y2() > cellCenterY ) )
+          crossings << edge.x1() + ( cellCenterY - edge.y1() ) * ( edge.x2() - edge.x1() ) / ( edge.y2() - edge.y1() );
+      }
+      qSort( crossings.begin(), crossings.end() );
+
+      const float* scanLine = data.constData() + ( row - strip.row ) * nCols;
+      for ( int i = 0; i + 1 < crossings.size(); i += 2 )
+      {
+        //cells with the center between two crossings are inside the polygon
+        double firstCol = floor(( crossings.at( i ) - strip.xMin ) / strip.cellSizeX - 0.5 ) + 1;
+        double lastCol = ceil(( crossings.at( i + 1 ) - strip.xMin ) / strip.cellSizeX - 0.5 ) - 1;
+        if ( lastCol < 0 || firstCol > nCols - 1 || firstCol > lastCol )
+          continue;
+
+        int endCol = clampedColumn( lastCol, nCols );
+        for ( int col = clampedColumn( firstCol, nCols ); col <= endCol; ++col )
+        {
+          if ( !strip.zonalStatistics->validPixel( scanLine[col] ) )
+            continue;
+
+          if ( !stats )
+            stats = &strip.stats.insert( zoneIndex, FeatureStats( strip.storeValues, strip.storeValueCounts ) ).value();
+          stats->addValue( scanLine[col] );
+        }
+      }
+    }
+  }
+}
+
+QgsAttributeMap QgsZonalStatistics::statisticsAttributes( FeatureStats& stats, const QMap<int, int>& fieldIndexes ) const
+{
+  QgsAttributeMap changeAttributeMap;
+  if ( mStatistics & QgsZonalStatistics::Count )
+    changeAttributeMap.insert( fieldIndexes.value( Count ), QVariant( stats.count ) );
+  if ( mStatistics & QgsZonalStatistics::Sum )
+    changeAttributeMap.insert( fieldIndexes.value( Sum ), QVariant( stats.sum ) );
+  if ( stats.count > 0 )
+  {
+    double mean = stats.sum / stats.count;
+    if ( mStatistics & QgsZonalStatistics::Mean )
+      changeAttributeMap.insert( fieldIndexes.value( Mean ), QVariant( mean ) );
+    if ( mStatistics & QgsZonalStatistics::Median )
+    {
+      qSort( stats.values.begin(), stats.values.end() );
+      int size =  stats.values.count();
+      bool even = ( size % 2 ) < 1;
+      double medianValue;
+      if ( even )
+      {
+        medianValue = ( stats.values[size / 2 - 1] + stats.values[size / 2] ) / 2;
+      }
+      else //odd
+      {
+        medianValue = stats.values[( size + 1 ) / 2 - 1];
+      }
+      changeAttributeMap.insert( fieldIndexes.value( Median ), QVariant( medianValue ) );
+    }
+    if ( mStatistics & QgsZonalStatistics::StDev )
+    {
+      double sumSquared = 0;
+      for ( int i = 0; i < stats.values.count(); ++i )
+      {
+        double diff = stats.values.at( i ) - mean;
+        sumSquared += diff * diff;
+      }
+      double stdev = qPow( sumSquared / stats.values.count(), 0.5 );
+      changeAttributeMap.insert( fieldIndexes.value( StDev ), QVariant( stdev ) );
+    }
+    if ( mStatistics & QgsZonalStatistics::Min )
+      changeAttributeMap.insert( fieldIndexes.value( Min ), QVariant( stats.min ) );
+    if ( mStatistics & QgsZonalStatistics::Max )
+      changeAttributeMap.insert( fieldIndexes.value( Max ), QVariant( stats.max ) );
+    if ( mStatistics & QgsZonalStatistics::Range )
+      changeAttributeMap.insert( fieldIndexes.value( Range ), QVariant( stats.max - stats.min ) );
+    if ( mStatistics & QgsZonalStatistics::Minority || mStatistics & QgsZonalStatistics::Majority )
+    {
+      QList<int> vals = stats.valueCount.values();
+      qSort( vals.begin(), vals.end() );
+      if ( mStatistics & QgsZonalStatistics::Minority )
+      {
+        float minorityKey = stats.valueCount.key( vals.first() );
+        changeAttributeMap.insert( fieldIndexes.value( Minority ), QVariant( minorityKey ) );
+      }
+      if ( mStatistics & QgsZonalStatistics::Majority )
+      {
+        float majKey = stats.valueCount.key( vals.last() );
+        changeAttributeMap.insert( fieldIndexes.value( Majority ), QVariant( majKey ) );
+      }
+    }
+    if ( mStatistics & QgsZonalStatistics::Variety )
+      changeAttributeMap.insert( fieldIndexes.value( Variety ), QVariant( stats.valueCount.count() ) );
+  }
+
+  return changeAttributeMap;
+}
+
 int QgsZonalStatistics::cellInfoForBBox( const QgsRectangle& rasterBBox, const QgsRectangle& featureBBox, double cellSizeX, double cellSizeY,
     int& offsetX, int& offsetY, int& nCellsX, int& nCellsY ) const
 {
@@ -18,7 +18,9 @@
 #ifndef QGSZONALSTATISTICS_H
 #define QGSZONALSTATISTICS_H
 
+#include "qgsfeature.h"
 #include "qgsrectangle.h"
+#include <QHash>
 #include <QString>
 
 class QgsGeometry;
@@ -56,6 +58,21 @@ class ANALYSIS_EXPORT QgsZonalStatistics
       @return 0 in case of success*/
     int calculateStatistics( QProgressDialog* p );
 
+    /** Sets whether the statistics of all polygons are calculated with a single pass over the raster.
+     * The polygons are rasterized into the rows of the raster and the raster is read in strips of
+     * rows, several strips in parallel. This is faster than reading the raster cells of each polygon
+     * separately if there are many polygons or the polygons overlap. Results are the same in both modes.
+     * @note added in QGIS 2.14
+     * @see singlePass()
+     */
+    void setSinglePass( bool singlePass ) { mSinglePass = singlePass; }
+
+    /** Returns whether the statistics of all polygons are calculated with a single pass over the raster.
+     * @note added in QGIS 2.14
+     * @see setSinglePass()
+     */
+    bool singlePass() const { return mSinglePass; }
+
   private:
     QgsZonalStatistics();
 
@@ -92,6 +109,16 @@ class ANALYSIS_EXPORT QgsZonalStatistics
         double count;
         float max;
         float min;
+        void merge( const FeatureStats& other )
+        {
+          sum += other.sum;
+          count += other.count;
+          min = qMin( min, other.min );
+          max = qMax( max, other.max );
+          for ( QMap< float, int >::const_iterator it = other.valueCount.constBegin(); it != other.valueCount.constEnd(); ++it )
+            valueCount[it.key()] += it.value();
+          values += other.values;
+        }
         QMap< float, int > valueCount;
         QList< float > values;
 
@@ -113,6 +140,21 @@ class ANALYSIS_EXPORT QgsZonalStatistics
     void statisticsFromPreciseIntersection( void* band, const QgsGeometry* poly, int pixelOffsetX, int pixelOffsetY, int nCellsX, int nCellsY,
                                             double cellSizeX, double cellSizeY, const QgsRectangle& rasterBBox, FeatureStats& stats );
 
+    struct Zone;
+    struct RasterStrip;
+
+    /** Calculates the statistics of the cells with the center inside each polygon with a single pass over the raster*/
+    void statisticsFromRasterPass( void* band, int nCellsX, int nCellsY, double cellSizeX, double cellSizeY,
+                                   const QgsRectangle& rasterBBox, QHash<QgsFeatureId, FeatureStats>& zoneStats, QProgressDialog* p );
+
+    /** Reads a strip of rows and adds the cells of the polygons in the strip to the statistics of the strip*/
+    static void statisticsFromStrip( RasterStrip& strip );
+
+    /** Returns the attribute values of the calculated statistics
+      @param stats statistics of a feature
+      @param fieldIndexes index of the field of each statistic*/
+    QgsAttributeMap statisticsAttributes( FeatureStats& stats, const QMap<int, int>& fieldIndexes ) const;
+
     /** Tests whether a pixel's value should be included in the result*/
     bool validPixel( float value ) const;
 
@@ -126,6 +168,7 @@ class ANALYSIS_EXPORT QgsZonalStatistics
     /** The nodata value of the input layer*/
     float mInputNodataValue;
     Statistics mStatistics;
+    bool mSinglePass;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( QgsZonalStatistics::Statistics )
@@ -0,0 +1,370 @@
+/***************************************************************************
+                        qgscoordinatekernels.cpp
+  -------------------------------------------------------------------
+Date                 : November 2015
+Copyright            : (C) 2015 by the QGIS Development Team
+email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgscoordinatekernels.h"
+#include "qgsgeometryutils.h"
+
+#include <QTransform>
+#include <cmath>
+#include <limits>
+
+// SSE2 is part of every x86-64 processor, no need to check at runtime
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#define QGS_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+void QgsCoordinateKernels::boundingBox( const double* x, const double* y, int n, double& xMin, double& yMin, double& xMax, double& yMax )
+{
+  xMin = std::numeric_limits<double>::max();
+  yMin = std::numeric_limits<double>::max();
+  xMax = -std::numeric_limits<double>::max();
+  yMax = -std::numeric_limits<double>::max();
+
+  int i = 0;
+#ifdef QGS_KERNELS_SSE2
+  if ( n >= 2 )
+  {
+    __m128d vxMin = _mm_set1_pd( xMin );
+    __m128d vyMin = _mm_set1_pd( yMin );
+    __m128d vxMax = _mm_set1_pd( xMax );
+    __m128d vyMax = _mm_set1_pd( yMax );
+    for ( ; i + 2 <= n; i += 2 )
+    {
+      __m128d vx = _mm_loadu_pd( x + i );
+      __m128d vy = _mm_loadu_pd( y + i );
+      // min/max return the second operand if any is NaN, so NaN coordinates are skipped
+      vxMin = _mm_min_pd( vx, vxMin );
+      vyMin = _mm_min_pd( vy, vyMin );
+      vxMax = _mm_max_pd( vx, vxMax );
+      vyMax = _mm_max_pd( vy, vyMax );
+    }
+    double lanes[2];
+    _mm_storeu_pd( lanes, vxMin );
+    xMin = qMin( lanes[0], lanes[1] );
+    _mm_storeu_pd( lanes, vyMin );
+    yMin = qMin( lanes[0], lanes[1] );
+    _mm_storeu_pd( lanes, vxMax );
+    xMax = qMax( lanes[0], lanes[1] );
+    _mm_storeu_pd( lanes, vyMax );
+    yMax = qMax( lanes[0], lanes[1] );
+  }
+#endif
+
+  for ( ; i < n; ++i )
+  {
+    if ( x[i] < xMin )
+      xMin = x[i];
+    if ( x[i] > xMax )
+      xMax = x[i];
+    if ( y[i] < yMin )
+      yMin = y[i];
+    if ( y[i] > yMax )
+      yMax = y[i];
+  }
+}
+
+double QgsCoordinateKernels::length( const double* x, const double* y, int n )
+{
+  double length = 0;
+  int i = 1;
+#ifdef QGS_KERNELS_SSE2
+  if ( n >= 3 )
+  {
+    __m128d sum = _mm_setzero_pd();
+    for ( ; i + 2 <= n; i += 2 )
+    {
+      __m128d dx = _mm_sub_pd( _mm_loadu_pd( x + i ), _mm_loadu_pd( x + i - 1 ) );
+      __m128d dy = _mm_sub_pd( _mm_loadu_pd( y + i ), _mm_loadu_pd( y + i - 1 ) );
+      sum = _mm_add_pd( sum, _mm_sqrt_pd( _mm_add_pd( _mm_mul_pd( dx, dx ), _mm_mul_pd( dy, dy ) ) ) );
+    }
+    double lanes[2];
+    _mm_storeu_pd( lanes, sum );
+    length = lanes[0] + lanes[1];
+  }
+#endif
+
+  for ( ; i < n; ++i )
+  {
+    double dx = x[i] - x[i - 1];
+    double dy = y[i] - y[i - 1];
+    length += sqrt( dx * dx + dy * dy );
+  }
+  return length;
+}
+
+double QgsCoordinateKernels::shoelaceSum( const double* x, const double* y, int n )
+{
+  double sum = 0;
+  int i = 0;
+#ifdef QGS_KERNELS_SSE2
+  if ( n >= 3 )
+  {
+    __m128d vsum = _mm_setzero_pd();
+    for ( ; i + 3 <= n; i += 2 )
+    {
+      __m128d x0 = _mm_loadu_pd( x + i );
+      __m128d y0 = _mm_loadu_pd( y + i );
+      __m128d x1 = _mm_loadu_pd( x + i + 1 );
+      __m128d y1 = _mm_loadu_pd( y + i + 1 );
+      vsum = _mm_add_pd( vsum, _mm_sub_pd( _mm_mul_pd( x0, y1 ), _mm_mul_pd( y0, x1 ) ) );
+    }
+    double lanes[2];
+    _mm_storeu_pd( lanes, vsum );
+    sum = lanes[0] + lanes[1];
+  }
+#endif
+
+  for ( ; i < n - 1; ++i )
+  {
+    sum += x[i] * y[i + 1] - y[i] * x[i + 1];
+  }
+  return sum;
+}
+
+void QgsCoordinateKernels::transform( const QTransform& t, double* x, double* y, int n )
+{
+  QTransform::TransformationType type = t.type();
+  if ( type == QTransform::TxNone )
+    return;
+
+  if ( type == QTransform::TxProject )
+  {
+    for ( int i = 0; i < n; ++i )
+    {
+      qreal tx, ty;
+      t.map( x[i], y[i], &tx, &ty );
+      x[i] = tx;
+      y[i] = ty;
+    }
+    return;
+  }
+
+  // same operations as QTransform::map() to get identical results
+  double m11 = t.m11(), m12 = t.m12(), m21 = t.m21(), m22 = t.m22(), dx = t.dx(), dy = t.dy();
+  bool scaleOnly = type <= QTransform::TxScale;
+  if ( type == QTransform::TxTranslate )
+  {
+    m11 = 1.0;
+    m22 = 1.0;
+  }
+
+  int i = 0;
+#ifdef QGS_KERNELS_SSE2
+  __m128d vm11 = _mm_set1_pd( m11 ), vm12 = _mm_set1_pd( m12 ), vm21 = _mm_set1_pd( m21 ), vm22 = _mm_set1_pd( m22 );
+  __m128d vdx = _mm_set1_pd( dx ), vdy = _mm_set1_pd( dy );
+  for ( ; i + 2 <= n; i += 2 )
+  {
+    __m128d vx = _mm_loadu_pd( x + i );
+    __m128d vy = _mm_loadu_pd( y + i );
+    __m128d nx, ny;
+    if ( scaleOnly )
+    {
+      nx = _mm_add_pd( _mm_mul_pd( vm11, vx ), vdx );
+      ny = _mm_add_pd( _mm_mul_pd( vm22, vy ), vdy );
+    }
+    else
+    {
+      nx = _mm_add_pd( _mm_add_pd( _mm_mul_pd( vm11, vx ), _mm_mul_pd( vm21, vy ) ), vdx );
+      ny = _mm_add_pd( _mm_add_pd( _mm_mul_pd( vm12, vx ), _mm_mul_pd( vm22, vy ) ), vdy );
+    }
+    _mm_storeu_pd( x + i, nx );
+    _mm_storeu_pd( y + i, ny );
+  }
+#endif
+
+  for ( ; i < n; ++i )
+  {
+    double fx = x[i], fy = y[i];
+    if ( scaleOnly )
+    {
+      x[i] = m11 * fx + dx;
+      y[i] = m22 * fy + dy;
+    }
+    else
+    {
+      x[i] = m11 * fx + m21 * fy + dx;
+      y[i] = m12 * fx + m22 * fy + dy;
+    }
+  }
+}
+
+void QgsCoordinateKernels::transformInterleaved( const QTransform& t, double* xy, int n )
+{
+  QTransform::TransformationType type = t.type();
+  if ( type == QTransform::TxNone )
+    return;
+
+  if ( type == QTransform::TxProject )
+  {
+    for ( int i = 0; i < n; ++i )
+    {
+      qreal tx, ty;
+      t.map( xy[2 * i], xy[2 * i + 1], &tx, &ty );
+      xy[2 * i] = tx;
+      xy[2 * i + 1] = ty;
+    }
+    return;
+  }
+
+  double m11 = t.m11(), m12 = t.m12(), m21 = t.m21(), m22 = t.m22(), dx = t.dx(), dy = t.dy();
+  if ( type == QTransform::TxTranslate )
+  {
+    m11 = 1.0;
+    m22 = 1.0;
+  }
+
+  int i = 0;
+#ifdef QGS_KERNELS_SSE2
+  if ( type <= QTransform::TxScale )
+  {
+    // one point per register: ( m11 * x + dx, m22 * y + dy )
+    __m128d scale = _mm_set_pd( m22, m11 );
+    __m128d offset = _mm_set_pd( dy, dx );
+    for ( ; i < n; ++i )
+    {
+      _mm_storeu_pd( xy + 2 * i, _mm_add_pd( _mm_mul_pd( scale, _mm_loadu_pd( xy + 2 * i ) ), offset ) );
+    }
+    return;
+  }
+
+  // two points per iteration, split to x and y registers and merged back
+  __m128d vm11 = _mm_set1_pd( m11 ), vm12 = _mm_set1_pd( m12 ), vm21 = _mm_set1_pd( m21 ), vm22 = _mm_set1_pd( m22 );
+  __m128d vdx = _mm_set1_pd( dx ), vdy = _mm_set1_pd( dy );
+  for ( ; i + 2 <= n; i += 2 )
+  {
+    __m128d p0 = _mm_loadu_pd( xy + 2 * i );
+    __m128d p1 = _mm_loadu_pd( xy + 2 * i + 2 );
+    __m128d vx = _mm_unpacklo_pd( p0, p1 );
+    __m128d vy = _mm_unpackhi_pd( p0, p1 );
+    __m128d nx = _mm_add_pd( _mm_add_pd( _mm_mul_pd( vm11, vx ), _mm_mul_pd( vm21, vy ) ), vdx );
+    __m128d ny = _mm_add_pd( _mm_add_pd( _mm_mul_pd( vm12, vx ), _mm_mul_pd( vm22, vy ) ), vdy );
+    _mm_storeu_pd( xy + 2 * i, _mm_unpacklo_pd( nx, ny ) );
+    _mm_storeu_pd( xy + 2 * i + 2, _mm_unpackhi_pd( nx, ny ) );
+  }
+#endif
+
+  bool scaleOnly = type <= QTransform::TxScale;
+  for ( ; i < n; ++i )
+  {
+    double fx = xy[2 * i], fy = xy[2 * i + 1];
+    if ( scaleOnly )
+    {
+      xy[2 * i] = m11 * fx + dx;
+      xy[2 * i + 1] = m22 * fy + dy;
+    }
+    else
+    {
+      xy[2 * i] = m11 * fx + m21 * fy + dx;
+      xy[2 * i + 1] = m12 * fx + m22 * fy + dy;
+    }
+  }
+}
+
+void QgsCoordinateKernels::interleave( const double* x, const double* y, int n, double* xy )
+{
+  int i = 0;
+#ifdef QGS_KERNELS_SSE2
+  for ( ; i + 2 <= n; i += 2 )
+  {
+    __m128d vx = _mm_loadu_pd( x + i );
+    __m128d vy = _mm_loadu_pd( y + i );
+    _mm_storeu_pd( xy + 2 * i, _mm_unpacklo_pd( vx, vy ) );
+    _mm_storeu_pd( xy + 2 * i + 2, _mm_unpackhi_pd( vx, vy ) );
+  }
+#endif
+
+  for ( ; i < n; ++i )
+  {
+    xy[2 * i] = x[i];
+    xy[2 * i + 1] = y[i];
+  }
+}
+
+int QgsCoordinateKernels::closestSegment( const double* x, const double* y, int n, double ptX, double ptY, double epsilon, double& sqrDist )
+{
+  sqrDist = std::numeric_limits<double>::max();
+  int closest = -1;
+  double segmentPtX, segmentPtY;
+
+  int i = 1;
+#ifdef QGS_KERNELS_SSE2
+  // distances of two segments at once, evaluated like QgsGeometryUtils::sqrDistToLine()
+  __m128d px = _mm_set1_pd( ptX );
+  __m128d py = _mm_set1_pd( ptY );
+  __m128d zero = _mm_setzero_pd();
+  __m128d one = _mm_set1_pd( 1.0 );
+  __m128d signBit = _mm_set1_pd( -0.0 );
+  __m128d eps = _mm_set1_pd( epsilon );
+  __m128d negEps = _mm_set1_pd( -epsilon );
+  for ( ; i + 2 <= n; i += 2 )
+  {
+    __m128d x1 = _mm_loadu_pd( x + i - 1 );
+    __m128d y1 = _mm_loadu_pd( y + i - 1 );
+    __m128d x2 = _mm_loadu_pd( x + i );
+    __m128d y2 = _mm_loadu_pd( y + i );
+
+    __m128d dx = _mm_sub_pd( x2, x1 );
+    __m128d nx = _mm_sub_pd( y2, y1 );
+    __m128d ny = _mm_xor_pd( dx, signBit );
+
+    __m128d num = _mm_sub_pd( _mm_mul_pd( px, ny ), _mm_mul_pd( py, nx ) );
+    num = _mm_sub_pd( num, _mm_mul_pd( x1, ny ) );
+    num = _mm_add_pd( num, _mm_mul_pd( y1, nx ) );
+    __m128d den = _mm_sub_pd( _mm_mul_pd( dx, ny ), _mm_mul_pd( nx, nx ) );
+    __m128d t = _mm_div_pd( num, den );
+
+    __m128d before = _mm_cmplt_pd( t, zero );
+    __m128d after = _mm_cmpgt_pd( t, one );
+    __m128d inside = _mm_andnot_pd( _mm_or_pd( before, after ), _mm_castsi128_pd( _mm_set1_epi32( -1 ) ) );
+
+    __m128d minX = _mm_or_pd( _mm_and_pd( before, x1 ),
+                              _mm_or_pd( _mm_and_pd( after, x2 ), _mm_and_pd( inside, _mm_add_pd( x1, _mm_mul_pd( t, dx ) ) ) ) );
+    __m128d minY = _mm_or_pd( _mm_and_pd( before, y1 ),
+                              _mm_or_pd( _mm_and_pd( after, y2 ), _mm_and_pd( inside, _mm_add_pd( y1, _mm_mul_pd( t, nx ) ) ) ) );
+
+    __m128d ddx = _mm_sub_pd( minX, px );
+    __m128d ddy = _mm_sub_pd( minY, py );
+    __m128d dist = _mm_add_pd( _mm_mul_pd( ddx, ddx ), _mm_mul_pd( ddy, ddy ) );
+    __m128d onSegment = _mm_and_pd( _mm_cmpgt_pd( dist, negEps ), _mm_cmple_pd( dist, eps ) );
+    dist = _mm_andnot_pd( onSegment, dist );
+
+    double lanes[2];
+    _mm_storeu_pd( lanes, dist );
+    // keep the first of equally close segments
+    if ( lanes[0] < sqrDist )
+    {
+      sqrDist = lanes[0];
+      closest = i;
+    }
+    if ( lanes[1] < sqrDist )
+    {
+      sqrDist = lanes[1];
+      closest = i + 1;
+    }
+  }
+#endif
+
+  for ( ; i < n; ++i )
+  {
+    double dist = QgsGeometryUtils::sqrDistToLine( ptX, ptY, x[i - 1], y[i - 1], x[i], y[i], segmentPtX, segmentPtY, epsilon );
+    if ( dist < sqrDist )
+    {
+      sqrDist = dist;
+      closest = i;
+    }
+  }
+  return closest;
+}
@@ -0,0 +1,78 @@
+/***************************************************************************
+                        qgscoordinatekernels.h
+  -------------------------------------------------------------------
+Date                 : November 2015
+Copyright            : (C) 2015 by the QGIS Development Team
+email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSCOORDINATEKERNELS_H
+#define QGSCOORDINATEKERNELS_H
+
+class QTransform;
+
+/** \ingroup core
+ * \class QgsCoordinateKernels
+ * \brief Loops over coordinate arrays as used by QgsLineStringV2 (separate arrays for x and y).
+ *
+ * On x86 processors two coordinates are processed at once with SSE2 instructions, other
+ * platforms use plain loops. Except for sums (length and area), which are added up in a different
+ * order, the results are the same as those of the scalar code.
+ *
+ * \note added in QGIS 2.14
+ * \note not available in Python bindings
+ */
+class CORE_EXPORT QgsCoordinateKernels
+{
+  public:
+
+    /** Calculates the bounding box of coordinates. NaN coordinates are skipped.
+     * If there are no coordinates, the minima are set to the largest double and the maxima
+     * to the lowest double.
+     */
+    static void boundingBox( const double* x, const double* y, int n, double& xMin, double& yMin, double& xMax, double& yMax );
+
+    /** Returns the length of the line through the coordinates
+     */
+    static double length( const double* x, const double* y, int n );
+
+    /** Returns the sum of x[i] * y[i+1] - y[i] * x[i+1] over all segments (twice the signed area
+     * of a closed ring)
+     */
+    static double shoelaceSum( const double* x, const double* y, int n );
+
+    /** Transforms coordinates in place, equivalent to QTransform::map() for each coordinate.
+     */
+    static void transform( const QTransform& t, double* x, double* y, int n );
+
+    /** Transforms interleaved coordinates (x0, y0, x1, y1, ...) in place, equivalent to
+     * QTransform::map() for each coordinate.
+     */
+    static void transformInterleaved( const QTransform& t, double* xy, int n );
+
+    /** Copies separate coordinate arrays to an interleaved array (x0, y0, x1, y1, ...)
+     */
+    static void interleave( const double* x, const double* y, int n, double* xy );
+
+    /** Finds the segment closest to a point, with the distance calculated as by
+     * QgsGeometryUtils::sqrDistToLine().
+     * @param x x coordinates of the vertices
+     * @param y y coordinates of the vertices
+     * @param n number of vertices
+     * @param ptX x coordinate of the point
+     * @param ptY y coordinate of the point
+     * @param epsilon distances up to epsilon are considered as 0
+     * @param sqrDist will be set to the squared distance to the closest segment
+     * @returns index of the end vertex of the first of the closest segments, or -1 if there is no segment
+     */
+    static int closestSegment( const double* x, const double* y, int n, double ptX, double ptY, double epsilon, double& sqrDist );
+};
+
+#endif // QGSCOORDINATEKERNELS_H
@@ -43,6 +43,10 @@ email                : morb at ozemail dot com dot au
 #include "qgspointv2.h"
 #include "qgspolygonv2.h"
 #include "qgslinestringv2.h"
+#include "qgswkbview.h"
+
+#include <QMutex>
+#include <QMutexLocker>
 
 #ifndef Q_WS_WIN
 #include <netinet/in.h>
@@ -50,15 +54,55 @@ email                : morb at ozemail dot com dot au
 #include <winsock.h>
 #endif
 
+//guards setting the geometry parsed from a pending WKB, which may happen in const methods of geometries shared between threads
+static QMutex sWkbParseMutex;
+
 struct QgsGeometryPrivate
 {
-  QgsGeometryPrivate(): ref( 1 ), geometry( 0 ), mWkb( 0 ), mWkbSize( 0 ), mGeos( 0 ) {}
+  QgsGeometryPrivate(): ref( 1 ), geometry( 0 ), mWkb( 0 ), mWkbSize( 0 ), mGeos( 0 ), mWkbPending( 0 ) {}
   ~QgsGeometryPrivate() { delete geometry; delete[] mWkb; GEOSGeom_destroy_r( QgsGeos::getGEOSHandler(), mGeos ); }
+
+  //! returns true if the geometry was set with fromWkb() and the WKB has not been parsed yet
+  bool wkbPending() const { return !mWkbPending.testAndSetAcquire( 0, 0 ); }
+
+  //! returns the geometry, parsing the WKB first if necessary
+  QgsAbstractGeometryV2* geom() const
+  {
+    if ( wkbPending() )
+      parseWkb();
+    return geometry;
+  }
+
+  void parseWkb() const
+  {
+    QgsAbstractGeometryV2* parsed = QgsGeometryFactory::geomFromWkb( mWkb );
+    QMutexLocker locker( &sWkbParseMutex );
+    if ( wkbPending() )
+    {
+      geometry = parsed;
+      mWkbPending.fetchAndStoreRelease( 0 );
+    }
+    else
+    {
+      //another thread has been faster
+      delete parsed;
+    }
+  }
+
+  //! deletes the geometry, a pending WKB is dropped without parsing it
+  void clearGeometry()
+  {
+    delete geometry;
+    geometry = 0;
+    mWkbPending = 0;
+  }
+
   QAtomicInt ref;
-  QgsAbstractGeometryV2* geometry;
+  mutable QgsAbstractGeometryV2* geometry;
   mutable const unsigned char* mWkb; //store wkb pointer for backward compatibility
   mutable int mWkbSize;
   mutable GEOSGeometry* mGeos;
+  mutable QAtomicInt mWkbPending; //1 while geometry has not been created from mWkb yet
 };
 
 QgsGeometry::QgsGeometry(): d( new QgsGeometryPrivate() )
@@ -109,21 +153,34 @@ void QgsGeometry::detach( bool cloneGeom )
 
   if ( d->ref > 1 )
   {
-    ( void )d->ref.deref();
-    QgsAbstractGeometryV2* cGeom = 0;
+    QgsGeometryPrivate* detached = new QgsGeometryPrivate();
 
-    if ( d->geometry && cloneGeom )
+    if ( cloneGeom && d->wkbPending() )
+    {
+      //copying the WKB is cheaper than parsing it
+      unsigned char* wkb = new unsigned char[d->mWkbSize];
+      memcpy( wkb, d->mWkb, d->mWkbSize );
+      detached->mWkb = wkb;
+      detached->mWkbSize = d->mWkbSize;
+      detached->mWkbPending = 1;
+    }
+    else if ( cloneGeom && d->geometry )
     {
-      cGeom = d->geometry->clone();
+      detached->geometry = d->geometry->clone();
     }
 
-    d = new QgsGeometryPrivate();
-    d->geometry = cGeom;
+    ( void )d->ref.deref();
+    d = detached;
   }
 }
 
 void QgsGeometry::removeWkbGeos()
 {
+  if ( d->wkbPending() )
+  {
+    //the geometry is needed after the WKB is gone
+    d->parseWkb();
+  }
   delete[] d->mWkb;
   d->mWkb = 0;
   d->mWkbSize = 0;
@@ -140,17 +197,13 @@ QgsAbstractGeometryV2* QgsGeometry::geometry() const
   {
     return 0;
   }
-  return d->geometry;
+  return d->geom();
 }
 
 void QgsGeometry::setGeometry( QgsAbstractGeometryV2* geometry )
 {
   detach( false );
-  if ( d->geometry )
-  {
-    delete d->geometry;
-    d->geometry = 0;
-  }
+  d->clearGeometry();
   removeWkbGeos();
 
   d->geometry = geometry;
@@ -158,7 +211,8 @@ void QgsGeometry::setGeometry( QgsAbstractGeometryV2* geometry )
 
 bool QgsGeometry::isEmpty() const
 {
-  return !d || !d->geometry;
+  //a pending WKB always results in a geometry, see fromWkb()
+  return !d || ( !d->wkbPending() && !d->geometry );
 }
 
 QgsGeometry* QgsGeometry::fromWkt( const QString& wkt )
@@ -248,7 +302,6 @@ QgsGeometry* QgsGeometry::fromRect( const QgsRectangle& rect )
 
 void QgsGeometry::fromWkb( unsigned char *wkb, size_t length )
 {
-  Q_UNUSED( length );
   if ( !d )
   {
     return;
@@ -256,54 +309,62 @@ void QgsGeometry::fromWkb( unsigned char *wkb, size_t length )
 
   detach( false );
 
-  if ( d->geometry )
-  {
-    delete d->geometry;
-    removeWkbGeos();
-  }
-  d->geometry = QgsGeometryFactory::geomFromWkb( wkb );
+  d->clearGeometry();
+  removeWkbGeos();
+
   d->mWkb = wkb;
   d->mWkbSize = length;
+
+  //parsing is deferred until the geometry is needed. The header is checked now, so that a
+  //pending WKB always results in a geometry.
+  if ( length > 0 && QgsWkbView( wkb, static_cast<int>( length ) ).isValid() )
+  {
+    d->mWkbPending = 1;
+  }
+  else
+  {
+    d->geometry = QgsGeometryFactory::geomFromWkb( wkb );
+  }
 }
 
 const unsigned char *QgsGeometry::asWkb() const
 {
-  if ( !d || !d->geometry )
+  if ( isEmpty() )
   {
     return 0;
   }
 
   if ( !d->mWkb )
   {
-    d->mWkb = d->geometry->asWkb( d->mWkbSize );
+    d->mWkb = d->geom()->asWkb( d->mWkbSize );
   }
   return d->mWkb;
 }
 
 size_t QgsGeometry::wkbSize() const
 {
-  if ( !d || !d->geometry )
+  if ( isEmpty() )
   {
     return 0;
   }
 
   if ( !d->mWkb )
   {
-    d->mWkb = d->geometry->asWkb( d->mWkbSize );
+    d->mWkb = d->geom()->asWkb( d->mWkbSize );
   }
   return d->mWkbSize;
 }
 
 const GEOSGeometry* QgsGeometry::asGeos( double precision ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
   if ( !d->mGeos )
   {
-    d->mGeos = QgsGeos::asGeos( d->geometry, precision );
+    d->mGeos = QgsGeos::asGeos( d->geom(), precision );
   }
   return d->mGeos;
 }
@@ -311,10 +372,14 @@ const GEOSGeometry* QgsGeometry::asGeos( double precision ) const
 
 QGis::WkbType QgsGeometry::wkbType() const
 {
-  if ( !d || !d->geometry )
+  if ( isEmpty() )
   {
     return QGis::WKBUnknown;
   }
+  else if ( d->wkbPending() )
+  {
+    return ( QGis::WkbType )QgsWkbView( d->mWkb, d->mWkbSize ).wkbType();
+  }
   else
   {
     return ( QGis::WkbType )d->geometry->wkbType();
@@ -324,20 +389,20 @@ QGis::WkbType QgsGeometry::wkbType() const
 
 QGis::GeometryType QgsGeometry::type() const
 {
-  if ( !d || !d->geometry )
+  if ( isEmpty() )
   {
     return QGis::UnknownGeometry;
   }
-  return ( QGis::GeometryType )( QgsWKBTypes::geometryType( d->geometry->wkbType() ) );
+  return ( QGis::GeometryType )( QgsWKBTypes::geometryType(( QgsWKBTypes::Type )wkbType() ) );
 }
 
 bool QgsGeometry::isMultipart() const
 {
-  if ( !d || !d->geometry )
+  if ( isEmpty() )
   {
     return false;
   }
-  return QgsWKBTypes::isMultiType( d->geometry->wkbType() );
+  return QgsWKBTypes::isMultiType(( QgsWKBTypes::Type )wkbType() );
 }
 
 void QgsGeometry::fromGeos( GEOSGeometry *geos )
@@ -345,7 +410,7 @@ void QgsGeometry::fromGeos( GEOSGeometry *geos )
   if ( d )
   {
     detach( false );
-    delete d->geometry;
+    d->clearGeometry();
     d->geometry = QgsGeos::fromGeos( geos );
     d->mGeos = geos;
   }
@@ -353,14 +418,14 @@ void QgsGeometry::fromGeos( GEOSGeometry *geos )
 
 QgsPoint QgsGeometry::closestVertex( const QgsPoint& point, int& atVertex, int& beforeVertex, int& afterVertex, double& sqrDist ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return QgsPoint( 0, 0 );
   }
   QgsPointV2 pt( point.x(), point.y() );
   QgsVertexId id;
 
-  QgsPointV2 vp = QgsGeometryUtils::closestVertex( *( d->geometry ), pt, id );
+  QgsPointV2 vp = QgsGeometryUtils::closestVertex( *( d->geom() ), pt, id );
   if ( !id.isValid() )
   {
     sqrDist = -1;
@@ -375,7 +440,7 @@ QgsPoint QgsGeometry::closestVertex( const QgsPoint& point, int& atVertex, int&
 
 void QgsGeometry::adjacentVertices( int atVertex, int& beforeVertex, int& afterVertex ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return;
   }
@@ -388,14 +453,14 @@ void QgsGeometry::adjacentVertices( int atVertex, int& beforeVertex, int& afterV
   }
 
   QgsVertexId beforeVertexId, afterVertexId;
-  QgsGeometryUtils::adjacentVertices( *( d->geometry ), id, beforeVertexId, afterVertexId );
+  QgsGeometryUtils::adjacentVertices( *( d->geom() ), id, beforeVertexId, afterVertexId );
   beforeVertex = vertexNrFromVertexId( beforeVertexId );
   afterVertex = vertexNrFromVertexId( afterVertexId );
 }
 
 bool QgsGeometry::moveVertex( double x, double y, int atVertex )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
@@ -409,12 +474,12 @@ bool QgsGeometry::moveVertex( double x, double y, int atVertex )
   detach( true );
 
   removeWkbGeos();
-  return d->geometry->moveVertex( id, QgsPointV2( x, y ) );
+  return d->geom()->moveVertex( id, QgsPointV2( x, y ) );
 }
 
 bool QgsGeometry::moveVertex( const QgsPointV2& p, int atVertex )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
@@ -428,30 +493,30 @@ bool QgsGeometry::moveVertex( const QgsPointV2& p, int atVertex )
   detach( true );
 
   removeWkbGeos();
-  return d->geometry->moveVertex( id, p );
+  return d->geom()->moveVertex( id, p );
 }
 
 bool QgsGeometry::deleteVertex( int atVertex )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
   //maintain compatibility with < 2.10 API
-  if ( d->geometry->geometryType() == "MultiPoint" )
+  if ( d->geom()->geometryType() == "MultiPoint" )
   {
     detach( true );
     removeWkbGeos();
     //delete geometry instead of point
-    return static_cast< QgsGeometryCollectionV2* >( d->geometry )->removeGeometry( atVertex );
+    return static_cast< QgsGeometryCollectionV2* >( d->geom() )->removeGeometry( atVertex );
   }
 
   //if it is a point, set the geometry to NULL
-  if ( QgsWKBTypes::flatType( d->geometry->wkbType() ) == QgsWKBTypes::Point )
+  if ( QgsWKBTypes::flatType( d->geom()->wkbType() ) == QgsWKBTypes::Point )
   {
     detach( false );
-    delete d->geometry;
+    delete d->geom();
     removeWkbGeos();
     d->geometry = 0;
     return true;
@@ -466,23 +531,23 @@ bool QgsGeometry::deleteVertex( int atVertex )
   detach( true );
 
   removeWkbGeos();
-  return d->geometry->deleteVertex( id );
+  return d->geom()->deleteVertex( id );
 }
 
 bool QgsGeometry::insertVertex( double x, double y, int beforeVertex )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
   //maintain compatibility with < 2.10 API
-  if ( d->geometry->geometryType() == "MultiPoint" )
+  if ( d->geom()->geometryType() == "MultiPoint" )
   {
     detach( true );
     removeWkbGeos();
     //insert geometry instead of point
-    return static_cast< QgsGeometryCollectionV2* >( d->geometry )->insertGeometry( new QgsPointV2( x, y ), beforeVertex );
+    return static_cast< QgsGeometryCollectionV2* >( d->geom() )->insertGeometry( new QgsPointV2( x, y ), beforeVertex );
   }
 
   QgsVertexId id;
@@ -495,12 +560,12 @@ bool QgsGeometry::insertVertex( double x, double y, int beforeVertex )
 
   removeWkbGeos();
 
-  return d->geometry->insertVertex( id, QgsPointV2( x, y ) );
+  return d->geom()->insertVertex( id, QgsPointV2( x, y ) );
 }
 
 QgsPoint QgsGeometry::vertexAt( int atVertex ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return QgsPoint( 0, 0 );
   }
@@ -511,7 +576,7 @@ QgsPoint QgsGeometry::vertexAt( int atVertex ) const
   {
     return QgsPoint( 0, 0 );
   }
-  QgsPointV2 pt = d->geometry->vertexAt( vId );
+  QgsPointV2 pt = d->geom()->vertexAt( vId );
   return QgsPoint( pt.x(), pt.y() );
 }
 
@@ -523,14 +588,14 @@ double QgsGeometry::sqrDistToVertexAt( QgsPoint& point, int atVertex ) const
 
 double QgsGeometry::closestVertexWithContext( const QgsPoint& point, int& atVertex ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0.0;
   }
 
   QgsVertexId vId;
   QgsPointV2 pt( point.x(), point.y() );
-  QgsPointV2 closestPoint = QgsGeometryUtils::closestVertex( *( d->geometry ), pt, vId );
+  QgsPointV2 closestPoint = QgsGeometryUtils::closestVertex( *( d->geom() ), pt, vId );
   atVertex = vertexNrFromVertexId( vId );
   return QgsGeometryUtils::sqrDistance2D( closestPoint, pt );
 }
@@ -542,7 +607,7 @@ double QgsGeometry::closestSegmentWithContext(
   double *leftOf,
   double epsilon ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
@@ -551,7 +616,7 @@ double QgsGeometry::closestSegmentWithContext(
   QgsVertexId vertexAfter;
   bool leftOfBool;
 
-  double sqrDist = d->geometry->closestSegment( QgsPointV2( point.x(), point.y() ), segmentPt,  vertexAfter, &leftOfBool, epsilon );
+  double sqrDist = d->geom()->closestSegment( QgsPointV2( point.x(), point.y() ), segmentPt,  vertexAfter, &leftOfBool, epsilon );
 
   minDistPoint.setX( segmentPt.x() );
   minDistPoint.setY( segmentPt.y() );
@@ -577,7 +642,7 @@ int QgsGeometry::addRing( const QList<QgsPoint>& ring )
 
 int QgsGeometry::addRing( QgsCurveV2* ring )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     delete ring;
     return 1;
@@ -586,7 +651,7 @@ int QgsGeometry::addRing( QgsCurveV2* ring )
   detach( true );
 
   removeWkbGeos();
-  return QgsGeometryEditUtils::addRing( d->geometry, ring );
+  return QgsGeometryEditUtils::addRing( d->geom(), ring );
 }
 
 int QgsGeometry::addPart( const QList<QgsPoint> &points, QGis::GeometryType geomType )
@@ -614,7 +679,7 @@ int QgsGeometry::addPart( QgsAbstractGeometryV2* part, QGis::GeometryType geomTy
     return 1;
   }
 
-  if ( !d->geometry )
+  if ( !d->geom() )
   {
     detach( false );
     switch ( geomType )
@@ -639,22 +704,22 @@ int QgsGeometry::addPart( QgsAbstractGeometryV2* part, QGis::GeometryType geomTy
   }
 
   convertToMultiType();
-  return QgsGeometryEditUtils::addPart( d->geometry, part );
+  return QgsGeometryEditUtils::addPart( d->geom(), part );
 }
 
 int QgsGeometry::addPart( const QgsGeometry *newPart )
 {
-  if ( !d || !d->geometry || !newPart || !newPart->d || !newPart->d->geometry )
+  if ( !d || !d->geom() || !newPart || !newPart->d || !newPart->d->geom() )
   {
     return 1;
   }
 
-  return addPart( newPart->d->geometry->clone() );
+  return addPart( newPart->d->geom()->clone() );
 }
 
 int QgsGeometry::addPart( GEOSGeometry *newPart )
 {
-  if ( !d || !d->geometry || !newPart )
+  if ( !d || !d->geom() || !newPart )
   {
     return 1;
   }
@@ -663,26 +728,26 @@ int QgsGeometry::addPart( GEOSGeometry *newPart )
 
   QgsAbstractGeometryV2* geom = QgsGeos::fromGeos( newPart );
   removeWkbGeos();
-  return QgsGeometryEditUtils::addPart( d->geometry, geom );
+  return QgsGeometryEditUtils::addPart( d->geom(), geom );
 }
 
 int QgsGeometry::translate( double dx, double dy )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 1;
   }
 
   detach( true );
 
-  d->geometry->transform( QTransform::fromTranslate( dx, dy ) );
+  d->geom()->transform( QTransform::fromTranslate( dx, dy ) );
   removeWkbGeos();
   return 0;
 }
 
 int QgsGeometry::rotate( double rotation, const QgsPoint& center )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 1;
   }
@@ -692,14 +757,14 @@ int QgsGeometry::rotate( double rotation, const QgsPoint& center )
   QTransform t = QTransform::fromTranslate( center.x(), center.y() );
   t.rotate( -rotation );
   t.translate( -center.x(), -center.y() );
-  d->geometry->transform( t );
+  d->geom()->transform( t );
   removeWkbGeos();
   return 0;
 }
 
 int QgsGeometry::splitGeometry( const QList<QgsPoint>& splitLine, QList<QgsGeometry*>& newGeometries, bool topological, QList<QgsPoint> &topologyTestPoints )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
@@ -711,7 +776,7 @@ int QgsGeometry::splitGeometry( const QList<QgsPoint>& splitLine, QList<QgsGeome
   splitLineString.setPoints( splitLinePointsV2 );
   QList<QgsPointV2> tp;
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   int result = geos.splitGeometry( splitLineString, newGeoms, topological, tp );
 
   if ( result == 0 )
@@ -734,7 +799,7 @@ int QgsGeometry::splitGeometry( const QList<QgsPoint>& splitLine, QList<QgsGeome
 /** Replaces a part of this geometry with another line*/
 int QgsGeometry::reshapeGeometry( const QList<QgsPoint>& reshapeWithLine )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
@@ -744,13 +809,13 @@ int QgsGeometry::reshapeGeometry( const QList<QgsPoint>& reshapeWithLine )
   QgsLineStringV2 reshapeLineString;
   reshapeLineString.setPoints( reshapeLine );
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   int errorCode = 0;
   QgsAbstractGeometryV2* geom = geos.reshapeGeometry( reshapeLineString, &errorCode );
   if ( errorCode == 0 && geom )
   {
     detach( false );
-    delete d->geometry;
+    delete d->geom();
     d->geometry = geom;
     removeWkbGeos();
     return 0;
@@ -760,12 +825,12 @@ int QgsGeometry::reshapeGeometry( const QList<QgsPoint>& reshapeWithLine )
 
 int QgsGeometry::makeDifference( const QgsGeometry* other )
 {
-  if ( !d || !d->geometry || !other->d || !other->d->geometry )
+  if ( !d || !d->geom() || !other->d || !other->d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
 
   QgsAbstractGeometryV2* diffGeom = geos.intersection( *( other->geometry() ) );
   if ( !diffGeom )
@@ -775,7 +840,7 @@ int QgsGeometry::makeDifference( const QgsGeometry* other )
 
   detach( false );
 
-  delete d->geometry;
+  delete d->geom();
   d->geometry = diffGeom;
   removeWkbGeos();
   return 0;
@@ -783,9 +848,17 @@ int QgsGeometry::makeDifference( const QgsGeometry* other )
 
 QgsRectangle QgsGeometry::boundingBox() const
 {
-  if ( d && d->geometry )
+  if ( d && d->wkbPending() )
+  {
+    QgsRectangle rect;
+    if ( QgsWkbView( d->mWkb, d->mWkbSize ).boundingBox( rect ) )
+    {
+      return rect;
+    }
+  }
+  if ( d && d->geom() )
   {
-    return d->geometry->boundingBox();
+    return d->geom()->boundingBox();
   }
   return QgsRectangle();
 }
@@ -800,120 +873,120 @@ bool QgsGeometry::intersects( const QgsRectangle& r ) const
 
 bool QgsGeometry::intersects( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.intersects( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.intersects( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::contains( const QgsPoint* p ) const
 {
-  if ( !d || !d->geometry || !p )
+  if ( !d || !d->geom() || !p )
   {
     return false;
   }
 
   QgsPointV2 pt( p->x(), p->y() );
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   return geos.contains( pt );
 }
 
 bool QgsGeometry::contains( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.contains( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.contains( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::disjoint( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.disjoint( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.disjoint( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::equals( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.isEqual( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.isEqual( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::touches( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.touches( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.touches( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::overlaps( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.overlaps( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.overlaps( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::within( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.within( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.within( *( geometry->d->geom() ) );
 }
 
 bool QgsGeometry::crosses( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry || !geometry->d || !geometry->d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.crosses( *( geometry->d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.crosses( *( geometry->d->geom() ) );
 }
 
 QString QgsGeometry::exportToWkt( const int &precision ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return QString();
   }
-  return d->geometry->asWkt( precision );
+  return d->geom()->asWkt( precision );
 }
 
 QString QgsGeometry::exportToGeoJSON( const int &precision ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return QString();
   }
-  return d->geometry->asJSON( precision );
+  return d->geom()->asJSON( precision );
 }
 
 QgsGeometry* QgsGeometry::convertToType( QGis::GeometryType destType, bool destMultipart ) const
@@ -936,7 +1009,7 @@ QgsGeometry* QgsGeometry::convertToType( QGis::GeometryType destType, bool destM
 
 bool QgsGeometry::convertToMultiType()
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
@@ -947,14 +1020,14 @@ bool QgsGeometry::convertToMultiType()
   }
 
   QgsGeometryCollectionV2* multiGeom = dynamic_cast<QgsGeometryCollectionV2*>
-                                       ( QgsGeometryFactory::geomFromWkbType( QgsWKBTypes::multiType( d->geometry->wkbType() ) ) );
+                                       ( QgsGeometryFactory::geomFromWkbType( QgsWKBTypes::multiType( d->geom()->wkbType() ) ) );
   if ( !multiGeom )
   {
     return false;
   }
 
   detach( true );
-  multiGeom->addGeometry( d->geometry );
+  multiGeom->addGeometry( d->geom() );
   d->geometry = multiGeom;
   removeWkbGeos();
   return true;
@@ -962,7 +1035,7 @@ bool QgsGeometry::convertToMultiType()
 
 bool QgsGeometry::convertToSingleType()
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
@@ -972,7 +1045,7 @@ bool QgsGeometry::convertToSingleType()
     return true;
   }
 
-  QgsGeometryCollectionV2* multiGeom = dynamic_cast<QgsGeometryCollectionV2*>( d->geometry );
+  QgsGeometryCollectionV2* multiGeom = dynamic_cast<QgsGeometryCollectionV2*>( d->geom() );
   if ( !multiGeom || multiGeom->partCount() < 1 )
     return false;
 
@@ -986,11 +1059,11 @@ bool QgsGeometry::convertToSingleType()
 
 QgsPoint QgsGeometry::asPoint() const
 {
-  if ( !d || !d->geometry || d->geometry->geometryType() != "Point" )
+  if ( !d || !d->geom() || d->geom()->geometryType() != "Point" )
   {
     return QgsPoint();
   }
-  QgsPointV2* pt = dynamic_cast<QgsPointV2*>( d->geometry );
+  QgsPointV2* pt = dynamic_cast<QgsPointV2*>( d->geom() );
   if ( !pt )
   {
     return QgsPoint();
@@ -1002,16 +1075,16 @@ QgsPoint QgsGeometry::asPoint() const
 QgsPolyline QgsGeometry::asPolyline() const
 {
   QgsPolyline polyLine;
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return polyLine;
   }
 
-  bool doSegmentation = ( d->geometry->geometryType() == "CompoundCurve" || d->geometry->geometryType() == "CircularString" );
+  bool doSegmentation = ( d->geom()->geometryType() == "CompoundCurve" || d->geom()->geometryType() == "CircularString" );
   QgsLineStringV2* line = 0;
   if ( doSegmentation )
   {
-    QgsCurveV2* curve = dynamic_cast<QgsCurveV2*>( d->geometry );
+    QgsCurveV2* curve = dynamic_cast<QgsCurveV2*>( d->geom() );
     if ( !curve )
     {
       return polyLine;
@@ -1020,7 +1093,7 @@ QgsPolyline QgsGeometry::asPolyline() const
   }
   else
   {
-    line = dynamic_cast<QgsLineStringV2*>( d->geometry );
+    line = dynamic_cast<QgsLineStringV2*>( d->geom() );
     if ( !line )
     {
       return polyLine;
@@ -1046,12 +1119,12 @@ QgsPolyline QgsGeometry::asPolyline() const
 
 QgsPolygon QgsGeometry::asPolygon() const
 {
-  bool doSegmentation = ( d->geometry->geometryType() == "CurvePolygon" );
+  bool doSegmentation = ( d->geom()->geometryType() == "CurvePolygon" );
 
   QgsPolygonV2* p = 0;
   if ( doSegmentation )
   {
-    QgsCurvePolygonV2* curvePoly = dynamic_cast<QgsCurvePolygonV2*>( d->geometry );
+    QgsCurvePolygonV2* curvePoly = dynamic_cast<QgsCurvePolygonV2*>( d->geom() );
     if ( !curvePoly )
     {
       return QgsPolygon();
@@ -1060,7 +1133,7 @@ QgsPolygon QgsGeometry::asPolygon() const
   }
   else
   {
-    p = dynamic_cast<QgsPolygonV2*>( d->geometry );
+    p = dynamic_cast<QgsPolygonV2*>( d->geom() );
   }
 
   if ( !p )
@@ -1080,12 +1153,12 @@ QgsPolygon QgsGeometry::asPolygon() const
 
 QgsMultiPoint QgsGeometry::asMultiPoint() const
 {
-  if ( !d || !d->geometry || d->geometry->geometryType() != "MultiPoint" )
+  if ( !d || !d->geom() || d->geom()->geometryType() != "MultiPoint" )
   {
     return QgsMultiPoint();
   }
 
-  const QgsMultiPointV2* mp = dynamic_cast<QgsMultiPointV2*>( d->geometry );
+  const QgsMultiPointV2* mp = dynamic_cast<QgsMultiPointV2*>( d->geom() );
   if ( !mp )
   {
     return QgsMultiPoint();
@@ -1104,12 +1177,12 @@ QgsMultiPoint QgsGeometry::asMultiPoint() const
 
 QgsMultiPolyline QgsGeometry::asMultiPolyline() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return QgsMultiPolyline();
   }
 
-  QgsGeometryCollectionV2* geomCollection = dynamic_cast<QgsGeometryCollectionV2*>( d->geometry );
+  QgsGeometryCollectionV2* geomCollection = dynamic_cast<QgsGeometryCollectionV2*>( d->geom() );
   if ( !geomCollection )
   {
     return QgsMultiPolyline();
@@ -1153,12 +1226,12 @@ QgsMultiPolyline QgsGeometry::asMultiPolyline() const
 
 QgsMultiPolygon QgsGeometry::asMultiPolygon() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return QgsMultiPolygon();
   }
 
-  QgsGeometryCollectionV2* geomCollection = dynamic_cast<QgsGeometryCollectionV2*>( d->geometry );
+  QgsGeometryCollectionV2* geomCollection = dynamic_cast<QgsGeometryCollectionV2*>( d->geom() );
   if ( !geomCollection )
   {
     return QgsMultiPolygon();
@@ -1196,17 +1269,17 @@ QgsMultiPolygon QgsGeometry::asMultiPolygon() const
 
 double QgsGeometry::area() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return -1.0;
   }
-  QgsGeos g( d->geometry );
+  QgsGeos g( d->geom() );
 
 #if 0
   //debug: compare geos area with calculation in QGIS
   double geosArea = g.area();
   double qgisArea = 0;
-  QgsSurfaceV2* surface = dynamic_cast<QgsSurfaceV2*>( d->geometry );
+  QgsSurfaceV2* surface = dynamic_cast<QgsSurfaceV2*>( d->geom() );
   if ( surface )
   {
     qgisArea = surface->area();
@@ -1218,33 +1291,33 @@ double QgsGeometry::area() const
 
 double QgsGeometry::length() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return -1.0;
   }
-  QgsGeos g( d->geometry );
+  QgsGeos g( d->geom() );
   return g.length();
 }
 
 double QgsGeometry::distance( const QgsGeometry& geom ) const
 {
-  if ( !d || !d->geometry || !geom.d || !geom.d->geometry )
+  if ( !d || !d->geom() || !geom.d || !geom.d->geom() )
   {
     return -1.0;
   }
 
-  QgsGeos g( d->geometry );
-  return g.distance( *( geom.d->geometry ) );
+  QgsGeos g( d->geom() );
+  return g.distance( *( geom.d->geom() ) );
 }
 
 QgsGeometry* QgsGeometry::buffer( double distance, int segments ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
-  QgsGeos g( d->geometry );
+  QgsGeos g( d->geom() );
   QgsAbstractGeometryV2* geom = g.buffer( distance, segments );
   if ( !geom )
   {
@@ -1255,12 +1328,12 @@ QgsGeometry* QgsGeometry::buffer( double distance, int segments ) const
 
 QgsGeometry* QgsGeometry::buffer( double distance, int segments, int endCapStyle, int joinStyle, double mitreLimit ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
-  QgsGeos g( d->geometry );
+  QgsGeos g( d->geom() );
   QgsAbstractGeometryV2* geom = g.buffer( distance, segments, endCapStyle, joinStyle, mitreLimit );
   if ( !geom )
   {
@@ -1271,12 +1344,12 @@ QgsGeometry* QgsGeometry::buffer( double distance, int segments, int endCapStyle
 
 QgsGeometry* QgsGeometry::offsetCurve( double distance, int segments, int joinStyle, double mitreLimit ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   QgsAbstractGeometryV2* offsetGeom = geos.offsetCurve( distance, segments, joinStyle, mitreLimit );
   if ( !offsetGeom )
   {
@@ -1287,12 +1360,12 @@ QgsGeometry* QgsGeometry::offsetCurve( double distance, int segments, int joinSt
 
 QgsGeometry* QgsGeometry::simplify( double tolerance ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   QgsAbstractGeometryV2* simplifiedGeom = geos.simplify( tolerance );
   if ( !simplifiedGeom )
   {
@@ -1303,12 +1376,12 @@ QgsGeometry* QgsGeometry::simplify( double tolerance ) const
 
 QgsGeometry* QgsGeometry::centroid() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   QgsPointV2 centroid;
   bool ok = geos.centroid( centroid );
   if ( !ok )
@@ -1320,12 +1393,12 @@ QgsGeometry* QgsGeometry::centroid() const
 
 QgsGeometry* QgsGeometry::pointOnSurface() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   QgsPointV2 pt;
   bool ok = geos.pointOnSurface( pt );
   if ( !ok )
@@ -1337,11 +1410,11 @@ QgsGeometry* QgsGeometry::pointOnSurface() const
 
 QgsGeometry* QgsGeometry::convexHull() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   QgsAbstractGeometryV2* cHull = geos.convexHull();
   if ( !cHull )
   {
@@ -1352,11 +1425,11 @@ QgsGeometry* QgsGeometry::convexHull() const
 
 QgsGeometry* QgsGeometry::interpolate( double distance ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 0;
   }
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   QgsAbstractGeometryV2* result = geos.interpolate( distance );
   if ( !result )
   {
@@ -1367,27 +1440,27 @@ QgsGeometry* QgsGeometry::interpolate( double distance ) const
 
 QgsGeometry* QgsGeometry::intersection( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry->d || !geometry->d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
 
-  QgsAbstractGeometryV2* resultGeom = geos.intersection( *( geometry->d->geometry ) );
+  QgsAbstractGeometryV2* resultGeom = geos.intersection( *( geometry->d->geom() ) );
   return new QgsGeometry( resultGeom );
 }
 
 QgsGeometry* QgsGeometry::combine( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry->d || !geometry->d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
 
-  QgsAbstractGeometryV2* resultGeom = geos.combine( *( geometry->d->geometry ) );
+  QgsAbstractGeometryV2* resultGeom = geos.combine( *( geometry->d->geom() ) );
   if ( !resultGeom )
   {
     return 0;
@@ -1397,14 +1470,14 @@ QgsGeometry* QgsGeometry::combine( const QgsGeometry* geometry ) const
 
 QgsGeometry* QgsGeometry::difference( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry->d || !geometry->d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
 
-  QgsAbstractGeometryV2* resultGeom = geos.difference( *( geometry->d->geometry ) );
+  QgsAbstractGeometryV2* resultGeom = geos.difference( *( geometry->d->geom() ) );
   if ( !resultGeom )
   {
     return 0;
@@ -1414,14 +1487,14 @@ QgsGeometry* QgsGeometry::difference( const QgsGeometry* geometry ) const
 
 QgsGeometry* QgsGeometry::symDifference( const QgsGeometry* geometry ) const
 {
-  if ( !d || !d->geometry || !geometry->d || !geometry->d->geometry )
+  if ( !d || !d->geom() || !geometry->d || !geometry->d->geom() )
   {
     return 0;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
 
-  QgsAbstractGeometryV2* resultGeom = geos.symDifference( *( geometry->d->geometry ) );
+  QgsAbstractGeometryV2* resultGeom = geos.symDifference( *( geometry->d->geom() ) );
   if ( !resultGeom )
   {
     return 0;
@@ -1432,12 +1505,12 @@ QgsGeometry* QgsGeometry::symDifference( const QgsGeometry* geometry ) const
 QList<QgsGeometry*> QgsGeometry::asGeometryCollection() const
 {
   QList<QgsGeometry*> geometryList;
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return geometryList;
   }
 
-  QgsGeometryCollectionV2* gc = dynamic_cast<QgsGeometryCollectionV2*>( d->geometry );
+  QgsGeometryCollectionV2* gc = dynamic_cast<QgsGeometryCollectionV2*>( d->geom() );
   if ( gc )
   {
     int numGeom = gc->numGeometries();
@@ -1449,7 +1522,7 @@ QList<QgsGeometry*> QgsGeometry::asGeometryCollection() const
   }
   else //a singlepart geometry
   {
-    geometryList.append( new QgsGeometry( d->geometry->clone() ) );
+    geometryList.append( new QgsGeometry( d->geom()->clone() ) );
   }
 
   return geometryList;
@@ -1492,19 +1565,19 @@ QPolygonF QgsGeometry::asQPolygonF() const
 
 bool QgsGeometry::deleteRing( int ringNum, int partNum )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
   detach( true );
 
-  return QgsGeometryEditUtils::deleteRing( d->geometry, ringNum, partNum );
+  return QgsGeometryEditUtils::deleteRing( d->geom(), ringNum, partNum );
 }
 
 bool QgsGeometry::deletePart( int partNum )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
@@ -1516,19 +1589,19 @@ bool QgsGeometry::deletePart( int partNum )
   }
 
   detach( true );
-  bool ok = QgsGeometryEditUtils::deletePart( d->geometry, partNum );
+  bool ok = QgsGeometryEditUtils::deletePart( d->geom(), partNum );
   removeWkbGeos();
   return ok;
 }
 
 int QgsGeometry::avoidIntersections( const QMap<QgsVectorLayer*, QSet< QgsFeatureId > >& ignoreFeatures )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 1;
   }
 
-  QgsAbstractGeometryV2* diffGeom = QgsGeometryEditUtils::avoidIntersections( *( d->geometry ), ignoreFeatures );
+  QgsAbstractGeometryV2* diffGeom = QgsGeometryEditUtils::avoidIntersections( *( d->geom() ), ignoreFeatures );
   if ( diffGeom )
   {
     detach( false );
@@ -1545,34 +1618,34 @@ void QgsGeometry::validateGeometry( QList<Error> &errors )
 
 bool QgsGeometry::isGeosValid() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   return geos.isValid();
 }
 
 bool QgsGeometry::isGeosEqual( const QgsGeometry& g ) const
 {
-  if ( !d || !d->geometry || !g.d || !g.d->geometry )
+  if ( !d || !d->geom() || !g.d || !g.d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
-  return geos.isEqual( *( g.d->geometry ) );
+  QgsGeos geos( d->geom() );
+  return geos.isEqual( *( g.d->geom() ) );
 }
 
 bool QgsGeometry::isGeosEmpty() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
-  QgsGeos geos( d->geometry );
+  QgsGeos geos( d->geom() );
   return geos.isEmpty();
 }
 
@@ -1596,12 +1669,12 @@ QgsGeometry *QgsGeometry::unaryUnion( const QList<QgsGeometry*> &geometryList )
 
 void QgsGeometry::convertToStraightSegment()
 {
-  if ( !d || !d->geometry || !requiresConversionToStraightSegments() )
+  if ( !d || !d->geom() || !requiresConversionToStraightSegments() )
   {
     return;
   }
 
-  QgsAbstractGeometryV2* straightGeom = d->geometry->segmentize();
+  QgsAbstractGeometryV2* straightGeom = d->geom()->segmentize();
   detach( false );
 
   d->geometry = straightGeom;
@@ -1610,56 +1683,56 @@ void QgsGeometry::convertToStraightSegment()
 
 bool QgsGeometry::requiresConversionToStraightSegments() const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
-  return d->geometry->hasCurvedSegments();
+  return d->geom()->hasCurvedSegments();
 }
 
 int QgsGeometry::transform( const QgsCoordinateTransform& ct )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 1;
   }
 
   detach();
-  d->geometry->transform( ct );
+  d->geom()->transform( ct );
   removeWkbGeos();
   return 0;
 }
 
 int QgsGeometry::transform( const QTransform& ct )
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return 1;
   }
 
   detach();
-  d->geometry->transform( ct );
+  d->geom()->transform( ct );
   removeWkbGeos();
   return 0;
 }
 
 void QgsGeometry::mapToPixel( const QgsMapToPixel& mtp )
 {
-  if ( d && d->geometry )
+  if ( d && d->geom() )
   {
     detach();
-    d->geometry->transform( mtp.transform() );
+    d->geom()->transform( mtp.transform() );
   }
 }
 
 #if 0
 void QgsGeometry::clip( const QgsRectangle& rect )
 {
-  if ( d && d->geometry )
+  if ( d && d->geom() )
   {
     detach();
-    d->geometry->clip( rect );
+    d->geom()->clip( rect );
     removeWkbGeos();
   }
 }
@@ -1667,21 +1740,21 @@ void QgsGeometry::clip( const QgsRectangle& rect )
 
 void QgsGeometry::draw( QPainter& p ) const
 {
-  if ( d && d->geometry )
+  if ( d && d->geom() )
   {
-    d->geometry->draw( p );
+    d->geom()->draw( p );
   }
 }
 
 bool QgsGeometry::vertexIdFromVertexNr( int nr, QgsVertexId& id ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return false;
   }
 
   QList< QList< QList< QgsPointV2 > > > coords;
-  d->geometry->coordinateSequence( coords );
+  d->geom()->coordinateSequence( coords );
 
   int vertexCount = 0;
   for ( int part = 0; part < coords.size(); ++part )
@@ -1708,13 +1781,13 @@ bool QgsGeometry::vertexIdFromVertexNr( int nr, QgsVertexId& id ) const
 
 int QgsGeometry::vertexNrFromVertexId( const QgsVertexId& id ) const
 {
-  if ( !d || !d->geometry )
+  if ( !d || !d->geom() )
   {
     return -1;
   }
 
   QList< QList< QList< QgsPointV2 > > > coords;
-  d->geometry->coordinateSequence( coords );
+  d->geom()->coordinateSequence( coords );
 
   int vertexCount = 0;
   for ( int part = 0; part < coords.size(); ++part )
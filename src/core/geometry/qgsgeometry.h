@@ -141,6 +141,8 @@ class CORE_EXPORT QgsGeometry
     /**
       Set the geometry, feeding in the buffer containing OGC Well-Known Binary and the buffer's length.
       This class will take ownership of the buffer.
+      Since QGIS 2.14 the buffer is only parsed when the geometry is accessed. wkbType(), type(),
+      boundingBox() and asWkb() are answered from the buffer itself.
      */
     void fromWkb( unsigned char * wkb, size_t length );
 
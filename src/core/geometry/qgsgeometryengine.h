@@ -38,6 +38,15 @@ class CORE_EXPORT QgsGeometryEngine
     virtual void geometryChanged() = 0;
     virtual void prepareGeometry() = 0;
 
+    /** Prepares the geometry for repeated relation tests like prepareGeometry(), but shares the
+     * prepared geometry with other engines through a process-wide cache. A geometry is prepared
+     * the second time it is requested, so calling this for geometries which are only tested once
+     * costs little, while a geometry tested again and again (e.g. a clip polygon) is prepared once.
+     * @returns true if the geometry is prepared
+     * @note added in QGIS 2.14
+     */
+    virtual bool prepareGeometryShared() { prepareGeometry(); return true; }
+
     virtual QgsAbstractGeometryV2* intersection( const QgsAbstractGeometryV2& geom, QString* errorMsg = 0 ) const = 0;
     virtual QgsAbstractGeometryV2* difference( const QgsAbstractGeometryV2& geom, QString* errorMsg = 0 ) const = 0;
     virtual QgsAbstractGeometryV2* combine( const QgsAbstractGeometryV2& geom, QString* errorMsg = 0 ) const = 0;
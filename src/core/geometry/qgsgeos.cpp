@@ -28,6 +28,9 @@ email                : marco.hugentobler at sourcepole dot com
 #include <limits>
 #include <cstdio>
 #include <QtCore/qmath.h>
+#include <QCache>
+#include <QMutex>
+#include <QMutexLocker>
 
 #define DEFAULT_QUADRANT_SEGMENTS 8
 
@@ -100,6 +103,113 @@ class GEOSInit
 
 static GEOSInit geosinit;
 
+//! default memory budget of the shared prepared geometry cache: 50 MB
+static const qint64 DEFAULT_SHARED_PREPARED_CACHE_SIZE = 50 * 1024 * 1024;
+//! number of geometries remembered as requested but not prepared yet
+static const int MAX_SEEN_SHARED_PREPARED = 1024;
+
+/**
+ * Prepared geometry in the shared cache, together with the geometry it has been prepared for.
+ */
+class QgsGeosPreparedEntry
+{
+  public:
+    explicit QgsGeosPreparedEntry( GEOSGeometry* geom )
+        : geometry( geom )
+        , prepared( GEOSPrepare_r( geosinit.ctxt, geom ) )
+    {}
+
+    ~QgsGeosPreparedEntry()
+    {
+      GEOSPreparedGeom_destroy_r( geosinit.ctxt, prepared );
+      GEOSGeom_destroy_r( geosinit.ctxt, geometry );
+    }
+
+    GEOSGeometry* geometry;
+    const GEOSPreparedGeometry* prepared;
+
+  private:
+    QgsGeosPreparedEntry( const QgsGeosPreparedEntry& );
+    QgsGeosPreparedEntry& operator=( const QgsGeosPreparedEntry& );
+};
+
+/**
+ * Process-wide cache of prepared geometries, keyed by WKB and precision of the geometry.
+ *
+ * GEOS builds the indexes of a prepared geometry lazily while evaluating predicates, so an
+ * entry is used by a single engine at a time: acquire() takes it out of the cache and
+ * release() puts it back. Engines asking for a geometry which is in use by another engine
+ * prepare their own copy. Least recently used entries are dropped once the memory
+ * budget is exceeded.
+ */
+class QgsGeosPreparedCache
+{
+  public:
+    QgsGeosPreparedCache()
+        : mEntries( DEFAULT_SHARED_PREPARED_CACHE_SIZE / 1024 )
+        , mSeen( MAX_SEEN_SHARED_PREPARED )
+    {}
+
+    /** Takes the prepared geometry for a key out of the cache, returns 0 if it is not cached.
+     * @param key WKB and precision of the geometry
+     * @param requestedBefore will be set to true if the key has been requested before
+     */
+    QgsGeosPreparedEntry* acquire( const QByteArray& key, bool& requestedBefore )
+    {
+      QMutexLocker locker( &mMutex );
+      QgsGeosPreparedEntry* entry = mEntries.take( key );
+      if ( entry )
+      {
+        requestedBefore = true;
+        return entry;
+      }
+
+      // only hashes are remembered, a collision just prepares a geometry early
+      uint hash = qHash( key );
+      requestedBefore = mSeen.contains( hash );
+      if ( !requestedBefore )
+        mSeen.insert( hash, new bool( true ) );
+      return 0;
+    }
+
+    //! Puts a prepared geometry back to the cache, the cache takes ownership
+    void release( const QByteArray& key, QgsGeosPreparedEntry* entry )
+    {
+      QMutexLocker locker( &mMutex );
+      // prepared geometries hold an index of the segments besides the geometry
+      mEntries.insert( key, entry, qMax( 1, 2 * key.size() / 1024 ) );
+    }
+
+    void setMaximumSize( qint64 bytes )
+    {
+      QMutexLocker locker( &mMutex );
+      mEntries.setMaxCost( qMax( qint64( 1 ), bytes / 1024 ) );
+    }
+
+    qint64 maximumSize() const
+    {
+      QMutexLocker locker( &mMutex );
+      return qint64( mEntries.maxCost() ) * 1024;
+    }
+
+    void clear()
+    {
+      QMutexLocker locker( &mMutex );
+      mEntries.clear();
+      mSeen.clear();
+    }
+
+  private:
+    mutable QMutex mMutex;
+    //! idle prepared geometries, cost in kB
+    QCache<QByteArray, QgsGeosPreparedEntry> mEntries;
+    //! hashes of keys which have been requested without being prepared
+    QCache<uint, bool> mSeen;
+};
+
+// declared after geosinit, so that it is destroyed before the GEOS context is finished
+static QgsGeosPreparedCache sharedPreparedCache;
+
 ///@endcond
 
 
@@ -125,38 +235,106 @@ class GEOSGeomScopedPtr
 };
 
 QgsGeos::QgsGeos( const QgsAbstractGeometryV2* geometry, double precision )
-    : QgsGeometryEngine( geometry ), mGeos( 0 ), mGeosPrepared( 0 ), mPrecision( precision )
+    : QgsGeometryEngine( geometry ), mGeos( 0 ), mGeosPrepared( 0 ), mPrecision( precision ), mSharedPrepared( 0 )
 {
   cacheGeos();
 }
 
 QgsGeos::~QgsGeos()
 {
+  releasePrepared();
   GEOSGeom_destroy_r( geosinit.ctxt, mGeos );
   mGeos = 0;
-  GEOSPreparedGeom_destroy_r( geosinit.ctxt, mGeosPrepared );
-  mGeosPrepared = 0;
 }
 
 void QgsGeos::geometryChanged()
 {
+  releasePrepared();
   GEOSGeom_destroy_r( geosinit.ctxt, mGeos );
   mGeos = 0;
-  GEOSPreparedGeom_destroy_r( geosinit.ctxt, mGeosPrepared );
-  mGeosPrepared = 0;
   cacheGeos();
 }
 
 void QgsGeos::prepareGeometry()
 {
-  GEOSPreparedGeom_destroy_r( geosinit.ctxt, mGeosPrepared );
-  mGeosPrepared = 0;
+  releasePrepared();
   if ( mGeos )
   {
     mGeosPrepared = GEOSPrepare_r( geosinit.ctxt, mGeos );
   }
 }
 
+bool QgsGeos::prepareGeometryShared()
+{
+  releasePrepared();
+  if ( !mGeometry || !mGeos )
+  {
+    return false;
+  }
+
+  int wkbSize = 0;
+  unsigned char* wkb = mGeometry->asWkb( wkbSize );
+  if ( !wkb )
+  {
+    return false;
+  }
+  QByteArray key( reinterpret_cast<const char*>( wkb ), wkbSize );
+  delete[] wkb;
+  key.append( reinterpret_cast<const char*>( &mPrecision ), sizeof( double ) );
+
+  bool requestedBefore = false;
+  QgsGeosPreparedEntry* entry = sharedPreparedCache.acquire( key, requestedBefore );
+  if ( !entry )
+  {
+    // geometries tested only once are not worth preparing
+    if ( !requestedBefore )
+    {
+      return false;
+    }
+
+    try
+    {
+      entry = new QgsGeosPreparedEntry( GEOSGeom_clone_r( geosinit.ctxt, mGeos ) );
+    }
+    CATCH_GEOS( false )
+  }
+
+  mSharedPrepared = entry;
+  mSharedKey = key;
+  mGeosPrepared = entry->prepared;
+  return true;
+}
+
+void QgsGeos::releasePrepared()
+{
+  if ( mSharedPrepared )
+  {
+    sharedPreparedCache.release( mSharedKey, mSharedPrepared );
+    mSharedPrepared = 0;
+    mSharedKey.clear();
+  }
+  else
+  {
+    GEOSPreparedGeom_destroy_r( geosinit.ctxt, mGeosPrepared );
+  }
+  mGeosPrepared = 0;
+}
+
+void QgsGeos::setSharedPreparedCacheSize( qint64 bytes )
+{
+  sharedPreparedCache.setMaximumSize( bytes );
+}
+
+qint64 QgsGeos::sharedPreparedCacheSize()
+{
+  return sharedPreparedCache.maximumSize();
+}
+
+void QgsGeos::clearSharedPreparedCache()
+{
+  sharedPreparedCache.clear();
+}
+
 void QgsGeos::cacheGeos() const
 {
   if ( !mGeometry || mGeos )
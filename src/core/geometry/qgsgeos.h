@@ -20,8 +20,11 @@ email                : marco.hugentobler at sourcepole dot com
 #include "qgspointv2.h"
 #include <geos_c.h>
 
+#include <QByteArray>
+
 class QgsLineStringV2;
 class QgsPolygonV2;
+class QgsGeosPreparedEntry;
 
 /** Does vector analysis using the geos library and handles import, export, exception handling*
  * \note this API is not considered stable and may change for 2.12
@@ -40,6 +43,7 @@ class CORE_EXPORT QgsGeos: public QgsGeometryEngine
     /** Removes caches*/
     void geometryChanged() override;
     void prepareGeometry() override;
+    bool prepareGeometryShared() override;
 
     QgsAbstractGeometryV2* intersection( const QgsAbstractGeometryV2& geom, QString* errorMsg = 0 ) const override;
     QgsAbstractGeometryV2* difference( const QgsAbstractGeometryV2& geom, QString* errorMsg = 0 ) const override;
@@ -96,10 +100,30 @@ class CORE_EXPORT QgsGeos: public QgsGeometryEngine
 
     static GEOSContextHandle_t getGEOSHandler();
 
+    /** Sets the maximum memory used by the cache of shared prepared geometries in bytes.
+     * @see prepareGeometryShared()
+     * @note added in QGIS 2.14
+     */
+    static void setSharedPreparedCacheSize( qint64 bytes );
+
+    /** Returns the maximum memory used by the cache of shared prepared geometries in bytes.
+     * @note added in QGIS 2.14
+     */
+    static qint64 sharedPreparedCacheSize();
+
+    /** Removes all prepared geometries from the shared cache which are not in use.
+     * @note added in QGIS 2.14
+     */
+    static void clearSharedPreparedCache();
+
   private:
     mutable GEOSGeometry* mGeos;
     const GEOSPreparedGeometry* mGeosPrepared;
     double mPrecision;
+    //! entry of the shared cache holding mGeosPrepared, if taken from the cache
+    QgsGeosPreparedEntry* mSharedPrepared;
+    //! cache key of mSharedPrepared
+    QByteArray mSharedKey;
 
     enum Overlay
     {
@@ -122,6 +146,8 @@ class CORE_EXPORT QgsGeos: public QgsGeometryEngine
 
     //geos util functions
     void cacheGeos() const;
+    //! destroys the prepared geometry or returns it to the shared cache
+    void releasePrepared();
     QgsAbstractGeometryV2* overlay( const QgsAbstractGeometryV2& geom, Overlay op, QString* errorMsg = 0 ) const;
     bool relation( const QgsAbstractGeometryV2& geom, Relation r, QString* errorMsg = 0 ) const;
     static GEOSCoordSequence* createCoordinateSequence( const QgsCurveV2* curve , double precision );
@@ -17,6 +17,7 @@
 
 #include "qgslinestringv2.h"
 #include "qgsapplication.h"
+#include "qgscoordinatekernels.h"
 #include "qgscoordinatetransform.h"
 #include "qgsgeometryutils.h"
 #include "qgsmaptopixel.h"
@@ -48,6 +49,13 @@ void QgsLineStringV2::clear()
   mBoundingBox = QgsRectangle();
 }
 
+QgsRectangle QgsLineStringV2::calculateBoundingBox() const
+{
+  double xMin, yMin, xMax, yMax;
+  QgsCoordinateKernels::boundingBox( mX.constData(), mY.constData(), mX.size(), xMin, yMin, xMax, yMax );
+  return QgsRectangle( xMin, yMin, xMax, yMax );
+}
+
 bool QgsLineStringV2::fromWkb( const unsigned char* wkb )
 {
   if ( !wkb )
@@ -150,16 +158,7 @@ QString QgsLineStringV2::asJSON( int precision ) const
 
 double QgsLineStringV2::length() const
 {
-  double length = 0;
-  int size = mX.size();
-  double dx, dy;
-  for ( int i = 1; i < size; ++i )
-  {
-    dx = mX.at( i ) - mX.at( i - 1 );
-    dy = mY.at( i ) - mY.at( i - 1 );
-    length += sqrt( dx * dx + dy * dy );
-  }
-  return length;
+  return QgsCoordinateKernels::length( mX.constData(), mY.constData(), mX.size() );
 }
 
 QgsPointV2 QgsLineStringV2::startPoint() const
@@ -419,10 +418,19 @@ void QgsLineStringV2::drawAsPolygon( QPainter& p ) const
 
 QPolygonF QgsLineStringV2::asQPolygonF() const
 {
-  QPolygonF points;
-  for ( int i = 0; i < mX.count(); ++i )
+  int nPoints = mX.count();
+  QPolygonF points( nPoints );
+  if ( sizeof( qreal ) == sizeof( double ) )
   {
-    points << QPointF( mX.at( i ), mY.at( i ) );
+    QgsCoordinateKernels::interleave( mX.constData(), mY.constData(), nPoints, reinterpret_cast<double*>( points.data() ) );
+  }
+  else
+  {
+    QPointF* ptr = points.data();
+    for ( int i = 0; i < nPoints; ++i, ++ptr )
+    {
+      *ptr = QPointF( mX.at( i ), mY.at( i ) );
+    }
   }
   return points;
 }
@@ -451,13 +459,7 @@ void QgsLineStringV2::transform( const QgsCoordinateTransform& ct, QgsCoordinate
 
 void QgsLineStringV2::transform( const QTransform& t )
 {
-  int nPoints = numPoints();
-  for ( int i = 0; i < nPoints; ++i )
-  {
-    qreal x, y;
-    t.map( mX.at( i ), mY.at( i ), &x, &y );
-    mX[i] = x; mY[i] = y;
-  }
+  QgsCoordinateKernels::transform( t, mX.data(), mY.data(), numPoints() );
   mBoundingBox = QgsRectangle();
 }
 
@@ -544,30 +546,24 @@ void QgsLineStringV2::addVertex( const QgsPointV2& pt )
 
 double QgsLineStringV2::closestSegment( const QgsPointV2& pt, QgsPointV2& segmentPt,  QgsVertexId& vertexAfter, bool* leftOf, double epsilon ) const
 {
-  double sqrDist = std::numeric_limits<double>::max();
-  double testDist = 0;
-  double segmentPtX, segmentPtY;
+  double sqrDist;
+  int i = QgsCoordinateKernels::closestSegment( mX.constData(), mY.constData(), mX.size(), pt.x(), pt.y(), epsilon, sqrDist );
+  if ( i < 0 )
+  {
+    return sqrDist;
+  }
 
-  int size = mX.size();
-  for ( int i = 1; i < size; ++i )
+  double prevX = mX.at( i - 1 );
+  double prevY = mY.at( i - 1 );
+  double segmentPtX, segmentPtY;
+  QgsGeometryUtils::sqrDistToLine( pt.x(), pt.y(), prevX, prevY, mX.at( i ), mY.at( i ), segmentPtX, segmentPtY, epsilon );
+  segmentPt.setX( segmentPtX );
+  segmentPt.setY( segmentPtY );
+  if ( leftOf )
   {
-    double prevX = mX.at( i - 1 );
-    double prevY = mY.at( i - 1 );
-    double currentX = mX.at( i );
-    double currentY = mY.at( i );
-    testDist = QgsGeometryUtils::sqrDistToLine( pt.x(), pt.y(), prevX, prevY, currentX, currentY, segmentPtX, segmentPtY, epsilon );
-    if ( testDist < sqrDist )
-    {
-      sqrDist = testDist;
-      segmentPt.setX( segmentPtX );
-      segmentPt.setY( segmentPtY );
-      if ( leftOf )
-      {
-        *leftOf = ( QgsGeometryUtils::leftOfLine( segmentPtX, segmentPtY, prevX, prevY, pt.x(), pt.y() ) < 0 );
-      }
-      vertexAfter.part = 0; vertexAfter.ring = 0; vertexAfter.vertex = i;
-    }
+    *leftOf = ( QgsGeometryUtils::leftOfLine( segmentPtX, segmentPtY, prevX, prevY, pt.x(), pt.y() ) < 0 );
   }
+  vertexAfter.part = 0; vertexAfter.ring = 0; vertexAfter.vertex = i;
   return sqrDist;
 }
 
@@ -584,11 +580,7 @@ bool QgsLineStringV2::pointAt( int i, QgsPointV2& vertex, QgsVertexId::VertexTyp
 
 void QgsLineStringV2::sumUpArea( double& sum ) const
 {
-  int maxIndex = numPoints() - 1;
-  for ( int i = 0; i < maxIndex; ++i )
-  {
-    sum += 0.5 * ( mX.at( i ) * mY.at( i + 1 ) - mY.at( i ) * mX.at( i + 1 ) );
-  }
+  sum += 0.5 * QgsCoordinateKernels::shoelaceSum( mX.constData(), mY.constData(), numPoints() );
 }
 
 void QgsLineStringV2::importVerticesFromWkb( const QgsConstWkbPtr& wkb )
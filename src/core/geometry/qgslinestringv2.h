@@ -136,6 +136,8 @@ class CORE_EXPORT QgsLineStringV2: public QgsCurveV2
     virtual QgsLineStringV2* clone() const override;
     virtual void clear() override;
 
+    virtual QgsRectangle calculateBoundingBox() const override;
+
     virtual bool fromWkb( const unsigned char* wkb ) override;
     virtual bool fromWkt( const QString& wkt ) override;
 
@@ -0,0 +1,241 @@
+/***************************************************************************
+                        qgswkbview.cpp
+  -------------------------------------------------------------------
+Date                 : November 2015
+Copyright            : (C) 2015 by the QGIS Development Team
+email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgswkbview.h"
+#include "qgsapplication.h"
+#include "qgsrectangle.h"
+
+#include <QPolygonF>
+#include <qnumeric.h>
+#include <cstring>
+#include <limits>
+
+/// @cond
+
+// Reads a WKB geometry made of points and line strings. Coordinates are collected into a
+// bounding box and/or a list of vertices. Reading stops with false at anything the
+// view does not handle (curves, empty parts, NaN coordinates, other byte order, end of buffer).
+class QgsWkbViewReader
+{
+  public:
+    QgsWkbViewReader( const unsigned char* wkb, int size, QPolygonF* points )
+        : mP( wkb )
+        , mEnd( size > 0 ? wkb + size : 0 )
+        , mPoints( points )
+        , mXMin( std::numeric_limits<double>::max() )
+        , mYMin( std::numeric_limits<double>::max() )
+        , mXMax( -std::numeric_limits<double>::max() )
+        , mYMax( -std::numeric_limits<double>::max() )
+    {}
+
+    bool readGeometry( bool addToBounds )
+    {
+      QgsWKBTypes::Type type;
+      if ( !readHeader( type ) )
+        return false;
+
+      int dim = 2 + QgsWKBTypes::hasZ( type ) + QgsWKBTypes::hasM( type );
+      unsigned int n;
+      switch ( QgsWKBTypes::flatType( type ) )
+      {
+        case QgsWKBTypes::Point:
+          return readPoints( 1, dim, addToBounds );
+
+        case QgsWKBTypes::LineString:
+          return read( n ) && n > 0 && readPoints( n, dim, addToBounds );
+
+        case QgsWKBTypes::Polygon:
+        {
+          if ( !read( n ) || n == 0 )
+            return false;
+          // like QgsCurvePolygonV2, the bounding box is the one of the exterior ring
+          for ( unsigned int i = 0; i < n; ++i )
+          {
+            unsigned int nPoints;
+            if ( !read( nPoints ) || nPoints == 0 || !readPoints( nPoints, dim, addToBounds && i == 0 ) )
+              return false;
+          }
+          return true;
+        }
+
+        case QgsWKBTypes::MultiPoint:
+        case QgsWKBTypes::MultiLineString:
+        case QgsWKBTypes::MultiPolygon:
+        case QgsWKBTypes::GeometryCollection:
+        {
+          if ( !read( n ) || n == 0 )
+            return false;
+          for ( unsigned int i = 0; i < n; ++i )
+          {
+            if ( !readGeometry( addToBounds ) )
+              return false;
+          }
+          return true;
+        }
+
+        default:
+          return false;
+      }
+    }
+
+    QgsRectangle boundingBox() const
+    {
+      return QgsRectangle( mXMin, mYMin, mXMax, mYMax );
+    }
+
+  private:
+    const unsigned char* mP;
+    const unsigned char* mEnd;
+    QPolygonF* mPoints;
+    double mXMin;
+    double mYMin;
+    double mXMax;
+    double mYMax;
+
+    bool available( size_t bytes ) const
+    {
+      return !mEnd || ( mP <= mEnd && static_cast<size_t>( mEnd - mP ) >= bytes );
+    }
+
+    template<typename T> bool read( T& v )
+    {
+      if ( !available( sizeof( v ) ) )
+        return false;
+      memcpy( &v, mP, sizeof( v ) );
+      mP += sizeof( v );
+      return true;
+    }
+
+    bool readHeader( QgsWKBTypes::Type& type )
+    {
+      char endian;
+      if ( !read( endian ) || endian != QgsApplication::endian() )
+        return false;
+      return read( type );
+    }
+
+    bool readPoints( unsigned int n, int dim, bool addToBounds )
+    {
+      if ( !available( static_cast<size_t>( n ) * dim * sizeof( double ) ) )
+        return false;
+
+      for ( unsigned int i = 0; i < n; ++i )
+      {
+        double x, y;
+        memcpy( &x, mP, sizeof( double ) );
+        memcpy( &y, mP + sizeof( double ), sizeof( double ) );
+        mP += dim * sizeof( double );
+
+        if ( qIsNaN( x ) || qIsNaN( y ) )
+          return false;
+
+        if ( addToBounds )
+        {
+          if ( x < mXMin )
+            mXMin = x;
+          if ( x > mXMax )
+            mXMax = x;
+          if ( y < mYMin )
+            mYMin = y;
+          if ( y > mYMax )
+            mYMax = y;
+        }
+        if ( mPoints )
+          mPoints->append( QPointF( x, y ) );
+      }
+      return true;
+    }
+};
+
+/// @endcond
+
+QgsWkbView::QgsWkbView( const unsigned char* wkb, int size )
+    : mWkb( wkb )
+    , mSize( size )
+{
+}
+
+bool QgsWkbView::isValid() const
+{
+  if ( !mWkb || ( mSize > 0 && mSize < static_cast<int>( 1 + sizeof( int ) ) ) )
+    return false;
+
+  if ( mWkb[0] != QgsApplication::endian() )
+    return false;
+
+  QgsWKBTypes::Type type;
+  memcpy( &type, mWkb + 1, sizeof( type ) );
+  return isSupportedType( type );
+}
+
+QgsWKBTypes::Type QgsWkbView::wkbType() const
+{
+  if ( !isValid() )
+    return QgsWKBTypes::Unknown;
+
+  QgsWKBTypes::Type type;
+  memcpy( &type, mWkb + 1, sizeof( type ) );
+  return type;
+}
+
+bool QgsWkbView::boundingBox( QgsRectangle& rect ) const
+{
+  if ( !isValid() )
+    return false;
+
+  QgsWkbViewReader reader( mWkb, mSize, 0 );
+  if ( !reader.readGeometry( true ) )
+    return false;
+
+  rect = reader.boundingBox();
+  return true;
+}
+
+bool QgsWkbView::vertices( QPolygonF& points ) const
+{
+  points.clear();
+  if ( !isValid() )
+    return false;
+
+  QgsWkbViewReader reader( mWkb, mSize, &points );
+  if ( !reader.readGeometry( false ) )
+  {
+    points.clear();
+    return false;
+  }
+  return true;
+}
+
+bool QgsWkbView::isSupportedType( QgsWKBTypes::Type type )
+{
+  switch ( QgsWKBTypes::flatType( type ) )
+  {
+    case QgsWKBTypes::Point:
+    case QgsWKBTypes::LineString:
+    case QgsWKBTypes::CircularString:
+    case QgsWKBTypes::CompoundCurve:
+    case QgsWKBTypes::Polygon:
+    case QgsWKBTypes::CurvePolygon:
+    case QgsWKBTypes::MultiPoint:
+    case QgsWKBTypes::MultiLineString:
+    case QgsWKBTypes::MultiPolygon:
+    case QgsWKBTypes::MultiCurve:
+    case QgsWKBTypes::MultiSurface:
+    case QgsWKBTypes::GeometryCollection:
+      return true;
+    default:
+      return false;
+  }
+}
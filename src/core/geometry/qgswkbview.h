@@ -0,0 +1,81 @@
+/***************************************************************************
+                        qgswkbview.h
+  -------------------------------------------------------------------
+Date                 : November 2015
+Copyright            : (C) 2015 by the QGIS Development Team
+email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSWKBVIEW_H
+#define QGSWKBVIEW_H
+
+#include "qgswkbtypes.h"
+
+class QgsRectangle;
+class QPolygonF;
+
+/** \ingroup core
+ * \class QgsWkbView
+ * \brief Read-only access to a WKB buffer without creating QgsAbstractGeometryV2 objects.
+ *
+ * The view does not copy or own the buffer. QgsGeometry uses it to answer questions about
+ * geometries created with QgsGeometry::fromWkb() (type, bounding box) before the WKB is parsed.
+ *
+ * Only geometries made of points and line strings (points, line strings, polygons, their multi types and
+ * collections of these) are read. Methods return false for curved geometries, empty parts and invalid
+ * data, in which case the WKB has to be parsed into a geometry.
+ *
+ * \note added in QGIS 2.14
+ * \note not available in Python bindings
+ */
+class CORE_EXPORT QgsWkbView
+{
+  public:
+
+    /** Constructor for a view on a WKB buffer
+     * @param wkb WKB buffer, has to stay valid as long as the view is used
+     * @param size size of the buffer in bytes. If 0, the size is not checked while reading.
+     */
+    QgsWkbView( const unsigned char* wkb, int size );
+
+    /** Returns true if the buffer starts with a WKB header in machine byte order of a geometry
+     * type supported by QgsGeometryFactory
+     */
+    bool isValid() const;
+
+    /** Returns the WKB type of the geometry as given in the header or QgsWKBTypes::Unknown if
+     * the view is not valid.
+     */
+    QgsWKBTypes::Type wkbType() const;
+
+    /** Calculates the bounding box of the geometry, identical to QgsAbstractGeometryV2::boundingBox()
+     * of the parsed geometry.
+     * @param rect will be set to the bounding box
+     * @returns false if the geometry could not be read
+     */
+    bool boundingBox( QgsRectangle& rect ) const;
+
+    /** Returns the x and y coordinates of all vertices of the geometry in the order
+     * they are stored in the WKB
+     * @param points will be set to the vertices
+     * @returns false if the geometry could not be read
+     */
+    bool vertices( QPolygonF& points ) const;
+
+    /** Returns true if geometries of a type can be created by QgsGeometryFactory
+     */
+    static bool isSupportedType( QgsWKBTypes::Type type );
+
+  private:
+    const unsigned char* mWkb;
+    int mSize;
+};
+
+#endif // QGSWKBVIEW_H
@@ -1263,7 +1263,13 @@ namespace pal
 
     double angle = mLF->hasFixedAngle() ? mLF->fixedAngle() : 0.0;
 
-    if ( mLF->hasFixedPosition() )
+    if ( mLF->hasCachedPlacement() )
+    {
+      // placement of the previous labeling run is the only candidate
+      const QgsLabelingCache::Placement& p = mLF->cachedPlacement();
+      lPos << new LabelPosition( 0, p.x, p.y, getLabelWidth(), getLabelHeight(), p.alpha, 0.0, this, p.reversed, static_cast<LabelPosition::Quadrant>( p.quadrant ) );
+    }
+    else if ( mLF->hasFixedPosition() )
     {
       lPos << new LabelPosition( 0, mLF->fixedPosition().x(), mLF->fixedPosition().y(), getLabelWidth(), getLabelHeight(), angle, 0.0, this );
     }
@@ -46,6 +46,7 @@
 #include "internalexception.h"
 #include "util.h"
 #include <QTime>
+#include <QtConcurrentMap>
 #include <cstdarg>
 #include <iostream>
 #include <fstream>
@@ -59,6 +60,22 @@ namespace pal
     return QgsGeometry::getGEOSHandler();
   }
 
+  // independent groups of features are solved in parallel once they have at least this many features
+  static const int MIN_FEATURES_PER_GROUP = 64;
+
+  /// @cond PRIVATE
+  struct FeatureGroup
+  {
+    Problem *problem;
+    QList<int> features;
+  };
+
+  static void solveFeatureGroup( FeatureGroup& group )
+  {
+    group.problem->solveFeatureGroup( group.features );
+  }
+  /// @endcond
+
   Pal::Pal()
   {
     // do not init and exit GEOS - we do it inside QGIS
@@ -590,14 +607,28 @@ namespace pal
 
     prob->reduce();
 
+    // features whose candidates never overlap are solved as separate problems on the thread pool.
+    // The split does not depend on the number of threads, so neither does the solution.
+    QList< QList<int> > groups = prob->independentFeatureGroups( MIN_FEATURES_PER_GROUP );
+    if ( groups.count() > 1 )
+    {
+      QList<FeatureGroup> tasks;
+      Q_FOREACH ( const QList<int>& features, groups )
+      {
+        FeatureGroup group;
+        group.problem = prob;
+        group.features = features;
+        tasks.append( group );
+      }
+
+      prob->init_sol_empty();
+      QtConcurrent::blockingMap( tasks, solveFeatureGroup );
+      return prob->getSolution( displayAll );
+    }
+
     try
     {
-      if ( searchMethod == FALP )
-        prob->init_sol_falp();
-      else if ( searchMethod == CHAIN )
-        prob->chain_search();
-      else
-        prob->popmusic();
+      prob->solve();
     }
     catch ( InternalException::Empty )
     {
@@ -46,6 +46,8 @@
 #include <ctime>
 #include <list>
 #include <limits.h> //for INT_MAX
+#include <QHash>
+#include <QVector>
 
 namespace pal
 {
@@ -217,6 +219,173 @@ namespace pal
     delete[] ok;
   }
 
+  typedef struct
+  {
+    QVector<int> *parents;
+    int feature;
+  } GroupContext;
+
+  static int groupRoot( QVector<int>& parents, int feature )
+  {
+    while ( parents[feature] != feature )
+    {
+      parents[feature] = parents[parents[feature]];
+      feature = parents[feature];
+    }
+    return feature;
+  }
+
+  bool groupCallback( LabelPosition *lp, void *ctx )
+  {
+    GroupContext *context = ( GroupContext* ) ctx;
+    int root1 = groupRoot( *context->parents, context->feature );
+    int root2 = groupRoot( *context->parents, lp->getProblemFeatureId() );
+
+    // the lowest feature is the root, so groups are ordered by their first feature
+    if ( root1 < root2 )
+      ( *context->parents )[root2] = root1;
+    else if ( root2 < root1 )
+      ( *context->parents )[root1] = root2;
+    return true;
+  }
+
+  QList< QList<int> > Problem::independentFeatureGroups( int minFeatures )
+  {
+    QVector<int> parents( nbft );
+    for ( int i = 0; i < nbft; i++ )
+      parents[i] = i;
+
+    // features are connected if the bounding boxes of their candidates overlap,
+    // which is cheaper than the exact test and still keeps conflicting features together
+    GroupContext context;
+    context.parents = &parents;
+    double amin[2];
+    double amax[2];
+    for ( int i = 0; i < nbft; i++ )
+    {
+      context.feature = i;
+      for ( int j = 0; j < featNbLp[i]; j++ )
+      {
+        mLabelPositions.at( featStartId[i] + j )->getBoundingBox( amin, amax );
+        candidates->Search( amin, amax, groupCallback, ( void* ) &context );
+      }
+    }
+
+    QHash<int, int> rootGroups;
+    QList< QList<int> > components;
+    for ( int i = 0; i < nbft; i++ )
+    {
+      int root = groupRoot( parents, i );
+      QHash<int, int>::const_iterator it = rootGroups.constFind( root );
+      if ( it == rootGroups.constEnd() )
+      {
+        rootGroups.insert( root, components.count() );
+        components.append( QList<int>() << i );
+      }
+      else
+      {
+        components[it.value()].append( i );
+      }
+    }
+
+    QList< QList<int> > groups;
+    QList<int> group;
+    Q_FOREACH ( const QList<int>& component, components )
+    {
+      group.append( component );
+      if ( group.count() >= minFeatures )
+      {
+        qSort( group );
+        groups.append( group );
+        group.clear();
+      }
+    }
+    if ( !group.isEmpty() )
+    {
+      qSort( group );
+      groups.append( group );
+    }
+
+    return groups;
+  }
+
+  void Problem::solveFeatureGroup( const QList<int>& features )
+  {
+    if ( pal->isCancelled() )
+      return;
+
+    // the candidates are lent to a problem holding just the features of the group,
+    // with feature and candidate ids renumbered for it
+    Problem *sub = new Problem();
+    sub->pal = pal;
+    sub->displayAll = displayAll;
+    sub->nbLabelledLayers = nbLabelledLayers;
+    sub->labelledLayersName = labelledLayersName;
+    memcpy( sub->bbox, bbox, sizeof( bbox ) );
+
+    sub->nbft = features.count();
+    sub->featStartId = new int[sub->nbft];
+    sub->featNbLp = new int[sub->nbft];
+    sub->inactiveCost = new double[sub->nbft];
+
+    int lpId = 0;
+    double subOverlap = 0.0;
+    for ( int i = 0; i < sub->nbft; i++ )
+    {
+      int feat = features.at( i );
+      sub->featStartId[i] = lpId;
+      sub->featNbLp[i] = featNbLp[feat];
+      sub->inactiveCost[i] = inactiveCost[feat];
+
+      for ( int j = 0; j < featNbLp[feat]; j++, lpId++ )
+      {
+        LabelPosition *lp = mLabelPositions.at( featStartId[feat] + j );
+        lp->setProblemIds( i, lpId );
+        lp->insertIntoIndex( sub->candidates );
+        sub->mLabelPositions.append( lp );
+        subOverlap += lp->getNumOverlaps();
+      }
+    }
+    sub->nblp = lpId;
+    sub->all_nblp = lpId;
+    sub->nbOverlap = subOverlap / 2;
+
+    try
+    {
+      sub->solve();
+    }
+    catch ( InternalException::Empty )
+    {
+      sub->init_sol_empty();
+    }
+
+    // hand the candidates back and store the solution
+    for ( int i = 0; i < sub->nbft; i++ )
+    {
+      int feat = features.at( i );
+      for ( int j = 0; j < featNbLp[feat]; j++ )
+      {
+        mLabelPositions.at( featStartId[feat] + j )->setProblemIds( feat, featStartId[feat] + j );
+      }
+
+      int label = sub->sol ? sub->sol->s[i] : -1;
+      sol->s[feat] = label < 0 ? -1 : featStartId[feat] + label - sub->featStartId[i];
+    }
+
+    sub->mLabelPositions.clear();
+    delete sub;
+  }
+
+  void Problem::solve()
+  {
+    if ( pal->searchMethod == FALP )
+      init_sol_falp();
+    else if ( pal->searchMethod == CHAIN )
+      chain_search();
+    else
+      popmusic();
+  }
+
   void Problem::init_sol_empty()
   {
     int i;
@@ -126,6 +126,28 @@ namespace pal
 
       void reduce();
 
+      /** Splits the features into groups which can be solved independently of each other.
+       * Candidates of features of a group do not overlap candidates of features in other
+       * groups. Groups smaller than minFeatures are merged with the following ones.
+       * The grouping only depends on the problem, not on the number of threads used to solve it.
+       * @param minFeatures minimum number of features of a group
+       * @returns list of groups, each a sorted list of feature indices
+       * @note added in QGIS 2.14
+       */
+      QList< QList<int> > independentFeatureGroups( int minFeatures );
+
+      /** Solves a group of features on its own and stores the result in the solution of the problem.
+       * Different groups returned by independentFeatureGroups() may be solved concurrently,
+       * the solution has to be initialized with init_sol_empty() before.
+       * @note added in QGIS 2.14
+       */
+      void solveFeatureGroup( const QList<int>& features );
+
+      /** Searches a solution using the search method of the Pal engine
+       * @note added in QGIS 2.14
+       */
+      void solve();
+
       /**
        * \brief popmusic framework
        */
@@ -28,6 +28,9 @@
 #include <QStringList>
 #include <QVector>
 
+#include <limits>
+#include <cmath>
+
 extern "C"
 {
 #include <proj_api.h>
@@ -37,6 +40,63 @@ extern "C"
 // if defined shows all information about transform to stdout
 // #define COORDINATE_TRANSFORM_VERBOSE
 
+// Definitions of WGS 84 and of the spherical mercator projection (EPSG:3857)
+// for which transformCoords() uses closed form formulas instead of PROJ.4
+static const char* WGS84_PROJ4 = "+proj=longlat +datum=WGS84 +no_defs";
+static const char* WEB_MERCATOR_PROJ4 = "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0 +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null +wktext +no_defs";
+
+// Constants and evaluation order as in PROJ.4 (pj_fwd.c, pj_inv.c, PJ_merc.c),
+// so the results are the same as the ones of pj_transform()
+static const double WEB_MERCATOR_A = 6378137.0;
+static const double WEB_MERCATOR_RA = 1. / 6378137.0;
+static const double HALF_PI = 1.5707963267948966;
+static const double QUARTER_PI = 0.78539816339744833;
+
+// Latitudes closer to the poles are left to PROJ.4, which fails for them
+static const double WEB_MERCATOR_MAX_LATITUDE = 89.99999;
+// Longitudes (in radians) beyond this are wrapped by PROJ.4 (SPI in adjlon.c)
+static const double WEB_MERCATOR_MAX_LAMBDA = 3.14159265359;
+
+static bool geographicToWebMercator( int numPoints, double *x, double *y, double *z )
+{
+  // longitudes outside of -180..180 are wrapped by PROJ.4
+  for ( int i = 0; i < numPoints; ++i )
+  {
+    if ( !( qAbs( x[i] ) <= 180.0 ) || !( qAbs( y[i] ) <= WEB_MERCATOR_MAX_LATITUDE ) )
+      return false;
+  }
+
+  for ( int i = 0; i < numPoints; ++i )
+  {
+    double lam = x[i] * DEG_TO_RAD;
+    double phi = y[i] * DEG_TO_RAD;
+    x[i] = WEB_MERCATOR_A * lam;
+    y[i] = WEB_MERCATOR_A * log( tan( QUARTER_PI + .5 * phi ) );
+    // z is converted to radians just like on the PROJ.4 path
+    z[i] *= DEG_TO_RAD;
+  }
+  return true;
+}
+
+static bool webMercatorToGeographic( int numPoints, double *x, double *y, double *z )
+{
+  for ( int i = 0; i < numPoints; ++i )
+  {
+    if ( !( qAbs( x[i] * WEB_MERCATOR_RA ) <= WEB_MERCATOR_MAX_LAMBDA ) || !( qAbs( y[i] ) < std::numeric_limits<double>::max() ) )
+      return false;
+  }
+
+  for ( int i = 0; i < numPoints; ++i )
+  {
+    double lam = x[i] * WEB_MERCATOR_RA;
+    double phi = HALF_PI - 2. * atan( exp( -( y[i] * WEB_MERCATOR_RA ) ) );
+    x[i] = lam * RAD_TO_DEG;
+    y[i] = phi * RAD_TO_DEG;
+    z[i] *= RAD_TO_DEG;
+  }
+  return true;
+}
+
 QgsCoordinateTransform::QgsCoordinateTransform()
     : QObject()
     , mShortCircuit( false )
@@ -45,6 +105,7 @@ QgsCoordinateTransform::QgsCoordinateTransform()
     , mDestinationProjection( 0 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
+    , mFastPath( NoFastPath )
 {
   setFinder();
 }
@@ -57,6 +118,7 @@ QgsCoordinateTransform::QgsCoordinateTransform( const QgsCoordinateReferenceSyst
     , mDestinationProjection( 0 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
+    , mFastPath( NoFastPath )
 {
   setFinder();
   mSourceCRS = source;
@@ -73,6 +135,7 @@ QgsCoordinateTransform::QgsCoordinateTransform( long theSourceSrsId, long theDes
     , mDestinationProjection( 0 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
+    , mFastPath( NoFastPath )
 {
   initialise();
 }
@@ -84,6 +147,7 @@ QgsCoordinateTransform::QgsCoordinateTransform( const QString& theSourceCRS, con
     , mDestinationProjection( 0 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
+    , mFastPath( NoFastPath )
 {
   setFinder();
   mSourceCRS.createFromWkt( theSourceCRS );
@@ -104,6 +168,7 @@ QgsCoordinateTransform::QgsCoordinateTransform( long theSourceSrid,
     , mDestinationProjection( 0 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
+    , mFastPath( NoFastPath )
 {
   setFinder();
 
@@ -265,6 +330,20 @@ void QgsCoordinateTransform::initialise()
     QgsDebugMsgLevel( "Source/Dest CRS UNequal, shortcircuit is NOt set.", 3 );
   }
 
+  mFastPath = NoFastPath;
+  if ( mInitialisedFlag && !mShortCircuit && useDefaultDatumTransform )
+  {
+    QString sourceProj4 = mSourceCRS.toProj4().simplified();
+    QString destProj4 = mDestCRS.toProj4().simplified();
+    if ( sourceProj4 == WGS84_PROJ4 && destProj4 == WEB_MERCATOR_PROJ4 )
+    {
+      mFastPath = GeographicToWebMercator;
+    }
+    else if ( sourceProj4 == WEB_MERCATOR_PROJ4 && destProj4 == WGS84_PROJ4 )
+    {
+      mFastPath = WebMercatorToGeographic;
+    }
+  }
 }
 
 //
@@ -655,6 +734,15 @@ void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, d
   QgsDebugMsg( QString( "[[[[[[ Number of points to transform: %1 ]]]]]]" ).arg( numPoints ) );
 #endif
 
+  // closed form transformation between WGS 84 and spherical mercator,
+  // PROJ.4 is used if any of the points is outside of its safe range
+  if ( mFastPath != NoFastPath )
+  {
+    bool toMercator = ( mFastPath == GeographicToWebMercator ) == ( direction == ForwardTransform );
+    if ( toMercator ? geographicToWebMercator( numPoints, x, y, z ) : webMercatorToGeographic( numPoints, x, y, z ) )
+      return;
+  }
+
   // use proj4 to do the transform
   QString dir;
   // if the source/destination projection is lat/long, convert the points to radians
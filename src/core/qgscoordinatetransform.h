@@ -285,6 +285,19 @@ class CORE_EXPORT QgsCoordinateTransform : public QObject
     int mSourceDatumTransform;
     int mDestinationDatumTransform;
 
+    //! Transformations computed with closed form formulas instead of PROJ.4
+    enum FastPath
+    {
+      NoFastPath,
+      GeographicToWebMercator, //!< source is WGS 84 and destination spherical mercator (EPSG:3857)
+      WebMercatorToGeographic  //!< source is spherical mercator and destination WGS 84
+    };
+
+    /*!
+     * Closed form transformation used by transformCoords(), set up by initialise()
+     */
+    FastPath mFastPath;
+
     /*!
      * Finder for PROJ grid files.
      */
@@ -37,6 +37,7 @@
 #include "qgsvectorcolorrampv2.h"
 #include "qgsstylev2.h"
 #include "qgsexpressioncontext.h"
+#include "qgsexpressionprogram.h"
 #include "qgsproject.h"
 #include "qgsstringutils.h"
 #include "qgsgeometrycollectionv2.h"
@@ -2638,6 +2639,8 @@ QgsExpression::QgsExpression( const QString& expr )
     , mScale( 0 )
     , mExp( expr )
     , mCalc( 0 )
+    , mProgram( 0 )
+    , mCompiledEvaluationEnabled( true )
 {
   mRootNode = ::parseExpression( expr, mParserErrorString );
 
@@ -2647,6 +2650,7 @@ QgsExpression::QgsExpression( const QString& expr )
 
 QgsExpression::~QgsExpression()
 {
+  delete mProgram;
   delete mCalc;
   delete mRootNode;
 }
@@ -2698,6 +2702,16 @@ void QgsExpression::setGeomCalculator( const QgsDistanceArea &calc )
   mCalc = new QgsDistanceArea( calc );
 }
 
+void QgsExpression::setCompiledEvaluationEnabled( bool enabled )
+{
+  mCompiledEvaluationEnabled = enabled;
+  if ( !enabled )
+  {
+    delete mProgram;
+    mProgram = 0;
+  }
+}
+
 bool QgsExpression::prepare( const QgsFields& fields )
 {
   QgsExpressionContext fc = QgsExpressionContextUtils::createFeatureBasedContext( 0, fields );
@@ -2707,6 +2721,9 @@ bool QgsExpression::prepare( const QgsFields& fields )
 bool QgsExpression::prepare( const QgsExpressionContext *context )
 {
   mEvalErrorString = QString();
+  delete mProgram;
+  mProgram = 0;
+
   if ( !mRootNode )
   {
     //re-parse expression. Creation of QgsExpressionContexts may have added extra
@@ -2721,7 +2738,13 @@ bool QgsExpression::prepare( const QgsExpressionContext *context )
     return false;
   }
 
-  return mRootNode->prepare( this, context );
+  if ( !mRootNode->prepare( this, context ) )
+    return false;
+
+  if ( mCompiledEvaluationEnabled )
+    mProgram = QgsExpressionProgram::compile( this, mRootNode, context );
+
+  return true;
 }
 
 QVariant QgsExpression::evaluate( const QgsFeature* f )
@@ -2784,9 +2807,67 @@ QVariant QgsExpression::evaluate( const QgsExpressionContext *context )
     return QVariant();
   }
 
+  if ( mProgram )
+  {
+    QVariant result;
+    if ( mProgram->run( this, context, result ) )
+      return result;
+  }
+
   return mRootNode->eval( this, context );
 }
 
+QVariantList QgsExpression::evaluateBatch( const QList<QgsFeature>& features, QgsExpressionContext* context )
+{
+  mEvalErrorString = QString();
+  QVariantList results;
+  results.reserve( features.count() );
+
+  if ( !mRootNode )
+  {
+    for ( int i = 0; i < features.count(); ++i )
+      results << QVariant();
+    mEvalErrorString = tr( "No root node! Parsing failed?" );
+    return results;
+  }
+
+  QString error;
+  int errorRow = features.count();
+
+  if ( mProgram && context )
+  {
+    QList<int> treeRows;
+    mProgram->runBatch( this, context, features, results, treeRows, errorRow, error );
+
+    Q_FOREACH ( int row, treeRows )
+    {
+      context->setFeature( features.at( row ) );
+      mEvalErrorString = QString();
+      results[row] = mRootNode->eval( this, context );
+      if ( !mEvalErrorString.isNull() && row < errorRow )
+      {
+        errorRow = row;
+        error = mEvalErrorString;
+      }
+    }
+  }
+  else
+  {
+    for ( int row = 0; row < features.count(); ++row )
+    {
+      if ( context )
+        context->setFeature( features.at( row ) );
+      mEvalErrorString = QString();
+      results << mRootNode->eval( this, context );
+      if ( !mEvalErrorString.isNull() && error.isNull() )
+        error = mEvalErrorString;
+    }
+  }
+
+  mEvalErrorString = error;
+  return results;
+}
+
 QString QgsExpression::dump() const
 {
   if ( !mRootNode )
@@ -3386,11 +3467,20 @@ QString QgsExpression::NodeInOperator::dump() const
 
 //
 
+QgsExpression::NodeFunction::~NodeFunction()
+{
+  clearPreparedGeometry();
+  delete mArgs;
+}
+
 QVariant QgsExpression::NodeFunction::eval( QgsExpression *parent, const QgsExpressionContext *context )
 {
   QString name = Functions()[mFnIndex]->name();
   Function* fd = context && context->hasFunction( name ) ? context->function( name ) : Functions()[mFnIndex];
 
+  if ( mPreparedEngine && fd == Functions()[mFnIndex] )
+    return evalPreparedRelation( parent, context );
+
   // evaluate arguments
   QVariantList argValues;
   if ( mArgs )
@@ -3432,9 +3522,140 @@ bool QgsExpression::NodeFunction::prepare( QgsExpression *parent, const QgsExpre
       res = res && n->prepare( parent, context );
     }
   }
+
+  if ( res )
+    prepareConstantGeometry( parent, context );
   return res;
 }
 
+///@cond PRIVATE
+
+typedef bool ( QgsGeometryEngine::*GeometryRelation )( const QgsAbstractGeometryV2&, QString* ) const;
+
+/** Looks up the spatial relation tested by a function.
+ * @param relation relation of the first to the second argument
+ * @param converse same relation from the second to the first argument
+ * @returns false if the function does not test a spatial relation
+ */
+static bool geometryRelation( const QString& name, GeometryRelation& relation, GeometryRelation& converse )
+{
+  if ( name == "disjoint" )
+    relation = converse = &QgsGeometryEngine::disjoint;
+  else if ( name == "intersects" )
+    relation = converse = &QgsGeometryEngine::intersects;
+  else if ( name == "touches" )
+    relation = converse = &QgsGeometryEngine::touches;
+  else if ( name == "crosses" )
+    relation = converse = &QgsGeometryEngine::crosses;
+  else if ( name == "overlaps" )
+    relation = converse = &QgsGeometryEngine::overlaps;
+  else if ( name == "contains" )
+  {
+    relation = &QgsGeometryEngine::contains;
+    converse = &QgsGeometryEngine::within;
+  }
+  else if ( name == "within" )
+  {
+    relation = &QgsGeometryEngine::within;
+    converse = &QgsGeometryEngine::contains;
+  }
+  else
+    return false;
+  return true;
+}
+
+/** Returns true if a node evaluates to the same geometry for every feature, i.e. it is a
+ * geometry constructor like geom_from_wkt with literal arguments */
+static bool isConstantGeometryNode( QgsExpression::Node* node, const QgsExpressionContext* context )
+{
+  if ( node->nodeType() != QgsExpression::ntFunction )
+    return false;
+
+  QgsExpression::NodeFunction* fnNode = static_cast<QgsExpression::NodeFunction*>( node );
+  QString name = QgsExpression::Functions()[fnNode->fnIndex()]->name();
+  if ( name != "geom_from_wkt" && name != "geom_from_gml" )
+    return false;
+  if ( context && context->hasFunction( name ) )
+    return false;
+  if ( !fnNode->args() )
+    return false;
+
+  Q_FOREACH ( QgsExpression::Node* arg, fnNode->args()->list() )
+  {
+    if ( arg->nodeType() != QgsExpression::ntLiteral )
+      return false;
+  }
+  return true;
+}
+
+///@endcond
+
+void QgsExpression::NodeFunction::prepareConstantGeometry( QgsExpression* parent, const QgsExpressionContext* context )
+{
+  clearPreparedGeometry();
+
+  QString name = Functions()[mFnIndex]->name();
+  GeometryRelation relation = 0;
+  GeometryRelation converse = 0;
+  if ( !mArgs || mArgs->count() != 2 || !geometryRelation( name, relation, converse ) )
+    return;
+  if ( context && context->hasFunction( name ) )
+    return;
+
+  int arg = -1;
+  if ( isConstantGeometryNode( mArgs->list().at( 0 ), context ) )
+    arg = 0;
+  else if ( isConstantGeometryNode( mArgs->list().at( 1 ), context ) )
+    arg = 1;
+  else
+    return;
+
+  // a failing conversion is reported when the expression is evaluated
+  QString evalErrorString = parent->evalErrorString();
+  QVariant value = mArgs->list().at( arg )->eval( parent, context );
+  bool failed = parent->hasEvalError();
+  parent->setEvalErrorString( evalErrorString );
+  if ( failed || !value.canConvert<QgsGeometry>() )
+    return;
+
+  QgsGeometry geom = value.value<QgsGeometry>();
+  if ( !geom.geometry() )
+    return;
+
+  mPreparedGeometry = new QgsGeometry( geom );
+  mPreparedEngine = QgsGeometry::createGeometryEngine( mPreparedGeometry->geometry() );
+  mPreparedEngine->prepareGeometry();
+  mPreparedArg = arg;
+}
+
+void QgsExpression::NodeFunction::clearPreparedGeometry()
+{
+  delete mPreparedEngine;
+  mPreparedEngine = 0;
+  delete mPreparedGeometry;
+  mPreparedGeometry = 0;
+  mPreparedArg = -1;
+}
+
+QVariant QgsExpression::NodeFunction::evalPreparedRelation( QgsExpression* parent, const QgsExpressionContext* context )
+{
+  QVariant v = mArgs->list().at( 1 - mPreparedArg )->eval( parent, context );
+  ENSURE_NO_EVAL_ERROR;
+  if ( isNull( v ) )
+    return QVariant();
+
+  QgsGeometry geom = getGeometry( v, parent );
+  ENSURE_NO_EVAL_ERROR;
+  if ( !geom.geometry() )
+    return TVL_False;
+
+  GeometryRelation relation = 0;
+  GeometryRelation converse = 0;
+  geometryRelation( Functions()[mFnIndex]->name(), relation, converse );
+  bool result = ( mPreparedEngine->*( mPreparedArg == 0 ? relation : converse ) )( *geom.geometry(), 0 );
+  return result ? TVL_True : TVL_False;
+}
+
 QString QgsExpression::NodeFunction::dump() const
 {
   Function* fd = Functions()[mFnIndex];
@@ -27,6 +27,7 @@
 
 class QgsFeature;
 class QgsGeometry;
+class QgsGeometryEngine;
 class QgsOgcUtils;
 class QgsVectorLayer;
 class QgsVectorDataProvider;
@@ -35,6 +36,7 @@ class QgsFields;
 class QgsDistanceArea;
 class QDomElement;
 class QgsExpressionContext;
+class QgsExpressionProgram;
 
 /**
 Class for parsing and evaluation of expressions (formerly called "search strings").
@@ -126,6 +128,28 @@ class CORE_EXPORT QgsExpression
     //! Returns true if the expression uses feature geometry for some computation
     bool needsGeometry() const;
 
+    /** Sets whether prepare() should compile the expression to a flat instruction stream.
+     * Compiled expressions keep intermediate values unboxed and resolve columns to
+     * attribute indices, falling back to the node tree for anything else. Enabled by default.
+     * @param enabled set to false to always evaluate the node tree
+     * @see compiledEvaluationEnabled()
+     * @see isCompiled()
+     * @note added in QGIS 2.14
+     */
+    void setCompiledEvaluationEnabled( bool enabled );
+
+    /** Returns whether prepare() compiles the expression.
+     * @see setCompiledEvaluationEnabled()
+     * @note added in QGIS 2.14
+     */
+    bool compiledEvaluationEnabled() const { return mCompiledEvaluationEnabled; }
+
+    /** Returns true if the last call to prepare() produced a compiled program which is
+     * used by evaluate().
+     * @note added in QGIS 2.14
+     */
+    bool isCompiled() const { return mProgram; }
+
     // evaluation
 
     //! Evaluate the feature and return the result
@@ -159,6 +183,22 @@ class CORE_EXPORT QgsExpression
      */
     QVariant evaluate( const QgsExpressionContext* context );
 
+    /** Evaluates the expression for a block of features at once.
+     *
+     * This is considerably faster than setting each feature on the context and calling
+     * evaluate() for it, as compiled expressions run every operator as a loop over the
+     * whole block and only touch the context when it is really needed.
+     * @param features features to evaluate
+     * @param context context for evaluating expression. The feature of the context
+     * is overwritten and left in an undefined state.
+     * @returns list with one result for each of the features. Results of features which
+     * failed to evaluate are null, in that case hasEvalError() returns true and
+     * evalErrorString() holds the error of the first failing feature.
+     * @note prepare() should be called before calling this method.
+     * @note added in QGIS 2.14
+     */
+    QVariantList evaluateBatch( const QList<QgsFeature>& features, QgsExpressionContext* context );
+
     //! Returns true if an error occurred when evaluating last input
     bool hasEvalError() const { return !mEvalErrorString.isNull(); }
     //! Returns evaluation error
@@ -778,9 +818,9 @@ class CORE_EXPORT QgsExpression
     class CORE_EXPORT NodeFunction : public Node
     {
       public:
-        NodeFunction( int fnIndex, NodeList* args ) : mFnIndex( fnIndex ), mArgs( args ) {}
+        NodeFunction( int fnIndex, NodeList* args ) : mFnIndex( fnIndex ), mArgs( args ), mPreparedGeometry( 0 ), mPreparedEngine( 0 ), mPreparedArg( -1 ) {}
         //NodeFunction( QString name, NodeList* args ) : mName(name), mArgs(args) {}
-        virtual ~NodeFunction() { delete mArgs; }
+        virtual ~NodeFunction();
 
         int fnIndex() const { return mFnIndex; }
         NodeList* args() const { return mArgs; }
@@ -802,6 +842,20 @@ class CORE_EXPORT QgsExpression
       private:
 
         QgsExpression::Function* getFunc() const;
+
+        /** Converts and prepares a constant geometry argument of a spatial relation function (e.g. a
+         * polygon given as WKT) once, instead of for every evaluated feature */
+        void prepareConstantGeometry( QgsExpression* parent, const QgsExpressionContext* context );
+        void clearPreparedGeometry();
+        //! Evaluates the spatial relation function with the prepared constant geometry
+        QVariant evalPreparedRelation( QgsExpression* parent, const QgsExpressionContext* context );
+
+        //! constant geometry argument of a spatial relation function
+        QgsGeometry* mPreparedGeometry;
+        //! engine with the prepared mPreparedGeometry
+        QgsGeometryEngine* mPreparedEngine;
+        //! index of the argument of mPreparedGeometry, -1 if none
+        int mPreparedArg;
     };
 
     class CORE_EXPORT NodeLiteral : public Node
@@ -873,6 +927,13 @@ class CORE_EXPORT QgsExpression
         virtual bool needsGeometry() const override;
         virtual void accept( Visitor& v ) const override { v.visit( *this ); }
 
+        //! Returns the list of WHEN / THEN pairs
+        //! @note added in QGIS 2.14
+        const WhenThenList& conditions() const { return mConditions; }
+        //! Returns the ELSE expression, or null if there is none
+        //! @note added in QGIS 2.14
+        Node* elseExp() const { return mElseExp; }
+
       protected:
         WhenThenList mConditions;
         Node* mElseExp;
@@ -922,7 +983,7 @@ class CORE_EXPORT QgsExpression
     /**
      * Used by QgsOgcUtils to create an empty
      */
-    QgsExpression() : mRootNode( 0 ), mRowNumber( 0 ), mScale( 0.0 ), mCalc( 0 ) {}
+    QgsExpression() : mRootNode( 0 ), mRowNumber( 0 ), mScale( 0.0 ), mCalc( 0 ), mProgram( 0 ), mCompiledEvaluationEnabled( true ) {}
 
     void initGeomCalculator();
 
@@ -937,6 +998,10 @@ class CORE_EXPORT QgsExpression
 
     QgsDistanceArea *mCalc;
 
+    //! Compiled form of the prepared node tree, or null
+    QgsExpressionProgram* mProgram;
+    bool mCompiledEvaluationEnabled;
+
     static QMap<QString, QVariant> gmSpecialColumns;
     static QMap<QString, QString> gmSpecialColumnGroups;
 
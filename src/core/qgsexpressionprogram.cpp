@@ -0,0 +1,1170 @@
+/***************************************************************************
+  qgsexpressionprogram.cpp
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsexpressionprogram.h"
+#include "qgsexpressioncontext.h"
+
+#include <qmath.h>
+#include <math.h>
+#include <limits>
+
+///@cond PRIVATE
+
+// three-value logic, same tables as used by the node tree
+
+enum ProgramTVL
+{
+  TvlFalse,
+  TvlTrue,
+  TvlUnknown
+};
+
+static const ProgramTVL TVL_AND[3][3] =
+{
+  { TvlFalse, TvlFalse,   TvlFalse },
+  { TvlFalse, TvlTrue,    TvlUnknown },
+  { TvlFalse, TvlUnknown, TvlUnknown }
+};
+
+static const ProgramTVL TVL_OR[3][3] =
+{
+  { TvlFalse,   TvlTrue, TvlUnknown },
+  { TvlTrue,    TvlTrue, TvlTrue },
+  { TvlUnknown, TvlTrue, TvlUnknown }
+};
+
+static const ProgramTVL TVL_NOT[3] = { TvlTrue, TvlFalse, TvlUnknown };
+
+///@endcond
+
+//
+// QgsExpressionProgram::Value
+//
+
+void QgsExpressionProgram::Value::setVariant( const QVariant& v )
+{
+  var = v;
+  boxed = true;
+  strNum = -1;
+  null = v.isNull();
+
+  switch ( v.type() )
+  {
+    case QVariant::Invalid:
+      type = Null;
+      null = true;
+      break;
+
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+      type = Int;
+      i = v.toLongLong();
+      break;
+
+    case QVariant::Double:
+      type = Double;
+      d = v.toDouble();
+      break;
+
+    case QVariant::String:
+      type = String;
+      s = v.toString();
+      break;
+
+    default:
+      type = Other;
+      break;
+  }
+}
+
+void QgsExpressionProgram::Value::setNull()
+{
+  type = Null;
+  null = true;
+  boxed = false;
+}
+
+void QgsExpressionProgram::Value::setInt( qint64 value )
+{
+  type = Int;
+  null = false;
+  boxed = false;
+  i = value;
+}
+
+void QgsExpressionProgram::Value::setDouble( double value )
+{
+  type = Double;
+  null = false;
+  boxed = false;
+  d = value;
+}
+
+void QgsExpressionProgram::Value::setString( const QString& value )
+{
+  type = String;
+  null = false;
+  boxed = false;
+  strNum = -1;
+  s = value;
+}
+
+QVariant QgsExpressionProgram::Value::toVariant() const
+{
+  if ( boxed )
+    return var;
+
+  switch ( type )
+  {
+    case Int:
+      return QVariant( static_cast<int>( i ) );
+    case Double:
+      return QVariant( d );
+    case String:
+      return QVariant( s );
+    case Null:
+    case Other:
+      break;
+  }
+  return QVariant();
+}
+
+//
+// operand conversions
+//
+// All helpers return false when the value can not be handled exactly like
+// the node tree would (which usually means the tree reports an evaluation
+// error). The program then gives up and the tree walker takes over.
+//
+
+static bool stringToDouble( const QString& str, double& x )
+{
+  bool ok;
+  x = str.toDouble( &ok );
+  return ok && qIsFinite( x ) && !qIsNaN( x );
+}
+
+static bool intValue( qint64 v, int& out )
+{
+  if ( v < std::numeric_limits<int>::min() || v > std::numeric_limits<int>::max() )
+    return false;
+  out = static_cast<int>( v );
+  return true;
+}
+
+//
+// QgsExpressionProgram
+//
+
+QgsExpressionProgram::QgsExpressionProgram()
+    : mResultRegister( -1 )
+    , mFallbackCount( 0 )
+    , mHasJumps( false )
+{
+}
+
+QgsExpressionProgram::~QgsExpressionProgram()
+{
+  qDeleteAll( mRegExps );
+}
+
+QgsExpressionProgram* QgsExpressionProgram::compile( QgsExpression* parent, QgsExpression::Node* rootNode, const QgsExpressionContext* context )
+{
+  if ( !rootNode )
+    return 0;
+
+  // a single literal, column or function call is evaluated just as fast by the tree
+  switch ( rootNode->nodeType() )
+  {
+    case QgsExpression::ntLiteral:
+    case QgsExpression::ntColumnRef:
+    case QgsExpression::ntFunction:
+      return 0;
+    default:
+      break;
+  }
+
+  QgsExpressionProgram* program = new QgsExpressionProgram();
+  if ( context && context->hasVariable( QgsExpressionContext::EXPR_FIELDS ) )
+    program->mFields = context->fields();
+
+  program->mResultRegister = program->compileNode( parent, rootNode );
+
+  // nothing to gain if the whole expression ended up in the tree walker
+  if ( program->mCode.count() == 1 && program->mCode.at( 0 ).op == OpEvalNode )
+  {
+    delete program;
+    return 0;
+  }
+
+  return program;
+}
+
+int QgsExpressionProgram::newRegister()
+{
+  mRegisters.append( Value() );
+  return mRegisters.count() - 1;
+}
+
+int QgsExpressionProgram::addInstruction( const Instruction& ins )
+{
+  switch ( ins.op )
+  {
+    case OpJump:
+    case OpJumpIfNotTrue:
+    case OpInBegin:
+    case OpInStep:
+    case OpInEnd:
+      mHasJumps = true;
+      break;
+    default:
+      break;
+  }
+  mCode.append( ins );
+  return mCode.count() - 1;
+}
+
+int QgsExpressionProgram::compileConstant( const QVariant& value )
+{
+  int reg = newRegister();
+  mRegisters[reg].setVariant( value );
+  mRegisters[reg].constant = true;
+  if ( mRegisters[reg].type == Value::String && !mRegisters[reg].null )
+  {
+    // parse the literal only once
+    double x;
+    mRegisters[reg].strNum = stringToDouble( mRegisters[reg].s, x ) ? 1 : 0;
+    mRegisters[reg].strNumValue = x;
+  }
+  return reg;
+}
+
+bool QgsExpressionProgram::isFoldable( const QgsExpression::Node* node ) const
+{
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntLiteral:
+      return true;
+
+    case QgsExpression::ntUnaryOperator:
+      return isFoldable( static_cast<const QgsExpression::NodeUnaryOperator*>( node )->operand() );
+
+    case QgsExpression::ntBinaryOperator:
+    {
+      const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+      return isFoldable( n->opLeft() ) && isFoldable( n->opRight() );
+    }
+
+    case QgsExpression::ntInOperator:
+    {
+      const QgsExpression::NodeInOperator* n = static_cast<const QgsExpression::NodeInOperator*>( node );
+      if ( !isFoldable( n->node() ) )
+        return false;
+      Q_FOREACH ( QgsExpression::Node* item, n->list()->list() )
+      {
+        if ( !isFoldable( item ) )
+          return false;
+      }
+      return true;
+    }
+
+    case QgsExpression::ntCondition:
+    {
+      const QgsExpression::NodeCondition* n = static_cast<const QgsExpression::NodeCondition*>( node );
+      Q_FOREACH ( QgsExpression::WhenThen* cond, n->conditions() )
+      {
+        if ( !isFoldable( cond->mWhenExp ) || !isFoldable( cond->mThenExp ) )
+          return false;
+      }
+      return !n->elseExp() || isFoldable( n->elseExp() );
+    }
+
+    // functions may depend on the context or be non-deterministic (rand, now, ...)
+    case QgsExpression::ntFunction:
+    case QgsExpression::ntColumnRef:
+      return false;
+  }
+  return false;
+}
+
+int QgsExpressionProgram::compileNode( QgsExpression* parent, QgsExpression::Node* node )
+{
+  if ( node->nodeType() == QgsExpression::ntLiteral )
+    return compileConstant( static_cast<QgsExpression::NodeLiteral*>( node )->value() );
+
+  if ( isFoldable( node ) )
+  {
+    QVariant value = node->eval( parent, ( QgsExpressionContext* )0 );
+    if ( !parent->hasEvalError() )
+      return compileConstant( value );
+
+    // leave the error to be reported at evaluation time
+    parent->setEvalErrorString( QString() );
+  }
+
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntColumnRef:
+    {
+      QString name = static_cast<QgsExpression::NodeColumnRef*>( node )->name();
+      int index = -1;
+      for ( int i = 0; i < mFields.count(); ++i )
+      {
+        if ( QString::compare( mFields.at( i ).name(), name, Qt::CaseInsensitive ) == 0 )
+        {
+          index = i;
+          break;
+        }
+      }
+      if ( index < 0 )
+        break;
+
+      Instruction ins( OpLoadColumn );
+      ins.dst = newRegister();
+      ins.extra = index;
+      addInstruction( ins );
+      return ins.dst;
+    }
+
+    case QgsExpression::ntUnaryOperator:
+    {
+      QgsExpression::NodeUnaryOperator* n = static_cast<QgsExpression::NodeUnaryOperator*>( node );
+      Instruction ins( OpUnary );
+      ins.a = compileNode( parent, n->operand() );
+      ins.dst = newRegister();
+      ins.extra = n->op();
+      addInstruction( ins );
+      return ins.dst;
+    }
+
+    case QgsExpression::ntBinaryOperator:
+    {
+      QgsExpression::NodeBinaryOperator* n = static_cast<QgsExpression::NodeBinaryOperator*>( node );
+      Instruction ins( OpBinary );
+      ins.a = compileNode( parent, n->opLeft() );
+      ins.b = compileNode( parent, n->opRight() );
+      ins.dst = newRegister();
+      ins.extra = n->op();
+
+      const Value& pattern = mRegisters.at( ins.b );
+      if ( pattern.constant && pattern.type == Value::String && !pattern.null )
+      {
+        switch ( n->op() )
+        {
+          case QgsExpression::boLike:
+          case QgsExpression::boNotLike:
+          case QgsExpression::boILike:
+          case QgsExpression::boNotILike:
+          {
+            QString esc_regexp = QRegExp::escape( pattern.s );
+            esc_regexp.replace( '%', ".*" );
+            esc_regexp.replace( '_', '.' );
+            bool caseSensitive = n->op() == QgsExpression::boLike || n->op() == QgsExpression::boNotLike;
+            ins.regexp = new QRegExp( esc_regexp, caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive );
+            mRegExps << ins.regexp;
+            break;
+          }
+          case QgsExpression::boRegexp:
+            ins.regexp = new QRegExp( pattern.s );
+            mRegExps << ins.regexp;
+            break;
+          default:
+            break;
+        }
+      }
+
+      addInstruction( ins );
+      return ins.dst;
+    }
+
+    case QgsExpression::ntInOperator:
+    {
+      QgsExpression::NodeInOperator* n = static_cast<QgsExpression::NodeInOperator*>( node );
+      if ( n->list()->count() == 0 )
+        break;
+
+      int value = compileNode( parent, n->node() );
+      int dst = newRegister();
+
+      QList<int> jumps;
+      Instruction begin( OpInBegin );
+      begin.dst = dst;
+      begin.a = value;
+      jumps << addInstruction( begin );
+
+      Q_FOREACH ( QgsExpression::Node* item, n->list()->list() )
+      {
+        Instruction step( OpInStep );
+        step.b = compileNode( parent, item );
+        step.dst = dst;
+        step.a = value;
+        step.extra = n->isNotIn();
+        jumps << addInstruction( step );
+      }
+
+      Instruction end( OpInEnd );
+      end.dst = dst;
+      end.extra = n->isNotIn();
+      addInstruction( end );
+
+      Q_FOREACH ( int jump, jumps )
+        mCode[jump].target = mCode.count();
+      return dst;
+    }
+
+    case QgsExpression::ntCondition:
+    {
+      QgsExpression::NodeCondition* n = static_cast<QgsExpression::NodeCondition*>( node );
+      int dst = newRegister();
+      QList<int> jumpsToEnd;
+
+      Q_FOREACH ( QgsExpression::WhenThen* cond, n->conditions() )
+      {
+        Instruction test( OpJumpIfNotTrue );
+        test.a = compileNode( parent, cond->mWhenExp );
+        int testIndex = addInstruction( test );
+
+        Instruction move( OpMove );
+        move.a = compileNode( parent, cond->mThenExp );
+        move.dst = dst;
+        addInstruction( move );
+
+        jumpsToEnd << addInstruction( Instruction( OpJump ) );
+        mCode[testIndex].target = mCode.count();
+      }
+
+      Instruction move( OpMove );
+      move.a = n->elseExp() ? compileNode( parent, n->elseExp() ) : compileConstant( QVariant() );
+      move.dst = dst;
+      addInstruction( move );
+
+      Q_FOREACH ( int jump, jumpsToEnd )
+        mCode[jump].target = mCode.count();
+      return dst;
+    }
+
+    case QgsExpression::ntLiteral:
+    case QgsExpression::ntFunction:
+      break;
+  }
+
+  // no native instruction - let the tree walker evaluate this sub tree
+  Instruction ins( OpEvalNode );
+  ins.dst = newRegister();
+  ins.node = node;
+  addInstruction( ins );
+  mFallbackCount++;
+  return ins.dst;
+}
+
+bool QgsExpressionProgram::run( QgsExpression* parent, const QgsExpressionContext* context, QVariant& result )
+{
+  return execute( parent, context, 0, result );
+}
+
+void QgsExpressionProgram::runBatch( QgsExpression* parent, QgsExpressionContext* context, const QgsFeatureList& features,
+                                     QVariantList& results, QList<int>& treeRows, int& errorRow, QString& error )
+{
+  const int count = features.count();
+  errorRow = count;
+
+  if ( mHasJumps )
+  {
+    // control flow differs between features, run them one by one
+    for ( int row = 0; row < count; ++row )
+    {
+      const QgsFeature& feature = features.at( row );
+      if ( mFallbackCount > 0 )
+        context->setFeature( feature );
+      parent->setEvalErrorString( QString() );
+
+      QVariant res;
+      if ( !execute( parent, context, &feature, res ) )
+      {
+        treeRows << row;
+        res = QVariant();
+      }
+      else if ( parent->hasEvalError() && row < errorRow )
+      {
+        errorRow = row;
+        error = parent->evalErrorString();
+      }
+      results << res;
+    }
+    parent->setEvalErrorString( QString() );
+    return;
+  }
+
+  // 0 = running, 1 = left to the tree, 2 = failed with an evaluation error
+  QVector<char> state( count, 0 );
+
+  mColumns.resize( mRegisters.count() );
+  Q_FOREACH ( const Instruction& ins, mCode )
+  {
+    mColumns[ins.dst].resize( count );
+  }
+
+  Q_FOREACH ( const Instruction& ins, mCode )
+  {
+    Value* dst = mColumns[ins.dst].data();
+
+    switch ( ins.op )
+    {
+      case OpLoadColumn:
+        for ( int row = 0; row < count; ++row )
+        {
+          if ( !state[row] )
+            dst[row].setVariant( features.at( row ).attribute( ins.extra ) );
+        }
+        break;
+
+      case OpEvalNode:
+        for ( int row = 0; row < count; ++row )
+        {
+          if ( state[row] )
+            continue;
+
+          context->setFeature( features.at( row ) );
+          parent->setEvalErrorString( QString() );
+          QVariant v = ins.node->eval( parent, context );
+          if ( parent->hasEvalError() )
+          {
+            state[row] = 2;
+            if ( row < errorRow )
+            {
+              errorRow = row;
+              error = parent->evalErrorString();
+            }
+          }
+          else
+          {
+            dst[row].setVariant( v );
+          }
+        }
+        break;
+
+      case OpMove:
+        for ( int row = 0; row < count; ++row )
+        {
+          if ( !state[row] )
+          {
+            dst[row] = operand( ins.a, row );
+            dst[row].constant = false;
+          }
+        }
+        break;
+
+      case OpUnary:
+      {
+        const QgsExpression::UnaryOperator op = ( QgsExpression::UnaryOperator ) ins.extra;
+        for ( int row = 0; row < count; ++row )
+        {
+          if ( !state[row] && !unaryOp( op, operand( ins.a, row ), dst[row] ) )
+            state[row] = 1;
+        }
+        break;
+      }
+
+      case OpBinary:
+        for ( int row = 0; row < count; ++row )
+        {
+          if ( !state[row] && !binaryOp( ins, operand( ins.a, row ), operand( ins.b, row ), dst[row] ) )
+            state[row] = 1;
+        }
+        break;
+
+      case OpJump:
+      case OpJumpIfNotTrue:
+      case OpInBegin:
+      case OpInStep:
+      case OpInEnd:
+        // not present in straight line programs
+        Q_ASSERT( false );
+        break;
+    }
+  }
+
+  for ( int row = 0; row < count; ++row )
+  {
+    switch ( state[row] )
+    {
+      case 0:
+        results << operand( mResultRegister, row ).toVariant();
+        break;
+      case 1:
+        treeRows << row;
+        results << QVariant();
+        break;
+      default:
+        results << QVariant();
+        break;
+    }
+  }
+  parent->setEvalErrorString( QString() );
+}
+
+bool QgsExpressionProgram::execute( QgsExpression* parent, const QgsExpressionContext* context, const QgsFeature* f, QVariant& result )
+{
+  Value* regs = mRegisters.data();
+  const Instruction* code = mCode.constData();
+  const int codeSize = mCode.count();
+
+  QgsFeature feature;
+  bool haveFeature = false;
+  if ( f )
+  {
+    feature = *f;
+    haveFeature = true;
+  }
+
+  int pc = 0;
+  while ( pc < codeSize )
+  {
+    const Instruction& ins = code[pc];
+    switch ( ins.op )
+    {
+      case OpLoadColumn:
+        if ( !haveFeature )
+        {
+          if ( !context || !context->hasVariable( QgsExpressionContext::EXPR_FEATURE ) )
+            return false;
+          feature = context->feature();
+          haveFeature = true;
+        }
+        regs[ins.dst].setVariant( feature.attribute( ins.extra ) );
+        break;
+
+      case OpEvalNode:
+      {
+        QVariant v = ins.node->eval( parent, context );
+        if ( parent->hasEvalError() )
+        {
+          // the tree would stop at the very same node
+          result = QVariant();
+          return true;
+        }
+        regs[ins.dst].setVariant( v );
+        break;
+      }
+
+      case OpMove:
+        regs[ins.dst] = regs[ins.a];
+        regs[ins.dst].constant = false;
+        break;
+
+      case OpUnary:
+        if ( !unaryOp(( QgsExpression::UnaryOperator ) ins.extra, regs[ins.a], regs[ins.dst] ) )
+          return false;
+        break;
+
+      case OpBinary:
+        if ( !binaryOp( ins, regs[ins.a], regs[ins.b], regs[ins.dst] ) )
+          return false;
+        break;
+
+      case OpJump:
+        pc = ins.target;
+        continue;
+
+      case OpJumpIfNotTrue:
+      {
+        int tvl;
+        if ( !tvlValue( regs[ins.a], tvl ) )
+          return false;
+        if ( tvl != TvlTrue )
+        {
+          pc = ins.target;
+          continue;
+        }
+        break;
+      }
+
+      case OpInBegin:
+        if ( regs[ins.a].null )
+        {
+          regs[ins.dst].setNull();
+          pc = ins.target;
+          continue;
+        }
+        // the destination register tracks whether the list contained a NULL
+        regs[ins.dst].i = 0;
+        break;
+
+      case OpInStep:
+      {
+        const Value& item = regs[ins.b];
+        if ( item.null )
+        {
+          regs[ins.dst].i = 1;
+          break;
+        }
+
+        bool equal;
+        if ( !valuesEqual( regs[ins.a], item, equal ) )
+          return false;
+        if ( equal )
+        {
+          regs[ins.dst].setInt( ins.extra ? 0 : 1 );
+          pc = ins.target;
+          continue;
+        }
+        break;
+      }
+
+      case OpInEnd:
+        if ( regs[ins.dst].i )
+          regs[ins.dst].setNull();
+        else
+          regs[ins.dst].setInt( ins.extra ? 1 : 0 );
+        break;
+    }
+    ++pc;
+  }
+
+  result = regs[mResultRegister].toVariant();
+  return true;
+}
+
+bool QgsExpressionProgram::numericValue( const Value& v, double& x )
+{
+  switch ( v.type )
+  {
+    case Value::Int:
+      x = v.i;
+      return true;
+    case Value::Double:
+      x = v.d;
+      return qIsFinite( x ) && !qIsNaN( x );
+    default:
+      return false;
+  }
+}
+
+bool QgsExpressionProgram::doubleSafeValue( const Value& v, double& x, bool& safe )
+{
+  switch ( v.type )
+  {
+    case Value::Int:
+    case Value::Double:
+      safe = true;
+      return numericValue( v, x );
+
+    case Value::String:
+      if ( v.strNum < 0 )
+      {
+        v.strNum = stringToDouble( v.s, v.strNumValue ) ? 1 : 0;
+      }
+      safe = v.strNum == 1;
+      x = v.strNumValue;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+bool QgsExpressionProgram::stringValue( const Value& v, QString& str )
+{
+  switch ( v.type )
+  {
+    case Value::String:
+      str = v.s;
+      return true;
+    case Value::Int:
+      str = QString::number( v.i );
+      return true;
+    default:
+      // double formatting and other types are left to QVariant
+      return false;
+  }
+}
+
+bool QgsExpressionProgram::tvlValue( const Value& v, int& tvl )
+{
+  if ( v.null )
+  {
+    tvl = TvlUnknown;
+    return true;
+  }
+
+  switch ( v.type )
+  {
+    case Value::Int:
+      tvl = v.i != 0 ? TvlTrue : TvlFalse;
+      return true;
+
+    case Value::Double:
+      tvl = v.d != 0 ? TvlTrue : TvlFalse;
+      return true;
+
+    case Value::String:
+    {
+      bool ok;
+      double x = v.s.toDouble( &ok );
+      if ( !ok )
+        return false;
+      tvl = x != 0 ? TvlTrue : TvlFalse;
+      return true;
+    }
+
+    case Value::Other:
+      if ( v.var.type() == QVariant::Bool )
+      {
+        tvl = v.var.toBool() ? TvlTrue : TvlFalse;
+        return true;
+      }
+      return false;
+
+    case Value::Null:
+      break;
+  }
+  return false;
+}
+
+bool QgsExpressionProgram::compareValues( const Value& l, const Value& r, double& diff )
+{
+  double fL, fR;
+  bool safeL, safeR;
+  if ( !doubleSafeValue( l, fL, safeL ) || !doubleSafeValue( r, fR, safeR ) )
+    return false;
+
+  if ( safeL && safeR )
+  {
+    diff = fL - fR;
+    return true;
+  }
+
+  QString sL, sR;
+  if ( !stringValue( l, sL ) || !stringValue( r, sR ) )
+    return false;
+
+  diff = QString::compare( sL, sR );
+  return true;
+}
+
+bool QgsExpressionProgram::valuesEqual( const Value& l, const Value& r, bool& equal )
+{
+  double diff;
+  if ( !compareValues( l, r, diff ) )
+    return false;
+  equal = diff == 0;
+  return true;
+}
+
+bool QgsExpressionProgram::unaryOp( QgsExpression::UnaryOperator op, const Value& v, Value& dst ) const
+{
+  switch ( op )
+  {
+    case QgsExpression::uoNot:
+    {
+      int tvl;
+      if ( !tvlValue( v, tvl ) )
+        return false;
+      if ( TVL_NOT[tvl] == TvlUnknown )
+        dst.setNull();
+      else
+        dst.setInt( TVL_NOT[tvl] == TvlTrue ? 1 : 0 );
+      return true;
+    }
+
+    case QgsExpression::uoMinus:
+    {
+      if ( v.null )
+        return false;
+
+      if ( v.type == Value::Int )
+      {
+        int x;
+        if ( !intValue( v.i, x ) )
+          return false;
+        dst.setInt( -x );
+        return true;
+      }
+
+      double x;
+      if ( !numericValue( v, x ) )
+        return false;
+      dst.setDouble( -x );
+      return true;
+    }
+  }
+  return false;
+}
+
+bool QgsExpressionProgram::binaryOp( const Instruction& ins, const Value& l, const Value& r, Value& dst ) const
+{
+  const QgsExpression::BinaryOperator op = ( QgsExpression::BinaryOperator ) ins.extra;
+
+  switch ( op )
+  {
+    case QgsExpression::boPlus:
+      if ( l.type == Value::String && r.type == Value::String )
+      {
+        // like the node tree, the sum of two NULL strings is a NULL string
+        dst.setString(( l.null ? QString() : l.s ) + ( r.null ? QString() : r.s ) );
+        dst.null = dst.s.isNull();
+        return true;
+      }
+      //intentional fall-through
+    case QgsExpression::boMinus:
+    case QgsExpression::boMul:
+    case QgsExpression::boDiv:
+    case QgsExpression::boMod:
+    {
+      if ( l.null || r.null )
+      {
+        dst.setNull();
+        return true;
+      }
+
+      if ( op != QgsExpression::boDiv && l.type == Value::Int && r.type == Value::Int )
+      {
+        int iL, iR;
+        if ( !intValue( l.i, iL ) || !intValue( r.i, iR ) )
+          return false;
+
+        // wrap around like the int arithmetic of the node tree
+        switch ( op )
+        {
+          case QgsExpression::boPlus: dst.setInt( static_cast<int>( static_cast<qint64>( iL ) + iR ) ); break;
+          case QgsExpression::boMinus: dst.setInt( static_cast<int>( static_cast<qint64>( iL ) - iR ) ); break;
+          case QgsExpression::boMul: dst.setInt( static_cast<int>( static_cast<qint64>( iL ) * iR ) ); break;
+          case QgsExpression::boMod:
+            if ( iR == 0 )
+              dst.setNull();
+            else
+              dst.setInt( iL % iR );
+            break;
+          default:
+            return false;
+        }
+        return true;
+      }
+
+      // strings may be int/double safe, date times need intervals: leave both to the tree
+      double fL, fR;
+      if ( !numericValue( l, fL ) || !numericValue( r, fR ) )
+        return false;
+
+      if (( op == QgsExpression::boDiv || op == QgsExpression::boMod ) && fR == 0. )
+      {
+        dst.setNull();
+        return true;
+      }
+
+      switch ( op )
+      {
+        case QgsExpression::boPlus: dst.setDouble( fL + fR ); break;
+        case QgsExpression::boMinus: dst.setDouble( fL - fR ); break;
+        case QgsExpression::boMul: dst.setDouble( fL * fR ); break;
+        case QgsExpression::boDiv: dst.setDouble( fL / fR ); break;
+        case QgsExpression::boMod: dst.setDouble( fmod( fL, fR ) ); break;
+        default: return false;
+      }
+      return true;
+    }
+
+    case QgsExpression::boIntDiv:
+    {
+      double fL, fR;
+      if ( l.null || r.null || !numericValue( l, fL ) || !numericValue( r, fR ) )
+        return false;
+      if ( fR == 0. )
+        dst.setNull();
+      else
+        dst.setInt( qFloor( fL / fR ) );
+      return true;
+    }
+
+    case QgsExpression::boPow:
+    {
+      if ( l.null || r.null )
+      {
+        dst.setNull();
+        return true;
+      }
+      double fL, fR;
+      if ( !numericValue( l, fL ) || !numericValue( r, fR ) )
+        return false;
+      dst.setDouble( pow( fL, fR ) );
+      return true;
+    }
+
+    case QgsExpression::boAnd:
+    case QgsExpression::boOr:
+    {
+      int tvlL, tvlR;
+      if ( !tvlValue( l, tvlL ) || !tvlValue( r, tvlR ) )
+        return false;
+      ProgramTVL res = op == QgsExpression::boAnd ? TVL_AND[tvlL][tvlR] : TVL_OR[tvlL][tvlR];
+      if ( res == TvlUnknown )
+        dst.setNull();
+      else
+        dst.setInt( res == TvlTrue ? 1 : 0 );
+      return true;
+    }
+
+    case QgsExpression::boEQ:
+    case QgsExpression::boNE:
+    case QgsExpression::boLT:
+    case QgsExpression::boGT:
+    case QgsExpression::boLE:
+    case QgsExpression::boGE:
+    {
+      if ( l.null || r.null )
+      {
+        dst.setNull();
+        return true;
+      }
+
+      double diff;
+      if ( !compareValues( l, r, diff ) )
+        return false;
+
+      bool res;
+      switch ( op )
+      {
+        case QgsExpression::boEQ: res = diff == 0; break;
+        case QgsExpression::boNE: res = diff != 0; break;
+        case QgsExpression::boLT: res = diff < 0; break;
+        case QgsExpression::boGT: res = diff > 0; break;
+        case QgsExpression::boLE: res = diff <= 0; break;
+        default: res = diff >= 0; break;
+      }
+      dst.setInt( res ? 1 : 0 );
+      return true;
+    }
+
+    case QgsExpression::boIs:
+    case QgsExpression::boIsNot:
+    {
+      bool equal;
+      if ( l.null && r.null )
+        equal = true;
+      else if ( l.null || r.null )
+        equal = false;
+      else if ( !valuesEqual( l, r, equal ) )
+        return false;
+
+      dst.setInt( equal == ( op == QgsExpression::boIs ) ? 1 : 0 );
+      return true;
+    }
+
+    case QgsExpression::boRegexp:
+    case QgsExpression::boLike:
+    case QgsExpression::boNotLike:
+    case QgsExpression::boILike:
+    case QgsExpression::boNotILike:
+    {
+      if ( l.null || r.null )
+      {
+        dst.setNull();
+        return true;
+      }
+
+      QString str;
+      if ( !stringValue( l, str ) )
+        return false;
+
+      bool matches;
+      if ( ins.regexp )
+      {
+        matches = op == QgsExpression::boRegexp ? ins.regexp->indexIn( str ) != -1 : ins.regexp->exactMatch( str );
+      }
+      else
+      {
+        QString regexp;
+        if ( !stringValue( r, regexp ) )
+          return false;
+
+        if ( op == QgsExpression::boRegexp )
+        {
+          matches = QRegExp( regexp ).indexIn( str ) != -1;
+        }
+        else
+        {
+          QString esc_regexp = QRegExp::escape( regexp );
+          esc_regexp.replace( '%', ".*" );
+          esc_regexp.replace( '_', '.' );
+          matches = QRegExp( esc_regexp, op == QgsExpression::boLike || op == QgsExpression::boNotLike ? Qt::CaseSensitive : Qt::CaseInsensitive ).exactMatch( str );
+        }
+      }
+
+      if ( op == QgsExpression::boNotLike || op == QgsExpression::boNotILike )
+        matches = !matches;
+
+      dst.setInt( matches ? 1 : 0 );
+      return true;
+    }
+
+    case QgsExpression::boConcat:
+    {
+      if ( l.null || r.null )
+      {
+        dst.setNull();
+        return true;
+      }
+      QString sL, sR;
+      if ( !stringValue( l, sL ) || !stringValue( r, sR ) )
+        return false;
+      dst.setString( sL + sR );
+      return true;
+    }
+  }
+
+  return false;
+}
+
+QString QgsExpressionProgram::dump() const
+{
+  static const char* opNames[] =
+  {
+    "LOADCOL", "EVAL", "MOVE", "UNARY", "BINARY", "JUMP", "JUMPIFNOT", "INBEGIN", "INSTEP", "INEND"
+  };
+
+  QStringList lines;
+  for ( int i = 0; i < mCode.count(); ++i )
+  {
+    const Instruction& ins = mCode.at( i );
+    QString line = QString( "%1: %2 r%3" ).arg( i ).arg( opNames[ins.op] ).arg( ins.dst );
+    if ( ins.a >= 0 )
+      line += QString( " r%1" ).arg( ins.a );
+    if ( ins.b >= 0 )
+      line += QString( " r%1" ).arg( ins.b );
+    switch ( ins.op )
+    {
+      case OpUnary:
+        line += QString( " %1" ).arg( QgsExpression::UnaryOperatorText[ins.extra] );
+        break;
+      case OpBinary:
+        line += QString( " %1" ).arg( QgsExpression::BinaryOperatorText[ins.extra] );
+        break;
+      case OpLoadColumn:
+        line += QString( " #%1" ).arg( ins.extra );
+        break;
+      case OpEvalNode:
+        line += ' ' + ins.node->dump();
+        break;
+      default:
+        break;
+    }
+    if ( ins.target >= 0 )
+      line += QString( " -> %1" ).arg( ins.target );
+    lines << line;
+  }
+  lines << QString( "result: r%1" ).arg( mResultRegister );
+  return lines.join( "\n" );
+}
@@ -0,0 +1,218 @@
+/***************************************************************************
+  qgsexpressionprogram.h
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSEXPRESSIONPROGRAM_H
+#define QGSEXPRESSIONPROGRAM_H
+
+/// @cond
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgsexpression.h"
+#include "qgsfeature.h"
+
+#include <QRegExp>
+#include <QVector>
+
+/** \ingroup core
+ * A prepared expression lowered to a flat instruction stream.
+ *
+ * After QgsExpression::prepare() the node tree is translated into a list of
+ * register based instructions. Literals and operator-only sub trees are
+ * folded to constants, column references are resolved to attribute indices
+ * and all intermediate values are kept in unboxed registers (integer, double
+ * or string) instead of QVariants.
+ *
+ * Nodes which have no native instruction (functions, geometry or date/time
+ * values) are embedded as tree walker calls. Whenever an operand combination
+ * is met at run time which the program cannot evaluate with exactly the same
+ * semantics as the node tree, run() returns false and the caller falls back
+ * to QgsExpression::Node::eval().
+ *
+ * @note not available in Python bindings
+ * @note added in QGIS 2.14
+ */
+class CORE_EXPORT QgsExpressionProgram
+{
+  public:
+
+    /** Compiles the (already prepared) expression tree.
+     * @param parent expression owning the node tree
+     * @param rootNode root of the prepared node tree
+     * @param context context used for preparation, used to resolve column indices
+     * @returns new program or null if the expression does not benefit from compilation
+     */
+    static QgsExpressionProgram* compile( QgsExpression* parent, QgsExpression::Node* rootNode, const QgsExpressionContext* context );
+
+    /** Runs the program against a context.
+     * @param parent expression used to report evaluation errors of embedded nodes
+     * @param context context to evaluate against
+     * @param result will be set to the evaluation result
+     * @returns false if the program can not evaluate this context and the node tree has to be used instead
+     */
+    bool run( QgsExpression* parent, const QgsExpressionContext* context, QVariant& result );
+
+    /** Runs the program for a block of features.
+     *
+     * Straight line programs are executed one instruction at a time over the
+     * whole block, so every operator runs as a loop over a contiguous array of
+     * registers. Programs containing CASE or IN jumps are run feature by feature.
+     * The feature of the context is only updated when the program embeds tree
+     * walker nodes which may need it.
+     *
+     * @param parent expression used to report evaluation errors of embedded nodes
+     * @param context context to evaluate against
+     * @param features block of features to evaluate
+     * @param results receives one value for each feature
+     * @param treeRows receives indices of features which the program could not evaluate,
+     * their results have to be computed with the node tree
+     * @param errorRow index of the first feature which failed to evaluate, or the number of features
+     * @param error receives the error message of the first feature which failed to evaluate
+     */
+    void runBatch( QgsExpression* parent, QgsExpressionContext* context, const QgsFeatureList& features,
+                   QVariantList& results, QList<int>& treeRows, int& errorRow, QString& error );
+
+    //! Returns number of instructions in the program
+    int instructionCount() const { return mCode.count(); }
+
+    //! Returns number of sub trees which are evaluated by the tree walker
+    int fallbackNodeCount() const { return mFallbackCount; }
+
+    //! Returns a textual listing of the program, for debugging
+    QString dump() const;
+
+    ~QgsExpressionProgram();
+
+  private:
+
+    //! Register value
+    struct Value
+    {
+      enum Type
+      {
+        Null,     //!< untyped NULL (an invalid QVariant)
+        Int,
+        Double,
+        String,
+        Other     //!< any other QVariant type, only passed through
+      };
+
+      Value() : type( Null ), null( true ), i( 0 ), d( 0 ), boxed( false ), constant( false ), strNum( -1 ), strNumValue( 0 ) {}
+
+      Type type;
+      //! true for untyped NULL and for typed null values (eg. a NULL string attribute)
+      bool null;
+      qint64 i;
+      double d;
+      QString s;
+
+      //! Original variant, valid when the value was loaded from a variant
+      QVariant var;
+      bool boxed;
+
+      //! true for registers holding a literal or folded constant
+      bool constant;
+
+      //! Cached result of parsing the string as double: -1 = not parsed yet, 0 = not a number, 1 = number
+      mutable signed char strNum;
+      mutable double strNumValue;
+
+      void setVariant( const QVariant& v );
+      void setNull();
+      void setInt( qint64 value );
+      void setDouble( double value );
+      void setString( const QString& value );
+      QVariant toVariant() const;
+    };
+
+    enum OpCode
+    {
+      OpLoadColumn,    //!< dst = feature.attribute( index )
+      OpEvalNode,      //!< dst = node->eval() using the tree walker
+      OpMove,          //!< dst = a
+      OpUnary,         //!< dst = extra( a )
+      OpBinary,        //!< dst = a extra b
+      OpJump,          //!< pc = target
+      OpJumpIfNotTrue, //!< if !a pc = target
+      OpInBegin,       //!< start "a IN (...)" - if a is NULL dst = NULL and pc = target
+      OpInStep,        //!< compare a with b, on match set dst and pc = target
+      OpInEnd          //!< finish "IN" test when no item matched
+    };
+
+    struct Instruction
+    {
+      Instruction( OpCode code = OpJump )
+          : op( code ), dst( -1 ), a( -1 ), b( -1 ), extra( 0 ), target( -1 ), node( 0 ), regexp( 0 ) {}
+
+      OpCode op;
+      int dst;
+      int a;
+      int b;
+      //! operator, attribute index or NOT IN flag
+      int extra;
+      int target;
+      QgsExpression::Node* node;
+      //! precompiled regular expression for LIKE / ~ with a literal pattern
+      QRegExp* regexp;
+    };
+
+    QgsExpressionProgram();
+
+    bool execute( QgsExpression* parent, const QgsExpressionContext* context, const QgsFeature* feature, QVariant& result );
+    const Value& operand( int reg, int row ) const
+    {
+      const Value& v = mRegisters.at( reg );
+      return v.constant ? v : mColumns.at( reg ).at( row );
+    }
+
+    int newRegister();
+    int addInstruction( const Instruction& ins );
+    int compileNode( QgsExpression* parent, QgsExpression::Node* node );
+    int compileConstant( const QVariant& value );
+    bool isFoldable( const QgsExpression::Node* node ) const;
+
+    static bool numericValue( const Value& v, double& x );
+    static bool doubleSafeValue( const Value& v, double& x, bool& safe );
+    static bool stringValue( const Value& v, QString& str );
+    static bool tvlValue( const Value& v, int& tvl );
+    static bool compareValues( const Value& l, const Value& r, double& diff );
+    static bool valuesEqual( const Value& l, const Value& r, bool& equal );
+
+    bool unaryOp( QgsExpression::UnaryOperator op, const Value& v, Value& dst ) const;
+    bool binaryOp( const Instruction& ins, const Value& l, const Value& r, Value& dst ) const;
+
+    QVector<Instruction> mCode;
+    QVector<Value> mRegisters;
+    //! Per register columns used by runBatch()
+    QVector< QVector<Value> > mColumns;
+    QList<QRegExp*> mRegExps;
+    QgsFields mFields;
+    int mResultRegister;
+    int mFallbackCount;
+    bool mHasJumps;
+
+    Q_DISABLE_COPY( QgsExpressionProgram )
+};
+
+/// @endcond
+
+#endif // QGSEXPRESSIONPROGRAM_H
@@ -0,0 +1,76 @@
+/***************************************************************************
+  qgslabelingcache.cpp
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgslabelingcache.h"
+
+#include <QMutexLocker>
+
+QgsLabelingCache::QgsLabelingCache()
+{
+}
+
+void QgsLabelingCache::clear()
+{
+  QMutexLocker lock( &mMutex );
+  mView.clear();
+  mExtent = QgsRectangle();
+  mPlacements.clear();
+}
+
+void QgsLabelingCache::clearLayer( const QString& layerId )
+{
+  QMutexLocker lock( &mMutex );
+  QString prefix = layerId + '|';
+  Placements::iterator it = mPlacements.begin();
+  while ( it != mPlacements.end() )
+  {
+    if ( it.key().startsWith( prefix ) )
+      it = mPlacements.erase( it );
+    else
+      ++it;
+  }
+}
+
+QgsLabelingCache::Placements QgsLabelingCache::placements( const QString& view, QgsRectangle& extent ) const
+{
+  QMutexLocker lock( &mMutex );
+  if ( view != mView )
+  {
+    extent = QgsRectangle();
+    return Placements();
+  }
+
+  extent = mExtent;
+  return mPlacements;
+}
+
+void QgsLabelingCache::setPlacements( const QString& view, const QgsRectangle& extent, const Placements& placements )
+{
+  QMutexLocker lock( &mMutex );
+  mView = view;
+  mExtent = extent;
+  mPlacements = placements;
+}
+
+QString QgsLabelingCache::view() const
+{
+  QMutexLocker lock( &mMutex );
+  return mView;
+}
+
+QString QgsLabelingCache::providerKey( const QString& layerId, const QString& providerName, int index )
+{
+  return QString( "%1|%2|%3" ).arg( layerId, providerName ).arg( index );
+}
@@ -0,0 +1,112 @@
+/***************************************************************************
+  qgslabelingcache.h
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSLABELINGCACHE_H
+#define QGSLABELINGCACHE_H
+
+#include "qgsfeature.h"
+#include "qgsrectangle.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+/**
+ * @brief The QgsLabelingCache class keeps label placements of the last labeling run.
+ *
+ * QgsLabelingEngineV2 stores where the labels ended up after a map render. When the
+ * next render shows the same map scale with the same settings (typically after a pan),
+ * features whose label lies well inside both the old and the new map extent get their
+ * previous placement as the only candidate. Only labels near the borders which have
+ * changed are placed from scratch.
+ *
+ * Placements are kept per label provider and feature ID. A placement is only reused
+ * if the label text and size did not change.
+ *
+ * The class is thread-safe.
+ *
+ * @note not available in Python bindings
+ * @note added in QGIS 2.14
+ */
+class CORE_EXPORT QgsLabelingCache
+{
+  public:
+
+    //! Label position chosen for a feature
+    struct Placement
+    {
+      Placement() : width( 0 ), height( 0 ), x( 0 ), y( 0 ), alpha( 0 ), quadrant( 0 ), reversed( false ) {}
+
+      //! text of the label
+      QString text;
+      //! width of the label in map units
+      double width;
+      //! height of the label in map units
+      double height;
+      //! x coordinate of the label origin
+      double x;
+      //! y coordinate of the label origin
+      double y;
+      //! label rotation in radians
+      double alpha;
+      //! quadrant of the label (pal::LabelPosition::Quadrant)
+      int quadrant;
+      //! whether the label is reversed (for labels along lines)
+      bool reversed;
+      //! bounding box of the label
+      QgsRectangle rect;
+    };
+
+    //! Placements of the labels of one provider, by feature ID
+    typedef QHash<QgsFeatureId, Placement> ProviderPlacements;
+    //! Placements of all providers, by provider key
+    typedef QHash<QString, ProviderPlacements> Placements;
+
+    QgsLabelingCache();
+
+    //! Removes all placements
+    void clear();
+
+    //! Removes placements of the providers of a layer
+    void clearLayer( const QString& layerId );
+
+    /** Returns placements of the last labeling run.
+     * @param view key of the map view (scale, CRS, labeling settings) of the labeling run
+     * @param extent will be set to the map extent of the last labeling run
+     * @returns placements or no placements if the last run was for another view
+     */
+    Placements placements( const QString& view, QgsRectangle& extent ) const;
+
+    /** Stores placements of a labeling run, replacing the previous ones.
+     * @param view key of the map view of the labeling run
+     * @param extent map extent of the labeling run
+     * @param placements placements of the labels
+     */
+    void setPlacements( const QString& view, const QgsRectangle& extent, const Placements& placements );
+
+    //! Returns key of the map view of the stored placements
+    QString view() const;
+
+    //! Returns key of a label provider, layerId has to be the ID of the layer of the provider
+    static QString providerKey( const QString& layerId, const QString& providerName, int index );
+
+  private:
+    mutable QMutex mMutex;
+    QString mView;
+    QgsRectangle mExtent;
+    Placements mPlacements;
+};
+
+#endif // QGSLABELINGCACHE_H
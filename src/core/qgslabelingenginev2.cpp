@@ -24,6 +24,10 @@
 #include "pal.h"
 #include "problem.h"
 
+#include <QSet>
+
+#include <cmath>
+
 
 
 // helper function for checking for job cancellation within PAL
@@ -32,6 +36,36 @@ static bool _palIsCancelled( void* ctx )
   return (( QgsRenderContext* ) ctx )->renderingStopped();
 }
 
+// helper function to store a label position in the labeling cache
+static QgsLabelingCache::Placement _cachePlacement( const pal::LabelPosition* lp, const QgsLabelFeature* lf )
+{
+  QgsLabelingCache::Placement placement;
+  placement.text = lf->labelText();
+  placement.width = lf->size().width();
+  placement.height = lf->size().height();
+
+  // LabelPosition swaps the corners of upside down labels, keep the values it has been constructed with
+  if ( lp->getUpsideDown() )
+  {
+    placement.x = lp->getX( 2 );
+    placement.y = lp->getY( 2 );
+    placement.alpha = lp->getAlpha() + M_PI;
+  }
+  else
+  {
+    placement.x = lp->getX( 0 );
+    placement.y = lp->getY( 0 );
+    placement.alpha = lp->getAlpha();
+  }
+  placement.quadrant = lp->getQuadrant();
+  placement.reversed = lp->getReversed();
+
+  double amin[2], amax[2];
+  lp->getBoundingBox( amin, amax );
+  placement.rect = QgsRectangle( amin[0], amin[1], amax[0], amax[1] );
+  return placement;
+}
+
 
 QgsLabelingEngineV2::QgsLabelingEngineV2()
     : mFlags( RenderOutlineLabels | UsePartialCandidates )
@@ -40,6 +74,8 @@ QgsLabelingEngineV2::QgsLabelingEngineV2()
     , mCandLine( 8 )
     , mCandPolygon( 8 )
     , mResults( 0 )
+    , mLabelingCache( 0 )
+    , mProviderCount( 0 )
 {
   mResults = new QgsLabelingResults;
 }
@@ -130,10 +166,43 @@ void QgsLabelingEngineV2::processProvider( QgsAbstractLabelProvider* provider, Q
   l->setUpsidedownLabels( upsdnlabels );
 
 
-  QList<QgsLabelFeature*> features = provider->labelFeatures( context );
+  // features are fetched in the first pass only, a repeated pass registers them again
+  bool firstPass = !mLabelFeatures.contains( provider );
+  if ( firstPass )
+    mLabelFeatures.insert( provider, provider->labelFeatures( context ) );
+  QList<QgsLabelFeature*> features = mLabelFeatures.value( provider );
+
+  // placements are cached for providers with a single candidate per label
+  bool cacheable = mLabelingCache && qgsDoubleNear( mMapSettings.rotation(), 0.0 ) &&
+                   arrangement != pal::P_CURVED &&
+                   !flags.testFlag( QgsAbstractLabelProvider::LabelPerFeaturePart ) &&
+                   !flags.testFlag( QgsAbstractLabelProvider::MergeConnectedLines );
+  QString cacheKey = QgsLabelingCache::providerKey( provider->layerId(), provider->name(), mProviderCount++ );
+  QgsLabelingCache::ProviderPlacements placements;
+  if ( cacheable )
+  {
+    mCachedProviderKeys.insert( provider, cacheKey );
+    if ( firstPass )
+      placements = mPreviousPlacements.value( cacheKey );
+  }
 
   Q_FOREACH ( QgsLabelFeature* feature, features )
   {
+    QgsLabelingCache::ProviderPlacements::const_iterator cached = placements.constFind( feature->id() );
+    if ( cached != placements.constEnd() && !feature->hasFixedPosition() && feature->repeatDistance() == 0 &&
+         cached->text == feature->labelText() &&
+         qgsDoubleNear( cached->width, feature->size().width(), cached->width * 1e-9 ) &&
+         qgsDoubleNear( cached->height, feature->size().height(), cached->height * 1e-9 ) )
+    {
+      // labels close to the borders of the previous or current map extent are placed again,
+      // they may have been clipped before or compete with labels coming into view
+      double margin = qMax( cached->width, cached->height );
+      const QgsRectangle& rect = cached->rect;
+      if ( rect.xMinimum() - margin >= mReuseExtent.xMinimum() && rect.xMaximum() + margin <= mReuseExtent.xMaximum() &&
+           rect.yMinimum() - margin >= mReuseExtent.yMinimum() && rect.yMaximum() + margin <= mReuseExtent.yMaximum() )
+        feature->setCachedPlacement( *cached );
+    }
+
     try
     {
       l->registerFeature( feature );
@@ -149,13 +218,52 @@ void QgsLabelingEngineV2::processProvider( QgsAbstractLabelProvider* provider, Q
   // any sub-providers?
   Q_FOREACH ( QgsAbstractLabelProvider* subProvider, provider->subProviders() )
   {
-    mSubProviders << subProvider;
+    if ( !mSubProviders.contains( subProvider ) )
+      mSubProviders << subProvider;
     processProvider( subProvider, context, p );
   }
 }
 
 
 void QgsLabelingEngineV2::run( QgsRenderContext& context )
+{
+  QgsGeometry* extentGeom( QgsGeometry::fromRect( mMapSettings.visibleExtent() ) );
+  if ( !qgsDoubleNear( mMapSettings.rotation(), 0.0 ) )
+  {
+    //PAL features are prerotated, so extent also needs to be unrotated
+    extentGeom->rotate( -mMapSettings.rotation(), mMapSettings.visibleExtent().center() );
+  }
+
+  QgsRectangle extent = extentGeom->boundingBox();
+  delete extentGeom;
+
+  // pre-rotated features move with the map center, so placements are only cached for unrotated maps
+  bool useCache = mLabelingCache && qgsDoubleNear( mMapSettings.rotation(), 0.0 );
+  QString cacheView;
+  mPreviousPlacements.clear();
+  mReuseExtent = QgsRectangle();
+  mLabelFeatures.clear();
+  if ( useCache )
+  {
+    cacheView = labelingCacheView();
+    QgsRectangle previousExtent;
+    mPreviousPlacements = mLabelingCache->placements( cacheView, previousExtent );
+    // when debugging the candidates all of them are generated
+    if ( !mPreviousPlacements.isEmpty() && previousExtent.intersects( extent ) && !mFlags.testFlag( DrawCandidates ) )
+      mReuseExtent = previousExtent.intersect( &extent );
+    else
+      mPreviousPlacements.clear();
+  }
+
+  // every failed pass drops at least one cached placement, so this terminates
+  while ( !runPass( context, extent, cacheView ) )
+    ;
+
+  mPreviousPlacements.clear();
+  mLabelFeatures.clear();
+}
+
+bool QgsLabelingEngineV2::runPass( QgsRenderContext& context, const QgsRectangle& extent, const QString& cacheView )
 {
   pal::Pal p;
 
@@ -179,6 +287,9 @@ void QgsLabelingEngineV2::run( QgsRenderContext& context )
   p.setShowPartial( mFlags.testFlag( UsePartialCandidates ) );
 
 
+  mCachedProviderKeys.clear();
+  mProviderCount = 0;
+
   // for each provider: get labels and register them in PAL
   Q_FOREACH ( QgsAbstractLabelProvider* provider, mProviders )
   {
@@ -190,16 +301,6 @@ void QgsLabelingEngineV2::run( QgsRenderContext& context )
 
   QPainter* painter = context.painter();
 
-  QgsGeometry* extentGeom( QgsGeometry::fromRect( mMapSettings.visibleExtent() ) );
-  if ( !qgsDoubleNear( mMapSettings.rotation(), 0.0 ) )
-  {
-    //PAL features are prerotated, so extent also needs to be unrotated
-    extentGeom->rotate( -mMapSettings.rotation(), mMapSettings.visibleExtent().center() );
-  }
-
-  QgsRectangle extent = extentGeom->boundingBox();
-  delete extentGeom;
-
   p.registerCancellationCallback( &_palIsCancelled, ( void* ) &context );
 
   QTime t;
@@ -218,14 +319,14 @@ void QgsLabelingEngineV2::run( QgsRenderContext& context )
   {
     Q_UNUSED( e );
     QgsDebugMsgLevel( "PAL EXCEPTION :-( " + QString::fromLatin1( e.what() ), 4 );
-    return;
+    return true;
   }
 
 
   if ( context.renderingStopped() )
   {
     delete problem;
-    return; // it has been cancelled
+    return true; // it has been cancelled
   }
 
 #if 1 // XXX strk
@@ -267,8 +368,37 @@ void QgsLabelingEngineV2::run( QgsRenderContext& context )
   {
     delete problem;
     delete labels;
-    return;
+    return true;
+  }
+
+  // a reused placement is the only candidate of its feature, if it lost a conflict
+  // the layout is repeated with all candidates of that feature
+  if ( !mPreviousPlacements.isEmpty() && dropLostPlacements( *labels ) )
+  {
+    delete problem;
+    delete labels;
+    return false;
   }
+
+  if ( !cacheView.isEmpty() )
+  {
+    QgsLabelingCache::Placements placements;
+    for ( std::list<pal::LabelPosition*>::const_iterator it = labels->begin(); it != labels->end(); ++it )
+    {
+      pal::LabelPosition* lp = *it;
+      QgsLabelFeature* lf = lp->getFeaturePart()->feature();
+      if ( !lf || lp->getNextPart() || lf->hasFixedPosition() || lf->repeatDistance() > 0 )
+        continue;
+
+      QHash<QgsAbstractLabelProvider*, QString>::const_iterator key = mCachedProviderKeys.constFind( lf->provider() );
+      if ( key == mCachedProviderKeys.constEnd() )
+        continue;
+
+      placements[key.value()].insert( lf->id(), _cachePlacement( lp, lf ) );
+    }
+    mLabelingCache->setPlacements( cacheView, extent, placements );
+  }
+
   painter->setRenderHint( QPainter::Antialiasing );
 
   // draw the labels
@@ -295,7 +425,43 @@ void QgsLabelingEngineV2::run( QgsRenderContext& context )
   delete problem;
   delete labels;
 
+  return true;
+}
 
+bool QgsLabelingEngineV2::dropLostPlacements( const std::list<pal::LabelPosition*>& labels )
+{
+  QSet<QgsLabelFeature*> placed;
+  for ( std::list<pal::LabelPosition*>::const_iterator it = labels.begin(); it != labels.end(); ++it )
+  {
+    placed.insert(( *it )->getFeaturePart()->feature() );
+  }
+
+  bool dropped = false;
+  Q_FOREACH ( const QList<QgsLabelFeature*>& features, mLabelFeatures )
+  {
+    Q_FOREACH ( QgsLabelFeature* feature, features )
+    {
+      if ( feature->hasCachedPlacement() && !placed.contains( feature ) )
+      {
+        feature->clearCachedPlacement();
+        dropped = true;
+      }
+    }
+  }
+  return dropped;
+}
+
+QString QgsLabelingEngineV2::labelingCacheView() const
+{
+  return QString( "%1|%2|%3|%4|%5|%6|%7|%8" )
+         .arg( mMapSettings.mapUnitsPerPixel(), 0, 'g', 17 )
+         .arg( mMapSettings.outputDpi() )
+         .arg( mMapSettings.hasCrsTransformEnabled() ? mMapSettings.destinationCrs().toProj4() : QString() )
+         .arg( static_cast<int>( mFlags ) )
+         .arg( static_cast<int>( mSearchMethod ) )
+         .arg( mCandPoint )
+         .arg( mCandLine )
+         .arg( mCandPolygon );
 }
 
 QgsLabelingResults* QgsLabelingEngineV2::takeResults()
@@ -362,6 +528,7 @@ QgsLabelFeature::QgsLabelFeature( QgsFeatureId id, GEOSGeometry* geometry, const
     , mIsObstacle( false )
     , mObstacleFactor( 1 )
     , mInfo( 0 )
+    , mHasCachedPlacement( false )
 {
 }
 
@@ -390,8 +557,9 @@ QgsAbstractLabelProvider*QgsLabelFeature::provider() const
 
 }
 
-QgsAbstractLabelProvider::QgsAbstractLabelProvider()
+QgsAbstractLabelProvider::QgsAbstractLabelProvider( const QString& layerId )
     : mEngine( 0 )
+    , mLayerId( layerId )
     , mFlags( DrawLabels )
     , mPlacement( QgsPalLayerSettings::AroundPoint )
     , mLinePlacementFlags( 0 )
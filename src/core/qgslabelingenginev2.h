@@ -18,12 +18,15 @@
 
 #include "qgsgeometry.h"
 
+#include "qgslabelingcache.h"
 #include "qgsmapsettings.h"
 
 #include "qgspallabeling.h"
 
 #include <QFlags>
 
+#include <list>
+
 class QgsAbstractLabelProvider;
 class QgsRenderContext;
 class QgsGeometry;
@@ -204,6 +207,25 @@ class CORE_EXPORT QgsLabelFeature
     //! Return provider of this instance
     QgsAbstractLabelProvider* provider() const;
 
+    /** Whether the feature has a placement from a previous labeling run which is used as its only candidate
+     * @note added in QGIS 2.14
+     */
+    bool hasCachedPlacement() const { return mHasCachedPlacement; }
+    /** Placement from a previous labeling run
+     * @note added in QGIS 2.14
+     */
+    const QgsLabelingCache::Placement& cachedPlacement() const { return mCachedPlacement; }
+    /** Sets placement from a previous labeling run, it will be the only candidate generated for the feature.
+     * Should be only used internally by the labeling engine.
+     * @note added in QGIS 2.14
+     */
+    void setCachedPlacement( const QgsLabelingCache::Placement& placement ) { mCachedPlacement = placement; mHasCachedPlacement = true; }
+    /** Removes the placement from a previous labeling run, all candidates will be generated for the feature.
+     * Should be only used internally by the labeling engine.
+     * @note added in QGIS 2.14
+     */
+    void clearCachedPlacement() { mHasCachedPlacement = false; }
+
   protected:
     //! Pointer to PAL layer (assigned when registered to PAL)
     pal::Layer* mLayer;
@@ -246,6 +268,10 @@ class CORE_EXPORT QgsLabelFeature
     QString mLabelText;
     //! extra information for curved labels (may be null)
     pal::LabelInfo* mInfo;
+    //! whether mCachedPlacement should be used as the only candidate
+    bool mHasCachedPlacement;
+    //! placement from a previous labeling run
+    QgsLabelingCache::Placement mCachedPlacement;
 };
 
 
@@ -268,7 +294,8 @@ class CORE_EXPORT QgsAbstractLabelProvider
 
   public:
     //! Construct the provider with default values
-    QgsAbstractLabelProvider();
+    //! @param layerId ID of associated layer (added in QGIS 2.14)
+    explicit QgsAbstractLabelProvider( const QString& layerId = QString() );
     //! Vritual destructor
     virtual ~QgsAbstractLabelProvider() {}
 
@@ -298,6 +325,10 @@ class CORE_EXPORT QgsAbstractLabelProvider
     //! Name of the layer (for statistics, debugging etc.) - does not need to be unique
     QString name() const { return mName; }
 
+    //! Returns ID of associated layer, or empty string if no layer is associated with the provider
+    //! @note added in QGIS 2.14
+    QString layerId() const { return mLayerId; }
+
     //! Flags associated with the provider
     Flags flags() const { return mFlags; }
 
@@ -322,6 +353,8 @@ class CORE_EXPORT QgsAbstractLabelProvider
 
     //! Name of the layer
     QString mName;
+    //! Associated layer's ID, if applicable
+    QString mLayerId;
     //! Flags altering drawing and registration of features
     Flags mFlags;
     //! Placement strategy
@@ -429,6 +462,17 @@ class CORE_EXPORT QgsLabelingEngineV2
     //! Which search method to use for removal collisions between labels
     QgsPalLabeling::Search searchMethod() const { return mSearchMethod; }
 
+    /** Sets the cache with label placements of the previous labeling run. Labels far enough from
+     * the borders of the previous and current map extent keep their placement. The cache is not owned
+     * by the engine and it has to exist until run() finishes.
+     * @note added in QGIS 2.14
+     */
+    void setLabelingCache( QgsLabelingCache* cache ) { mLabelingCache = cache; }
+    /** Returns the cache with label placements of the previous labeling run
+     * @note added in QGIS 2.14
+     */
+    QgsLabelingCache* labelingCache() const { return mLabelingCache; }
+
     //! Read configuration of the labeling engine from the current project file
     void readSettingsFromProject();
     //! Write configuration of the labeling engine to the current project file
@@ -452,6 +496,35 @@ class CORE_EXPORT QgsLabelingEngineV2
 
     //! Resulting labeling layout
     QgsLabelingResults* mResults;
+
+    //! Placements of the previous labeling run (not owned)
+    QgsLabelingCache* mLabelingCache;
+
+  private:
+    //! Returns key identifying the map view and labeling settings in the labeling cache
+    QString labelingCacheView() const;
+
+    /** Registers the label features in PAL, solves and draws the layout.
+     * @param cacheView key of the map view in the labeling cache, empty if placements are not cached
+     * @returns false if reused placements lost a conflict and the pass has to be repeated
+     */
+    bool runPass( QgsRenderContext& context, const QgsRectangle& extent, const QString& cacheView );
+
+    /** Stops reusing the placements of features which are not in the solution labels.
+     * @returns true if any placement was dropped
+     */
+    bool dropLostPlacements( const std::list<pal::LabelPosition*>& labels );
+
+    //! Placements of the previous labeling run which may be reused in the current run
+    QgsLabelingCache::Placements mPreviousPlacements;
+    //! Part of the map where previous placements may be reused
+    QgsRectangle mReuseExtent;
+    //! Keys of providers whose placements are cached
+    QHash<QgsAbstractLabelProvider*, QString> mCachedProviderKeys;
+    //! Number of providers processed in the current pass
+    int mProviderCount;
+    //! Label features of the providers in the current run
+    QHash<QgsAbstractLabelProvider*, QList<QgsLabelFeature*> > mLabelFeatures;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( QgsLabelingEngineV2::Flags )
@@ -17,12 +17,37 @@
 
 #include "qgsmaplayerregistry.h"
 #include "qgsmaplayer.h"
+#include "qgslogger.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+
+//! default memory budget of the cache: 100 MB
+static const qint64 DEFAULT_MAXIMUM_MEMORY = 100 * 1024 * 1024;
+//! default size budget of the disk cache: 500 MB
+static const qint64 DEFAULT_MAXIMUM_DISK_SIZE = 500 * 1024 * 1024;
+
+static const char* DISK_IMAGE_SUFFIX = ".qgsimg";
+static const quint32 DISK_IMAGE_MAGIC = 0x51524331; // "QRC1"
 
 QgsMapRendererCache::QgsMapRendererCache()
+    : mScale( 0 )
+    , mMaximumDiskSize( DEFAULT_MAXIMUM_DISK_SIZE )
+    , mDiskSize( 0 )
 {
+  // costs are measured in kB to stay within the int range of QCache
+  mCachedImages.setMaxCost( DEFAULT_MAXIMUM_MEMORY / 1024 );
   clear();
 }
 
+QgsMapRendererCache::~QgsMapRendererCache()
+{
+  QMutexLocker lock( &mMutex );
+  clearInternal();
+}
+
 void QgsMapRendererCache::clear()
 {
   QMutexLocker lock( &mMutex );
@@ -35,15 +60,26 @@ void QgsMapRendererCache::clearInternal()
   mScale = 0;
 
   // make sure we are disconnected from all layers
-  Q_FOREACH ( const QString& layerId, mCachedImages.keys() )
+  Q_FOREACH ( const QString& layerId, mConnectedLayers )
   {
     QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( layerId );
     if ( layer )
     {
-      disconnect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
+      disconnect( layer, 0, this, 0 );
     }
   }
+  mConnectedLayers.clear();
   mCachedImages.clear();
+
+  Q_FOREACH ( const QString& key, mDiskKeys )
+  {
+    QFile::remove( cacheFilePath( key ) );
+  }
+  mDiskKeys.clear();
+  mDiskImageSizes.clear();
+  mDiskSize = 0;
+
+  mLabelingCache.clear();
 }
 
 bool QgsMapRendererCache::init( const QgsRectangle& extent, double scale )
@@ -55,9 +91,7 @@ bool QgsMapRendererCache::init( const QgsRectangle& extent, double scale )
        scale == mScale )
     return true;
 
-  clearInternal();
-
-  // set new params
+  // set new params - images of other views stay cached
   mExtent = extent;
   mScale = scale;
 
@@ -67,38 +101,235 @@ bool QgsMapRendererCache::init( const QgsRectangle& extent, double scale )
 void QgsMapRendererCache::setCacheImage( const QString& layerId, const QImage& img )
 {
   QMutexLocker lock( &mMutex );
-  mCachedImages[layerId] = img;
+  QString key = cacheKey( layerId );
+  mCachedImages.insert( key, new QImage( img ), qMax( 1, img.byteCount() / 1024 ) );
+
+  if ( !mCacheDirectory.isEmpty() )
+  {
+    writeDiskImage( key, img );
+  }
+
+  // connect to the layer to listen to layer's repaintRequested() signals,
+  // style changes and edits invalidate the label placements as well
+  if ( mConnectedLayers.contains( layerId ) )
+    return;
 
-  // connect to the layer to listen to layer's repaintRequested() signals
   QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( layerId );
   if ( layer )
   {
     connect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
+    connect( layer, SIGNAL( rendererChanged() ), this, SLOT( layerRequestedRepaint() ) );
+    if ( layer->type() == QgsMapLayer::VectorLayer )
+      connect( layer, SIGNAL( layerModified() ), this, SLOT( layerRequestedRepaint() ) );
+    mConnectedLayers.insert( layerId );
   }
 }
 
 QImage QgsMapRendererCache::cacheImage( const QString& layerId )
 {
   QMutexLocker lock( &mMutex );
-  return mCachedImages.value( layerId );
+  QString key = cacheKey( layerId );
+  if ( QImage* img = mCachedImages.object( key ) )
+    return *img;
+
+  if ( mCacheDirectory.isEmpty() || !mDiskImageSizes.contains( key ) )
+    return QImage();
+
+  // evicted from memory, restore from the disk cache
+  QImage img = readDiskImage( key );
+  if ( !img.isNull() )
+    mCachedImages.insert( key, new QImage( img ), qMax( 1, img.byteCount() / 1024 ) );
+  return img;
 }
 
 void QgsMapRendererCache::layerRequestedRepaint()
 {
   QgsMapLayer* layer = qobject_cast<QgsMapLayer*>( sender() );
-  if ( layer )
-    clearCacheImage( layer->id() );
+  if ( !layer )
+    return;
+
+  clearCacheImage( layer->id() );
+
+  QMutexLocker lock( &mMutex );
+  disconnect( layer, 0, this, 0 );
+  mConnectedLayers.remove( layer->id() );
+  mLabelingCache.clearLayer( layer->id() );
 }
 
 void QgsMapRendererCache::clearCacheImage( const QString& layerId )
 {
   QMutexLocker lock( &mMutex );
 
-  mCachedImages.remove( layerId );
+  QString prefix = layerId + '|';
+  Q_FOREACH ( const QString& key, mCachedImages.keys() )
+  {
+    if ( key.startsWith( prefix ) )
+      mCachedImages.remove( key );
+  }
+  Q_FOREACH ( const QString& key, mDiskKeys )
+  {
+    if ( key.startsWith( prefix ) )
+      removeDiskImage( key );
+  }
+}
 
-  QgsMapLayer* layer = QgsMapLayerRegistry::instance()->mapLayer( layerId );
-  if ( layer )
+void QgsMapRendererCache::setMaximumMemory( qint64 bytes )
+{
+  QMutexLocker lock( &mMutex );
+  mCachedImages.setMaxCost( qMax( qint64( 1 ), bytes / 1024 ) );
+}
+
+qint64 QgsMapRendererCache::maximumMemory() const
+{
+  QMutexLocker lock( &mMutex );
+  return qint64( mCachedImages.maxCost() ) * 1024;
+}
+
+void QgsMapRendererCache::setCacheDirectory( const QString& path )
+{
+  QMutexLocker lock( &mMutex );
+  if ( path == mCacheDirectory )
+    return;
+
+  Q_FOREACH ( const QString& key, mDiskKeys )
+  {
+    QFile::remove( cacheFilePath( key ) );
+  }
+  mDiskKeys.clear();
+  mDiskImageSizes.clear();
+  mDiskSize = 0;
+
+  mCacheDirectory = path;
+  if ( mCacheDirectory.isEmpty() )
+    return;
+
+  QDir dir( mCacheDirectory );
+  if ( !dir.exists() && !dir.mkpath( "." ) )
+  {
+    QgsDebugMsg( QString( "Could not create map renderer cache directory %1" ).arg( mCacheDirectory ) );
+    mCacheDirectory.clear();
+    return;
+  }
+
+  // images left behind by a previous session can not be trusted anymore
+  Q_FOREACH ( const QString& fileName, dir.entryList( QStringList() << QString( "*%1" ).arg( DISK_IMAGE_SUFFIX ), QDir::Files ) )
+  {
+    dir.remove( fileName );
+  }
+}
+
+QString QgsMapRendererCache::cacheDirectory() const
+{
+  QMutexLocker lock( &mMutex );
+  return mCacheDirectory;
+}
+
+void QgsMapRendererCache::setMaximumDiskSize( qint64 bytes )
+{
+  QMutexLocker lock( &mMutex );
+  mMaximumDiskSize = bytes;
+  trimDiskCache();
+}
+
+qint64 QgsMapRendererCache::maximumDiskSize() const
+{
+  QMutexLocker lock( &mMutex );
+  return mMaximumDiskSize;
+}
+
+QString QgsMapRendererCache::cacheKey( const QString& layerId ) const
+{
+  return QString( "%1|%2|%3" ).arg( layerId, mExtent.toString( 16 ) ).arg( mScale, 0, 'g', 17 );
+}
+
+QString QgsMapRendererCache::cacheFilePath( const QString& key ) const
+{
+  QByteArray hash = QCryptographicHash::hash( key.toUtf8(), QCryptographicHash::Md5 ).toHex();
+  return QDir( mCacheDirectory ).filePath( QString::fromLatin1( hash ) + DISK_IMAGE_SUFFIX );
+}
+
+bool QgsMapRendererCache::writeDiskImage( const QString& key, const QImage& img )
+{
+  if ( mDiskImageSizes.contains( key ) )
+    removeDiskImage( key );
+
+  // images are stored uncompressed, writing them must not slow down the rendering
+  QImage image = img.format() == QImage::Format_ARGB32_Premultiplied ? img : img.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+
+  QFile file( cacheFilePath( key ) );
+  if ( !file.open( QIODevice::WriteOnly ) )
+  {
+    QgsDebugMsg( QString( "Could not write map renderer cache file %1" ).arg( file.fileName() ) );
+    return false;
+  }
+
+  QDataStream ds( &file );
+  ds << DISK_IMAGE_MAGIC << qint32( image.width() ) << qint32( image.height() )
+  << qint32( image.dotsPerMeterX() ) << qint32( image.dotsPerMeterY() );
+  int bytes = image.bytesPerLine() * image.height();
+  if ( ds.writeRawData( reinterpret_cast<const char*>( image.constBits() ), bytes ) != bytes )
+  {
+    file.close();
+    file.remove();
+    return false;
+  }
+  file.close();
+
+  mDiskKeys.append( key );
+  mDiskImageSizes.insert( key, file.size() );
+  mDiskSize += file.size();
+  trimDiskCache();
+  return true;
+}
+
+QImage QgsMapRendererCache::readDiskImage( const QString& key )
+{
+  QFile file( cacheFilePath( key ) );
+  if ( !file.open( QIODevice::ReadOnly ) )
+  {
+    removeDiskImage( key );
+    return QImage();
+  }
+
+  QDataStream ds( &file );
+  quint32 magic;
+  qint32 width, height, dpmX, dpmY;
+  ds >> magic >> width >> height >> dpmX >> dpmY;
+  if ( ds.status() != QDataStream::Ok || magic != DISK_IMAGE_MAGIC || width <= 0 || height <= 0 )
+  {
+    file.close();
+    removeDiskImage( key );
+    return QImage();
+  }
+
+  QImage image( width, height, QImage::Format_ARGB32_Premultiplied );
+  int bytes = image.bytesPerLine() * image.height();
+  if ( ds.readRawData( reinterpret_cast<char*>( image.bits() ), bytes ) != bytes )
+  {
+    file.close();
+    removeDiskImage( key );
+    return QImage();
+  }
+  image.setDotsPerMeterX( dpmX );
+  image.setDotsPerMeterY( dpmY );
+
+  // mark as most recently used
+  mDiskKeys.removeOne( key );
+  mDiskKeys.append( key );
+  return image;
+}
+
+void QgsMapRendererCache::removeDiskImage( const QString& key )
+{
+  QFile::remove( cacheFilePath( key ) );
+  mDiskKeys.removeOne( key );
+  mDiskSize -= mDiskImageSizes.take( key );
+}
+
+void QgsMapRendererCache::trimDiskCache()
+{
+  while ( mDiskSize > mMaximumDiskSize && !mDiskKeys.isEmpty() )
   {
-    disconnect( layer, SIGNAL( repaintRequested() ), this, SLOT( layerRequestedRepaint() ) );
+    removeDiskImage( mDiskKeys.first() );
   }
 }
@@ -16,11 +16,14 @@
 #ifndef QGSMAPRENDERERCACHE_H
 #define QGSMAPRENDERERCACHE_H
 
-#include <QMap>
+#include <QCache>
 #include <QImage>
 #include <QMutex>
+#include <QSet>
+#include <QStringList>
 
 #include "qgsrectangle.h"
+#include "qgslabelingcache.h"
 
 
 /**
@@ -28,7 +31,14 @@
  *
  * Once a layer has rendered image stored in the cache (using setCacheImage(...)),
  * the cache listens to repaintRequested() signals from layer. If triggered, the cache
- * removes the rendered image (and disconnects from the layer).
+ * removes all rendered images and label placements of the layer (and disconnects
+ * from the layer). Style changes and edits of the layer do the same.
+ *
+ * Images are kept for every map view (extent and scale) they were rendered for,
+ * so going back to a previously rendered view is served from the cache. The
+ * least recently used images are dropped once the memory budget is exceeded.
+ * Optionally the images are also written to a cache directory, which is used
+ * to restore images that have been dropped from memory.
  *
  * The class is thread-safe (multiple classes can access the same instance safely).
  *
@@ -40,11 +50,13 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
   public:
 
     QgsMapRendererCache();
+    ~QgsMapRendererCache();
 
     //! invalidate the cache contents
     void clear();
 
-    //! initialize cache: set new parameters and erase cache if parameters have changed
+    //! initialize cache: set the map view which following calls of setCacheImage() and cacheImage() refer to.
+    //! Images cached for other views are kept until they are evicted.
     //! @return flag whether the parameters are the same as last time
     bool init( const QgsRectangle& extent, double scale );
 
@@ -54,9 +66,51 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
     //! get cached image for the specified layer ID. Returns null image if it is not cached.
     QImage cacheImage( const QString& layerId );
 
-    //! remove layer from the cache
+    //! remove layer from the cache (images for all map views). Label placements of the layer are kept.
     void clearCacheImage( const QString& layerId );
 
+    /** Sets the maximum memory used by cached images in bytes. Least recently
+     * used images are removed from memory when the limit is exceeded.
+     * @note added in QGIS 2.14
+     */
+    void setMaximumMemory( qint64 bytes );
+
+    /** Returns the maximum memory used by cached images in bytes.
+     * @note added in QGIS 2.14
+     */
+    qint64 maximumMemory() const;
+
+    /** Sets the directory where cached images are stored in addition to the memory cache.
+     * An empty path disables the disk cache. Files written by the cache are removed
+     * when the cache is cleared or destroyed.
+     * @note added in QGIS 2.14
+     */
+    void setCacheDirectory( const QString& path );
+
+    /** Returns the directory where cached images are stored, or an empty string if the
+     * disk cache is disabled.
+     * @note added in QGIS 2.14
+     */
+    QString cacheDirectory() const;
+
+    /** Sets the maximum size of the disk cache in bytes.
+     * @note added in QGIS 2.14
+     */
+    void setMaximumDiskSize( qint64 bytes );
+
+    /** Returns the maximum size of the disk cache in bytes.
+     * @note added in QGIS 2.14
+     */
+    qint64 maximumDiskSize() const;
+
+    /** Returns the cache of label placements used by the labeling engine to keep labels
+     * in place when the map is panned. Placements of a layer are cleared when the layer requests
+     * a repaint, its style changes or it is edited, but not when its images are re-rendered.
+     * @note added in QGIS 2.14
+     * @note not available in Python bindings
+     */
+    QgsLabelingCache* labelingCache() { return &mLabelingCache; }
+
   protected slots:
     //! remove layer (that emitted the signal) from the cache
     void layerRequestedRepaint();
@@ -65,11 +119,33 @@ class CORE_EXPORT QgsMapRendererCache : public QObject
     //! invalidate cache contents (without locking)
     void clearInternal();
 
+  private:
+    //! returns cache key of the layer image for the current view
+    QString cacheKey( const QString& layerId ) const;
+    //! returns path of the disk cache file for a cache key
+    QString cacheFilePath( const QString& key ) const;
+    bool writeDiskImage( const QString& key, const QImage& img );
+    QImage readDiskImage( const QString& key );
+    void removeDiskImage( const QString& key );
+    void trimDiskCache();
+
   protected:
-    QMutex mMutex;
+    mutable QMutex mMutex;
     QgsRectangle mExtent;
     double mScale;
-    QMap<QString, QImage> mCachedImages;
+    //! in-memory images, key is layer ID + view, cost in bytes
+    QCache<QString, QImage> mCachedImages;
+    //! layers whose repaintRequested() signal is connected
+    QSet<QString> mConnectedLayers;
+
+    QString mCacheDirectory;
+    qint64 mMaximumDiskSize;
+    qint64 mDiskSize;
+    //! keys of images stored on disk, least recently used first
+    QStringList mDiskKeys;
+    QMap<QString, qint64> mDiskImageSizes;
+
+    QgsLabelingCache mLabelingCache;
 };
 
 
@@ -136,6 +136,7 @@ class CORE_EXPORT QgsMapSettings
       UseRenderingOptimization = 0x20, //!< Enable vector simplification and other rendering optimizations
       DrawSelection      = 0x40,  //!< Whether vector selections should be shown in the rendered map
       DrawSymbolBounds   = 0x80,  //!< Draw bounds of symbols (for debugging/testing)
+      ParallelFeatureRendering = 0x100, //!< Render the features of a single vector layer on multiple threads (added in QGIS 2.14)
       // TODO: ignore scale-based visibility (overview)
     };
     Q_DECLARE_FLAGS( Flags, Flag )
@@ -21,6 +21,7 @@
 #include <QVector>
 #include <QTransform>
 
+#include "qgscoordinatekernels.h"
 #include "qgslogger.h"
 
 QgsMapToPixel::QgsMapToPixel( double mapUnitsPerPixel,
@@ -333,6 +334,21 @@ void QgsMapToPixel::transformInPlace( float& x, float& y ) const
   x = mx; y = my;
 }
 
+void QgsMapToPixel::transformInPlace( QPolygonF& poly ) const
+{
+  if ( sizeof( qreal ) == sizeof( double ) )
+  {
+    QgsCoordinateKernels::transformInterleaved( mMatrix, reinterpret_cast<double*>( poly.data() ), poly.size() );
+    return;
+  }
+
+  QPointF* ptr = poly.data();
+  for ( int i = 0; i < poly.size(); ++i, ++ptr )
+  {
+    transformInPlace( ptr->rx(), ptr->ry() );
+  }
+}
+
 QTransform QgsMapToPixel::transform() const
 {
   // NOTE: operations are done in the reverse order in which
@@ -39,6 +39,50 @@ QgsRenderContext::QgsRenderContext()
   mVectorSimplifyMethod.setSimplifyHints( QgsVectorSimplifyMethod::NoSimplification );
 }
 
+QgsRenderContext::QgsRenderContext( const QgsRenderContext& rh )
+    : mFlags( rh.mFlags )
+    , mPainter( rh.mPainter )
+    , mCoordTransform( rh.mCoordTransform )
+    , mExtent( rh.mExtent )
+    , mMapToPixel( rh.mMapToPixel )
+    , mRenderingStopped( rh.mRenderingStopped )
+    , mScaleFactor( rh.mScaleFactor )
+    , mRasterScaleFactor( rh.mRasterScaleFactor )
+    , mRendererScale( rh.mRendererScale )
+    , mLabelingEngine( rh.mLabelingEngine )
+    , mLabelingEngine2( rh.mLabelingEngine2 )
+    , mSelectionColor( rh.mSelectionColor )
+    , mVectorSimplifyMethod( rh.mVectorSimplifyMethod )
+    , mExpressionContext( rh.mExpressionContext )
+    , mGeometry( rh.mGeometry )
+    , mFeatureFilterProvider( rh.mFeatureFilterProvider ? rh.mFeatureFilterProvider->clone() : 0 )
+{
+}
+
+QgsRenderContext& QgsRenderContext::operator=( const QgsRenderContext & rh )
+{
+  if ( &rh == this )
+    return *this;
+
+  mFlags = rh.mFlags;
+  mPainter = rh.mPainter;
+  mCoordTransform = rh.mCoordTransform;
+  mExtent = rh.mExtent;
+  mMapToPixel = rh.mMapToPixel;
+  mRenderingStopped = rh.mRenderingStopped;
+  mScaleFactor = rh.mScaleFactor;
+  mRasterScaleFactor = rh.mRasterScaleFactor;
+  mRendererScale = rh.mRendererScale;
+  mLabelingEngine = rh.mLabelingEngine;
+  mLabelingEngine2 = rh.mLabelingEngine2;
+  mSelectionColor = rh.mSelectionColor;
+  mVectorSimplifyMethod = rh.mVectorSimplifyMethod;
+  mExpressionContext = rh.mExpressionContext;
+  mGeometry = rh.mGeometry;
+  setFeatureFilterProvider( rh.mFeatureFilterProvider );
+  return *this;
+}
+
 QgsRenderContext::~QgsRenderContext()
 {
   delete mFeatureFilterProvider;
@@ -81,6 +125,7 @@ QgsRenderContext QgsRenderContext::fromMapSettings( const QgsMapSettings& mapSet
   ctx.setSelectionColor( mapSettings.selectionColor() );
   ctx.setFlag( DrawSelection, mapSettings.testFlag( QgsMapSettings::DrawSelection ) );
   ctx.setFlag( DrawSymbolBounds, mapSettings.testFlag( QgsMapSettings::DrawSymbolBounds ) );
+  ctx.setFlag( ParallelFeatureRendering, mapSettings.testFlag( QgsMapSettings::ParallelFeatureRendering ) );
   ctx.setRasterScaleFactor( 1.0 );
   ctx.setScaleFactor( mapSettings.outputDpi() / 25.4 ); // = pixels per mm
   ctx.setRendererScale( mapSettings.scale() );
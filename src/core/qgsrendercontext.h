@@ -45,6 +45,8 @@ class CORE_EXPORT QgsRenderContext
 {
   public:
     QgsRenderContext();
+    QgsRenderContext( const QgsRenderContext& rh );
+    QgsRenderContext& operator=( const QgsRenderContext& rh );
     ~QgsRenderContext();
 
     /** Enumeration of flags that affect rendering operations.
@@ -58,6 +60,7 @@ class CORE_EXPORT QgsRenderContext
       UseRenderingOptimization = 0x08, //!< Enable vector simplification and other rendering optimizations
       DrawSelection      = 0x10,  //!< Whether vector selections should be shown in the rendered map
       DrawSymbolBounds   = 0x20,  //!< Draw bounds of symbols (for debugging/testing)
+      ParallelFeatureRendering = 0x40, //!< Render the features of a single vector layer on multiple threads (added in QGIS 2.14)
     };
     Q_DECLARE_FLAGS( Flags, Flag )
 
@@ -193,7 +196,9 @@ class CORE_EXPORT QgsRenderContext
      */
     const QgsExpressionContext& expressionContext() const { return mExpressionContext; }
 
-    /** Returns pointer to the unsegmentized geometry*/
+    /** Returns pointer to the unsegmentized geometry. While rendering features, this is only
+     * set for curved geometries (it is 0 for points, line strings and polygons).
+     */
     const QgsAbstractGeometryV2* geometry() const { return mGeometry; }
     /** Sets pointer to original (unsegmentized) geometry*/
     void setGeometry( const QgsAbstractGeometryV2* geometry ) { mGeometry = geometry; }
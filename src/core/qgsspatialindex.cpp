@@ -1,5 +1,5 @@
 /***************************************************************************
-    qgsspatialindex.cpp  - wrapper class for spatial index library
+    qgsspatialindex.cpp  - packed in-memory R-tree
     ----------------------
     begin                : December 2006
     copyright            : (C) 2006 by Martin Dobias
@@ -21,178 +21,500 @@
 #include "qgsrectangle.h"
 #include "qgslogger.h"
 
-#include "SpatialIndex.h"
+#include <QDataStream>
+#include <QVarLengthArray>
 
-using namespace SpatialIndex;
+#include <cmath>
+#include <queue>
+#include <vector>
 
+//! maximum number of children of a tree node
+static const int NODE_SIZE = 16;
+//! maximum number of inserted entries kept outside of the packed trees
+static const int MAX_PENDING_ENTRIES = 64;
+//! maximum number of entries reserved in advance when reading an index from a stream
+static const quint32 MAX_STREAM_RESERVE = 65536;
+//! identifies the binary form of the index
+static const quint32 STREAM_MAGIC = 0x51534958; // "QSIX"
+static const quint32 STREAM_VERSION = 1;
 
+/// @cond PRIVATE
 
-// custom visitor that adds found features to list
-class QgisVisitor : public SpatialIndex::IVisitor
+//! Bounding box and feature ID of an index entry
+struct QgsSpatialIndexEntry
 {
-  public:
-    explicit QgisVisitor( QList<QgsFeatureId> & list )
-        : mList( list ) {}
+  double xMin, yMin, xMax, yMax;
+  QgsFeatureId id;
+};
 
-    void visitNode( const INode& n ) override
-      { Q_UNUSED( n ); }
+struct QgsSpatialIndexCenterXLessThan
+{
+  bool operator()( const QgsSpatialIndexEntry& e1, const QgsSpatialIndexEntry& e2 ) const
+  {
+    return e1.xMin + e1.xMax < e2.xMin + e2.xMax;
+  }
+};
 
-    void visitData( const IData& d ) override
-    {
-      mList.append( d.getIdentifier() );
-    }
+struct QgsSpatialIndexCenterYLessThan
+{
+  bool operator()( const QgsSpatialIndexEntry& e1, const QgsSpatialIndexEntry& e2 ) const
+  {
+    return e1.yMin + e1.yMax < e2.yMin + e2.yMax;
+  }
+};
 
-    void visitData( std::vector<const IData*>& v ) override
-      { Q_UNUSED( v ); }
+//! Candidate of the nearest neighbor search: a tree node, a packed item or a pending entry
+struct QgsSpatialIndexCandidate
+{
+  QgsSpatialIndexCandidate( double dist, int t, int i ) : distance( dist ), tree( t ), index( i ) {}
 
-  private:
-    QList<QgsFeatureId>& mList;
+  double distance;
+  //! index of the packed tree, -1 for a pending entry
+  int tree;
+  int index;
+
+  //! reversed for std::priority_queue to return the closest candidate first
+  bool operator<( const QgsSpatialIndexCandidate& other ) const { return distance > other.distance; }
 };
 
-class QgsSpatialIndexCopyVisitor : public SpatialIndex::IVisitor
+/** Packed R-tree which is built at once from entries in tree order. Items may be flagged
+ * as deleted, but not added.
+ */
+class QgsSpatialIndexTree
 {
   public:
-    explicit QgsSpatialIndexCopyVisitor( SpatialIndex::ISpatialIndex* newIndex )
-        : mNewIndex( newIndex ) {}
+    QgsSpatialIndexTree()
+        : mItemCount( 0 )
+        , mDeletedCount( 0 )
+    {}
+
+    //! number of items which are not flagged as deleted
+    int liveCount() const { return mItemCount - mDeletedCount; }
 
-    void visitNode( const INode& n ) override
-      { Q_UNUSED( n ); }
+    //! true if more than half of the items are flagged as deleted
+    bool needsRebuild() const { return mDeletedCount > mItemCount / 2; }
 
-    void visitData( const IData& d ) override
+    bool remove( const QgsRectangle& r, QgsFeatureId id )
     {
-      SpatialIndex::IShape* shape;
-      d.getShape( &shape );
-      mNewIndex->insertData( 0, 0, *shape, d.getIdentifier() );
-      delete shape;
+      if ( mItemCount == 0 )
+        return false;
+
+      QVarLengthArray<int, 64> stack;
+      stack.append( rootNode() );
+      while ( stack.count() )
+      {
+        int node = stack.last();
+        stack.removeLast();
+        int end = childrenEnd( node );
+        for ( int child = static_cast<int>( mIndices.at( node ) ); child < end; ++child )
+        {
+          if ( !boxIntersects( child, r.xMinimum(), r.yMinimum(), r.xMaximum(), r.yMaximum() ) )
+            continue;
+
+          if ( child >= mItemCount )
+            stack.append( child );
+          else if ( mIndices.at( child ) == id && !mDeleted.at( child ) )
+          {
+            mDeleted[child] = true;
+            ++mDeletedCount;
+            return true;
+          }
+        }
+      }
+      return false;
     }
 
-    void visitData( std::vector<const IData*>& v ) override
-      { Q_UNUSED( v ); }
+    void intersects( double xMin, double yMin, double xMax, double yMax, QList<QgsFeatureId>& list ) const
+    {
+      if ( mItemCount == 0 )
+        return;
+
+      QVarLengthArray<int, 64> stack;
+      stack.append( rootNode() );
+      const bool* deleted = mDeleted.constData();
+      const qint64* indices = mIndices.constData();
+      while ( stack.count() )
+      {
+        int node = stack.last();
+        stack.removeLast();
 
-  private:
-    SpatialIndex::ISpatialIndex* mNewIndex;
-};
+        int first = static_cast<int>( indices[node] );
+        int end = childrenEnd( node );
+        if ( first < mItemCount )
+        {
+          for ( int child = first; child < end; ++child )
+          {
+            if ( !deleted[child] && boxIntersects( child, xMin, yMin, xMax, yMax ) )
+              list.append( indices[child] );
+          }
+        }
+        else
+        {
+          for ( int child = first; child < end; ++child )
+          {
+            if ( boxIntersects( child, xMin, yMin, xMax, yMax ) )
+              stack.append( child );
+          }
+        }
+      }
+    }
 
+    //! returns the live entries in tree order
+    QVector<QgsSpatialIndexEntry> entries() const
+    {
+      QVector<QgsSpatialIndexEntry> result;
+      result.reserve( liveCount() );
+      for ( int i = 0; i < mItemCount; ++i )
+      {
+        if ( mDeleted.at( i ) )
+          continue;
+        QgsSpatialIndexEntry e;
+        e.xMin = mBoxes.at( 4 * i );
+        e.yMin = mBoxes.at( 4 * i + 1 );
+        e.xMax = mBoxes.at( 4 * i + 2 );
+        e.yMax = mBoxes.at( 4 * i + 3 );
+        e.id = mIndices.at( i );
+        result.append( e );
+      }
+      return result;
+    }
 
-/** Utility class for bulk loading of R-trees. Not a part of public API. */
-class QgsFeatureIteratorDataStream : public IDataStream
-{
-  public:
-    //! constructor - needs to load all data to a vector for later access when bulk loading
-    explicit QgsFeatureIteratorDataStream( const QgsFeatureIterator& fi )
-        : mFi( fi )
-        , mNextData( 0 )
+    /** Builds the packed tree from entries which are already in tree order.
+     * Nodes are created by grouping NODE_SIZE consecutive entries of the level below.
+     */
+    void build( const QVector<QgsSpatialIndexEntry>& entries )
+    {
+      mItemCount = entries.count();
+      mDeletedCount = 0;
+      mDeleted = QVector<bool>( mItemCount, false );
+      mLevelBounds.clear();
+      mBoxes.clear();
+      mIndices.clear();
+      if ( mItemCount == 0 )
+        return;
+
+      // the number of nodes is below n / ( NODE_SIZE - 1 ) + levels
+      int capacity = mItemCount + mItemCount / ( NODE_SIZE - 1 ) + 32;
+      mBoxes.reserve( 4 * capacity );
+      mIndices.reserve( capacity );
+      Q_FOREACH ( const QgsSpatialIndexEntry& e, entries )
+      {
+        mBoxes << e.xMin << e.yMin << e.xMax << e.yMax;
+        mIndices << e.id;
+      }
+      mLevelBounds << mItemCount;
+
+      int levelStart = 0;
+      int levelEnd = mItemCount;
+      do
+      {
+        for ( int first = levelStart; first < levelEnd; first += NODE_SIZE )
+        {
+          int end = qMin( first + NODE_SIZE, levelEnd );
+          double xMin = mBoxes.at( 4 * first ), yMin = mBoxes.at( 4 * first + 1 );
+          double xMax = mBoxes.at( 4 * first + 2 ), yMax = mBoxes.at( 4 * first + 3 );
+          for ( int child = first + 1; child < end; ++child )
+          {
+            xMin = qMin( xMin, mBoxes.at( 4 * child ) );
+            yMin = qMin( yMin, mBoxes.at( 4 * child + 1 ) );
+            xMax = qMax( xMax, mBoxes.at( 4 * child + 2 ) );
+            yMax = qMax( yMax, mBoxes.at( 4 * child + 3 ) );
+          }
+          mBoxes << xMin << yMin << xMax << yMax;
+          mIndices << first;
+        }
+        levelStart = levelEnd;
+        levelEnd = mIndices.count();
+        mLevelBounds << levelEnd;
+      }
+      while ( levelEnd - levelStart > 1 );
+    }
+
+    int rootNode() const { return mIndices.count() - 1; }
+
+    //! returns end of the children range of a node: children never cross the end of their level
+    int childrenEnd( int node ) const
+    {
+      int first = static_cast<int>( mIndices.at( node ) );
+      int levelEnd = *qUpperBound( mLevelBounds.constBegin(), mLevelBounds.constEnd(), first );
+      return qMin( first + NODE_SIZE, levelEnd );
+    }
+
+    bool boxIntersects( int i, double xMin, double yMin, double xMax, double yMax ) const
     {
-      readNextEntry();
+      const double* b = mBoxes.constData() + 4 * i;
+      return b[0] <= xMax && b[1] <= yMax && b[2] >= xMin && b[3] >= yMin;
     }
 
-    ~QgsFeatureIteratorDataStream()
+    double boxDistance( int i, double x, double y ) const
     {
-      delete mNextData;
+      const double* b = mBoxes.constData() + 4 * i;
+      return distance( b[0], b[1], b[2], b[3], x, y );
     }
 
-    //! returns a pointer to the next entry in the stream or 0 at the end of the stream.
-    virtual IData* getNext() override
+    static double distance( double xMin, double yMin, double xMax, double yMax, double x, double y )
     {
-      RTree::Data* ret = mNextData;
-      mNextData = 0;
-      readNextEntry();
-      return ret;
+      double dx = x < xMin ? xMin - x : ( x > xMax ? x - xMax : 0.0 );
+      double dy = y < yMin ? yMin - y : ( y > yMax ? y - yMax : 0.0 );
+      return std::sqrt( dx * dx + dy * dy );
     }
 
-    //! returns true if there are more items in the stream.
-    virtual bool hasNext() override { return mNextData != 0; }
+    //! number of items (feature entries) at the start of the packed arrays
+    int mItemCount;
+    //! number of packed items flagged as deleted
+    int mDeletedCount;
+    //! bounding boxes of items followed by tree nodes (xmin, ymin, xmax, ymax)
+    QVector<double> mBoxes;
+    //! feature ID for items, index of the first child for nodes
+    QVector<qint64> mIndices;
+    //! deletion flags of packed items
+    QVector<bool> mDeleted;
+    //! end index of each level of the packed arrays, starting at the items
+    QVector<int> mLevelBounds;
+};
 
-    //! returns the total number of entries available in the stream.
-    virtual uint32_t size() override { Q_ASSERT( 0 && "not available" ); return 0; }
+/// @endcond
 
-    //! sets the stream pointer to the first entry, if possible.
-    virtual void rewind() override { Q_ASSERT( 0 && "not available" ); }
 
-  protected:
-    void readNextEntry()
+/** Data of spatial index that may be implicitly shared.
+ *
+ * Entries are kept in a few packed trees of decreasing size. Inserted entries are collected
+ * in a small buffer, which is packed into a new tree when it is full. Trees of similar size
+ * are merged, so there are only logarithmically many of them and queries never scan more
+ * than MAX_PENDING_ENTRIES entries linearly.
+ */
+class QgsSpatialIndexData : public QSharedData
+{
+  public:
+    QgsSpatialIndexData()
+    {
+    }
+
+    explicit QgsSpatialIndexData( const QgsFeatureIterator& fi )
     {
+      QVector<QgsSpatialIndexEntry> entries;
+      QgsFeatureIterator it( fi );
       QgsFeature f;
-      SpatialIndex::Region r;
+      QgsRectangle r;
       QgsFeatureId id;
-      while ( mFi.nextFeature( f ) )
+      while ( it.nextFeature( f ) )
       {
         if ( QgsSpatialIndex::featureInfo( f, r, id ) )
+          entries.append( makeEntry( r, id ) );
+      }
+
+      addTree( entries );
+    }
+
+    // default copy constructor shares the implicitly shared arrays
+
+    void insert( const QgsRectangle& r, QgsFeatureId id )
+    {
+      mPending.append( makeEntry( r, id ) );
+      if ( mPending.count() > MAX_PENDING_ENTRIES )
+        packPending();
+    }
+
+    bool remove( const QgsRectangle& r, QgsFeatureId id )
+    {
+      for ( int i = 0; i < mPending.count(); ++i )
+      {
+        if ( mPending.at( i ).id == id )
+        {
+          mPending.remove( i );
+          return true;
+        }
+      }
+
+      for ( int t = 0; t < mTrees.count(); ++t )
+      {
+        if ( !mTrees[t].remove( r, id ) )
+          continue;
+
+        if ( mTrees.at( t ).needsRebuild() )
         {
-          mNextData = new RTree::Data( 0, 0, r, id );
-          return;
+          QVector<QgsSpatialIndexEntry> live = mTrees.at( t ).entries();
+          mTrees.remove( t );
+          addTree( live );
         }
+        return true;
       }
+      return false;
     }
 
-  private:
-    QgsFeatureIterator mFi;
-    RTree::Data* mNextData;
-};
+    void intersects( const QgsRectangle& r, QList<QgsFeatureId>& list ) const
+    {
+      double xMin = r.xMinimum(), yMin = r.yMinimum(), xMax = r.xMaximum(), yMax = r.yMaximum();
 
+      Q_FOREACH ( const QgsSpatialIndexTree& tree, mTrees )
+        tree.intersects( xMin, yMin, xMax, yMax, list );
 
-/** Data of spatial index that may be implicitly shared */
-class QgsSpatialIndexData : public QSharedData
-{
-  public:
-    QgsSpatialIndexData()
+      Q_FOREACH ( const QgsSpatialIndexEntry& e, mPending )
+      {
+        if ( e.xMin <= xMax && e.yMin <= yMax && e.xMax >= xMin && e.yMax >= yMin )
+          list.append( e.id );
+      }
+    }
+
+    void nearestNeighbor( const QgsPoint& point, int neighbors, QList<QgsFeatureId>& list ) const
+    {
+      double x = point.x(), y = point.y();
+      std::priority_queue<QgsSpatialIndexCandidate> queue;
+
+      for ( int t = 0; t < mTrees.count(); ++t )
+      {
+        const QgsSpatialIndexTree& tree = mTrees.at( t );
+        if ( tree.mItemCount > 0 )
+          queue.push( QgsSpatialIndexCandidate( tree.boxDistance( tree.rootNode(), x, y ), t, tree.rootNode() ) );
+      }
+      for ( int i = 0; i < mPending.count(); ++i )
+      {
+        const QgsSpatialIndexEntry& e = mPending.at( i );
+        queue.push( QgsSpatialIndexCandidate( QgsSpatialIndexTree::distance( e.xMin, e.yMin, e.xMax, e.yMax, x, y ), -1, i ) );
+      }
+
+      int count = 0;
+      double lastDistance = 0.0;
+      while ( !queue.empty() )
+      {
+        QgsSpatialIndexCandidate c = queue.top();
+        // report all neighbors with the same distance as the last one
+        if ( count >= neighbors && c.distance > lastDistance )
+          break;
+        queue.pop();
+
+        if ( c.tree < 0 )
+        {
+          list.append( mPending.at( c.index ).id );
+          ++count;
+          lastDistance = c.distance;
+          continue;
+        }
+
+        const QgsSpatialIndexTree& tree = mTrees.at( c.tree );
+        if ( c.index < tree.mItemCount )
+        {
+          list.append( tree.mIndices.at( c.index ) );
+          ++count;
+          lastDistance = c.distance;
+        }
+        else
+        {
+          int end = tree.childrenEnd( c.index );
+          for ( int child = static_cast<int>( tree.mIndices.at( c.index ) ); child < end; ++child )
+          {
+            if ( child < tree.mItemCount && tree.mDeleted.at( child ) )
+              continue;
+            queue.push( QgsSpatialIndexCandidate( tree.boxDistance( child, x, y ), c.tree, child ) );
+          }
+        }
+      }
+    }
+
+    //! number of live entries of the largest tree, which come first in entries()
+    int largestTreeCount() const
     {
-      initTree();
+      return mTrees.isEmpty() ? 0 : mTrees.first().liveCount();
     }
 
-    explicit QgsSpatialIndexData( const QgsFeatureIterator& fi )
+    //! returns all live entries, trees in tree order followed by pending entries
+    QVector<QgsSpatialIndexEntry> entries() const
+    {
+      QVector<QgsSpatialIndexEntry> result;
+      Q_FOREACH ( const QgsSpatialIndexTree& tree, mTrees )
+        result += tree.entries();
+      result += mPending;
+      return result;
+    }
+
+    /** Adds a tree of entries which are already in tree order, e.g. the largest tree
+     * read from a stream. Must only be called on an empty index.
+     */
+    void addPackedTree( const QVector<QgsSpatialIndexEntry>& entries )
+    {
+      if ( entries.isEmpty() )
+        return;
+
+      QgsSpatialIndexTree tree;
+      tree.build( entries );
+      mTrees.append( tree );
+    }
+
+    //! Inserts entries, packing them into a tree unless they fit into the buffer
+    void insertEntries( const QVector<QgsSpatialIndexEntry>& entries )
     {
-      QgsFeatureIteratorDataStream fids( fi );
-      initTree( &fids );
+      mPending += entries;
+      if ( mPending.count() > MAX_PENDING_ENTRIES )
+        packPending();
     }
 
-    QgsSpatialIndexData( const QgsSpatialIndexData& other )
-        : QSharedData( other )
+  private:
+
+    /** Packs the buffered entries into a new tree, together with all trees which are
+     * smaller than twice the number of new entries.
+     */
+    void packPending()
     {
-      initTree();
-
-      // copy R-tree data one by one (is there a faster way??)
-      double low[]  = { DBL_MIN, DBL_MIN };
-      double high[] = { DBL_MAX, DBL_MAX };
-      SpatialIndex::Region query( low, high, 2 );
-      QgsSpatialIndexCopyVisitor visitor( mRTree );
-      other.mRTree->intersectsWithQuery( query, visitor );
+      QVector<QgsSpatialIndexEntry> entries = mPending;
+      mPending.clear();
+      while ( !mTrees.isEmpty() && mTrees.last().liveCount() <= 2 * entries.count() )
+      {
+        entries += mTrees.last().entries();
+        mTrees.remove( mTrees.count() - 1 );
+      }
+      addTree( entries );
     }
 
-    ~QgsSpatialIndexData()
+    //! Sorts entries and adds them as a new tree, keeping the trees ordered by decreasing size
+    void addTree( QVector<QgsSpatialIndexEntry> entries )
     {
-      delete mRTree;
-      delete mStorage;
+      if ( entries.isEmpty() )
+        return;
+
+      sortTileRecursive( entries );
+      QgsSpatialIndexTree tree;
+      tree.build( entries );
+
+      int pos = mTrees.count();
+      while ( pos > 0 && mTrees.at( pos - 1 ).liveCount() < tree.liveCount() )
+        --pos;
+      mTrees.insert( pos, tree );
     }
 
-    void initTree( IDataStream* inputStream = 0 )
+    //! Sorts entries into sort-tile-recursive order: vertical slices sorted by x, each sorted by y
+    static void sortTileRecursive( QVector<QgsSpatialIndexEntry>& entries )
     {
-      // for now only memory manager
-      mStorage = StorageManager::createNewMemoryStorageManager();
-
-      // R-Tree parameters
-      double fillFactor = 0.7;
-      unsigned long indexCapacity = 10;
-      unsigned long leafCapacity = 10;
-      unsigned long dimension = 2;
-      RTree::RTreeVariant variant = RTree::RV_RSTAR;
-
-      // create R-tree
-      SpatialIndex::id_type indexId;
-
-      if ( inputStream )
-        mRTree = RTree::createAndBulkLoadNewRTree( RTree::BLM_STR, *inputStream, *mStorage, fillFactor, indexCapacity,
-                 leafCapacity, dimension, variant, indexId );
-      else
-        mRTree = RTree::createNewRTree( *mStorage, fillFactor, indexCapacity,
-                                        leafCapacity, dimension, variant, indexId );
+      int count = entries.count();
+      if ( count <= NODE_SIZE )
+        return;
+
+      int leafCount = ( count + NODE_SIZE - 1 ) / NODE_SIZE;
+      int sliceCount = static_cast<int>( std::ceil( std::sqrt( static_cast<double>( leafCount ) ) ) );
+      int sliceSize = NODE_SIZE * ( ( leafCount + sliceCount - 1 ) / sliceCount );
+
+      qSort( entries.begin(), entries.end(), QgsSpatialIndexCenterXLessThan() );
+      for ( int start = 0; start < count; start += sliceSize )
+      {
+        QVector<QgsSpatialIndexEntry>::iterator end = entries.begin() + qMin( start + sliceSize, count );
+        qSort( entries.begin() + start, end, QgsSpatialIndexCenterYLessThan() );
+      }
     }
 
-    /** Storage manager */
-    SpatialIndex::IStorageManager* mStorage;
+    static QgsSpatialIndexEntry makeEntry( const QgsRectangle& r, QgsFeatureId id )
+    {
+      QgsSpatialIndexEntry e;
+      e.xMin = r.xMinimum();
+      e.yMin = r.yMinimum();
+      e.xMax = r.xMaximum();
+      e.yMax = r.yMaximum();
+      e.id = id;
+      return e;
+    }
 
-    /** R-tree containing spatial index */
-    SpatialIndex::ISpatialIndex* mRTree;
+    //! packed trees, ordered by decreasing number of live entries
+    QVector<QgsSpatialIndexTree> mTrees;
+    //! inserted entries which are not part of a packed tree yet
+    QVector<QgsSpatialIndexEntry> mPending;
 };
 
 // -------------------------------------------------------------------------
@@ -224,95 +546,49 @@ QgsSpatialIndex& QgsSpatialIndex::operator=( const QgsSpatialIndex & other )
   return *this;
 }
 
-Region QgsSpatialIndex::rectToRegion( const QgsRectangle& rect )
-{
-  double pt1[2], pt2[2];
-  pt1[0] = rect.xMinimum();
-  pt1[1] = rect.yMinimum();
-  pt2[0] = rect.xMaximum();
-  pt2[1] = rect.yMaximum();
-  return Region( pt1, pt2, 2 );
-}
-
-bool QgsSpatialIndex::featureInfo( const QgsFeature& f, SpatialIndex::Region& r, QgsFeatureId &id )
+bool QgsSpatialIndex::featureInfo( const QgsFeature& f, QgsRectangle& rect, QgsFeatureId &id )
 {
   if ( !f.constGeometry() )
     return false;
 
-  QgsGeometry g( *f.constGeometry() );
-
   id = f.id();
-  r = rectToRegion( g.boundingBox() );
+  rect = f.constGeometry()->boundingBox();
   return true;
 }
 
 
 bool QgsSpatialIndex::insertFeature( const QgsFeature& f )
 {
-  Region r;
+  QgsRectangle r;
   QgsFeatureId id;
   if ( !featureInfo( f, r, id ) )
     return false;
 
-  // TODO: handle possible exceptions correctly
-  try
-  {
-    d->mRTree->insertData( 0, 0, r, FID_TO_NUMBER( id ) );
-    return true;
-  }
-  catch ( Tools::Exception &e )
-  {
-    Q_UNUSED( e );
-    QgsDebugMsg( QString( "Tools::Exception caught: " ).arg( e.what().c_str() ) );
-  }
-  catch ( const std::exception &e )
-  {
-    Q_UNUSED( e );
-    QgsDebugMsg( QString( "std::exception caught: " ).arg( e.what() ) );
-  }
-  catch ( ... )
-  {
-    QgsDebugMsg( "unknown spatial index exception caught" );
-  }
-
-  return false;
+  d->insert( r, FID_TO_NUMBER( id ) );
+  return true;
 }
 
 bool QgsSpatialIndex::deleteFeature( const QgsFeature& f )
 {
-  Region r;
+  QgsRectangle r;
   QgsFeatureId id;
   if ( !featureInfo( f, r, id ) )
     return false;
 
-  // TODO: handle exceptions
-  return d->mRTree->deleteData( r, FID_TO_NUMBER( id ) );
+  return d->remove( r, FID_TO_NUMBER( id ) );
 }
 
 QList<QgsFeatureId> QgsSpatialIndex::intersects( const QgsRectangle& rect ) const
 {
   QList<QgsFeatureId> list;
-  QgisVisitor visitor( list );
-
-  Region r = rectToRegion( rect );
-
-  d->mRTree->intersectsWithQuery( r, visitor );
-
+  d->intersects( rect, list );
   return list;
 }
 
 QList<QgsFeatureId> QgsSpatialIndex::nearestNeighbor( const QgsPoint& point, int neighbors ) const
 {
   QList<QgsFeatureId> list;
-  QgisVisitor visitor( list );
-
-  double pt[2];
-  pt[0] = point.x();
-  pt[1] = point.y();
-  Point p( pt, 2 );
-
-  d->mRTree->nearestNeighborQuery( neighbors, p, visitor );
-
+  d->nearestNeighbor( point, neighbors, list );
   return list;
 }
 
@@ -320,3 +596,46 @@ QAtomicInt QgsSpatialIndex::refs() const
 {
   return d->ref;
 }
+
+QDataStream& operator<<( QDataStream& out, const QgsSpatialIndex& index )
+{
+  // entries of the largest tree are written in tree order, followed by the other ones
+  QVector<QgsSpatialIndexEntry> entries = index.d->entries();
+  quint32 packedCount = index.d->largestTreeCount();
+  out << STREAM_MAGIC << STREAM_VERSION << packedCount << static_cast<quint32>( entries.count() );
+  Q_FOREACH ( const QgsSpatialIndexEntry& e, entries )
+  {
+    out << e.xMin << e.yMin << e.xMax << e.yMax << e.id;
+  }
+  return out;
+}
+
+QDataStream& operator>>( QDataStream& in, QgsSpatialIndex& index )
+{
+  quint32 magic, version, packedCount, count;
+  in >> magic >> version >> packedCount >> count;
+  if ( in.status() != QDataStream::Ok || magic != STREAM_MAGIC || version != STREAM_VERSION || packedCount > count )
+  {
+    in.setStatus( QDataStream::ReadCorruptData );
+    return in;
+  }
+
+  // the count is not trusted, beyond the reserved size the vector grows as entries are read
+  QVector<QgsSpatialIndexEntry> entries;
+  entries.reserve( qMin( count, MAX_STREAM_RESERVE ) );
+  for ( quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i )
+  {
+    QgsSpatialIndexEntry e;
+    in >> e.xMin >> e.yMin >> e.xMax >> e.yMax >> e.id;
+    entries.append( e );
+  }
+  if ( in.status() != QDataStream::Ok )
+    return in;
+
+  // the largest tree is already in tree order, so only its upper levels need to be built
+  QgsSpatialIndex result;
+  result.d->addPackedTree( entries.mid( 0, packedCount ) );
+  result.d->insertEntries( entries.mid( packedCount ) );
+  index = result;
+  return in;
+}
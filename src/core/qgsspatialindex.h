@@ -1,5 +1,5 @@
 /***************************************************************************
-    qgsspatialindex.h  - wrapper class for spatial index library
+    qgsspatialindex.h  - packed in-memory R-tree
     ----------------------
     begin                : December 2006
     copyright            : (C) 2006 by Martin Dobias
@@ -16,20 +16,6 @@
 #ifndef QGSSPATIALINDEX_H
 #define QGSSPATIALINDEX_H
 
-// forward declaration
-namespace SpatialIndex
-{
-  class IStorageManager;
-  class ISpatialIndex;
-  class Region;
-  class Point;
-
-  namespace StorageManager
-  {
-    class IBuffer;
-  }
-}
-
 class QgsFeature;
 class QgsRectangle;
 class QgsPoint;
@@ -42,6 +28,17 @@ class QgsPoint;
 class QgsSpatialIndexData;
 class QgsFeatureIterator;
 
+/** \ingroup core
+ * In-memory R-tree of feature bounding boxes.
+ *
+ * Entries are kept in a packed tree built with the sort-tile-recursive (STR)
+ * algorithm: the bounding boxes of all nodes are stored in contiguous arrays,
+ * level by level. Inserted features are collected in a small buffer which is
+ * merged into the packed tree once it grows, deleted features are flagged and
+ * dropped with the next rebuild.
+ *
+ * The index is implicitly shared, copies are cheap until one of them is modified.
+ */
 class CORE_EXPORT QgsSpatialIndex
 {
 
@@ -82,7 +79,10 @@ class CORE_EXPORT QgsSpatialIndex
     /** Returns features that intersect the specified rectangle */
     QList<QgsFeatureId> intersects( const QgsRectangle& rect ) const;
 
-    /** Returns nearest neighbors (their count is specified by second parameter) */
+    /** Returns nearest neighbors (their count is specified by second parameter).
+     * Features are ordered by distance of their bounding box from the point. If
+     * several features share the distance of the last neighbor, all of them are returned.
+     */
     QList<QgsFeatureId> nearestNeighbor( const QgsPoint& point, int neighbors ) const;
 
     /* debugging */
@@ -92,11 +92,11 @@ class CORE_EXPORT QgsSpatialIndex
 
   protected:
     // @note not available in python bindings
-    static SpatialIndex::Region rectToRegion( const QgsRectangle& rect );
-    // @note not available in python bindings
-    static bool featureInfo( const QgsFeature& f, SpatialIndex::Region& r, QgsFeatureId &id );
+    static bool featureInfo( const QgsFeature& f, QgsRectangle& rect, QgsFeatureId &id );
 
-    friend class QgsFeatureIteratorDataStream; // for access to featureInfo()
+    friend class QgsSpatialIndexData; // for access to featureInfo()
+    friend QDataStream& operator<<( QDataStream& out, const QgsSpatialIndex& index );
+    friend QDataStream& operator>>( QDataStream& in, QgsSpatialIndex& index );
 
   private:
 
@@ -104,5 +104,14 @@ class CORE_EXPORT QgsSpatialIndex
 
 };
 
+/** Writes the index to stream out in a binary form. QGIS version compatibility is not guaranteed.
+ * @note added in QGIS 2.14
+ */
+CORE_EXPORT QDataStream& operator<<( QDataStream& out, const QgsSpatialIndex& index );
+/** Reads an index from stream in into index. QGIS version compatibility is not guaranteed.
+ * @note added in QGIS 2.14
+ */
+CORE_EXPORT QDataStream& operator>>( QDataStream& in, QgsSpatialIndex& index );
+
 #endif
 
@@ -37,6 +37,8 @@
 #include <QTextStream>
 #include <QSet>
 #include <QMetaType>
+#include <QThread>
+#include <QtConcurrentMap>
 
 #include <cassert>
 #include <cstdlib> // size_t
@@ -54,6 +56,46 @@
 #define TO8F(x)  QFile::encodeName( x ).constData()
 #endif
 
+/// @cond
+
+// number of features read from the source before their geometries are transformed and written
+static const int FEATURE_BATCH_SIZE = 1000;
+
+// transforms the geometries of a range of features of a batch with a transform of its own,
+// as the proj objects of a transform must not be used by several threads at the same time
+struct QgsVectorFileWriterTransformTask
+{
+  QgsFeature* features;
+  int count;
+  const QgsCoordinateTransform* ct;
+  //! index of the first feature which failed to transform or -1
+  int failedIndex;
+  QString error;
+};
+
+static void transformFeatures( QgsVectorFileWriterTransformTask& task )
+{
+  for ( int i = 0; i < task.count; ++i )
+  {
+    QgsGeometry* geom = task.features[i].geometry();
+    if ( !geom )
+      continue;
+
+    try
+    {
+      geom->transform( *task.ct );
+    }
+    catch ( QgsCsException &e )
+    {
+      task.failedIndex = i;
+      task.error = e.what();
+      return;
+    }
+  }
+}
+
+/// @endcond
+
 
 QgsVectorFileWriter::QgsVectorFileWriter(
   const QString &theVectorFileName,
@@ -1848,7 +1890,8 @@ QgsVectorFileWriter::writeAsVectorFormat( QgsVectorLayer* layer,
     QString *newFilename,
     SymbologyExport symbologyExport,
     double symbologyScale,
-    const QgsRectangle* filterExtent )
+    const QgsRectangle* filterExtent,
+    int transactionSize )
 {
   QgsCoordinateTransform* ct = 0;
   if ( destCRS && layer )
@@ -1857,7 +1900,8 @@ QgsVectorFileWriter::writeAsVectorFormat( QgsVectorLayer* layer,
   }
 
   QgsVectorFileWriter::WriterError error = writeAsVectorFormat( layer, fileName, fileEncoding, ct, driverName, onlySelected,
-      errorMessage, datasourceOptions, layerOptions, skipAttributeCreation, newFilename, symbologyExport, symbologyScale, filterExtent );
+      errorMessage, datasourceOptions, layerOptions, skipAttributeCreation, newFilename, symbologyExport, symbologyScale, filterExtent,
+      transactionSize );
   delete ct;
   return error;
 }
@@ -1875,7 +1919,8 @@ QgsVectorFileWriter::WriterError QgsVectorFileWriter::writeAsVectorFormat( QgsVe
     QString *newFilename,
     SymbologyExport symbologyExport,
     double symbologyScale,
-    const QgsRectangle* filterExtent )
+    const QgsRectangle* filterExtent,
+    int transactionSize )
 {
   if ( !layer )
   {
@@ -1971,7 +2016,6 @@ QgsVectorFileWriter::WriterError QgsVectorFileWriter::writeAsVectorFormat( QgsVe
   }
 
   QgsAttributeList allAttr = skipAttributeCreation ? QgsAttributeList() : layer->attributeList();
-  QgsFeature fet;
 
   //add possible attributes needed by renderer
   writer->addRendererAttributes( layer, allAttr );
@@ -2024,67 +2068,142 @@ QgsVectorFileWriter::WriterError QgsVectorFileWriter::writeAsVectorFormat( QgsVe
     transactionsEnabled = false;
   }
 
-  // write all features
-  while ( fit.nextFeature( fet ) )
+  // GeoPackage and SpatiaLite keep all changes of a transaction in their journal,
+  // so large exports are committed in chunks (0 means a single transaction)
+  if ( driverName != "GPKG" && driverName != "SQLite" && driverName != "SpatiaLite" )
   {
+    transactionSize = 0;
+  }
+  else if ( transactionSize < 0 )
+  {
+    QSettings settings;
+    transactionSize = settings.value( "/qgis/vectorFileWriterTransactionSize", 100000 ).toInt();
+  }
+  int transactionCount = 0;
+
+  // each thread transforms with its own copy of the transform
+  QList<QgsCoordinateTransform*> transforms;
+  if ( shallTransform )
+  {
+    int threadCount = qMax( 1, QThread::idealThreadCount() );
+    for ( int i = 0; i < threadCount; ++i )
+      transforms << ct->clone();
+  }
+
+  // features are read from the source in batches: the geometries of a batch are transformed
+  // in parallel, then the features are converted and written in their original order
+  QVector<QgsFeature> batch( FEATURE_BATCH_SIZE );
+  bool stop = false;
+  while ( !stop )
+  {
+    int batchCount = 0;
+    while ( batchCount < batch.size() && fit.nextFeature( batch[batchCount] ) )
+      ++batchCount;
+    if ( batchCount == 0 )
+      break;
+
+    int failedIndex = -1;
+    QString failedError;
     if ( shallTransform )
     {
-      try
+      QList<QgsVectorFileWriterTransformTask> tasks;
+      int taskSize = ( batchCount + transforms.size() - 1 ) / transforms.size();
+      for ( int i = 0; i < transforms.size() && i * taskSize < batchCount; ++i )
       {
-        if ( fet.geometry() )
-        {
-          fet.geometry()->transform( *ct );
-        }
+        QgsVectorFileWriterTransformTask task;
+        task.features = batch.data() + i * taskSize;
+        task.count = qMin( taskSize, batchCount - i * taskSize );
+        task.ct = transforms.at( i );
+        task.failedIndex = -1;
+        tasks << task;
       }
-      catch ( QgsCsException &e )
-      {
-        delete writer;
 
-        QString msg = QObject::tr( "Failed to transform a point while drawing a feature with ID '%1'. Writing stopped. (Exception: %2)" )
-                      .arg( fet.id() ).arg( e.what() );
-        QgsLogger::warning( msg );
-        if ( errorMessage )
-          *errorMessage = msg;
+      QtConcurrent::blockingMap( tasks, transformFeatures );
 
-        return ErrProjection;
+      for ( int i = 0; i < tasks.size(); ++i )
+      {
+        if ( tasks.at( i ).failedIndex >= 0 )
+        {
+          failedIndex = i * taskSize + tasks.at( i ).failedIndex;
+          failedError = tasks.at( i ).error;
+          break;
+        }
       }
     }
 
-    if ( fet.constGeometry() && filterExtent && !fet.constGeometry()->intersects( *filterExtent ) )
-      continue;
-
-    if ( allAttr.size() < 1 && skipAttributeCreation )
+    // features before a failed transformation are written as before
+    int writeCount = failedIndex >= 0 ? failedIndex : batchCount;
+    for ( int i = 0; i < writeCount; ++i )
     {
-      fet.initAttributes( 0 );
-    }
+      QgsFeature& fet = batch[i];
 
-    if ( !writer->addFeature( fet, layer->rendererV2(), mapUnits ) )
-    {
-      WriterError err = writer->hasError();
-      if ( err != NoError && errorMessage )
+      if ( fet.constGeometry() && filterExtent && !fet.constGeometry()->intersects( *filterExtent ) )
+        continue;
+
+      if ( allAttr.size() < 1 && skipAttributeCreation )
+      {
+        fet.initAttributes( 0 );
+      }
+
+      if ( !writer->addFeature( fet, layer->rendererV2(), mapUnits ) )
       {
-        if ( errorMessage->isEmpty() )
+        WriterError err = writer->hasError();
+        if ( err != NoError && errorMessage )
         {
-          *errorMessage = QObject::tr( "Feature write errors:" );
+          if ( errorMessage->isEmpty() )
+          {
+            *errorMessage = QObject::tr( "Feature write errors:" );
+          }
+          *errorMessage += '\n' + writer->errorMessage();
+        }
+        errors++;
+
+        if ( errors > 1000 )
+        {
+          if ( errorMessage )
+          {
+            *errorMessage += QObject::tr( "Stopping after %1 errors" ).arg( errors );
+          }
+
+          n = -1;
+          stop = true;
+          break;
         }
-        *errorMessage += '\n' + writer->errorMessage();
       }
-      errors++;
+      n++;
 
-      if ( errors > 1000 )
+      if ( transactionsEnabled && transactionSize > 0 && ++transactionCount >= transactionSize )
       {
-        if ( errorMessage )
+        transactionCount = 0;
+        if ( OGRERR_NONE != OGR_L_CommitTransaction( writer->mLayer ) )
         {
-          *errorMessage += QObject::tr( "Stopping after %1 errors" ).arg( errors );
+          QgsDebugMsg( "Error while committing transaction on OGRLayer." );
+        }
+        if ( OGRERR_NONE != OGR_L_StartTransaction( writer->mLayer ) )
+        {
+          QgsDebugMsg( "Error when trying to restart transactions on OGRLayer." );
+          transactionsEnabled = false;
         }
-
-        n = -1;
-        break;
       }
     }
-    n++;
+
+    if ( !stop && failedIndex >= 0 )
+    {
+      qDeleteAll( transforms );
+      delete writer;
+
+      QString msg = QObject::tr( "Failed to transform a point while drawing a feature with ID '%1'. Writing stopped. (Exception: %2)" )
+                    .arg( batch.at( failedIndex ).id() ).arg( failedError );
+      QgsLogger::warning( msg );
+      if ( errorMessage )
+        *errorMessage = msg;
+
+      return ErrProjection;
+    }
   }
 
+  qDeleteAll( transforms );
+
   if ( transactionsEnabled )
   {
     if ( OGRERR_NONE != OGR_L_CommitTransaction( writer->mLayer ) )
@@ -175,6 +175,9 @@ class CORE_EXPORT QgsVectorFileWriter
     @param symbologyExport symbology to export
     @param symbologyScale scale of symbology
     @param filterExtent if not a null pointer, only features intersecting the extent will be saved
+    @param transactionSize number of features after which GeoPackage and SpatiaLite files are committed,
+    0 for a single transaction and -1 for the "/qgis/vectorFileWriterTransactionSize" setting (100000 by default).
+    Added in QGIS 2.14.
     */
     static WriterError writeAsVectorFormat( QgsVectorLayer* layer,
                                             const QString& fileName,
@@ -189,7 +192,8 @@ class CORE_EXPORT QgsVectorFileWriter
                                             QString *newFilename = 0,
                                             SymbologyExport symbologyExport = NoSymbology,
                                             double symbologyScale = 1.0,
-                                            const QgsRectangle* filterExtent = 0 // added in 2.4
+                                            const QgsRectangle* filterExtent = 0, // added in 2.4
+                                            int transactionSize = -1 // added in 2.14
                                           );
 
     //! @note added in v2.2
@@ -206,7 +210,8 @@ class CORE_EXPORT QgsVectorFileWriter
                                             QString *newFilename = 0,
                                             SymbologyExport symbologyExport = NoSymbology,
                                             double symbologyScale = 1.0,
-                                            const QgsRectangle* filterExtent = 0 // added in 2.4
+                                            const QgsRectangle* filterExtent = 0, // added in 2.4
+                                            int transactionSize = -1 // added in 2.14
                                           );
 
     /** Create shapefile and initialize it */
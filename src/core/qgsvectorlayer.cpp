@@ -3236,15 +3236,29 @@ QList<QVariant> QgsVectorLayer::getValues( const QString &fieldOrExpression, boo
   }
 
   // create list of non-null attribute values
-  while ( fit.nextFeature( f ) )
+  if ( expression )
   {
-    if ( expression )
+    // evaluate the expression for blocks of features at once
+    const int blockSize = 1000;
+    QgsFeatureList block;
+    block.reserve( blockSize );
+    bool hasMore = true;
+    while ( hasMore )
     {
-      context.setFeature( f );
-      QVariant v = expression->evaluate( &context );
-      values << v;
+      hasMore = fit.nextFeature( f );
+      if ( hasMore )
+        block << f;
+
+      if ( block.count() == blockSize || ( !hasMore && !block.isEmpty() ) )
+      {
+        values << expression->evaluateBatch( block, &context );
+        block.clear();
+      }
     }
-    else
+  }
+  else
+  {
+    while ( fit.nextFeature( f ) )
     {
       values << f.attribute( attrNum );
     }
@@ -46,10 +46,10 @@ static void _fixQPictureDPI( QPainter* p )
 
 
 QgsVectorLayerLabelProvider::QgsVectorLayerLabelProvider( QgsVectorLayer* layer, bool withFeatureLoop, const QgsPalLayerSettings* settings, const QString& layerName )
+    : QgsAbstractLabelProvider( layer->id() )
 {
   mSettings = settings ? *settings : QgsPalLayerSettings::fromLayer( layer );
   mName = layerName.isEmpty() ? layer->id() : layerName;
-  mLayerId = layer->id();
   mFields = layer->fields();
   mCrs = layer->crs();
   if ( withFeatureLoop )
@@ -73,8 +73,8 @@ QgsVectorLayerLabelProvider::QgsVectorLayerLabelProvider(
   const QgsCoordinateReferenceSystem& crs,
   QgsAbstractFeatureSource* source,
   bool ownsSource )
-    : mSettings( settings )
-    , mLayerId( layerId )
+    : QgsAbstractLabelProvider( layerId )
+    , mSettings( settings )
     , mFields( fields )
     , mCrs( crs )
     , mSource( source )
@@ -36,6 +36,103 @@
 
 #include <QSettings>
 #include <QPicture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+//! number of features rendered by one worker thread in a batch
+static const int PARALLEL_CHUNK_SIZE = 4096;
+//! smallest number of features given to a worker thread, for the last batch of a layer
+static const int PARALLEL_MIN_CHUNK_SIZE = 256;
+
+/// @cond PRIVATE
+/** Features collected for rendering on multiple threads. Each worker thread renders
+ * a contiguous range of the batch, so compositing the images of the workers in order
+ * keeps the z-order of the features. */
+struct QgsVectorLayerRendererBatch
+{
+  QgsVectorLayerRendererBatch() : chunkCount( 0 ) {}
+
+  QVector<QgsFeature> features;
+  //! symbol layer to render for each feature, -1 for all
+  QVector<int> symbolLayers;
+  //! whether the renderer drew each feature, set by the worker threads
+  QVector<bool> rendered;
+  //! number of chunks the batch is rendered by
+  int chunkCount;
+};
+
+/** Worker state for rendering features on a separate thread.
+ * Each chunk owns an image of the size of the layer image, a copy of the
+ * render context painting into it and an independent clone of the renderer. */
+struct QgsVectorLayerRendererChunk
+{
+  QgsVectorLayerRendererChunk()
+      : painter( 0 ), transform( 0 ), renderer( 0 ), mainContext( 0 ), selectedIds( 0 )
+      , drawVertexMarkers( false ), vertexMarkerOnlyForSelection( false )
+      , features( 0 ), symbolLayers( 0 ), rendered( 0 ), count( 0 ) {}
+
+  QImage image;
+  QPainter* painter;
+  QgsCoordinateTransform* transform;
+  QgsRenderContext context;
+  QgsFeatureRendererV2* renderer;
+
+  const QgsRenderContext* mainContext;
+  const QgsFeatureIds* selectedIds;
+  bool drawVertexMarkers;
+  bool vertexMarkerOnlyForSelection;
+
+  //! range of the batch rendered by this chunk
+  QgsFeature* features;
+  const int* symbolLayers;
+  bool* rendered;
+  int count;
+
+  QFuture<void> future;
+};
+
+//! number of features collected before they are rendered, one chunk for each thread of the pool
+static int parallelBatchSize()
+{
+  return qMax( 1, QThreadPool::globalInstance()->maxThreadCount() ) * PARALLEL_CHUNK_SIZE;
+}
+
+static void renderChunk( QgsVectorLayerRendererChunk* chunk )
+{
+  QgsRenderContext& context = chunk->context;
+
+  // reset the image left from the previous batch
+  chunk->painter->setCompositionMode( QPainter::CompositionMode_Clear );
+  chunk->painter->fillRect( chunk->image.rect(), Qt::transparent );
+  chunk->painter->setCompositionMode( QPainter::CompositionMode_SourceOver );
+
+  for ( int i = 0; i < chunk->count; ++i )
+  {
+    if ( chunk->mainContext->renderingStopped() )
+      break;
+
+    QgsFeature& fet = chunk->features[i];
+    int symbolLayer = chunk->symbolLayers[i];
+    context.expressionContext().setFeature( fet );
+
+    // symbol levels do not respect the showSelection() flag
+    bool sel = ( symbolLayer >= 0 || context.showSelection() ) && chunk->selectedIds->contains( fet.id() );
+    bool drawMarker = ( chunk->drawVertexMarkers && context.drawEditingInformation() && ( !chunk->vertexMarkerOnlyForSelection || sel ) );
+
+    try
+    {
+      chunk->rendered[i] = chunk->renderer->renderFeature( fet, context, symbolLayer, sel, drawMarker );
+    }
+    catch ( const QgsCsException &cse )
+    {
+      Q_UNUSED( cse );
+      QgsDebugMsg( QString( "Failed to transform a point while drawing a feature with ID '%1'. Ignoring this feature. %2" )
+                   .arg( fet.id() ).arg( cse.what() ) );
+    }
+  }
+}
+/// @endcond
 
 // TODO:
 // - passing of cache to QgsVectorLayer
@@ -53,6 +150,9 @@ QgsVectorLayerRenderer::QgsVectorLayerRenderer( QgsVectorLayer* layer, QgsRender
     , mLabelProvider( 0 )
     , mDiagramProvider( 0 )
     , mLayerTransparency( 0 )
+    , mCollectingBatch( 0 )
+    , mRenderingBatch( 0 )
+    , mParallelRegisterLabels( false )
 {
   mSource = new QgsVectorLayerFeatureSource( layer );
 
@@ -281,6 +381,10 @@ void QgsVectorLayerRenderer::setGeometryCachePointer( QgsGeometryCache* cache )
 
 void QgsVectorLayerRenderer::drawRendererV2( QgsFeatureIterator& fit )
 {
+  bool parallel = canRenderInParallel();
+  if ( parallel )
+    startParallelChunks( true );
+
   QgsFeature fet;
   while ( fit.nextFeature( fet ) )
   {
@@ -295,47 +399,30 @@ void QgsVectorLayerRenderer::drawRendererV2( QgsFeatureIterator& fit )
         break;
       }
 
-      mContext.expressionContext().setFeature( fet );
-
-      bool sel = mContext.showSelection() && mSelectedFeatureIds.contains( fet.id() );
-      bool drawMarker = ( mDrawVertexMarkers && mContext.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
-
       if ( mCache )
       {
         // Cache this for the use of (e.g.) modifying the feature's uncommitted geometry.
         mCache->cacheGeometry( fet.id(), *fet.constGeometry() );
       }
 
+      if ( parallel )
+      {
+        // rendering and label registration happen once the batch is rendered
+        addParallelFeature( fet, -1 );
+        continue;
+      }
+
+      mContext.expressionContext().setFeature( fet );
+
+      bool sel = mContext.showSelection() && mSelectedFeatureIds.contains( fet.id() );
+      bool drawMarker = ( mDrawVertexMarkers && mContext.drawEditingInformation() && ( !mVertexMarkerOnlyForSelection || sel ) );
+
       // render feature
       bool rendered = mRendererV2->renderFeature( fet, mContext, -1, sel, drawMarker );
 
       // labeling - register feature
       if ( rendered )
-      {
-        if ( mContext.labelingEngine() )
-        {
-          if ( mLabeling )
-          {
-            mContext.labelingEngine()->registerFeature( mLayerID, fet, mContext );
-          }
-          if ( mDiagrams )
-          {
-            mContext.labelingEngine()->registerDiagramFeature( mLayerID, fet, mContext );
-          }
-        }
-        // new labeling engine
-        if ( mContext.labelingEngineV2() )
-        {
-          if ( mLabelProvider )
-          {
-            mLabelProvider->registerFeature( fet, mContext );
-          }
-          if ( mDiagramProvider )
-          {
-            mDiagramProvider->registerFeature( fet, mContext );
-          }
-        }
-      }
+        registerLabelFeature( fet );
     }
     catch ( const QgsCsException &cse )
     {
@@ -345,6 +432,9 @@ void QgsVectorLayerRenderer::drawRendererV2( QgsFeatureIterator& fit )
     }
   }
 
+  if ( parallel )
+    finishParallelChunks();
+
   stopRendererV2( 0 );
 }
 
@@ -394,30 +484,7 @@ void QgsVectorLayerRenderer::drawRendererV2Levels( QgsFeatureIterator& fit )
       mCache->cacheGeometry( fet.id(), *fet.constGeometry() );
     }
 
-    if ( mContext.labelingEngine() )
-    {
-      mContext.expressionContext().setFeature( fet );
-      if ( mLabeling )
-      {
-        mContext.labelingEngine()->registerFeature( mLayerID, fet, mContext );
-      }
-      if ( mDiagrams )
-      {
-        mContext.labelingEngine()->registerDiagramFeature( mLayerID, fet, mContext );
-      }
-    }
-    // new labeling engine
-    if ( mContext.labelingEngineV2() )
-    {
-      if ( mLabelProvider )
-      {
-        mLabelProvider->registerFeature( fet, mContext );
-      }
-      if ( mDiagramProvider )
-      {
-        mDiagramProvider->registerFeature( fet, mContext );
-      }
-    }
+    registerLabelFeature( fet );
   }
 
   // find out the order
@@ -438,6 +505,10 @@ void QgsVectorLayerRenderer::drawRendererV2Levels( QgsFeatureIterator& fit )
     }
   }
 
+  bool parallel = canRenderInParallel();
+  if ( parallel )
+    startParallelChunks( false );
+
   // 2. draw features in correct order
   for ( int l = 0; l < levels.count(); l++ )
   {
@@ -452,6 +523,21 @@ void QgsVectorLayerRenderer::drawRendererV2Levels( QgsFeatureIterator& fit )
       }
       int layer = item.layer();
       QList<QgsFeature>& lst = features[item.symbol()];
+
+      if ( parallel )
+      {
+        // batches keep the order of the features, so the levels still stack correctly
+        if ( mContext.renderingStopped() )
+        {
+          finishParallelChunks();
+          stopRendererV2( selRenderer );
+          return;
+        }
+        Q_FOREACH ( const QgsFeature& feature, lst )
+          addParallelFeature( feature, layer );
+        continue;
+      }
+
       QList<QgsFeature>::iterator fit;
       for ( fit = lst.begin(); fit != lst.end(); ++fit )
       {
@@ -481,6 +567,9 @@ void QgsVectorLayerRenderer::drawRendererV2Levels( QgsFeatureIterator& fit )
     }
   }
 
+  if ( parallel )
+    finishParallelChunks();
+
   stopRendererV2( selRenderer );
 }
 
@@ -495,8 +584,197 @@ void QgsVectorLayerRenderer::stopRendererV2( QgsSingleSymbolRendererV2* selRende
   }
 }
 
+void QgsVectorLayerRenderer::registerLabelFeature( QgsFeature& feature )
+{
+  // data defined properties of labels and diagrams are evaluated for this feature
+  mContext.expressionContext().setFeature( feature );
+
+  if ( mContext.labelingEngine() )
+  {
+    if ( mLabeling )
+    {
+      mContext.labelingEngine()->registerFeature( mLayerID, feature, mContext );
+    }
+    if ( mDiagrams )
+    {
+      mContext.labelingEngine()->registerDiagramFeature( mLayerID, feature, mContext );
+    }
+  }
+  // new labeling engine
+  if ( mContext.labelingEngineV2() )
+  {
+    if ( mLabelProvider )
+    {
+      mLabelProvider->registerFeature( feature, mContext );
+    }
+    if ( mDiagramProvider )
+    {
+      mDiagramProvider->registerFeature( feature, mContext );
+    }
+  }
+}
 
 
+bool QgsVectorLayerRenderer::canRenderInParallel() const
+{
+  if ( !mContext.testFlag( QgsRenderContext::ParallelFeatureRendering ) || QThread::idealThreadCount() < 2 )
+    return false;
+
+  // renderers which collect features and draw them in stopRender() (rule based render queue,
+  // point displacement, heatmap, inverted polygons) need to see all features at once
+  QString type = mRendererV2->type();
+  if ( type != "singleSymbol" && type != "categorizedSymbol" && type != "graduatedSymbol" )
+    return false;
+
+  if ( mRendererV2->paintEffect() && mRendererV2->paintEffect()->enabled() )
+    return false;
+
+  if ( mContext.useAdvancedEffects() && mFeatureBlendMode != QPainter::CompositionMode_SourceOver )
+    return false;
+
+  // chunk images are composited with a plain image draw, so the target has to be
+  // an untransformed raster image without clipping
+  QPainter* p = mContext.painter();
+  if ( !p || !p->device() || p->device()->devType() != QInternal::Image )
+    return false;
+
+  return !mContext.forceVectorOutput()
+         && p->compositionMode() == QPainter::CompositionMode_SourceOver
+         && p->worldTransform().isIdentity()
+         && !p->hasClipping();
+}
+
+
+void QgsVectorLayerRenderer::startParallelChunks( bool registerLabels )
+{
+  mParallelRegisterLabels = registerLabels;
+  mCollectingBatch = new QgsVectorLayerRendererBatch;
+  mCollectingBatch->features.reserve( parallelBatchSize() );
+  mRenderingBatch = new QgsVectorLayerRendererBatch;
+}
+
+
+QgsVectorLayerRendererChunk* QgsVectorLayerRenderer::createChunk()
+{
+  QPainter* p = mContext.painter();
+  const QImage* target = static_cast<const QImage*>( p->device() );
+
+  QgsVectorLayerRendererChunk* chunk = new QgsVectorLayerRendererChunk;
+  chunk->image = QImage( target->size(), QImage::Format_ARGB32_Premultiplied );
+  chunk->image.setDotsPerMeterX( target->dotsPerMeterX() );
+  chunk->image.setDotsPerMeterY( target->dotsPerMeterY() );
+  chunk->painter = new QPainter( &chunk->image );
+  chunk->painter->setRenderHints( p->renderHints() );
+
+  chunk->context = mContext;
+  chunk->context.setPainter( chunk->painter );
+  chunk->transform = mContext.coordinateTransform() ? mContext.coordinateTransform()->clone() : 0;
+  chunk->context.setCoordinateTransform( chunk->transform );
+
+  chunk->renderer = mRendererV2->clone();
+  if ( mDrawVertexMarkers )
+    chunk->renderer->setVertexMarkerAppearance( mVertexMarkerStyle, mVertexMarkerSize );
+  chunk->renderer->startRender( chunk->context, mFields );
+
+  chunk->mainContext = &mContext;
+  chunk->selectedIds = &mSelectedFeatureIds;
+  chunk->drawVertexMarkers = mDrawVertexMarkers;
+  chunk->vertexMarkerOnlyForSelection = mVertexMarkerOnlyForSelection;
+  return chunk;
+}
+
+
+void QgsVectorLayerRenderer::addParallelFeature( const QgsFeature& feature, int symbolLayer )
+{
+  mCollectingBatch->features.append( feature );
+  mCollectingBatch->symbolLayers.append( symbolLayer );
+  if ( mCollectingBatch->features.count() >= parallelBatchSize() )
+    submitBatch();
+}
+
+
+void QgsVectorLayerRenderer::submitBatch()
+{
+  // the workers render the previous batch while the next one is collected
+  finishBatch();
+  qSwap( mCollectingBatch, mRenderingBatch );
+  mCollectingBatch->features.clear();
+  mCollectingBatch->symbolLayers.clear();
+
+  QgsVectorLayerRendererBatch* batch = mRenderingBatch;
+  int count = batch->features.count();
+  batch->rendered.fill( false, count );
+
+  // split the batch in contiguous ranges, one per worker thread, so that each worker image
+  // is cleared and composited once per batch and the images stack in feature order
+  int chunkCount = qBound( 1, count / PARALLEL_MIN_CHUNK_SIZE, QThreadPool::globalInstance()->maxThreadCount() );
+  int chunkSize = ( count + chunkCount - 1 ) / chunkCount;
+  batch->chunkCount = 0;
+  for ( int first = 0; first < count; first += chunkSize )
+  {
+    // images are only allocated for the workers in use
+    if ( batch->chunkCount == mChunks.count() )
+      mChunks.append( createChunk() );
+
+    QgsVectorLayerRendererChunk* chunk = mChunks.at( batch->chunkCount++ );
+    chunk->features = batch->features.data() + first;
+    chunk->symbolLayers = batch->symbolLayers.constData() + first;
+    chunk->rendered = batch->rendered.data() + first;
+    chunk->count = qMin( chunkSize, count - first );
+    chunk->future = QtConcurrent::run( renderChunk, chunk );
+  }
+}
+
+
+void QgsVectorLayerRenderer::finishBatch()
+{
+  QgsVectorLayerRendererBatch* batch = mRenderingBatch;
+  for ( int i = 0; i < batch->chunkCount; ++i )
+  {
+    QgsVectorLayerRendererChunk* chunk = mChunks.at( i );
+    chunk->future.waitForFinished();
+    mContext.painter()->drawImage( 0, 0, chunk->image );
+  }
+
+  if ( mParallelRegisterLabels && batch->chunkCount > 0 )
+  {
+    for ( int i = 0; i < batch->features.count(); ++i )
+    {
+      if ( batch->rendered.at( i ) )
+        registerLabelFeature( batch->features[i] );
+    }
+  }
+
+  batch->chunkCount = 0;
+  batch->features.clear();
+  batch->symbolLayers.clear();
+}
+
+
+void QgsVectorLayerRenderer::finishParallelChunks()
+{
+  if ( !mCollectingBatch->features.isEmpty() && !mContext.renderingStopped() )
+    submitBatch();
+  finishBatch();
+
+  Q_FOREACH ( QgsVectorLayerRendererChunk* chunk, mChunks )
+  {
+    chunk->renderer->stopRender( chunk->context );
+    delete chunk->renderer;
+    chunk->painter->end();
+    delete chunk->painter;
+    chunk->context.setCoordinateTransform( 0 );
+    delete chunk->transform;
+    delete chunk;
+  }
+  mChunks.clear();
+
+  delete mCollectingBatch;
+  mCollectingBatch = 0;
+  delete mRenderingBatch;
+  mRenderingBatch = 0;
+}
+
 
 void QgsVectorLayerRenderer::prepareLabeling( QgsVectorLayer* layer, QStringList& attributeNames )
 {
@@ -43,6 +43,8 @@ typedef QList<int> QgsAttributeList;
 
 class QgsVectorLayerLabelProvider;
 class QgsVectorLayerDiagramProvider;
+struct QgsVectorLayerRendererChunk;
+struct QgsVectorLayerRendererBatch;
 
 /**
  * Implementation of threaded rendering for vector layers.
@@ -81,6 +83,37 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
     /** Stop version 2 renderer and selected renderer (if required) */
     void stopRendererV2( QgsSingleSymbolRendererV2* selRenderer );
 
+    /** Registers a rendered feature with the labeling and diagram engines */
+    void registerLabelFeature( QgsFeature& feature );
+
+    /** Returns true if features of the layer may be rendered on multiple threads.
+     * This requires the QgsRenderContext::ParallelFeatureRendering flag, a raster
+     * paint device and a renderer without paint effects or feature blending.
+     * @note added in QGIS 2.14
+     */
+    bool canRenderInParallel() const;
+
+    /** Prepares collecting features into batches rendered on worker threads.
+     * Labels of rendered features are registered when the batch is composited if registerLabels is true. */
+    void startParallelChunks( bool registerLabels );
+
+    /** Creates the image, render context and renderer clone of a worker thread */
+    QgsVectorLayerRendererChunk* createChunk();
+
+    /** Adds a feature to the batch being collected, submitting the batch once it is full */
+    void addParallelFeature( const QgsFeature& feature, int symbolLayer );
+
+    /** Finishes the batch being rendered and starts rendering the collected batch,
+     * split in one contiguous range of features per worker thread */
+    void submitBatch();
+
+    /** Waits for the batch being rendered, composites the worker images in feature order
+     * and registers labels of the rendered features */
+    void finishBatch();
+
+    /** Renders the remaining features, composites them and frees the worker resources */
+    void finishParallelChunks();
+
 
   protected:
 
@@ -124,6 +157,15 @@ class QgsVectorLayerRenderer : public QgsMapLayerRenderer
 
     QgsVectorSimplifyMethod mSimplifyMethod;
     bool mSimplifyGeometry;
+
+    //! worker chunks used for parallel rendering, empty when rendering serially
+    QList<QgsVectorLayerRendererChunk*> mChunks;
+    //! features collected while the previous batch is rendered
+    QgsVectorLayerRendererBatch* mCollectingBatch;
+    //! features being rendered by the worker chunks
+    QgsVectorLayerRendererBatch* mRenderingBatch;
+    //! whether labels are registered when a batch is composited
+    bool mParallelRegisterLabels;
 };
 
 
@@ -603,6 +603,11 @@ bool QgsRasterProjector::preciseSrcRowCol( int theDestRow, int theDestCol, int *
   QgsDebugMsgLevel( QString( "x = %1 y = %2" ).arg( x ).arg( y ), 5 );
 #endif
 
+  return pointSrcRowCol( x, y, theSrcRow, theSrcCol );
+}
+
+bool QgsRasterProjector::pointSrcRowCol( double x, double y, int *theSrcRow, int *theSrcCol )
+{
   if ( !mExtent.contains( QgsPoint( x, y ) ) )
   {
     return false;
@@ -957,12 +962,44 @@ QgsRasterBlock * QgsRasterProjector::block( int bandNo, QgsRectangle  const & ex
 
   outputBlock->setIsNoData();
 
+  // in precise mode the centers of the cells of a whole row are transformed at once
+  QVector<double> rowX, rowY, rowZ;
+  if ( inverseCt )
+  {
+    rowX.resize( width );
+    rowY.resize( width );
+    rowZ.resize( width );
+  }
+
   int srcRow, srcCol;
   for ( int i = 0; i < height; ++i )
   {
+    bool rowTransformed = false;
+    if ( inverseCt )
+    {
+      double y = mDestExtent.yMaximum() - ( i + 0.5 ) * mDestYRes;
+      for ( int j = 0; j < width; ++j )
+      {
+        rowX[j] = mDestExtent.xMinimum() + ( j + 0.5 ) * mDestXRes;
+        rowY[j] = y;
+        rowZ[j] = 0;
+      }
+      try
+      {
+        inverseCt->transformInPlace( rowX, rowY, rowZ );
+        rowTransformed = true;
+      }
+      catch ( QgsCsException & )
+      {
+        // fall back to transforming the cells one by one
+        QgsDebugMsgLevel( QString( "Row %1 could not be transformed at once" ).arg( i ), 4 );
+      }
+    }
+
     for ( int j = 0; j < width; ++j )
     {
-      bool inside = srcRowCol( i, j, &srcRow, &srcCol, inverseCt );
+      bool inside = rowTransformed ? pointSrcRowCol( rowX[j], rowY[j], &srcRow, &srcCol )
+                    : srcRowCol( i, j, &srcRow, &srcCol, inverseCt );
       if ( !inside ) continue; // we have everything set to no data
 
       qgssize srcIndex = ( qgssize )srcRow * mSrcCols + srcCol;
@@ -154,6 +154,9 @@ class CORE_EXPORT QgsRasterProjector : public QgsRasterInterface
     /** \brief Get precise source row and column indexes for current source extent and resolution */
     inline bool preciseSrcRowCol( int theDestRow, int theDestCol, int *theSrcRow, int *theSrcCol, const QgsCoordinateTransform* ct );
 
+    /** \brief Get source row and column indexes of a point in source CRS for current source extent and resolution */
+    inline bool pointSrcRowCol( double x, double y, int *theSrcRow, int *theSrcCol );
+
     /** \brief Get approximate source row and column indexes for current source extent and resolution */
     inline bool approximateSrcRowCol( int theDestRow, int theDestCol, int *theSrcRow, int *theSrcCol );
 
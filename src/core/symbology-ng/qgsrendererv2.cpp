@@ -107,11 +107,7 @@ const unsigned char* QgsFeatureRendererV2::_getLineString( QPolygonF& pts, QgsRe
     ct->transformPolygon( pts );
   }
 
-  QPointF* ptr = pts.data();
-  for ( int i = 0; i < pts.size(); ++i, ++ptr )
-  {
-    mtp.transformInPlace( ptr->rx(), ptr->ry() );
-  }
+  mtp.transformInPlace( pts );
 
   return wkbPtr;
 }
@@ -172,11 +168,7 @@ const unsigned char* QgsFeatureRendererV2::_getPolygon( QPolygonF& pts, QList<QP
     }
 
 
-    ptr = poly.data();
-    for ( int i = 0; i < poly.size(); ++i, ++ptr )
-    {
-      mtp.transformInPlace( ptr->rx(), ptr->ry() );
-    }
+    mtp.transformInPlace( poly );
 
     if ( idx == 0 )
       pts = poly;
@@ -282,17 +274,21 @@ void QgsFeatureRendererV2::renderFeatureWithSymbol( QgsFeature& feature, QgsSymb
 
 
   const QgsGeometry* geom = feature.constGeometry();
-  if ( !geom || !geom->geometry() )
+  if ( !geom || geom->isEmpty() )
   {
     return;
   }
 
   const QgsGeometry* segmentizedGeometry = geom;
   bool deleteSegmentizedGeometry = false;
-  context.setGeometry( geom->geometry() );
+
+  // the unsegmentized geometry is only needed for curves. Linear geometries are drawn
+  // from the WKB, which avoids parsing geometries created by providers with fromWkb()
+  const QgsAbstractGeometryV2* curvedGeometry = 0;
+  context.setGeometry( 0 );
 
   //convert curve types to normal point/line/polygon ones
-  switch ( QgsWKBTypes::flatType( geom->geometry()->wkbType() ) )
+  switch ( QgsWKBTypes::flatType(( QgsWKBTypes::Type )geom->wkbType() ) )
   {
     case QgsWKBTypes::CurvePolygon:
     case QgsWKBTypes::CircularString:
@@ -300,7 +296,9 @@ void QgsFeatureRendererV2::renderFeatureWithSymbol( QgsFeature& feature, QgsSymb
     case QgsWKBTypes::MultiSurface:
     case QgsWKBTypes::MultiCurve:
     {
-      QgsAbstractGeometryV2* g = geom->geometry()->segmentize();
+      curvedGeometry = geom->geometry();
+      context.setGeometry( curvedGeometry );
+      QgsAbstractGeometryV2* g = curvedGeometry->segmentize();
       if ( !g )
       {
         return;
@@ -314,7 +312,7 @@ void QgsFeatureRendererV2::renderFeatureWithSymbol( QgsFeature& feature, QgsSymb
       break;
   }
 
-  switch ( QgsWKBTypes::flatType( segmentizedGeometry->geometry()->wkbType() ) )
+  switch ( QgsWKBTypes::flatType(( QgsWKBTypes::Type )segmentizedGeometry->wkbType() ) )
   {
     case QgsWKBTypes::Point:
     {
@@ -398,7 +396,7 @@ void QgsFeatureRendererV2::renderFeatureWithSymbol( QgsFeature& feature, QgsSymb
       const unsigned char* ptr = wkbPtr;
       QPolygonF pts;
 
-      const QgsGeometryCollectionV2* geomCollection = dynamic_cast<const QgsGeometryCollectionV2*>( geom->geometry() );
+      const QgsGeometryCollectionV2* geomCollection = dynamic_cast<const QgsGeometryCollectionV2*>( curvedGeometry );
 
       for ( unsigned int i = 0; i < num; ++i )
       {
@@ -428,7 +426,7 @@ void QgsFeatureRendererV2::renderFeatureWithSymbol( QgsFeature& feature, QgsSymb
       QPolygonF pts;
       QList<QPolygonF> holes;
 
-      const QgsGeometryCollectionV2* geomCollection = dynamic_cast<const QgsGeometryCollectionV2*>( geom->geometry() );
+      const QgsGeometryCollectionV2* geomCollection = dynamic_cast<const QgsGeometryCollectionV2*>( curvedGeometry );
 
       for ( unsigned int i = 0; i < num; ++i )
       {
@@ -563,6 +563,9 @@ void QgsMapCanvas::setCachingEnabled( bool enabled )
   if ( enabled )
   {
     mCache = new QgsMapRendererCache;
+    QSettings settings;
+    mCache->setMaximumMemory( settings.value( "/qgis/mapCacheMemoryMB", 100 ).toLongLong() * 1024 * 1024 );
+    mCache->setCacheDirectory( settings.value( "/qgis/mapCacheDirectory" ).toString() );
   }
   else
   {
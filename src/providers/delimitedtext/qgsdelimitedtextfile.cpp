@@ -29,6 +29,8 @@
 #include <QRegExp>
 #include <QUrl>
 
+#include <cstring>
+
 
 QgsDelimitedTextFile::QgsDelimitedTextFile( const QString& url ) :
     mFileName( QString() ),
@@ -37,6 +39,14 @@ QgsDelimitedTextFile::QgsDelimitedTextFile( const QString& url ) :
     mStream( 0 ),
     mUseWatcher( true ),
     mWatcher( 0 ),
+    mUseMemoryMap( false ),
+    mMapData( 0 ),
+    mMapSize( 0 ),
+    mMapStart( 0 ),
+    mMapPos( 0 ),
+    mCodec( 0 ),
+    mCodecIsUtf8( false ),
+    mMapTokenizer( false ),
     mDefinitionValid( false ),
     mUseHeader( true ),
     mDiscardEmptyFields( false ),
@@ -73,6 +83,13 @@ void QgsDelimitedTextFile::close()
     delete mStream;
     mStream = 0;
   }
+  if ( mMapData )
+  {
+    mFile->unmap( mMapData );
+    mMapData = 0;
+    mMapTokenizer = false;
+    mLineCheckpoints.clear();
+  }
   if ( mFile )
   {
     delete mFile;
@@ -102,7 +119,7 @@ bool QgsDelimitedTextFile::open()
       delete mFile;
       mFile = 0;
     }
-    if ( mFile )
+    if ( mFile && !( mUseMemoryMap && mapFile() ) )
     {
       mStream = new QTextStream( mFile );
       if ( ! mEncoding.isEmpty() )
@@ -110,6 +127,9 @@ bool QgsDelimitedTextFile::open()
         QTextCodec *codec =  QTextCodec::codecForName( mEncoding.toAscii() );
         mStream->setCodec( codec );
       }
+    }
+    if ( mFile )
+    {
       if ( mUseWatcher )
       {
         mWatcher = new QFileSystemWatcher();
@@ -121,6 +141,120 @@ bool QgsDelimitedTextFile::open()
   return mFile != 0;
 }
 
+bool QgsDelimitedTextFile::mapFile()
+{
+  qint64 size = mFile->size();
+  if ( size <= 0 )
+    return false;
+
+  // same codec as the text stream would use
+  QTextCodec *codec = mEncoding.isEmpty() ? QTextCodec::codecForLocale() : QTextCodec::codecForName( mEncoding.toAscii() );
+  if ( !codec )
+    return false;
+
+  // in UTF-16 and UTF-32 a new line is not a single byte
+  int mib = codec->mibEnum();
+  if ( mib >= 1013 && mib <= 1019 )
+    return false;
+
+  uchar *data = mFile->map( 0, size );
+  if ( !data )
+  {
+    QgsDebugMsg( "Data file " + mFileName + " could not be mapped into memory" );
+    return false;
+  }
+
+  // a byte order mark overrides the encoding, as in QTextStream
+  qint64 start = 0;
+  if ( size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF )
+  {
+    codec = QTextCodec::codecForName( "UTF-8" );
+    start = 3;
+  }
+  else if ( size >= 2 && (( data[0] == 0xFF && data[1] == 0xFE ) || ( data[0] == 0xFE && data[1] == 0xFF ) ) )
+  {
+    mFile->unmap( data );
+    return false;
+  }
+
+  mMapData = data;
+  mMapSize = size;
+  mMapStart = start;
+  mMapPos = start;
+  mCodec = codec;
+  mCodecIsUtf8 = codec->mibEnum() == 106;
+  mLineCheckpoints.clear();
+
+  // CSV records can be split byte by byte if no byte of a multibyte
+  // character can be mistaken for a delimiter, quote or escape character
+  mib = codec->mibEnum();
+  memset( mMapCharClass, 0, sizeof( mMapCharClass ) );
+  mMapTokenizer = mType == DelimTypeCSV
+                  && ( mCodecIsUtf8 || mib == 3 || mib == 4 || mib == 2252 )
+                  && setMapCharClass( mDelimChars, MapDelimChar )
+                  && setMapCharClass( mQuoteChar, MapQuoteChar )
+                  && setMapCharClass( mEscapeChar, MapEscapeChar );
+  return true;
+}
+
+bool QgsDelimitedTextFile::setMapCharClass( const QString &chars, char charClass )
+{
+  Q_FOREACH ( QChar c, chars )
+  {
+    if ( c.unicode() >= 128 ) return false;
+    mMapCharClass[c.unicode()] |= charClass;
+  }
+  return true;
+}
+
+bool QgsDelimitedTextFile::readMappedLine( const char *&line, qint64 &length )
+{
+  if ( mMapPos >= mMapSize ) return false;
+
+  if ( mLineNumber % LINE_CHECKPOINT_INTERVAL == 0 && mLineNumber / LINE_CHECKPOINT_INTERVAL == mLineCheckpoints.count() )
+  {
+    mLineCheckpoints.append( mMapPos );
+  }
+
+  // lines end with \n, a preceding \r is dropped as QTextStream::readLine() does
+  line = reinterpret_cast<const char *>( mMapData + mMapPos );
+  const char *end = static_cast<const char *>( memchr( line, '\n', mMapSize - mMapPos ) );
+  length = end ? end - line : mMapSize - mMapPos;
+  mMapPos += end ? length + 1 : length;
+  if ( length > 0 && line[length - 1] == '\r' ) length--;
+  return true;
+}
+
+QString QgsDelimitedTextFile::decodeMapped( const char *data, qint64 size ) const
+{
+  return mCodecIsUtf8 ? QString::fromUtf8( data, size ) : mCodec->toUnicode( data, size );
+}
+
+bool QgsDelimitedTextFile::isMappedSpace( const char *c, int size ) const
+{
+  uchar u = *c;
+  if ( u < 128 ) return u == ' ' || ( u >= '\t' && u <= '\r' );
+  // eg a no-break space
+  QString decoded = decodeMapped( c, size );
+  return decoded.size() == 1 && decoded.at( 0 ).isSpace();
+}
+
+bool QgsDelimitedTextFile::readLine( QString &buffer )
+{
+  if ( ! mMapData )
+  {
+    if ( mStream->atEnd() ) return false;
+    buffer = mStream->readLine();
+    return ! buffer.isNull();
+  }
+
+  const char *line;
+  qint64 length;
+  if ( ! readMappedLine( line, length ) ) return false;
+  buffer = decodeMapped( line, length );
+  return true;
+}
+
 void QgsDelimitedTextFile::updateFile()
 {
   close();
@@ -163,6 +297,12 @@ bool QgsDelimitedTextFile::setFromUrl( const QUrl &url )
     mUseWatcher = ! url.queryItemValue( "useWatcher" ).toUpper().startsWith( 'N' );
   }
 
+  mUseMemoryMap = false;
+  if ( url.hasQueryItem( "mapFile" ) )
+  {
+    mUseMemoryMap = url.queryItemValue( "mapFile" ).toUpper().startsWith( 'Y' );
+  }
+
   // The default type is csv, to be consistent with the
   // previous implementation (except that quoting should be handled properly)
 
@@ -274,6 +414,11 @@ QUrl QgsDelimitedTextFile::url()
     url.addQueryItem( "useWatcher", "no" );
   }
 
+  if ( mUseMemoryMap )
+  {
+    url.addQueryItem( "mapFile", "yes" );
+  }
+
   url.addQueryItem( "type", type() );
   if ( mType == DelimTypeRegexp )
   {
@@ -320,6 +465,12 @@ void QgsDelimitedTextFile::setEncoding( const QString& encoding )
   mEncoding = encoding;
 }
 
+void QgsDelimitedTextFile::setUseMemoryMap( bool useMemoryMap )
+{
+  resetDefinition();
+  mUseMemoryMap = useMemoryMap;
+}
+
 void QgsDelimitedTextFile::setUseWatcher( bool useWatcher )
 {
   resetDefinition();
@@ -529,8 +680,22 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextRecord( QStringList &reco
 
     // Find the first non-blank line to read
     QString buffer;
-    status = nextLine( buffer, true );
-    if ( status != RecordOk ) return RecordEOF;
+    const char *line = 0;
+    qint64 length = 0;
+    if ( mMapTokenizer )
+    {
+      do
+      {
+        if ( ! readMappedLine( line, length ) ) return RecordEOF;
+        mLineNumber++;
+      }
+      while ( length == 0 );
+    }
+    else
+    {
+      status = nextLine( buffer, true );
+      if ( status != RecordOk ) return RecordEOF;
+    }
 
     mCurrentRecord.clear();
     mRecordLineNumber = mLineNumber;
@@ -539,7 +704,10 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextRecord( QStringList &reco
       mRecordNumber++;
       if ( mRecordNumber > mMaxRecordNumber ) mMaxRecordNumber = mRecordNumber;
     }
-    status = ( this->*mParser )( buffer, mCurrentRecord );
+    if ( mMapTokenizer )
+      status = parseQuotedMapped( line, length, mCurrentRecord );
+    else
+      status = ( this->*mParser )( buffer, mCurrentRecord );
   }
   if ( status == RecordOk )
   {
@@ -555,15 +723,19 @@ QgsDelimitedTextFile::Status  QgsDelimitedTextFile::reset()
   if ( ! isValid() || ! open() ) return InvalidDefinition;
 
   // Reset the file pointer
-  mStream->seek( 0 );
+  if ( mMapData )
+    mMapPos = mMapStart;
+  else
+    mStream->seek( 0 );
   mLineNumber = 0;
   mRecordNumber = -1;
   mRecordLineNumber = -1;
 
   // Skip header lines
+  QString buffer;
   for ( int i = mSkipLines; i-- > 0; )
   {
-    if ( mStream->readLine().isNull() ) return RecordEOF;
+    if ( ! readLine( buffer ) ) return RecordEOF;
     mLineNumber++;
   }
   // Read the column names
@@ -580,16 +752,14 @@ QgsDelimitedTextFile::Status  QgsDelimitedTextFile::reset()
 
 QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextLine( QString &buffer, bool skipBlank )
 {
-  if ( ! mStream )
+  if ( ! mStream && ! mMapData )
   {
     Status status = reset();
     if ( status != RecordOk ) return status;
   }
 
-  while ( ! mStream->atEnd() )
+  while ( readLine( buffer ) )
   {
-    buffer = mStream->readLine();
-    if ( buffer.isNull() ) break;
     mLineNumber++;
     if ( skipBlank && buffer.isEmpty() ) continue;
     return RecordOk;
@@ -601,8 +771,24 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextLine( QString &buffer, bo
 
 bool QgsDelimitedTextFile::setNextLineNumber( long nextLineNumber )
 {
-  if ( ! mStream ) return false;
-  if ( mLineNumber > nextLineNumber - 1 )
+  if ( ! mStream && ! mMapData ) return false;
+  if ( mMapData )
+  {
+    // continue from the closest remembered line offset
+    long target = nextLineNumber - 1;
+    if ( mLineNumber > target || target - mLineNumber >= LINE_CHECKPOINT_INTERVAL )
+    {
+      long checkpoint = qMin( target / LINE_CHECKPOINT_INTERVAL, long( mLineCheckpoints.count() ) - 1 );
+      long checkpointLine = checkpoint < 0 ? 0 : checkpoint * LINE_CHECKPOINT_INTERVAL;
+      if ( mLineNumber > target || checkpointLine > mLineNumber )
+      {
+        mRecordNumber = -1;
+        mMapPos = checkpoint < 0 ? mMapStart : mLineCheckpoints.at( checkpoint );
+        mLineNumber = checkpointLine;
+      }
+    }
+  }
+  else if ( mLineNumber > nextLineNumber - 1 )
   {
     mRecordNumber = -1;
     mStream->seek( 0 );
@@ -838,6 +1024,194 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::parseQuoted( QString &buffer,
   return status;
 }
 
+///@cond PRIVATE
+
+// Bytes of a field read from a memory map.  The field refers to the
+// mapped bytes until a character does not follow the previous one (eg
+// after an escape or a line break), only then the bytes are copied.
+class QgsDelimitedTextMappedField
+{
+  public:
+    QgsDelimitedTextMappedField()
+        : mStart( 0 )
+        , mEnd( 0 )
+    {}
+
+    void append( const char *c, int size = 1 )
+    {
+      if ( c != mEnd )
+      {
+        flush();
+        mStart = c;
+      }
+      mEnd = c + size;
+    }
+
+    void appendNewLine()
+    {
+      flush();
+      mCopy.append( '\n' );
+    }
+
+    void clear()
+    {
+      mCopy.clear();
+      mStart = mEnd = 0;
+    }
+
+    //! Decode the field, from UTF-8 if codec is null
+    QString toString( QTextCodec *codec )
+    {
+      if ( ! mCopy.isEmpty() ) flush();
+      const char *data = mCopy.isEmpty() ? mStart : mCopy.constData();
+      int size = mCopy.isEmpty() ? mEnd - mStart : mCopy.size();
+      return codec ? codec->toUnicode( data, size ) : QString::fromUtf8( data, size );
+    }
+
+  private:
+    void flush()
+    {
+      if ( mEnd != mStart ) mCopy.append( mStart, mEnd - mStart );
+      mStart = mEnd = 0;
+    }
+
+    const char *mStart;
+    const char *mEnd;
+    QByteArray mCopy;
+};
+
+///@endcond
+
+QgsDelimitedTextFile::Status QgsDelimitedTextFile::parseQuotedMapped( const char *line, qint64 length, QStringList &fields )
+{
+  // Same state machine as parseQuoted, but working on the mapped bytes.  Only
+  // ASCII characters can be delimiters, quotes or escapes (see mapFile())
+  Status status = RecordOk;
+  QgsDelimitedTextMappedField field;
+  bool escaped = false;
+  bool quoted = false;
+  char quoteChar = 0;
+  bool started = false;
+  bool ended = false;
+  const char *cp = line;
+  const char *cpmax = line + length;
+
+  while ( true )
+  {
+    // If end of line then if escaped or buffered then try to get more...
+    if ( cp >= cpmax )
+    {
+      if ( quoted || escaped )
+      {
+        if ( ! readMappedLine( line, length ) )
+        {
+          status = RecordInvalid;
+          break;
+        }
+        mLineNumber++;
+        field.appendNewLine();
+        cp = line;
+        cpmax = line + length;
+        escaped = false;
+        continue;
+      }
+      break;
+    }
+
+    // A multibyte character is handled as a whole
+    const char *c = cp;
+    uchar u = *c;
+    int size = 1;
+    if ( mCodecIsUtf8 && u >= 0xC0 )
+    {
+      size = qMin<qint64>( u >= 0xF0 ? 4 : u >= 0xE0 ? 3 : 2, cpmax - c );
+    }
+    cp += size;
+
+    if ( escaped )
+    {
+      field.append( c, size );
+      escaped = false;
+      continue;
+    }
+
+    char charClass = u < 128 ? mMapCharClass[u] : 0;
+    bool isQuote = false;
+    bool isEscape = false;
+    bool isDelim = charClass & MapDelimChar;
+    if ( ! isDelim )
+    {
+      bool isQuoteChar = charClass & MapQuoteChar;
+      isQuote = quoted ? *c == quoteChar : isQuoteChar;
+      isEscape = charClass & MapEscapeChar;
+      if ( isQuoteChar && isEscape ) isEscape = isQuote;
+    }
+
+    if ( isQuote )
+    {
+      if ( quoted )
+      {
+        if ( isEscape && cp < cpmax && *cp == quoteChar )
+        {
+          field.append( cp );
+          cp++;
+        }
+        else
+        {
+          quoted = false;
+          ended =  true;
+        }
+      }
+      else if ( ! started )
+      {
+        field.clear();
+        quoteChar = *c;
+        quoted = true;
+        started = true;
+      }
+      else
+      {
+        fields.clear();
+        return RecordInvalid;
+      }
+    }
+    else if ( isEscape )
+    {
+      escaped = true;
+    }
+    else if ( quoted )
+    {
+      field.append( c, size );
+    }
+    else if ( isDelim )
+    {
+      appendField( fields, field.toString( mCodecIsUtf8 ? 0 : mCodec ), ended );
+      field.clear();
+      started = false;
+      ended = false;
+    }
+    else if ( isMappedSpace( c, size ) )
+    {
+      if ( ! ended ) field.append( c, size );
+    }
+    else
+    {
+      if ( ended )
+      {
+        fields.clear();
+        return RecordInvalid;
+      }
+      field.append( c, size );
+      started = true;
+    }
+  }
+  if ( started )
+  {
+    appendField( fields, field.toString( mCodecIsUtf8 ? 0 : mCodec ), ended );
+  }
+  return status;
+}
+
 bool QgsDelimitedTextFile::isValid()
 {
   return mDefinitionValid && QFile::exists( mFileName ) && QFileInfo( mFileName ).size() > 0;
@@ -22,12 +22,14 @@
 #include <QRegExp>
 #include <QUrl>
 #include <QObject>
+#include <QVector>
 
 class QgsFeature;
 class QgsField;
 class QFile;
 class QFileSystemWatcher;
 class QTextStream;
+class QTextCodec;
 
 
 /**
@@ -65,6 +67,7 @@ class QTextStream;
 *   The field is ignored for csv and whitespace
 * - quoteChar, optional, a single character used for quoting plain fields
 * - escapeChar, optional, a single characer used for escaping (may be the same as quoteChar)
+* - mapFile, optional, yes to read the file through a memory map (see setUseMemoryMap)
 */
 
 // Note: this has been implemented as a single class rather than a set of classes based
@@ -296,6 +299,28 @@ class QgsDelimitedTextFile : public QObject
 
     void setUseWatcher( bool useWatcher );
 
+    /** Set to read the file through a memory map instead of a text stream.
+     * Lines are decoded straight from the mapped bytes and the offsets of every
+     * LINE_CHECKPOINT_INTERVAL lines are remembered, so that moving to a record
+     * (eg when fetching features by id or from an index) does not rescan the file.
+     * For CSV files in UTF-8 or a single byte encoding, with ASCII delimiter, quote
+     * and escape characters, records are split straight from the mapped bytes and
+     * each field is decoded once, without building a string for the line first.
+     * Files in UTF-16 or UTF-32 encodings, or which cannot be mapped, are read
+     * through a text stream anyway.
+     * @param useMemoryMap True to use a memory map, false otherwise
+     * @note added in QGIS 2.14
+     */
+    void setUseMemoryMap( bool useMemoryMap );
+
+    /** Return the option for reading the file through a memory map
+     * @note added in QGIS 2.14
+     */
+    bool useMemoryMap()
+    {
+      return mUseMemoryMap;
+    }
+
   signals:
     /** Signal sent when the file is updated by another process
      */
@@ -327,6 +352,9 @@ class QgsDelimitedTextFile : public QObject
     Status parseRegexp( QString &buffer, QStringList &fields );
     /** Parse quote delimited fields, where quote and escape are different */
     Status parseQuoted( QString &buffer, QStringList &fields );
+    /** Parse quote delimited fields straight from the bytes of a memory mapped line,
+     * as parseQuoted does for a decoded line */
+    Status parseQuotedMapped( const char *line, qint64 length, QStringList &fields );
 
     /** Return the next line from the data file.  If skipBlank is true then
      * blank lines will be skipped - this is for compatibility with previous
@@ -338,6 +366,43 @@ class QgsDelimitedTextFile : public QObject
      */
     bool setNextLineNumber( long nextLineNumber );
 
+    /** Read a raw line from the stream or the memory map.
+     * @return false at the end of the file
+     */
+    bool readLine( QString &buffer );
+
+    /** Read the bytes of a raw line from the memory map, without the end of line.
+     * @return false at the end of the file
+     */
+    bool readMappedLine( const char *&line, qint64 &length );
+
+    /** Decode bytes read from the memory map */
+    QString decodeMapped( const char *data, qint64 size ) const;
+
+    /** Whether the mapped character of size bytes is white space */
+    bool isMappedSpace( const char *c, int size ) const;
+
+    /** Try to map the opened file into memory
+     * @return true if the file will be read through the memory map
+     */
+    bool mapFile();
+
+    /** Mark the characters of chars as charClass for the mapped CSV tokenizer
+     * @return false if one of the characters is not ASCII
+     */
+    bool setMapCharClass( const QString &chars, char charClass );
+
+    //! Classes of the special characters of the mapped CSV tokenizer
+    enum MapCharClass
+    {
+      MapDelimChar = 1,
+      MapQuoteChar = 2,
+      MapEscapeChar = 4
+    };
+
+    //! Number of lines between the remembered line offsets of a memory mapped file
+    static const int LINE_CHECKPOINT_INTERVAL = 64;
+
     /** Utility routine to add a field to a record, accounting for trimming
      *  and discarding, and maximum field count
      */
@@ -353,6 +418,21 @@ class QgsDelimitedTextFile : public QObject
     bool mUseWatcher;
     QFileSystemWatcher *mWatcher;
 
+    // Memory mapped reading
+    bool mUseMemoryMap;
+    uchar *mMapData;
+    qint64 mMapSize;
+    qint64 mMapStart;
+    qint64 mMapPos;
+    QTextCodec *mCodec;
+    bool mCodecIsUtf8;
+    // Records are split by parseQuotedMapped
+    bool mMapTokenizer;
+    // MapCharClass flags of the ASCII characters
+    char mMapCharClass[128];
+    // Byte offsets of lines 0, LINE_CHECKPOINT_INTERVAL, 2 * LINE_CHECKPOINT_INTERVAL, ...
+    QVector<qint64> mLineCheckpoints;
+
     // Parameters common to parsers
     bool mDefinitionValid;
     DelimiterType mType;
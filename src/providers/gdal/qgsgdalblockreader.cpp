@@ -0,0 +1,364 @@
+/***************************************************************************
+    qgsgdalblockreader.cpp  -  block aligned reading of GDAL rasters
+    ---------------------
+    begin                : November 2015
+    copyright            : (C) 2015 by the QGIS Development Team
+    email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsgdalblockreader.h"
+#include "qgsgdalproviderbase.h"
+#include "qgslogger.h"
+
+#include <QCache>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+#include <QThread>
+#include <QtConcurrentMap>
+
+#include <cstring>
+
+// smaller blocks (e.g. single row strips) are read directly
+static const int MIN_BLOCK_PIXELS = 4096;
+
+/// @cond
+
+// decoded window of a band, aligned to the blocks of the band
+struct QgsGdalBlock
+{
+  QgsGdalBlock() : xOff( 0 ), yOff( 0 ), width( 0 ), height( 0 ) {}
+
+  QByteArray data;
+  int xOff;
+  int yOff;
+  int width;
+  int height;
+};
+
+class QgsGdalBlockCache
+{
+  public:
+    QgsGdalBlockCache() : mCache( 64 * 1024 ), mHits( 0 ) {}
+
+    bool find( const QString& key, QgsGdalBlock& block )
+    {
+      QMutexLocker locker( &mMutex );
+      QgsGdalBlock* cached = mCache.object( key );
+      if ( !cached )
+        return false;
+
+      block = *cached;
+      mHits++;
+      return true;
+    }
+
+    int hits()
+    {
+      QMutexLocker locker( &mMutex );
+      return mHits;
+    }
+
+    void insert( const QString& key, const QgsGdalBlock& block )
+    {
+      QMutexLocker locker( &mMutex );
+      // cost in kB
+      mCache.insert( key, new QgsGdalBlock( block ), block.data.size() / 1024 + 1 );
+    }
+
+    void setMaxCost( int kB )
+    {
+      QMutexLocker locker( &mMutex );
+      mCache.setMaxCost( kB );
+    }
+
+    int maxCost()
+    {
+      QMutexLocker locker( &mMutex );
+      return mCache.maxCost();
+    }
+
+    void clear()
+    {
+      QMutexLocker locker( &mMutex );
+      mCache.clear();
+    }
+
+  private:
+    QMutex mMutex;
+    QCache<QString, QgsGdalBlock> mCache;
+    int mHits;
+};
+
+// read-only dataset handles of data sources, so that each decoding thread has its own handle.
+// The idle handles of a data source are closed when its last reader is destroyed.
+class QgsGdalDatasetPool
+{
+  public:
+    void addReader( const QString& uri )
+    {
+      QMutexLocker locker( &mMutex );
+      mHandles[uri].readers++;
+    }
+
+    void removeReader( const QString& uri )
+    {
+      QMutexLocker locker( &mMutex );
+      QHash<QString, Handles>::iterator it = mHandles.find( uri );
+      if ( it == mHandles.end() || --it->readers > 0 )
+        return;
+
+      closeAll( it->idle );
+      mHandles.erase( it );
+    }
+
+    GDALDatasetH acquire( const QString& uri, const QString& key )
+    {
+      {
+        QMutexLocker locker( &mMutex );
+        Handles& handles = mHandles[uri];
+        if ( handles.key != key )
+        {
+          // the data source has changed
+          closeAll( handles.idle );
+          handles.key = key;
+        }
+        if ( !handles.idle.isEmpty() )
+          return handles.idle.takeLast();
+      }
+
+      return QgsGdalProviderBase::gdalOpen( TO8F( uri ), GA_ReadOnly );
+    }
+
+    void release( const QString& uri, const QString& key, GDALDatasetH dataset )
+    {
+      QMutexLocker locker( &mMutex );
+      QHash<QString, Handles>::iterator it = mHandles.find( uri );
+      if ( it == mHandles.end() || it->readers == 0 || it->key != key || it->idle.count() >= QThread::idealThreadCount() )
+      {
+        GDALClose( dataset );
+        return;
+      }
+      it->idle.append( dataset );
+    }
+
+    void clear()
+    {
+      QMutexLocker locker( &mMutex );
+      for ( QHash<QString, Handles>::iterator it = mHandles.begin(); it != mHandles.end(); ++it )
+        closeAll( it->idle );
+      mHandles.clear();
+    }
+
+  private:
+    struct Handles
+    {
+      Handles() : readers( 0 ) {}
+
+      int readers;
+      QString key;
+      QList<GDALDatasetH> idle;
+    };
+
+    QMutex mMutex;
+    QHash<QString, Handles> mHandles;
+
+    static void closeAll( QList<GDALDatasetH>& datasets )
+    {
+      Q_FOREACH ( GDALDatasetH dataset, datasets )
+        GDALClose( dataset );
+      datasets.clear();
+    }
+};
+
+static QgsGdalBlockCache sBlockCache;
+static QgsGdalDatasetPool sDatasetPool;
+
+// block to be decoded by one thread
+struct QgsGdalBlockTask
+{
+  QString uri;
+  QString key;
+  QString cacheKey;
+  int bandNo;
+  GDALDataType type;
+  QgsGdalBlock block;
+  bool ok;
+};
+
+static bool readBlockWindow( GDALDatasetH dataset, QgsGdalBlockTask& task )
+{
+  GDALRasterBandH band = GDALGetRasterBand( dataset, task.bandNo );
+  if ( !band )
+    return false;
+
+  QgsGdalBlock& block = task.block;
+  block.data.resize( block.width * block.height * ( GDALGetDataTypeSize( task.type ) / 8 ) );
+  CPLErr err = QgsGdalProviderBase::gdalRasterIO( band, GF_Read, block.xOff, block.yOff, block.width, block.height,
+               block.data.data(), block.width, block.height, task.type, 0, 0 );
+  return err == CE_None;
+}
+
+static void decodeBlock( QgsGdalBlockTask& task )
+{
+  GDALDatasetH dataset = sDatasetPool.acquire( task.uri, task.key );
+  if ( !dataset )
+  {
+    task.ok = false;
+    return;
+  }
+
+  task.ok = readBlockWindow( dataset, task );
+  sDatasetPool.release( task.uri, task.key, dataset );
+}
+
+// copies the part of a block inside the window to the window buffer
+static void copyBlock( const QgsGdalBlock& block, int dataSize, int xOff, int yOff, int width, int height, char* data )
+{
+  int left = qMax( xOff, block.xOff );
+  int right = qMin( xOff + width, block.xOff + block.width );
+  int top = qMax( yOff, block.yOff );
+  int bottom = qMin( yOff + height, block.yOff + block.height );
+  if ( left >= right || top >= bottom )
+    return;
+
+  const char* src = block.data.constData();
+  for ( int row = top; row < bottom; ++row )
+  {
+    memcpy( data + (( row - yOff ) * width + left - xOff ) * dataSize,
+            src + (( row - block.yOff ) * block.width + left - block.xOff ) * dataSize,
+            ( right - left ) * dataSize );
+  }
+}
+
+/// @endcond
+
+QgsGdalBlockReader::QgsGdalBlockReader( const QString& uri, GDALDatasetH dataset )
+    : mValid( false )
+    , mUri( uri )
+    , mXSize( 0 )
+    , mYSize( 0 )
+    , mXBlockSize( 0 )
+    , mYBlockSize( 0 )
+{
+  QSettings settings;
+  setCacheSize( settings.value( "/qgis/gdalBlockCacheSize", 64 ).toInt() );
+  if ( cacheSize() <= 0 || !dataset || GDALGetRasterCount( dataset ) < 1 )
+    return;
+
+  mXSize = GDALGetRasterXSize( dataset );
+  mYSize = GDALGetRasterYSize( dataset );
+  GDALGetBlockSize( GDALGetRasterBand( dataset, 1 ), &mXBlockSize, &mYBlockSize );
+  if ( mXBlockSize <= 0 || mYBlockSize <= 0 || mXBlockSize * mYBlockSize < MIN_BLOCK_PIXELS )
+    return;
+
+  if ( mXBlockSize >= mXSize && mYBlockSize >= mYSize )
+    return; // a single block
+
+  // blocks of the previous version of a file must not be found in the cache
+  mKey = uri;
+  QFileInfo fileInfo( uri );
+  if ( fileInfo.exists() )
+    mKey += '|' + QString::number( fileInfo.lastModified().toMSecsSinceEpoch() );
+
+  sDatasetPool.addReader( mUri );
+  mValid = true;
+}
+
+QgsGdalBlockReader::~QgsGdalBlockReader()
+{
+  if ( mValid )
+    sDatasetPool.removeReader( mUri );
+}
+
+bool QgsGdalBlockReader::read( GDALDatasetH dataset, int bandNo, GDALDataType type, int xOff, int yOff, int width, int height, void* data )
+{
+  if ( !mValid || width <= 0 || height <= 0 || xOff < 0 || yOff < 0 || xOff + width > mXSize || yOff + height > mYSize )
+    return false;
+
+  int dataSize = GDALGetDataTypeSize( type ) / 8;
+  char* buffer = static_cast<char*>( data );
+
+  QList<QgsGdalBlockTask> missing;
+  for ( int yBlock = yOff / mYBlockSize; yBlock <= ( yOff + height - 1 ) / mYBlockSize; ++yBlock )
+  {
+    for ( int xBlock = xOff / mXBlockSize; xBlock <= ( xOff + width - 1 ) / mXBlockSize; ++xBlock )
+    {
+      QgsGdalBlockTask task;
+      task.cacheKey = QString( "%1|%2|%3|%4|%5" ).arg( mKey ).arg( bandNo ).arg( type ).arg( xBlock ).arg( yBlock );
+      if ( sBlockCache.find( task.cacheKey, task.block ) )
+      {
+        copyBlock( task.block, dataSize, xOff, yOff, width, height, buffer );
+        continue;
+      }
+
+      task.uri = mUri;
+      task.key = mKey;
+      task.bandNo = bandNo;
+      task.type = type;
+      task.block.xOff = xBlock * mXBlockSize;
+      task.block.yOff = yBlock * mYBlockSize;
+      task.block.width = qMin( mXBlockSize, mXSize - task.block.xOff );
+      task.block.height = qMin( mYBlockSize, mYSize - task.block.yOff );
+      task.ok = false;
+      missing << task;
+    }
+  }
+
+  if ( missing.size() == 1 || QThread::idealThreadCount() < 2 )
+  {
+    // not worth other threads, the provider's dataset is used
+    for ( int i = 0; i < missing.size(); ++i )
+      missing[i].ok = readBlockWindow( dataset, missing[i] );
+  }
+  else if ( !missing.isEmpty() )
+  {
+    QtConcurrent::blockingMap( missing, decodeBlock );
+  }
+
+  bool ok = true;
+  Q_FOREACH ( const QgsGdalBlockTask& task, missing )
+  {
+    if ( !task.ok )
+    {
+      QgsDebugMsg( QString( "Reading block at %1,%2 of band %3 failed" ).arg( task.block.xOff ).arg( task.block.yOff ).arg( bandNo ) );
+      ok = false;
+      continue;
+    }
+    sBlockCache.insert( task.cacheKey, task.block );
+    copyBlock( task.block, dataSize, xOff, yOff, width, height, buffer );
+  }
+  return ok;
+}
+
+void QgsGdalBlockReader::setCacheSize( int sizeMB )
+{
+  sBlockCache.setMaxCost( qMax( 0, sizeMB ) * 1024 );
+}
+
+int QgsGdalBlockReader::cacheSize()
+{
+  return sBlockCache.maxCost() / 1024;
+}
+
+int QgsGdalBlockReader::cacheHits()
+{
+  return sBlockCache.hits();
+}
+
+void QgsGdalBlockReader::cleanup()
+{
+  sBlockCache.clear();
+  sDatasetPool.clear();
+}
@@ -0,0 +1,87 @@
+/***************************************************************************
+    qgsgdalblockreader.h  -  block aligned reading of GDAL rasters
+    ---------------------
+    begin                : November 2015
+    copyright            : (C) 2015 by the QGIS Development Team
+    email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSGDALBLOCKREADER_H
+#define QGSGDALBLOCKREADER_H
+
+#include <QString>
+
+#include <gdal.h>
+
+/**
+  \brief Reads full resolution windows of a GDAL raster by its native blocks.
+
+  Blocks which are not cached are decoded in parallel, each thread with its own dataset
+  handle from a pool of read-only handles of the data source, which are closed when the last
+  reader of the data source is destroyed. Decoded blocks are kept in a
+  least recently used cache shared by all readers of the process, so that renderers of
+  the same source (e.g. clones of a provider) do not decode a block twice.
+
+  The cache size is read from the "/qgis/gdalBlockCacheSize" setting (in MB, 0 disables the reader).
+*/
+class QgsGdalBlockReader
+{
+  public:
+    /**
+     * @param uri data source to open additional dataset handles with
+     * @param dataset dataset of the provider, to get the raster and block size from
+     */
+    QgsGdalBlockReader( const QString& uri, GDALDatasetH dataset );
+    ~QgsGdalBlockReader();
+
+    /** Returns false if the reader cannot be used for the dataset (untiled rasters or disabled cache) */
+    bool isValid() const { return mValid; }
+
+    /**
+     * Reads a window of a band at full resolution, the result is the same as of GDALRasterIO
+     * with a buffer of the size of the window
+     * @param dataset dataset of the provider, used for reading in the calling thread
+     * @param bandNo band number (from 1)
+     * @param type data type of the buffer
+     * @param xOff column of the first pixel
+     * @param yOff row of the first pixel
+     * @param width width of the window
+     * @param height height of the window
+     * @param data buffer of width * height values
+     * @returns false if reading failed
+     */
+    bool read( GDALDatasetH dataset, int bandNo, GDALDataType type, int xOff, int yOff, int width, int height, void* data );
+
+    /** Sets the maximum size of the shared block cache in MB */
+    static void setCacheSize( int sizeMB );
+
+    /** Returns the maximum size of the shared block cache in MB */
+    static int cacheSize();
+
+    /** Returns the number of blocks found in the shared block cache since the provider library was loaded */
+    static int cacheHits();
+
+    /** Removes all blocks from the cache and closes unused dataset handles. Called when the provider library is unloaded. */
+    static void cleanup();
+
+  private:
+    Q_DISABLE_COPY( QgsGdalBlockReader )
+
+    bool mValid;
+    QString mUri;
+    //! identifies the data source in the cache, changes when the file changes
+    QString mKey;
+    int mXSize;
+    int mYSize;
+    int mXBlockSize;
+    int mYBlockSize;
+};
+
+#endif // QGSGDALBLOCKREADER_H
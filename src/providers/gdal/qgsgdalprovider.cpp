@@ -19,6 +19,7 @@
 #include "qgslogger.h"
 #include "qgsgdalproviderbase.h"
 #include "qgsgdalprovider.h"
+#include "qgsgdalblockreader.h"
 #include "qgsconfig.h"
 
 #include "qgsapplication.h"
@@ -106,6 +107,7 @@ QgsGdalProvider::QgsGdalProvider( const QString &uri, QgsError error )
     , mGdalBaseDataset( 0 )
     , mGdalDataset( 0 )
     , mGeoTransform()
+    , mBlockReader( 0 )
 {
   setError( error );
 }
@@ -122,6 +124,7 @@ QgsGdalProvider::QgsGdalProvider( const QString &uri, bool update )
     , mYBlockSize( 0 )
     , mGdalBaseDataset( 0 )
     , mGdalDataset( 0 )
+    , mBlockReader( 0 )
 {
   QgsDebugMsg( "constructing with uri '" + uri + "'." );
 
@@ -213,6 +216,7 @@ bool QgsGdalProvider::crsFromWkt( const char *wkt )
 QgsGdalProvider::~QgsGdalProvider()
 {
   QgsDebugMsg( "entering." );
+  delete mBlockReader;
   if ( mGdalBaseDataset )
   {
     GDALDereferenceDataset( mGdalBaseDataset );
@@ -233,6 +237,9 @@ void QgsGdalProvider::closeDataset()
   }
   mValid = false;
 
+  delete mBlockReader;
+  mBlockReader = 0;
+
   GDALDereferenceDataset( mGdalBaseDataset );
   mGdalBaseDataset = NULL;
 
@@ -595,11 +602,18 @@ void QgsGdalProvider::readBlock( int theBandNo, QgsRectangle  const & theExtent,
   GDALRasterBandH gdalBand = GDALGetRasterBand( mGdalDataset, theBandNo );
   GDALDataType type = ( GDALDataType )mGdalDataType[theBandNo-1];
   CPLErrorReset();
-  CPLErr err = gdalRasterIO( gdalBand, GF_Read,
-                             srcLeft, srcTop, srcWidth, srcHeight,
-                             ( void * )tmpBlock,
-                             tmpWidth, tmpHeight, type,
-                             0, 0 );
+  CPLErr err = CE_None;
+  // windows at full resolution are assembled from (cached) blocks, decoded in parallel
+  bool blockRead = mBlockReader && tmpWidth == srcWidth && tmpHeight == srcHeight &&
+                   mBlockReader->read( mGdalDataset, theBandNo, type, srcLeft, srcTop, srcWidth, srcHeight, tmpBlock );
+  if ( !blockRead )
+  {
+    err = gdalRasterIO( gdalBand, GF_Read,
+                        srcLeft, srcTop, srcWidth, srcHeight,
+                        ( void * )tmpBlock,
+                        tmpWidth, tmpHeight, type,
+                        0, 0 );
+  }
 
   if ( err != CPLE_None )
   {
@@ -2700,6 +2714,18 @@ void QgsGdalProvider::initBaseDataset()
     //QgsDebugMsg( QString( "mInternalNoDataValue[%1] = %2" ).arg( i - 1 ).arg( mInternalNoDataValue[i-1] ) );
   }
 
+  // blocks are read from other handles of the data source, which only see
+  // saved changes and are not warped
+  if ( !mUpdate && mGdalDataset == mGdalBaseDataset )
+  {
+    mBlockReader = new QgsGdalBlockReader( dataSourceUri(), mGdalDataset );
+    if ( !mBlockReader->isValid() )
+    {
+      delete mBlockReader;
+      mBlockReader = 0;
+    }
+  }
+
   mValid = true;
 }
 
@@ -3004,7 +3030,16 @@ QGISEXTERN QList<QPair<QString, QString> > *pyramidResamplingMethods()
   return &methods;
 }
 
+/**
+  Number of raster blocks read from the block cache of the provider, for diagnostics
+*/
+QGISEXTERN int blockCacheHits()
+{
+  return QgsGdalBlockReader::cacheHits();
+}
+
 QGISEXTERN void cleanupProvider()
 {
+  QgsGdalBlockReader::cleanup();
   GDALDestroyDriverManager();
 }
@@ -33,6 +33,8 @@
 #include <QMap>
 #include <QVector>
 
+class QgsGdalBlockReader;
+
 class QgsRasterPyramid;
 
 /** \ingroup core
@@ -303,6 +305,9 @@ class QgsGdalProvider : public QgsRasterDataProvider, QgsGdalProviderBase
 
     /** \brief sublayers list saved for subsequent access */
     QStringList mSubLayers;
+
+    /** \brief Reader of full resolution windows by blocks, null if not used for the dataset */
+    QgsGdalBlockReader* mBlockReader;
 };
 
 #endif
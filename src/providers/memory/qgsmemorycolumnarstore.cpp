@@ -0,0 +1,397 @@
+/***************************************************************************
+    qgsmemorycolumnarstore.cpp
+    ---------------------
+    begin                : November 2015
+    copyright            : (C) 2015 by the QGIS Development Team
+    email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsmemorycolumnarstore.h"
+
+#include "qgsgeometry.h"
+#include "qgsgeometryfactory.h"
+
+#include <QDate>
+
+// deleted rows are only dropped when there are at least this many of them
+static const int MIN_DELETED_ROWS_TO_COMPACT = 1024;
+
+QgsMemoryColumnarStore::QgsMemoryColumnarStore()
+    : mDeletedCount( 0 )
+    , mWkbUnused( 0 )
+{
+}
+
+void QgsMemoryColumnarStore::addColumn( QVariant::Type type )
+{
+  Column column;
+  column.type = type;
+  for ( int row = 0; row < mIds.count(); ++row )
+    setValue( column, row, QVariant() );
+  mColumns.append( column );
+}
+
+void QgsMemoryColumnarStore::removeColumn( int index )
+{
+  if ( index < 0 || index >= mColumns.count() )
+    return;
+
+  mColumns.remove( index );
+}
+
+void QgsMemoryColumnarStore::addFeature( QgsFeatureId fid, const QgsFeature& feature )
+{
+  Q_ASSERT( mIds.isEmpty() || fid > mIds.last() );
+
+  int row = mIds.count();
+  mIds.append( fid );
+  mDeleted.append( false );
+
+  const QgsAttributes& attributes = feature.attributes();
+  for ( int i = 0; i < mColumns.count(); ++i )
+  {
+    setValue( mColumns[i], row, i < attributes.count() ? attributes.at( i ) : QVariant() );
+  }
+
+  mWkbOffsets.append( -1 );
+  mWkbSizes.append( 0 );
+  mBoxes << 0.0 << 0.0 << 0.0 << 0.0;
+  setGeometry( row, feature.constGeometry() );
+}
+
+bool QgsMemoryColumnarStore::deleteFeature( QgsFeatureId fid )
+{
+  int r = row( fid );
+  if ( r < 0 )
+    return false;
+
+  mDeleted[r] = true;
+  ++mDeletedCount;
+  setGeometry( r, 0 );
+
+  compactIfNeeded();
+  return true;
+}
+
+bool QgsMemoryColumnarStore::changeAttributeValue( QgsFeatureId fid, int field, const QVariant& value )
+{
+  int r = row( fid );
+  if ( r < 0 || field < 0 || field >= mColumns.count() )
+    return false;
+
+  setValue( mColumns[field], r, value );
+  return true;
+}
+
+bool QgsMemoryColumnarStore::changeGeometry( QgsFeatureId fid, const QgsGeometry* geometry )
+{
+  int r = row( fid );
+  if ( r < 0 )
+    return false;
+
+  setGeometry( r, geometry );
+
+  compactIfNeeded();
+  return true;
+}
+
+int QgsMemoryColumnarStore::row( QgsFeatureId fid ) const
+{
+  QVector<QgsFeatureId>::const_iterator it = qLowerBound( mIds.constBegin(), mIds.constEnd(), fid );
+  if ( it == mIds.constEnd() || *it != fid )
+    return -1;
+
+  int r = it - mIds.constBegin();
+  return mDeleted.at( r ) ? -1 : r;
+}
+
+QgsRectangle QgsMemoryColumnarStore::boundingBox( int row ) const
+{
+  if ( !hasGeometry( row ) )
+    return QgsRectangle();
+
+  const double* box = mBoxes.constData() + 4 * row;
+  return QgsRectangle( box[0], box[1], box[2], box[3] );
+}
+
+QgsGeometry* QgsMemoryColumnarStore::geometry( int row ) const
+{
+  qint64 offset = mWkbOffsets.at( row );
+  if ( offset < 0 )
+    return 0;
+
+  QgsAbstractGeometryV2* geom = QgsGeometryFactory::geomFromWkb( reinterpret_cast<const unsigned char*>( mWkb.constData() + offset ) );
+  if ( !geom )
+    return 0;
+
+  return new QgsGeometry( geom );
+}
+
+QVariant QgsMemoryColumnarStore::attribute( int row, int field ) const
+{
+  if ( field < 0 || field >= mColumns.count() )
+    return QVariant();
+
+  return value( mColumns.at( field ), row );
+}
+
+void QgsMemoryColumnarStore::readFeature( int row, QgsFeature& feature, bool readGeometry, const QgsAttributeList* attributes ) const
+{
+  feature.setFeatureId( mIds.at( row ) );
+
+  QgsAttributes values( mColumns.count() );
+  if ( attributes )
+  {
+    Q_FOREACH ( int field, *attributes )
+    {
+      if ( field >= 0 && field < mColumns.count() )
+        values[field] = value( mColumns.at( field ), row );
+    }
+  }
+  else
+  {
+    for ( int field = 0; field < mColumns.count(); ++field )
+      values[field] = value( mColumns.at( field ), row );
+  }
+  feature.setAttributes( values );
+
+  if ( readGeometry )
+    feature.setGeometry( geometry( row ) );
+  else
+    feature.setGeometry( 0 );
+}
+
+QgsRectangle QgsMemoryColumnarStore::extent() const
+{
+  QgsRectangle rect;
+  rect.setMinimal();
+  for ( int row = 0; row < mIds.count(); ++row )
+  {
+    if ( hasGeometry( row ) )
+      rect.unionRect( boundingBox( row ) );
+  }
+  return rect;
+}
+
+void QgsMemoryColumnarStore::setValue( Column& column, int row, const QVariant& value )
+{
+  char state;
+  if ( !value.isValid() )
+    state = NullValue;
+  else if ( value.type() == column.type && !value.isNull() &&
+            ( column.type == QVariant::Int || column.type == QVariant::LongLong ||
+              column.type == QVariant::Double || column.type == QVariant::String ||
+              column.type == QVariant::Date ) )
+    state = StoredValue;
+  else
+    state = OtherValue;
+
+  qint64 integer = 0;
+  double number = 0.0;
+  QString string;
+  if ( state == StoredValue )
+  {
+    switch ( column.type )
+    {
+      case QVariant::Int:
+      case QVariant::LongLong:
+        integer = value.toLongLong();
+        break;
+      case QVariant::Date:
+        integer = value.toDate().toJulianDay();
+        break;
+      case QVariant::Double:
+        number = value.toDouble();
+        break;
+      default:
+        string = value.toString();
+        break;
+    }
+  }
+
+  // only the array matching the type of the column is filled
+  bool append = row == column.states.count();
+  switch ( column.type )
+  {
+    case QVariant::Int:
+    case QVariant::LongLong:
+    case QVariant::Date:
+      if ( append )
+        column.integers.append( integer );
+      else
+        column.integers[row] = integer;
+      break;
+    case QVariant::Double:
+      if ( append )
+        column.doubles.append( number );
+      else
+        column.doubles[row] = number;
+      break;
+    case QVariant::String:
+      if ( append )
+        column.strings.append( string );
+      else
+        column.strings[row] = string;
+      break;
+    default:
+      break;
+  }
+
+  if ( append )
+    column.states.append( state );
+  else
+    column.states[row] = state;
+
+  if ( state == OtherValue )
+    column.others.insert( row, value );
+  else if ( !append )
+    column.others.remove( row );
+}
+
+QVariant QgsMemoryColumnarStore::value( const Column& column, int row )
+{
+  switch ( column.states.at( row ) )
+  {
+    case NullValue:
+      return QVariant();
+    case OtherValue:
+      return column.others.value( row );
+    default:
+      break;
+  }
+
+  switch ( column.type )
+  {
+    case QVariant::Int:
+      return QVariant( static_cast<int>( column.integers.at( row ) ) );
+    case QVariant::LongLong:
+      return QVariant( column.integers.at( row ) );
+    case QVariant::Date:
+      return QVariant( QDate::fromJulianDay( static_cast<int>( column.integers.at( row ) ) ) );
+    case QVariant::Double:
+      return QVariant( column.doubles.at( row ) );
+    case QVariant::String:
+      return QVariant( column.strings.at( row ) );
+    default:
+      return QVariant();
+  }
+}
+
+void QgsMemoryColumnarStore::setGeometry( int row, const QgsGeometry* geometry )
+{
+  if ( mWkbOffsets.at( row ) >= 0 )
+  {
+    mWkbUnused += mWkbSizes.at( row );
+    mWkbOffsets[row] = -1;
+    mWkbSizes[row] = 0;
+  }
+
+  double* box = mBoxes.data() + 4 * row;
+  box[0] = box[1] = box[2] = box[3] = 0.0;
+
+  if ( !geometry || geometry->isEmpty() )
+    return;
+
+  const unsigned char* wkb = geometry->asWkb();
+  int size = geometry->wkbSize();
+  if ( !wkb || size <= 0 )
+    return;
+
+  mWkbOffsets[row] = mWkb.size();
+  mWkbSizes[row] = size;
+  mWkb.append( reinterpret_cast<const char*>( wkb ), size );
+
+  QgsRectangle rect = geometry->boundingBox();
+  box[0] = rect.xMinimum();
+  box[1] = rect.yMinimum();
+  box[2] = rect.xMaximum();
+  box[3] = rect.yMaximum();
+}
+
+void QgsMemoryColumnarStore::compactIfNeeded()
+{
+  bool dropRows = mDeletedCount >= MIN_DELETED_ROWS_TO_COMPACT && mDeletedCount * 2 >= mIds.count();
+  bool dropWkb = mWkbUnused > 0 && mWkbUnused * 2 >= mWkb.size();
+  if ( !dropRows && !dropWkb )
+    return;
+
+  int rowCount = dropRows ? mIds.count() - mDeletedCount : mIds.count();
+
+  QVector<QgsFeatureId> ids;
+  QVector<bool> deleted;
+  QVector<qint64> wkbOffsets;
+  QVector<int> wkbSizes;
+  QVector<double> boxes;
+  QVector<int> rowMap;
+  ids.reserve( rowCount );
+  deleted.reserve( rowCount );
+  wkbOffsets.reserve( rowCount );
+  wkbSizes.reserve( rowCount );
+  boxes.reserve( 4 * rowCount );
+  rowMap.reserve( rowCount );
+
+  QByteArray wkb;
+  wkb.reserve( mWkb.size() - mWkbUnused );
+
+  for ( int row = 0; row < mIds.count(); ++row )
+  {
+    if ( dropRows && mDeleted.at( row ) )
+      continue;
+
+    rowMap.append( row );
+    ids.append( mIds.at( row ) );
+    deleted.append( mDeleted.at( row ) );
+    if ( mWkbOffsets.at( row ) >= 0 )
+    {
+      wkbOffsets.append( wkb.size() );
+      wkb.append( mWkb.constData() + mWkbOffsets.at( row ), mWkbSizes.at( row ) );
+    }
+    else
+    {
+      wkbOffsets.append( -1 );
+    }
+    wkbSizes.append( mWkbSizes.at( row ) );
+    const double* box = mBoxes.constData() + 4 * row;
+    boxes << box[0] << box[1] << box[2] << box[3];
+  }
+
+  if ( dropRows )
+  {
+    for ( int i = 0; i < mColumns.count(); ++i )
+    {
+      const Column& column = mColumns.at( i );
+      Column compacted;
+      compacted.type = column.type;
+      compacted.states.reserve( rowCount );
+      for ( int newRow = 0; newRow < rowMap.count(); ++newRow )
+      {
+        int row = rowMap.at( newRow );
+        compacted.states.append( column.states.at( row ) );
+        if ( !column.integers.isEmpty() )
+          compacted.integers.append( column.integers.at( row ) );
+        if ( !column.doubles.isEmpty() )
+          compacted.doubles.append( column.doubles.at( row ) );
+        if ( !column.strings.isEmpty() )
+          compacted.strings.append( column.strings.at( row ) );
+        if ( column.states.at( row ) == OtherValue )
+          compacted.others.insert( newRow, column.others.value( row ) );
+      }
+      mColumns[i] = compacted;
+    }
+    mDeletedCount = 0;
+  }
+
+  mIds = ids;
+  mDeleted = deleted;
+  mWkbOffsets = wkbOffsets;
+  mWkbSizes = wkbSizes;
+  mBoxes = boxes;
+  mWkb = wkb;
+  mWkbUnused = 0;
+}
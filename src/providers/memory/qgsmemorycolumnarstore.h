@@ -0,0 +1,153 @@
+/***************************************************************************
+    qgsmemorycolumnarstore.h
+    ---------------------
+    begin                : November 2015
+    copyright            : (C) 2015 by the QGIS Development Team
+    email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSMEMORYCOLUMNARSTORE_H
+#define QGSMEMORYCOLUMNARSTORE_H
+
+#include "qgsfeature.h"
+#include "qgsrectangle.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+class QgsGeometry;
+
+/**
+ * Column oriented feature storage of the memory provider.
+ *
+ * Attribute values are kept in typed arrays, one per field, and geometries as
+ * WKB in a single byte array with a table of offsets. Values which do not match
+ * the type of their field are stored aside, so features are returned unchanged.
+ *
+ * Rows are kept in the order of ascending feature ids, feature ids of new features
+ * have to be larger than the ids of all stored features. Deleted rows and replaced
+ * geometries are dropped once they make up half of the storage.
+ *
+ * All data is held in implicitly shared containers, copies are cheap until modified.
+ */
+class QgsMemoryColumnarStore
+{
+  public:
+    QgsMemoryColumnarStore();
+
+    //! Number of features
+    int featureCount() const { return mIds.count() - mDeletedCount; }
+
+    //! Number of rows, including deleted ones
+    int rowCount() const { return mIds.count(); }
+
+    //! Appends a column for a field of given type, existing rows get NULL values
+    void addColumn( QVariant::Type type );
+
+    //! Removes column of the field with given index
+    void removeColumn( int index );
+
+    /** Appends a feature. Missing attributes are stored as NULL values, surplus ones are dropped.
+     * @param fid feature id, larger than the ids of all stored features
+     * @param feature feature with attributes and geometry to store
+     */
+    void addFeature( QgsFeatureId fid, const QgsFeature& feature );
+
+    //! Deletes a feature, returns false if there is no such feature
+    bool deleteFeature( QgsFeatureId fid );
+
+    //! Changes an attribute value, returns false if there is no such feature or field
+    bool changeAttributeValue( QgsFeatureId fid, int field, const QVariant& value );
+
+    //! Changes the geometry of a feature, returns false if there is no such feature
+    bool changeGeometry( QgsFeatureId fid, const QgsGeometry* geometry );
+
+    //! Returns row of a feature or -1 if there is no such feature
+    int row( QgsFeatureId fid ) const;
+
+    bool isDeleted( int row ) const { return mDeleted.at( row ); }
+
+    QgsFeatureId featureId( int row ) const { return mIds.at( row ); }
+
+    bool hasGeometry( int row ) const { return mWkbOffsets.at( row ) >= 0; }
+
+    //! Bounding box of the geometry of a row
+    QgsRectangle boundingBox( int row ) const;
+
+    //! Returns a new geometry for a row or 0 if the row has no geometry, caller takes ownership
+    QgsGeometry* geometry( int row ) const;
+
+    //! Returns value of an attribute
+    QVariant attribute( int row, int field ) const;
+
+    /** Fills a feature with the values of a row
+     * @param row row to read
+     * @param feature feature to fill (id, geometry and attributes are set)
+     * @param readGeometry false to leave the feature without geometry
+     * @param attributes indices of the attributes to read, all attributes if null
+     */
+    void readFeature( int row, QgsFeature& feature, bool readGeometry, const QgsAttributeList* attributes = 0 ) const;
+
+    //! Returns union of the bounding boxes of all geometries, a minimal rectangle if there are no geometries
+    QgsRectangle extent() const;
+
+  private:
+
+    //! How a value of a column is stored
+    enum ValueState
+    {
+      StoredValue,  //!< in the typed array of the column
+      NullValue,    //!< invalid variant
+      OtherValue    //!< variant of another type, in the others hash
+    };
+
+    struct Column
+    {
+      QVariant::Type type;
+      //! Int, LongLong and Date (as julian day) values
+      QVector<qint64> integers;
+      //! Double values
+      QVector<double> doubles;
+      //! String values
+      QVector<QString> strings;
+      //! ValueState for each row
+      QVector<char> states;
+      //! Values not matching the type of the column, by row
+      QHash<int, QVariant> others;
+    };
+
+    //! Sets value of a row, row equal to the number of values appends it
+    static void setValue( Column& column, int row, const QVariant& value );
+    static QVariant value( const Column& column, int row );
+
+    void setGeometry( int row, const QgsGeometry* geometry );
+
+    //! Drops deleted rows and unused WKB if they make up half of the storage
+    void compactIfNeeded();
+
+    QVector<QgsFeatureId> mIds;
+    QVector<bool> mDeleted;
+    int mDeletedCount;
+
+    QVector<Column> mColumns;
+
+    QByteArray mWkb;
+    //! Offset of the WKB of each row in mWkb, -1 for rows without geometry
+    QVector<qint64> mWkbOffsets;
+    QVector<int> mWkbSizes;
+    //! Bytes of mWkb not used by any row
+    qint64 mWkbUnused;
+    //! Bounding boxes of the rows: xmin, ymin, xmax, ymax
+    QVector<double> mBoxes;
+};
+
+#endif // QGSMEMORYCOLUMNARSTORE_H
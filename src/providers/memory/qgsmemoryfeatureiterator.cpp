@@ -25,6 +25,7 @@
 QgsMemoryFeatureIterator::QgsMemoryFeatureIterator( QgsMemoryFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource<QgsMemoryFeatureSource>( source, ownSource, request )
     , mSelectRectGeom( 0 )
+    , mRow( 0 )
     , mSubsetExpression( 0 )
 {
   if ( !mSource->mSubsetString.isEmpty() )
@@ -49,9 +50,17 @@ QgsMemoryFeatureIterator::QgsMemoryFeatureIterator( QgsMemoryFeatureSource* sour
   else if ( mRequest.filterType() == QgsFeatureRequest::FilterFid )
   {
     mUsingFeatureIdList = true;
-    QgsFeatureMap::const_iterator it = mSource->mFeatures.find( mRequest.filterFid() );
-    if ( it != mSource->mFeatures.end() )
-      mFeatureIdList.append( mRequest.filterFid() );
+    if ( mSource->mColumnar )
+    {
+      if ( mSource->mStore.row( mRequest.filterFid() ) >= 0 )
+        mFeatureIdList.append( mRequest.filterFid() );
+    }
+    else
+    {
+      QgsFeatureMap::const_iterator it = mSource->mFeatures.find( mRequest.filterFid() );
+      if ( it != mSource->mFeatures.end() )
+        mFeatureIdList.append( mRequest.filterFid() );
+    }
   }
   else
   {
@@ -76,7 +85,9 @@ bool QgsMemoryFeatureIterator::fetchFeature( QgsFeature& feature )
   if ( mClosed )
     return false;
 
-  if ( mUsingFeatureIdList )
+  if ( mSource->mColumnar )
+    return nextFeatureColumnar( feature );
+  else if ( mUsingFeatureIdList )
     return nextFeatureUsingList( feature );
   else
     return nextFeatureTraverseAll( feature );
@@ -183,6 +194,68 @@ bool QgsMemoryFeatureIterator::nextFeatureTraverseAll( QgsFeature& feature )
   return hasFeature;
 }
 
+bool QgsMemoryFeatureIterator::nextFeatureColumnar( QgsFeature& feature )
+{
+  const QgsMemoryColumnarStore& store = mSource->mStore;
+  const QgsRectangle& filterRect = mRequest.filterRect();
+  bool exactIntersect = !filterRect.isNull() && mRequest.flags() & QgsFeatureRequest::ExactIntersect;
+  bool fetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry );
+  // the subset expression may refer to any attribute or to the geometry
+  const QgsAttributeList* attributes = 0;
+  if ( !mSubsetExpression && mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes )
+    attributes = &mRequest.subsetOfAttributes();
+
+  for ( ;; )
+  {
+    int row;
+    if ( mUsingFeatureIdList )
+    {
+      if ( mFeatureIdListIterator == mFeatureIdList.constEnd() )
+        break;
+
+      row = store.row( *mFeatureIdListIterator );
+      ++mFeatureIdListIterator;
+      if ( row < 0 )
+        continue;
+    }
+    else
+    {
+      if ( mRow >= store.rowCount() )
+        break;
+
+      row = mRow++;
+      if ( store.isDeleted( row ) )
+        continue;
+    }
+
+    // cheap test against the stored bounding box first
+    if ( !filterRect.isNull() && ( !store.hasGeometry( row ) || !store.boundingBox( row ).intersects( filterRect ) ) )
+      continue;
+
+    store.readFeature( row, feature, fetchGeometry || exactIntersect || mSubsetExpression, attributes );
+
+    if ( exactIntersect && !( feature.constGeometry() && feature.constGeometry()->intersects( mSelectRectGeom ) ) )
+      continue;
+
+    if ( mSubsetExpression )
+    {
+      mSource->mExpressionContext.setFeature( feature );
+      if ( !mSubsetExpression->evaluate( &mSource->mExpressionContext ).toBool() )
+        continue;
+    }
+
+    if ( !fetchGeometry )
+      feature.setGeometry( 0 );
+
+    feature.setValid( true );
+    feature.setFields( mSource->mFields ); // allow name-based attribute lookups
+    return true;
+  }
+
+  close();
+  return false;
+}
+
 bool QgsMemoryFeatureIterator::rewind()
 {
   if ( mClosed )
@@ -190,6 +263,8 @@ bool QgsMemoryFeatureIterator::rewind()
 
   if ( mUsingFeatureIdList )
     mFeatureIdListIterator = mFeatureIdList.constBegin();
+  else if ( mSource->mColumnar )
+    mRow = 0;
   else
     mSelectIterator = mSource->mFeatures.constBegin();
 
@@ -215,6 +290,8 @@ bool QgsMemoryFeatureIterator::close()
 QgsMemoryFeatureSource::QgsMemoryFeatureSource( const QgsMemoryProvider* p )
     : mFields( p->mFields )
     , mFeatures( p->mFeatures )
+    , mColumnar( p->mColumnar )
+    , mStore( p->mStore )
     , mSpatialIndex( p->mSpatialIndex ? new QgsSpatialIndex( *p->mSpatialIndex ) : 0 )  // just shallow copy
     , mSubsetString( p->mSubsetString )
 {
@@ -17,6 +17,7 @@
 
 #include "qgsfeatureiterator.h"
 #include "qgsexpressioncontext.h"
+#include "qgsmemorycolumnarstore.h"
 
 class QgsMemoryProvider;
 
@@ -36,6 +37,8 @@ class QgsMemoryFeatureSource : public QgsAbstractFeatureSource
   protected:
     QgsFields mFields;
     QgsFeatureMap mFeatures;
+    bool mColumnar;
+    QgsMemoryColumnarStore mStore;
     QgsSpatialIndex* mSpatialIndex;
     QString mSubsetString;
     QgsExpressionContext mExpressionContext;
@@ -64,9 +67,12 @@ class QgsMemoryFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Qgs
 
     bool nextFeatureUsingList( QgsFeature& feature );
     bool nextFeatureTraverseAll( QgsFeature& feature );
+    bool nextFeatureColumnar( QgsFeature& feature );
 
     QgsGeometry* mSelectRectGeom;
     QgsFeatureMap::const_iterator mSelectIterator;
+    //! next row of the columnar storage when traversing all features
+    int mRow;
     bool mUsingFeatureIdList;
     QList<QgsFeatureId> mFeatureIdList;
     QList<QgsFeatureId>::const_iterator mFeatureIdListIterator;
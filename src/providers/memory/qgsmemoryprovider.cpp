@@ -32,6 +32,7 @@ static const QString TEXT_PROVIDER_DESCRIPTION = "Memory provider";
 
 QgsMemoryProvider::QgsMemoryProvider( const QString& uri )
     : QgsVectorDataProvider( uri )
+    , mColumnar( false )
     , mSpatialIndex( 0 )
 {
   // Initialize the geometry with the uri to support old style uri's
@@ -71,6 +72,12 @@ QgsMemoryProvider::QgsMemoryProvider( const QString& uri )
 
   mNextFeatureId = 1;
 
+  // attributes in typed arrays and geometries in one WKB buffer, for large layers
+  if ( url.hasQueryItem( "storage" ) && url.queryItemValue( "storage" ) == "columnar" )
+  {
+    mColumnar = true;
+  }
+
   mNativeTypes
   << QgsVectorDataProvider::NativeType( tr( "Whole number (integer)" ), "integer", QVariant::Int, 0, 10 )
   // Decimal number from OGR/Shapefile/dbf may come with length up to 32 and
@@ -158,7 +165,8 @@ QgsMemoryProvider::QgsMemoryProvider( const QString& uri )
     addAttributes( attributes );
   }
 
-  if ( url.hasQueryItem( "index" ) && url.queryItemValue( "index" ) == "yes" )
+  // columnar storage always has a spatial index, it does not keep the geometries around to filter them quickly
+  if ( mColumnar || ( url.hasQueryItem( "index" ) && url.queryItemValue( "index" ) == "yes" ) )
   {
     createSpatialIndex();
   }
@@ -233,6 +241,10 @@ QString QgsMemoryProvider::dataSourceUri( bool expandAuthConfig ) const
   {
     uri.addQueryItem( "index", "yes" );
   }
+  if ( mColumnar )
+  {
+    uri.addQueryItem( "storage", "columnar" );
+  }
 
   QgsAttributeList attrs = const_cast<QgsMemoryProvider *>( this )->attributeIndexes();
   for ( int i = 0; i < attrs.size(); i++ )
@@ -270,6 +282,9 @@ QGis::WkbType QgsMemoryProvider::geometryType() const
 
 long QgsMemoryProvider::featureCount() const
 {
+  if ( mColumnar )
+    return mStore.featureCount();
+
   return mFeatures.count();
 }
 
@@ -292,9 +307,22 @@ QgsCoordinateReferenceSystem QgsMemoryProvider::crs()
 
 bool QgsMemoryProvider::addFeatures( QgsFeatureList & flist )
 {
+  if ( featureCount() == 0 )
+    mExtent.setMinimal();
+
   // TODO: sanity checks of fields and geometries
   for ( QgsFeatureList::iterator it = flist.begin(); it != flist.end(); ++it )
   {
+    if ( mColumnar )
+    {
+      it->setFeatureId( mNextFeatureId );
+      mStore.addFeature( mNextFeatureId, *it );
+      mSpatialIndex->insertFeature( *it );
+      extendExtent( *it );
+      mNextFeatureId++;
+      continue;
+    }
+
     mFeatures[mNextFeatureId] = *it;
     QgsFeature& newfeat = mFeatures[mNextFeatureId];
     newfeat.setFeatureId( mNextFeatureId );
@@ -304,10 +332,13 @@ bool QgsMemoryProvider::addFeatures( QgsFeatureList & flist )
     if ( mSpatialIndex )
       mSpatialIndex->insertFeature( newfeat );
 
+    extendExtent( newfeat );
+
     mNextFeatureId++;
   }
 
-  updateExtent();
+  if ( featureCount() == 0 )
+    mExtent = QgsRectangle();
 
   return true;
 }
@@ -316,6 +347,19 @@ bool QgsMemoryProvider::deleteFeatures( const QgsFeatureIds & id )
 {
   for ( QgsFeatureIds::const_iterator it = id.begin(); it != id.end(); ++it )
   {
+    if ( mColumnar )
+    {
+      int row = mStore.row( *it );
+      if ( row < 0 )
+        continue;
+
+      if ( mStore.hasGeometry( row ) )
+        mSpatialIndex->deleteFeature( indexEntry( *it, mStore.boundingBox( row ) ) );
+
+      mStore.deleteFeature( *it );
+      continue;
+    }
+
     QgsFeatureMap::iterator fit = mFeatures.find( *it );
 
     // check whether such feature exists
@@ -354,6 +398,12 @@ bool QgsMemoryProvider::addAttributes( const QList<QgsField> &attributes )
     // add new field as a last one
     mFields.append( *it );
 
+    if ( mColumnar )
+    {
+      mStore.addColumn( it->type() );
+      continue;
+    }
+
     for ( QgsFeatureMap::iterator fit = mFeatures.begin(); fit != mFeatures.end(); ++fit )
     {
       QgsFeature& f = fit.value();
@@ -376,6 +426,12 @@ bool QgsMemoryProvider::deleteAttributes( const QgsAttributeIds& attributes )
     int idx = *it;
     mFields.remove( idx );
 
+    if ( mColumnar )
+    {
+      mStore.removeColumn( idx );
+      continue;
+    }
+
     for ( QgsFeatureMap::iterator fit = mFeatures.begin(); fit != mFeatures.end(); ++fit )
     {
       QgsFeature& f = fit.value();
@@ -391,6 +447,14 @@ bool QgsMemoryProvider::changeAttributeValues( const QgsChangedAttributesMap & a
 {
   for ( QgsChangedAttributesMap::const_iterator it = attr_map.begin(); it != attr_map.end(); ++it )
   {
+    if ( mColumnar )
+    {
+      const QgsAttributeMap& attrs = it.value();
+      for ( QgsAttributeMap::const_iterator it2 = attrs.begin(); it2 != attrs.end(); ++it2 )
+        mStore.changeAttributeValue( it.key(), it2.key(), it2.value() );
+      continue;
+    }
+
     QgsFeatureMap::iterator fit = mFeatures.find( it.key() );
     if ( fit == mFeatures.end() )
       continue;
@@ -406,6 +470,23 @@ bool QgsMemoryProvider::changeGeometryValues( QgsGeometryMap & geometry_map )
 {
   for ( QgsGeometryMap::const_iterator it = geometry_map.begin(); it != geometry_map.end(); ++it )
   {
+    if ( mColumnar )
+    {
+      int row = mStore.row( it.key() );
+      if ( row < 0 )
+        continue;
+
+      if ( mStore.hasGeometry( row ) )
+        mSpatialIndex->deleteFeature( indexEntry( it.key(), mStore.boundingBox( row ) ) );
+
+      mStore.changeGeometry( it.key(), &it.value() );
+
+      QgsFeature feature( it.key() );
+      feature.setGeometry( it.value() );
+      mSpatialIndex->insertFeature( feature );
+      continue;
+    }
+
     QgsFeatureMap::iterator fit = mFeatures.find( it.key() );
     if ( fit == mFeatures.end() )
       continue;
@@ -473,10 +554,14 @@ int QgsMemoryProvider::capabilities() const
 
 void QgsMemoryProvider::updateExtent()
 {
-  if ( mFeatures.count() == 0 )
+  if ( featureCount() == 0 )
   {
     mExtent = QgsRectangle();
   }
+  else if ( mColumnar )
+  {
+    mExtent = mStore.extent();
+  }
   else
   {
     mExtent.setMinimal();
@@ -488,6 +573,19 @@ void QgsMemoryProvider::updateExtent()
   }
 }
 
+void QgsMemoryProvider::extendExtent( const QgsFeature& feature )
+{
+  if ( feature.constGeometry() )
+    mExtent.unionRect( feature.constGeometry()->boundingBox() );
+}
+
+QgsFeature QgsMemoryProvider::indexEntry( QgsFeatureId fid, const QgsRectangle& rect )
+{
+  QgsFeature feature( fid );
+  feature.setGeometry( QgsGeometry::fromRect( rect ) );
+  return feature;
+}
+
 
 
 // --------------------------------
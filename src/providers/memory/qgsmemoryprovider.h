@@ -15,6 +15,7 @@
 
 #include "qgsvectordataprovider.h"
 #include "qgscoordinatereferencesystem.h"
+#include "qgsmemorycolumnarstore.h"
 
 
 typedef QMap<QgsFeatureId, QgsFeature> QgsFeatureMap;
@@ -162,7 +163,13 @@ class QgsMemoryProvider : public QgsVectorDataProvider
     // called when added / removed features or geometries has been changed
     void updateExtent();
 
+    // called when features have been added, only grows the extent
+    void extendExtent( const QgsFeature& feature );
+
   private:
+    // feature with just the bounding box of a geometry, enough to remove it from the spatial index
+    static QgsFeature indexEntry( QgsFeatureId fid, const QgsRectangle& rect );
+
     // Coordinate reference system
     QgsCoordinateReferenceSystem mCrs;
 
@@ -175,6 +182,10 @@ class QgsMemoryProvider : public QgsVectorDataProvider
     QgsFeatureMap mFeatures;
     QgsFeatureId mNextFeatureId;
 
+    // features in columnar storage (storage=columnar), used instead of mFeatures
+    bool mColumnar;
+    QgsMemoryColumnarStore mStore;
+
     // indexing
     QgsSpatialIndex* mSpatialIndex;
 
@@ -1247,6 +1247,58 @@ qint64 QgsPostgresConn::getBinaryInt( QgsPostgresResult &queryResult, int row, i
   return oid;
 }
 
+bool QgsPostgresConn::isBinaryNumberField( const QgsField &fld )
+{
+  const QString &type = fld.typeName();
+  // float4 stays text: widening the binary value to double would show digits that its text form rounds away
+  return type == "int2" || type == "int4" || type == "int8" || type == "float8";
+}
+
+QVariant QgsPostgresConn::getBinaryNumber( QgsPostgresResult &queryResult, int row, int col, const QgsField &fld )
+{
+  if ( ::PQgetisnull( queryResult.result(), row, col ) )
+    return QVariant( fld.type() );
+
+  const char *p = ::PQgetvalue( queryResult.result(), row, col );
+  const QString &type = fld.typeName();
+
+  // binary cursors return values in network byte order, see deduceEndian()
+  if ( type == "int2" )
+  {
+    quint16 v;
+    memcpy( &v, p, sizeof( v ) );
+    if ( mSwapEndian )
+      v = ntohs( v );
+    return fld.type() == QVariant::LongLong ? QVariant( qlonglong( qint16( v ) ) ) : QVariant( int( qint16( v ) ) );
+  }
+  else if ( type == "int4" )
+  {
+    quint32 v;
+    memcpy( &v, p, sizeof( v ) );
+    if ( mSwapEndian )
+      v = ntohl( v );
+    return fld.type() == QVariant::LongLong ? QVariant( qlonglong( qint32( v ) ) ) : QVariant( int( qint32( v ) ) );
+  }
+  else
+  {
+    quint32 v[2];
+    memcpy( v, p, sizeof( v ) );
+    quint64 u;
+    if ( mSwapEndian )
+      u = ( quint64( ntohl( v[0] ) ) << 32 ) | ntohl( v[1] );
+    else
+      memcpy( &u, v, sizeof( u ) );
+
+    if ( type == "float8" )
+    {
+      double d;
+      memcpy( &d, &u, sizeof( d ) );
+      return QVariant( d );
+    }
+    return QVariant( qlonglong( u ) );
+  }
+}
+
 QString QgsPostgresConn::fieldExpression( const QgsField &fld, QString expr )
 {
   const QString &type = fld.typeName();
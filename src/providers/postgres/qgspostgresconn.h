@@ -298,6 +298,18 @@ class QgsPostgresConn : public QObject
 
     qint64 getBinaryInt( QgsPostgresResult &queryResult, int row, int col );
 
+    /** Returns true if values of the field can be fetched from a binary cursor
+     * without a cast to text (int2, int4, int8 and float8 columns).
+     * @note added in QGIS 2.14
+     */
+    static bool isBinaryNumberField( const QgsField &fld );
+
+    /** Decodes a value of a field for which isBinaryNumberField() is true
+     * from a binary cursor. NULL values are returned as null variants of the field type.
+     * @note added in QGIS 2.14
+     */
+    QVariant getBinaryNumber( QgsPostgresResult &queryResult, int row, int col, const QgsField &fld );
+
     QString fieldExpression( const QgsField &fld, QString expr = "%1" );
 
     QString connInfo() const { return mConnInfo; }
@@ -24,16 +24,23 @@
 
 #include <QObject>
 #include <QSettings>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 
 
 const int QgsPostgresFeatureIterator::sFeatureQueueSize = 2000;
 
+//! number of rows decoded by one thread, smaller batches are decoded on the calling thread
+static const int DECODE_BLOCK_SIZE = 250;
+
 
 QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource<QgsPostgresFeatureSource>( source, ownSource, request )
     , mFeatureQueueSize( sFeatureQueueSize )
     , mFetched( 0 )
     , mFetchGeometry( false )
+    , mFetchPending( false )
+    , mPrimaryKeyAttr( source->mPrimaryKeyAttrs.value( 0, -1 ) )
     , mExpressionCompiled( false )
     , mLastFetch( false )
 {
@@ -122,38 +129,14 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
 
   if ( mFeatureQueue.empty() && !mLastFetch )
   {
-    QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( mFeatureQueueSize ).arg( mCursorName );
-    QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( mFeatureQueueSize ), 4 );
-    if ( mConn->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
-    {
-      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-    }
-
-    QgsPostgresResult queryResult;
-    for ( ;; )
-    {
-      queryResult = mConn->PQgetResult();
-      if ( !queryResult.result() )
-        break;
-
-      if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
-      {
-        QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-        break;
-      }
+    if ( !mFetchPending )
+      sendFetch();
+    receiveFetch();
 
-      int rows = queryResult.PQntuples();
-      if ( rows == 0 )
-        continue;
-
-      mLastFetch = rows < mFeatureQueueSize;
-
-      for ( int row = 0; row < rows; row++ )
-      {
-        mFeatureQueue.enqueue( QgsFeature() );
-        getFeature( queryResult, row, mFeatureQueue.back() );
-      } // for each row in queue
-    }
+    // let the server prepare the next batch while this one is consumed, unless the
+    // connection is shared with the provider and the other iterators of a transaction
+    if ( !mIsTransactionConnection && !mLastFetch && !mFeatureQueue.empty() )
+      sendFetch();
   }
 
   if ( mFeatureQueue.empty() )
@@ -175,6 +158,94 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
   return true;
 }
 
+void QgsPostgresFeatureIterator::sendFetch()
+{
+  QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( mFeatureQueueSize ).arg( mCursorName );
+  QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( mFeatureQueueSize ), 4 );
+  if ( mConn->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
+  {
+    QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+    mFetchPending = false;
+    return;
+  }
+  mFetchPending = true;
+}
+
+void QgsPostgresFeatureIterator::receiveFetch()
+{
+  mFetchPending = false;
+
+  QgsPostgresResult queryResult;
+  for ( ;; )
+  {
+    queryResult = mConn->PQgetResult();
+    if ( !queryResult.result() )
+      break;
+
+    if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+      break;
+    }
+
+    int rows = queryResult.PQntuples();
+    if ( rows == 0 )
+      continue;
+
+    mLastFetch = rows < mFeatureQueueSize;
+
+    // features of a FID map layer get their ids assigned in fetch order, so they are always decoded serially
+    if ( rows < 2 * DECODE_BLOCK_SIZE || QThreadPool::globalInstance()->maxThreadCount() < 2 || mSource->mPrimaryKeyType == pktFidMap )
+    {
+      for ( int row = 0; row < rows; row++ )
+      {
+        mFeatureQueue.enqueue( QgsFeature() );
+        getFeature( queryResult, row, mFeatureQueue.back() );
+      } // for each row in queue
+      continue;
+    }
+
+    // decode blocks of rows in parallel, getFeature() only reads the result, the source and the iterator
+    QVector<QgsFeature> features( rows );
+    QList<DecodeBlock> blocks;
+    for ( int first = 0; first < rows; first += DECODE_BLOCK_SIZE )
+    {
+      DecodeBlock block;
+      block.iterator = this;
+      block.result = &queryResult;
+      block.firstRow = first;
+      block.lastRow = qMin( first + DECODE_BLOCK_SIZE, rows ) - 1;
+      block.features = &features;
+      blocks << block;
+    }
+    QtConcurrent::blockingMap( blocks, decodeBlock );
+
+    Q_FOREACH ( const QgsFeature& feature, features )
+      mFeatureQueue.enqueue( feature );
+  }
+}
+
+void QgsPostgresFeatureIterator::discardFetch()
+{
+  if ( !mFetchPending )
+    return;
+
+  QgsPostgresResult queryResult;
+  for ( ;; )
+  {
+    queryResult = mConn->PQgetResult();
+    if ( !queryResult.result() )
+      break;
+  }
+  mFetchPending = false;
+}
+
+void QgsPostgresFeatureIterator::decodeBlock( DecodeBlock& block )
+{
+  for ( int row = block.firstRow; row <= block.lastRow; ++row )
+    block.iterator->getFeature( *block.result, row, ( *block.features )[row] );
+}
+
 bool QgsPostgresFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
 {
   if ( !mExpressionCompiled )
@@ -214,6 +285,8 @@ bool QgsPostgresFeatureIterator::rewind()
   if ( mClosed )
     return false;
 
+  discardFetch();
+
   // move cursor to first record
   mConn->PQexecNR( QString( "move absolute 0 in %1" ).arg( mCursorName ) );
   mFeatureQueue.clear();
@@ -228,6 +301,7 @@ bool QgsPostgresFeatureIterator::close()
   if ( mClosed )
     return false;
 
+  discardFetch();
   mConn->closeCursor( mCursorName );
 
   if ( !mIsTransactionConnection )
@@ -412,13 +486,24 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
       break;
   }
 
+  // numeric attributes are transferred in binary form, the others as text
+  mBinaryAttributes.fill( false, mSource->mFields.count() );
   bool subsetOfAttributes = mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;
   Q_FOREACH ( int idx, subsetOfAttributes ? mRequest.subsetOfAttributes() : mSource->mFields.allAttributesList() )
   {
     if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
       continue;
 
-    query += delim + mConn->fieldExpression( mSource->mFields.at( idx ) );
+    const QgsField &fld = mSource->mFields.at( idx );
+    if ( QgsPostgresConn::isBinaryNumberField( fld ) )
+    {
+      mBinaryAttributes[idx] = true;
+      query += delim + QgsPostgresConn::quotedIdentifier( fld.name() );
+    }
+    else
+    {
+      query += delim + mConn->fieldExpression( fld );
+    }
   }
 
   query += " FROM " + mSource->mQuery;
@@ -440,7 +525,7 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
 }
 
 
-bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature )
+bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature ) const
 {
   feature.initAttributes( mSource->mFields.count() );
 
@@ -517,8 +602,8 @@ bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int
     case pktInt:
       fid = mConn->getBinaryInt( queryResult, row, col++ );
       if ( mSource->mPrimaryKeyType == pktInt &&
-           ( !subsetOfAttributes || fetchAttributes.contains( mSource->mPrimaryKeyAttrs[0] ) ) )
-        feature.setAttribute( mSource->mPrimaryKeyAttrs[0], fid );
+           ( !subsetOfAttributes || fetchAttributes.contains( mPrimaryKeyAttr ) ) )
+        feature.setAttribute( mPrimaryKeyAttr, fid );
       break;
 
     case pktFidMap:
@@ -566,12 +651,15 @@ bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int
   return true;
 }
 
-void QgsPostgresFeatureIterator::getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature )
+void QgsPostgresFeatureIterator::getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature ) const
 {
   if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
     return;
 
-  QVariant v = QgsPostgresProvider::convertValue( mSource->mFields.at( idx ).type(), queryResult.PQgetvalue( row, col ) );
+  const QgsField &fld = mSource->mFields.at( idx );
+  QVariant v = mBinaryAttributes.at( idx )
+               ? mConn->getBinaryNumber( queryResult, row, col, fld )
+               : QgsPostgresProvider::convertValue( fld.type(), queryResult.PQgetvalue( row, col ) );
   feature.setAttribute( idx, v );
 
   col++;
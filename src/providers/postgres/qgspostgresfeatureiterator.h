@@ -95,10 +95,35 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
 
 
     QString whereClauseRect();
-    bool getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature );
-    void getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature );
+    /** Decodes a row of a result into a feature. Runs on several threads at once for
+     * parallel decoding, so it must only read shared state: members of the source are
+     * accessed through const methods only, e.g. mPrimaryKeyAttr instead of mPrimaryKeyAttrs[0].
+     */
+    bool getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature ) const;
+    void getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature ) const;
     bool declareCursor( const QString& whereClause );
 
+    //! Sends the FETCH for the next batch of features without waiting for the result
+    void sendFetch();
+
+    //! Waits for the results of a sent FETCH and decodes them into the feature queue
+    void receiveFetch();
+
+    //! Drops the results of a FETCH that has been sent but not received yet
+    void discardFetch();
+
+    //! Range of result rows decoded on a worker thread
+    struct DecodeBlock
+    {
+      const QgsPostgresFeatureIterator* iterator;
+      QgsPostgresResult* result;
+      int firstRow;
+      int lastRow;
+      QVector<QgsFeature>* features;
+    };
+
+    static void decodeBlock( DecodeBlock& block );
+
     QString mCursorName;
 
     /**
@@ -116,6 +141,15 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
 
+    //! Set to true, if a FETCH has been sent and its results have not been received yet
+    bool mFetchPending;
+
+    //! Flags of attributes which are fetched as binary numbers instead of text
+    QVector<bool> mBinaryAttributes;
+
+    //! Index of the first primary key attribute, -1 if there is none
+    int mPrimaryKeyAttr;
+
     bool mIsTransactionConnection;
 
     static const int sFeatureQueueSize;
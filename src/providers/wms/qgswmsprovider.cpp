@@ -67,6 +67,9 @@
 #include <QTextCodec>
 #include <QTime>
 #include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QFutureInterface>
 
 #include <QScriptEngine>
 #include <QScriptValue>
@@ -90,6 +93,124 @@ static QString DEFAULT_LATLON_CRS = "CRS:84";
 
 QMap<QString, QgsWmsStatistics::Stat> QgsWmsStatistics::sData;
 
+/// @cond
+
+class QgsWmsTileCacheData
+{
+  public:
+    QgsWmsTileCacheData()
+    {
+      QSettings s;
+      // cost in kB
+      mCache.setMaxCost( s.value( "/qgis/wmsTileCacheSize", 64 ).toInt() * 1024 );
+    }
+
+    struct Tile
+    {
+      Tile( const QImage& i, const QDateTime& e ) : image( i ), expiry( e ) {}
+      QImage image;
+      QDateTime expiry;
+    };
+
+    QMutex mMutex;
+    QCache<QString, Tile> mCache;
+
+    // Tiles are decoded in a pool of their own: map layers are rendered by threads of the
+    // global pool, which wait for the decoding of their tiles and would never let it start
+    // if all threads of the global pool were rendering.
+    QThreadPool mDecodePool;
+};
+
+class QgsWmsTileDecodeTask : public QRunnable
+{
+  public:
+    explicit QgsWmsTileDecodeTask( const QByteArray& data ) : mData( data ) { mResult.reportStarted(); }
+
+    QFuture<QImage> future() { return mResult.future(); }
+
+    void run() override
+    {
+      QImage image = QImage::fromData( mData );
+      mResult.reportResult( image );
+      mResult.reportFinished();
+    }
+
+  private:
+    QByteArray mData;
+    QFutureInterface<QImage> mResult;
+};
+
+static QgsWmsTileCacheData* tileCacheData()
+{
+  static QgsWmsTileCacheData sTileCache;
+  return &sTileCache;
+}
+
+/// @endcond
+
+bool QgsWmsTileCache::find( const QString& key, QImage& image )
+{
+  QgsWmsTileCacheData* data = tileCacheData();
+  QMutexLocker locker( &data->mMutex );
+  QgsWmsTileCacheData::Tile* cached = data->mCache.object( key );
+  if ( !cached )
+    return false;
+
+  if ( cached->expiry < QDateTime::currentDateTime() )
+  {
+    data->mCache.remove( key );
+    return false;
+  }
+
+  image = cached->image;
+  return true;
+}
+
+void QgsWmsTileCache::insert( const QString& key, const QImage& image, const QDateTime& expiry )
+{
+  QgsWmsTileCacheData* data = tileCacheData();
+  QMutexLocker locker( &data->mMutex );
+  data->mCache.insert( key, new QgsWmsTileCacheData::Tile( image, expiry ), image.byteCount() / 1024 + 1 );
+}
+
+void QgsWmsTileCache::remove( const QString& keyPrefix )
+{
+  QgsWmsTileCacheData* data = tileCacheData();
+  QMutexLocker locker( &data->mMutex );
+  Q_FOREACH ( const QString& key, data->mCache.keys() )
+  {
+    if ( key.startsWith( keyPrefix ) )
+      data->mCache.remove( key );
+  }
+}
+
+// draws a tile, or the part source of it, to the area of its map rectangle in the image of a view extent
+static void drawTile( QImage* image, const QgsRectangle& viewExtent, const QRectF& r, const QImage& tile, const QRectF& source, bool smoothPixmapTransform, bool replace )
+{
+  double cr = viewExtent.width() / image->width();
+
+  QRectF dst(( r.left() - viewExtent.xMinimum() ) / cr,
+             ( viewExtent.yMaximum() - r.bottom() ) / cr,
+             r.width() / cr,
+             r.height() / cr );
+
+  QPainter p( image );
+  if ( smoothPixmapTransform )
+    p.setRenderHint( QPainter::SmoothPixmapTransform, true );
+  if ( replace )
+    p.setCompositionMode( QPainter::CompositionMode_Source );
+  p.drawImage( dst, tile, source );
+}
+
+// decodes a tile in the decoding pool of the tile cache
+static QFuture<QImage> decodeTile( const QByteArray& data )
+{
+  QgsWmsTileDecodeTask* task = new QgsWmsTileDecodeTask( data );
+  QFuture<QImage> future = task->future();
+  tileCacheData()->mDecodePool.start( task );
+  return future;
+}
+
 QgsWmsProvider::QgsWmsProvider( QString const& uri, const QgsWmsCapabilities* capabilities )
     : QgsRasterDataProvider( uri )
     , mHttpGetLegendGraphicResponse( 0 )
@@ -455,6 +576,40 @@ void QgsWmsProvider::setFormatQueryItem( QUrl &url )
     setQueryItem( url, "FORMAT", mSettings.mImageMimeType );
 }
 
+QString QgsWmsProvider::tileCacheKey( double tres, const QgsWmtsTileMatrix* tm, const QRectF& rect ) const
+{
+  int col = ( int ) floor(( rect.center().x() - tm->topLeft.x() ) / ( tm->tileWidth * tres ) );
+  int row = ( int ) floor(( tm->topLeft.y() - rect.center().y() ) / ( tm->tileHeight * tres ) );
+  return QString( "%1|%2|%3|%4|%5" ).arg( dataSourceUri() ).arg( mDpi ).arg( qgsDoubleToString( tres ) ).arg( row ).arg( col );
+}
+
+bool QgsWmsProvider::drawPlaceholderTile( double tres, const QRectF& rect )
+{
+  // tile matrices are ordered by resolution, the closest coarser one first
+  const QMap<double, QgsWmtsTileMatrix> &m = mTileMatrixSet->tileMatrices;
+  for ( QMap<double, QgsWmtsTileMatrix>::const_iterator it = m.upperBound( tres ); it != m.constEnd(); ++it )
+  {
+    QImage tile;
+    if ( !QgsWmsTileCache::find( tileCacheKey( it.key(), &it.value(), rect ), tile ) )
+      continue;
+
+    double twMap = it->tileWidth * it.key();
+    double thMap = it->tileHeight * it.key();
+    int col = ( int ) floor(( rect.center().x() - it->topLeft.x() ) / twMap );
+    int row = ( int ) floor(( it->topLeft.y() - rect.center().y() ) / thMap );
+    double left = it->topLeft.x() + col * twMap;
+    double top = it->topLeft.y() - row * thMap;
+
+    QRectF source(( rect.left() - left ) / twMap * tile.width(),
+                  ( top - rect.bottom() ) / thMap * tile.height(),
+                  rect.width() / twMap * tile.width(),
+                  rect.height() / thMap * tile.height() );
+    drawTile( mCachedImage, mCachedViewExtent, rect, tile, source, mSettings.mSmoothPixmapTransform, false );
+    return true;
+  }
+  return false;
+}
+
 QImage *QgsWmsProvider::draw( QgsRectangle const &viewExtent, int pixelWidth, int pixelHeight )
 {
   QgsDebugMsg( "Entering." );
@@ -823,10 +978,31 @@ QImage *QgsWmsProvider::draw( QgsRectangle const &viewExtent, int pixelWidth, in
         break;
     }
 
-    emit statusChanged( tr( "Getting tiles." ) );
+    // tiles decoded before are taken from the tile cache, the others are requested
+    // with a cached tile of a coarser tile matrix drawn in their place until they arrive
+    QList<QgsWmsTiledImageDownloadHandler::TileRequest> missing;
+    Q_FOREACH ( QgsWmsTiledImageDownloadHandler::TileRequest request, requests )
+    {
+      request.cacheKey = tileCacheKey( tres, tm, request.rect );
 
-    QgsWmsTiledImageDownloadHandler handler( dataSourceUri(), mSettings.authorization(), mTileReqNo, requests, mCachedImage, mCachedViewExtent, mSettings.mSmoothPixmapTransform );
-    handler.downloadBlocking();
+      QImage tile;
+      if ( QgsWmsTileCache::find( request.cacheKey, tile ) )
+      {
+        drawTile( mCachedImage, mCachedViewExtent, request.rect, tile, tile.rect(), mSettings.mSmoothPixmapTransform, false );
+        continue;
+      }
+
+      request.placeholder = mSettings.mTiled && drawPlaceholderTile( tres, request.rect );
+      missing << request;
+    }
+
+    if ( !missing.isEmpty() )
+    {
+      emit statusChanged( tr( "Getting tiles." ) );
+
+      QgsWmsTiledImageDownloadHandler handler( dataSourceUri(), mSettings.authorization(), mTileReqNo, missing, mCachedImage, mCachedViewExtent, mSettings.mSmoothPixmapTransform );
+      handler.downloadBlocking();
+    }
 
 
 #if 0
@@ -2869,6 +3045,9 @@ void QgsWmsProvider::reloadData()
 {
   delete mCachedImage;
   mCachedImage = 0;
+
+  // tile cache keys start with the data source, see tileCacheKey()
+  QgsWmsTileCache::remove( dataSourceUri() + '|' );
 }
 
 
@@ -3344,6 +3523,10 @@ QgsWmsTiledImageDownloadHandler::QgsWmsTiledImageDownloadHandler( const QString&
     request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), r.index );
     request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ), r.rect );
     request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
+    request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileCacheKey ), r.cacheKey );
+
+    if ( r.placeholder )
+      mPlaceholderKeys << r.cacheKey;
 
     QNetworkReply *reply = mNAM->get( request );
     connect( reply, SIGNAL( finished() ), this, SLOT( tileReplyFinished() ) );
@@ -3363,6 +3546,13 @@ void QgsWmsTiledImageDownloadHandler::downloadBlocking()
   mEventLoop->exec( QEventLoop::ExcludeUserInputEvents );
 
   Q_ASSERT( mReplies.isEmpty() );
+  Q_ASSERT( mDecoding.isEmpty() );
+}
+
+void QgsWmsTiledImageDownloadHandler::finishIfDone()
+{
+  if ( mReplies.isEmpty() && mDecoding.isEmpty() )
+    finish();
 }
 
 
@@ -3388,6 +3578,9 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
   }
 #endif
 
+  QSettings s;
+  QDateTime expiry = QDateTime::currentDateTime().addSecs( s.value( "/qgis/defaultTileExpiry", "24" ).toInt() * 60 * 60 );
+
   if ( mNAM->cache() )
   {
     QNetworkCacheMetaData cmd = mNAM->cache()->metaData( reply->request().url() );
@@ -3402,10 +3595,9 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
 
     QgsDebugMsg( QString( "expirationDate:%1" ).arg( cmd.expirationDate().toString() ) );
     if ( cmd.expirationDate().isNull() )
-    {
-      QSettings s;
-      cmd.setExpirationDate( QDateTime::currentDateTime().addSecs( s.value( "/qgis/defaultTileExpiry", "24" ).toInt() * 60 * 60 ) );
-    }
+      cmd.setExpirationDate( expiry );
+    else
+      expiry = cmd.expirationDate();
 
     mNAM->cache()->updateMetaData( cmd );
   }
@@ -3438,6 +3630,7 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
       request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileIndex ), tileNo );
       request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRect ), r );
       request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileRetry ), 0 );
+      request.setAttribute( static_cast<QNetworkRequest::Attribute>( TileCacheKey ), reply->request().attribute( static_cast<QNetworkRequest::Attribute>( TileCacheKey ) ) );
 
       mReplies.removeOne( reply );
       reply->deleteLater();
@@ -3461,8 +3654,7 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
       mReplies.removeOne( reply );
       reply->deleteLater();
 
-      if ( mReplies.isEmpty() )
-        finish();
+      finishIfDone();
 
       return;
     }
@@ -3500,8 +3692,7 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
       mReplies.removeOne( reply );
       reply->deleteLater();
 
-      if ( mReplies.isEmpty() )
-        finish();
+      finishIfDone();
 
       return;
     }
@@ -3509,40 +3700,17 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
     // only take results from current request number
     if ( mTileReqNo == tileReqNo )
     {
-      double cr = mCachedViewExtent.width() / mCachedImage->width();
-
-      QRectF dst(( r.left() - mCachedViewExtent.xMinimum() ) / cr,
-                 ( mCachedViewExtent.yMaximum() - r.bottom() ) / cr,
-                 r.width() / cr,
-                 r.height() / cr );
-
       QgsDebugMsg( QString( "tile reply: length %1" ).arg( reply->bytesAvailable() ) );
 
-      QImage myLocalImage = QImage::fromData( reply->readAll() );
-
-      if ( !myLocalImage.isNull() )
-      {
-        QPainter p( mCachedImage );
-        if ( mSmoothPixmapTransform )
-          p.setRenderHint( QPainter::SmoothPixmapTransform, true );
-        p.drawImage( dst, myLocalImage );
-#if 0
-        myLocalImage.save( QString( "%1/%2-tile-%3.png" ).arg( QDir::tempPath() ).arg( mTileReqNo ).arg( tileNo ) );
-        p.drawRect( dst ); // show tile bounds
-        p.drawText( dst, Qt::AlignCenter, QString( "(%1)\n%2,%3\n%4,%5\n%6x%7" )
-                    .arg( tileNo )
-                    .arg( r.left() ).arg( r.bottom() )
-                    .arg( r.right() ).arg( r.top() )
-                    .arg( r.width() ).arg( r.height() ) );
-#endif
-      }
-      else
-      {
-        QgsMessageLog::logMessage( tr( "Returned image is flawed [Content-Type:%1; URL: %2]" )
-                                   .arg( contentType, reply->url().toString() ), tr( "WMS" ) );
-
-        repeatTileRequest( reply->request() );
-      }
+      // the image is decoded by a worker thread and drawn in tileDecoded()
+      QFutureWatcher<QImage>* watcher = new QFutureWatcher<QImage>( this );
+      connect( watcher, SIGNAL( finished() ), this, SLOT( tileDecoded() ) );
+      DecodingTile decoding;
+      decoding.request = reply->request();
+      decoding.contentType = contentType;
+      decoding.expiry = expiry;
+      mDecoding.insert( watcher, decoding );
+      watcher->setFuture( decodeTile( reply->readAll() ) );
     }
     else
     {
@@ -3552,9 +3720,7 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
     mReplies.removeOne( reply );
     reply->deleteLater();
 
-    if ( mReplies.isEmpty() )
-      finish();
-
+    finishIfDone();
   }
   else
   {
@@ -3566,8 +3732,7 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
     mReplies.removeOne( reply );
     reply->deleteLater();
 
-    if ( mReplies.isEmpty() )
-      finish();
+    finishIfDone();
   }
 
 #if 0
@@ -3581,6 +3746,40 @@ void QgsWmsTiledImageDownloadHandler::tileReplyFinished()
 }
 
 
+void QgsWmsTiledImageDownloadHandler::tileDecoded()
+{
+  QFutureWatcher<QImage>* watcher = static_cast< QFutureWatcher<QImage>* >( sender() );
+  DecodingTile decoding = mDecoding.take( watcher );
+  const QNetworkRequest& request = decoding.request;
+  QImage image = watcher->result();
+  watcher->deleteLater();
+
+  int tileReqNo = request.attribute( static_cast<QNetworkRequest::Attribute>( TileReqNo ) ).toInt();
+  if ( mTileReqNo == tileReqNo )
+  {
+    QRectF r = request.attribute( static_cast<QNetworkRequest::Attribute>( TileRect ) ).toRectF();
+    QString cacheKey = request.attribute( static_cast<QNetworkRequest::Attribute>( TileCacheKey ) ).toString();
+
+    if ( !image.isNull() )
+    {
+      // the tile replaces its placeholder, including transparent areas
+      drawTile( mCachedImage, mCachedViewExtent, r, image, image.rect(), mSmoothPixmapTransform, mPlaceholderKeys.contains( cacheKey ) );
+      if ( !cacheKey.isEmpty() )
+        QgsWmsTileCache::insert( cacheKey, image, decoding.expiry );
+    }
+    else
+    {
+      QgsMessageLog::logMessage( tr( "Returned image is flawed [Content-Type:%1; URL: %2]" )
+                                 .arg( decoding.contentType, request.url().toString() ), tr( "WMS" ) );
+
+      repeatTileRequest( request );
+    }
+  }
+
+  finishIfDone();
+}
+
+
 void QgsWmsTiledImageDownloadHandler::repeatTileRequest( QNetworkRequest const &oldRequest )
 {
   QgsWmsStatistics::Stat& stat = QgsWmsStatistics::statForUri( mProviderUri );
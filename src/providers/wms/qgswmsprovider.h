@@ -25,10 +25,14 @@
 #include "qgswmscapabilities.h"
 
 #include <QString>
+#include <QDateTime>
 #include <QStringList>
 #include <QDomElement>
+#include <QFutureWatcher>
 #include <QHash>
+#include <QImage>
 #include <QMap>
+#include <QSet>
 #include <QVector>
 #include <QUrl>
 
@@ -448,6 +452,12 @@ class QgsWmsProvider : public QgsRasterDataProvider
     //! add image FORMAT parameter to url
     void setFormatQueryItem( QUrl &url );
 
+    //! key of a tile in the shared tile cache
+    QString tileCacheKey( double tres, const QgsWmtsTileMatrix* tm, const QRectF& rect ) const;
+
+    //! draws the part of a cached tile of a coarser tile matrix covering a tile, returns false if there is none
+    bool drawPlaceholderTile( double tres, const QRectF& rect );
+
     //! Name of the stored connection
     QString mConnectionName;
 
@@ -603,10 +613,14 @@ class QgsWmsTiledImageDownloadHandler : public QObject
 
     struct TileRequest
     {
-      TileRequest( const QUrl& u, const QRectF& r, int i ) : url( u ), rect( r ), index( i ) {}
+      TileRequest( const QUrl& u, const QRectF& r, int i ) : url( u ), rect( r ), index( i ), placeholder( false ) {}
       QUrl url;
       QRectF rect;
       int index;
+      //! key of the decoded tile in QgsWmsTileCache, the tile is not cached if empty
+      QString cacheKey;
+      //! true if a placeholder has been drawn where the tile goes
+      bool placeholder;
     };
 
     QgsWmsTiledImageDownloadHandler( const QString& providerUri, const QgsWmsAuthorization& auth, int reqNo, const QList<TileRequest>& requests, QImage* cachedImage, const QgsRectangle& cachedViewExtent, bool smoothPixmapTransform );
@@ -616,6 +630,7 @@ class QgsWmsTiledImageDownloadHandler : public QObject
 
   protected slots:
     void tileReplyFinished();
+    void tileDecoded();
 
   protected:
     /**
@@ -629,6 +644,9 @@ class QgsWmsTiledImageDownloadHandler : public QObject
 
     void finish() { QMetaObject::invokeMethod( mEventLoop, "quit", Qt::QueuedConnection ); }
 
+    //! finishes when there are no running requests and no tiles being decoded
+    void finishIfDone();
+
     QString mProviderUri;
 
     QgsWmsAuthorization mAuth;
@@ -644,6 +662,21 @@ class QgsWmsTiledImageDownloadHandler : public QObject
 
     //! Running tile requests
     QList<QNetworkReply*> mReplies;
+
+    //! Tile being decoded by a worker thread
+    struct DecodingTile
+    {
+      QNetworkRequest request;
+      QString contentType;
+      //! time after which the decoded tile is dropped from QgsWmsTileCache
+      QDateTime expiry;
+    };
+
+    //! Tiles being decoded by worker threads
+    QHash< QFutureWatcher<QImage>*, DecodingTile > mDecoding;
+
+    //! Cache keys of the tiles for which a placeholder was drawn
+    QSet<QString> mPlaceholderKeys;
 };
 
 
@@ -667,6 +700,27 @@ class QgsWmsStatistics
 };
 
 
+/**
+ * Memory cache of decoded tiles shared by all WMTS and WMS-C layers, so that tiles
+ * are not decoded again when the map is panned or the same service is used by several layers.
+ * The size of the cache is set by the "/qgis/wmsTileCacheSize" setting in MB.
+ * Tiles expire like the replies they were decoded from.
+ * \note added in QGIS 2.14
+ */
+class QgsWmsTileCache
+{
+  public:
+    //! get a tile, returns false if it is not cached or has expired
+    static bool find( const QString& key, QImage& image );
+
+    //! add a decoded tile, which is dropped after expiry
+    static void insert( const QString& key, const QImage& image, const QDateTime& expiry );
+
+    //! remove the tiles with keys starting with keyPrefix
+    static void remove( const QString& keyPrefix );
+};
+
+
 #endif
 
 // ENDS
@@ -1388,6 +1388,10 @@ QImage* QgsWMSServer::getMap( HitTest* hitTest )
     runHitTest( &thePainter, *hitTest );
   else
   {
+    // features of large vector layers may be rendered on several threads (opt-in)
+    char* parallelEnv = getenv( "QGIS_SERVER_PARALLEL_RENDERING" );
+    bool parallel = parallelEnv && QString( parallelEnv ).compare( "true", Qt::CaseInsensitive ) == 0;
+    mMapRenderer->rendererContext()->setFlag( QgsRenderContext::ParallelFeatureRendering, parallel );
     mMapRenderer->render( &thePainter );
   }
 
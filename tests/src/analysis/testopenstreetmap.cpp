@@ -34,6 +34,7 @@ class TestOpenStreetMap : public QObject
     /** Our tests proper begin here */
     void download();
     void importAndQueries();
+    void importPbf();
   private:
 
 };
@@ -188,6 +189,46 @@ void TestOpenStreetMap::importAndQueries()
 }
 
 
+void TestOpenStreetMap::importPbf()
+{
+  QString dbFilename =  QDir::tempPath() + "/testdata_pbf.db";
+  QString pbfFilename = TEST_DATA_DIR "/openstreetmap/testdata.osm.pbf";
+
+  QgsOSMXmlImport import( pbfFilename, dbFilename );
+  bool res = import.import();
+  if ( import.hasError() )
+    qDebug( "PBF ERR: %s", import.errorString().toAscii().data() );
+  QCOMPARE( res, true );
+  QCOMPARE( import.hasError(), false );
+
+  QgsOSMDatabase db( dbFilename );
+  QCOMPARE( db.open(), true );
+
+  // same content as testdata.xml
+  QgsOSMNode n = db.node( 11111 );
+  QCOMPARE( n.isValid(), true );
+  QCOMPARE( n.point().x(), 14.4277148 );
+  QCOMPARE( n.point().y(), 50.0651387 );
+
+  QgsOSMTags tags = db.tags( false, 11111 );
+  QCOMPARE( tags.count(), 7 );
+  QCOMPARE( tags.value( "addr:postcode" ), QString( "12800" ) );
+  QCOMPARE( db.tags( false, 360769661 ).count(), 0 );
+
+  QgsOSMWay w = db.way( 32137532 );
+  QCOMPARE( w.isValid(), true );
+  QCOMPARE( w.nodes().count(), 5 );
+  QCOMPARE( w.nodes().at( 0 ), ( qint64 )360769661 );
+  QCOMPARE( w.nodes().at( 1 ), ( qint64 )360769664 );
+
+  QgsOSMTags tagsW = db.tags( true, 32137532 );
+  QCOMPARE( tagsW.count(), 3 );
+  QCOMPARE( tagsW.value( "building" ), QString( "yes" ) );
+
+  db.close();
+}
+
+
 QTEST_MAIN( TestOpenStreetMap )
 
 #include "testopenstreetmap.moc"
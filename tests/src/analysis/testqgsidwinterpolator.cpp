@@ -0,0 +1,248 @@
+/***************************************************************************
+  testqgsidwinterpolator.cpp
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+
+#include "qgis.h"
+#include "qgsapplication.h"
+#include "qgsgeometry.h"
+#include "qgsgridfilewriter.h"
+#include "qgsidwinterpolator.h"
+#include "qgsvectordataprovider.h"
+#include "qgsvectorlayer.h"
+
+#include <QDir>
+#include <QThreadPool>
+
+#include <cmath>
+#include <limits>
+
+class TestQgsIDWInterpolator : public QObject
+{
+    Q_OBJECT
+
+  public:
+    TestQgsIDWInterpolator() : mLayer( 0 ) {}
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void searchRadius();
+    void maxDataPoints();
+    void searchRadiusAndMaxDataPoints();
+    void concurrentGrid();
+
+  private:
+    QgsVectorLayer* mLayer;
+    //! data points with the value in the z coordinate
+    QVector<vertexData> mPoints;
+
+    QList<QgsInterpolator::LayerData> layerData() const;
+    int bruteForce( double x, double y, double radius, int maxDataPoints, double& result ) const;
+    void compareWithBruteForce( double radius, int maxDataPoints );
+};
+
+void TestQgsIDWInterpolator::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  // irregularly spread points in the square 0,0 - 100,100, a third of them squeezed towards the x axis
+  mLayer = new QgsVectorLayer( "Point?crs=EPSG:4326&field=value:double", "points", "memory" );
+  QVERIFY( mLayer->isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 300; ++i )
+  {
+    vertexData v;
+    v.x = fmod( i * 37.71 + i * i * 0.013, 100.0 );
+    v.y = fmod( i * 61.33 + i * i * 0.021, 100.0 ) * ( i % 3 == 0 ? 0.3 : 1.0 );
+    v.z = fmod( i * 17.1, 1000.0 );
+    mPoints << v;
+
+    QgsFeature f( mLayer->pendingFields() );
+    f.setAttribute( 0, v.z );
+    f.setGeometry( QgsGeometry::fromPoint( QgsPoint( v.x, v.y ) ) );
+    features << f;
+  }
+  mLayer->dataProvider()->addFeatures( features );
+}
+
+void TestQgsIDWInterpolator::cleanupTestCase()
+{
+  delete mLayer;
+  QgsApplication::exitQgis();
+}
+
+QList<QgsInterpolator::LayerData> TestQgsIDWInterpolator::layerData() const
+{
+  QgsInterpolator::LayerData ld;
+  ld.vectorLayer = mLayer;
+  ld.zCoordInterpolation = false;
+  ld.interpolationAttribute = 0;
+  ld.mInputType = QgsInterpolator::POINTS;
+  return QList<QgsInterpolator::LayerData>() << ld;
+}
+
+int TestQgsIDWInterpolator::bruteForce( double x, double y, double radius, int maxDataPoints, double& result ) const
+{
+  QList< QPair<double, double> > candidates;
+  Q_FOREACH ( const vertexData& v, mPoints )
+  {
+    double distance = sqrt(( v.x - x ) * ( v.x - x ) + ( v.y - y ) * ( v.y - y ) );
+    if ( distance < std::numeric_limits<double>::min() )
+    {
+      result = v.z;
+      return 0;
+    }
+    if ( radius > 0 && distance > radius )
+      continue;
+    candidates << qMakePair( distance, v.z );
+  }
+
+  qSort( candidates );
+  if ( maxDataPoints > 0 )
+    candidates = candidates.mid( 0, maxDataPoints );
+  if ( candidates.isEmpty() )
+    return 1;
+
+  double sumCounter = 0;
+  double sumDenominator = 0;
+  for ( int i = 0; i < candidates.size(); ++i )
+  {
+    double weight = 1 / pow( candidates.at( i ).first, 2.0 );
+    sumCounter += weight * candidates.at( i ).second;
+    sumDenominator += weight;
+  }
+  result = sumCounter / sumDenominator;
+  return 0;
+}
+
+void TestQgsIDWInterpolator::compareWithBruteForce( double radius, int maxDataPoints )
+{
+  QgsIDWInterpolator interpolator( layerData() );
+  interpolator.setSearchRadius( radius );
+  interpolator.setMaxDataPoints( maxDataPoints );
+
+  // query points inside and well outside of the data extent
+  int interpolated = 0;
+  int missing = 0;
+  for ( double y = -60.5; y < 160; y += 3.7 )
+  {
+    for ( double x = -60.5; x < 160; x += 3.3 )
+    {
+      double expected = 0;
+      int expectedCode = bruteForce( x, y, radius, maxDataPoints, expected );
+      double result = 0;
+      QCOMPARE( interpolator.interpolatePoint( x, y, result ), expectedCode );
+      if ( expectedCode == 0 )
+      {
+        QVERIFY( qgsDoubleNear( result, expected, 1e-9 * qMax( 1.0, fabs( expected ) ) ) );
+        ++interpolated;
+      }
+      else
+        ++missing;
+    }
+  }
+  QVERIFY( interpolated > 0 );
+  // without a search radius all points are interpolated
+  QVERIFY( radius > 0 ? missing > 0 : missing == 0 );
+
+  // a query point on a data point takes its value
+  double result = 0;
+  QCOMPARE( interpolator.interpolatePoint( mPoints.at( 7 ).x, mPoints.at( 7 ).y, result ), 0 );
+  QCOMPARE( result, mPoints.at( 7 ).z );
+}
+
+void TestQgsIDWInterpolator::searchRadius()
+{
+  compareWithBruteForce( 12.5, 0 );
+}
+
+void TestQgsIDWInterpolator::maxDataPoints()
+{
+  compareWithBruteForce( 0, 1 );
+  compareWithBruteForce( 0, 6 );
+}
+
+void TestQgsIDWInterpolator::searchRadiusAndMaxDataPoints()
+{
+  compareWithBruteForce( 20, 5 );
+}
+
+void TestQgsIDWInterpolator::concurrentGrid()
+{
+  QgsRectangle extent( -50, -50, 150, 150 );
+  QString serialFile = QDir::tempPath() + "/idw_serial.asc";
+  QString parallelFile = QDir::tempPath() + "/idw_parallel.asc";
+  int maxThreads = QThreadPool::globalInstance()->maxThreadCount();
+
+  // a single thread interpolates without prepareConcurrentInterpolation()
+  QThreadPool::globalInstance()->setMaxThreadCount( 1 );
+  QgsIDWInterpolator serialInterpolator( layerData() );
+  serialInterpolator.setSearchRadius( 30 );
+  serialInterpolator.setMaxDataPoints( 8 );
+  QgsGridFileWriter serialWriter( &serialInterpolator, serialFile, extent, 97, 83, 200.0 / 97, 200.0 / 83 );
+  QCOMPARE( serialWriter.writeFile(), 0 );
+
+  QThreadPool::globalInstance()->setMaxThreadCount( qMax( maxThreads, 4 ) );
+  QgsIDWInterpolator parallelInterpolator( layerData() );
+  parallelInterpolator.setSearchRadius( 30 );
+  parallelInterpolator.setMaxDataPoints( 8 );
+  QgsGridFileWriter parallelWriter( &parallelInterpolator, parallelFile, extent, 97, 83, 200.0 / 97, 200.0 / 83 );
+  QCOMPARE( parallelWriter.writeFile(), 0 );
+  QThreadPool::globalInstance()->setMaxThreadCount( maxThreads );
+
+  QFile serial( serialFile );
+  QVERIFY( serial.open( QIODevice::ReadOnly ) );
+  QFile parallel( parallelFile );
+  QVERIFY( parallel.open( QIODevice::ReadOnly ) );
+  QByteArray serialData = serial.readAll();
+  QVERIFY( serialData.contains( "-9999 " ) );
+  QVERIFY( serialData == parallel.readAll() );
+
+  // a layer without points is cached as well, a point added afterwards is not read by the threads
+  QgsVectorLayer emptyLayer( "Point?crs=EPSG:4326&field=value:double", "empty", "memory" );
+  QList<QgsInterpolator::LayerData> emptyData = layerData();
+  emptyData[0].vectorLayer = &emptyLayer;
+  QgsIDWInterpolator emptyInterpolator( emptyData );
+  emptyInterpolator.setSearchRadius( 30 );
+  emptyInterpolator.setMaxDataPoints( 8 );
+  QVERIFY( emptyInterpolator.prepareConcurrentInterpolation() );
+
+  QgsFeature f( emptyLayer.pendingFields() );
+  f.setAttribute( 0, 1.0 );
+  f.setGeometry( QgsGeometry::fromPoint( QgsPoint( 50, 50 ) ) );
+  emptyLayer.dataProvider()->addFeatures( QgsFeatureList() << f );
+
+  QString emptyFile = QDir::tempPath() + "/idw_empty.asc";
+  QThreadPool::globalInstance()->setMaxThreadCount( qMax( maxThreads, 4 ) );
+  QgsGridFileWriter emptyWriter( &emptyInterpolator, emptyFile, extent, 20, 20, 10, 10 );
+  QCOMPARE( emptyWriter.writeFile(), 0 );
+  QThreadPool::globalInstance()->setMaxThreadCount( maxThreads );
+
+  QFile empty( emptyFile );
+  QVERIFY( empty.open( QIODevice::ReadOnly ) );
+  QStringList lines = QString::fromAscii( empty.readAll() ).split( '\n', QString::SkipEmptyParts );
+  QCOMPARE( lines.size(), 6 + 20 );
+  for ( int i = 6; i < lines.size(); ++i )
+  {
+    QStringList values = lines.at( i ).trimmed().split( ' ' );
+    QCOMPARE( values.size(), 20 );
+    QCOMPARE( values.count( "-9999" ), 20 );
+  }
+}
+
+QTEST_MAIN( TestQgsIDWInterpolator )
+#include "testqgsidwinterpolator.moc"
@@ -0,0 +1,228 @@
+/***************************************************************************
+  testqgsnetworkanalysis.cpp
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+
+#include "qgis.h"
+#include "qgsapplication.h"
+#include "qgscompactgraph.h"
+#include "qgsgeometry.h"
+#include "qgsgraph.h"
+#include "qgsgraphanalyzer.h"
+#include "qgsgraphbuilder.h"
+#include "qgslinevectorlayerdirector.h"
+#include "qgspoint.h"
+#include "qgsvectordataprovider.h"
+#include "qgsvectorlayer.h"
+
+#include <limits>
+
+class TestQgsNetworkAnalysis : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void compactGraphShortestPath();
+    void lineDirectorTiePoints();
+
+  private:
+    QgsGraph* createGraph();
+    void checkShortestPaths( const QgsGraph* graph, const QgsCompactGraph& compact, QgsCompactGraph::SearchAlgorithm algorithm );
+    bool hasArc( const QgsGraph* graph, const QgsPoint& from, const QgsPoint& to ) const;
+};
+
+void TestQgsNetworkAnalysis::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+}
+
+void TestQgsNetworkAnalysis::cleanupTestCase()
+{
+  QgsApplication::exitQgis();
+}
+
+QgsGraph* TestQgsNetworkAnalysis::createGraph()
+{
+  // 4x4 grid of vertices 100 map units apart with arcs in both directions,
+  // cost of an arc is the first property
+  QgsGraph* graph = new QgsGraph();
+  for ( int row = 0; row < 4; ++row )
+  {
+    for ( int col = 0; col < 4; ++col )
+      graph->addVertex( QgsPoint( col * 100, row * 100 ) );
+  }
+
+  for ( int row = 0; row < 4; ++row )
+  {
+    for ( int col = 0; col < 4; ++col )
+    {
+      int v = row * 4 + col;
+      // the middle row is one way, from left to right
+      if ( col < 3 )
+      {
+        graph->addArc( v, v + 1, QVector<QVariant>() << 100.0 + row );
+        if ( row != 2 )
+          graph->addArc( v + 1, v, QVector<QVariant>() << 100.0 + row );
+      }
+      if ( row < 3 )
+      {
+        graph->addArc( v, v + 4, QVector<QVariant>() << 110.0 + col );
+        graph->addArc( v + 4, v, QVector<QVariant>() << 110.0 + col );
+      }
+    }
+  }
+
+  // parallel arcs: a shortcut next to the grid arc and a detour costing more
+  graph->addArc( 5, 6, QVector<QVariant>() << 40.0 );
+  graph->addArc( 5, 6, QVector<QVariant>() << 250.0 );
+  // a diagonal cheaper than the straight line distance
+  graph->addArc( 0, 15, QVector<QVariant>() << 300.0 );
+
+  // a vertex which can be left but not reached
+  int unreachable = graph->addVertex( QgsPoint( 500, 500 ) );
+  graph->addArc( unreachable, 15, QVector<QVariant>() << 50.0 );
+  return graph;
+}
+
+void TestQgsNetworkAnalysis::checkShortestPaths( const QgsGraph* graph, const QgsCompactGraph& compact, QgsCompactGraph::SearchAlgorithm algorithm )
+{
+  for ( int from = 0; from < graph->vertexCount(); ++from )
+  {
+    QVector<double> costs;
+    QgsGraphAnalyzer::dijkstra( graph, from, 0, 0, &costs );
+
+    for ( int to = 0; to < graph->vertexCount(); ++to )
+    {
+      QVector<int> arcs;
+      double cost = compact.shortestPath( from, to, &arcs, algorithm );
+
+      if ( costs.at( to ) == std::numeric_limits<double>::infinity() )
+      {
+        QVERIFY( cost == std::numeric_limits<double>::infinity() );
+        QVERIFY( arcs.isEmpty() );
+        continue;
+      }
+      QVERIFY( qgsDoubleNear( cost, costs.at( to ), 1e-9 ) );
+
+      if ( from == to )
+      {
+        QVERIFY( arcs.isEmpty() );
+        continue;
+      }
+
+      // the arcs form a path from the start to the end vertex with the cost found
+      QVERIFY( !arcs.isEmpty() );
+      QCOMPARE( graph->arc( arcs.first() ).outVertex(), from );
+      QCOMPARE( graph->arc( arcs.last() ).inVertex(), to );
+      double pathCost = 0;
+      for ( int i = 0; i < arcs.size(); ++i )
+      {
+        if ( i > 0 )
+          QCOMPARE( graph->arc( arcs.at( i ) ).outVertex(), graph->arc( arcs.at( i - 1 ) ).inVertex() );
+        pathCost += graph->arc( arcs.at( i ) ).property( 0 ).toDouble();
+      }
+      QVERIFY( qgsDoubleNear( pathCost, cost, 1e-9 ) );
+    }
+  }
+}
+
+void TestQgsNetworkAnalysis::compactGraphShortestPath()
+{
+  QgsGraph* graph = createGraph();
+  QgsCompactGraph compact( graph, 0 );
+  QCOMPARE( compact.vertexCount(), graph->vertexCount() );
+  QCOMPARE( compact.arcCount(), graph->arcCount() );
+
+  checkShortestPaths( graph, compact, QgsCompactGraph::BidirectionalDijkstra );
+  checkShortestPaths( graph, compact, QgsCompactGraph::AStar );
+
+  compact.buildContractionHierarchy();
+  QVERIFY( compact.hasContractionHierarchy() );
+  checkShortestPaths( graph, compact, QgsCompactGraph::ContractionHierarchy );
+  // the other algorithms ignore the shortcuts of the hierarchy
+  checkShortestPaths( graph, compact, QgsCompactGraph::BidirectionalDijkstra );
+
+  delete graph;
+}
+
+bool TestQgsNetworkAnalysis::hasArc( const QgsGraph* graph, const QgsPoint& from, const QgsPoint& to ) const
+{
+  int fromIdx = graph->findVertex( from );
+  int toIdx = graph->findVertex( to );
+  if ( fromIdx < 0 || toIdx < 0 )
+    return false;
+  Q_FOREACH ( int arc, graph->vertex( fromIdx ).outArc() )
+  {
+    if ( graph->arc( arc ).inVertex() == toIdx )
+      return true;
+  }
+  return false;
+}
+
+void TestQgsNetworkAnalysis::lineDirectorTiePoints()
+{
+  QgsVectorLayer* layer = new QgsVectorLayer( "LineString?crs=EPSG:3857", "lines", "memory" );
+  QVERIFY( layer->isValid() );
+  QgsFeatureList features;
+  QgsFeature f1;
+  f1.setGeometry( QgsGeometry::fromPolyline( QgsPolyline() << QgsPoint( 0, 0 ) << QgsPoint( 100, 0 ) << QgsPoint( 100, 100 ) ) );
+  features << f1;
+  // ends within the topology tolerance of the end of the first line
+  QgsFeature f2;
+  f2.setGeometry( QgsGeometry::fromPolyline( QgsPolyline() << QgsPoint( 0, 100 ) << QgsPoint( 99.996, 99.997 ) ) );
+  features << f2;
+  layer->dataProvider()->addFeatures( features );
+
+  QVector<QgsPoint> additionalPoints;
+  additionalPoints << QgsPoint( 50, 10 ) // on the first segment
+  << QgsPoint( 60, 40 ) // as far from the first and the second segment, the first one wins
+  << QgsPoint( -5, 105 ) // tied to the start of the second line
+  << QgsPoint( 49.996, 5 ); // within the topology tolerance of the first tie point
+
+  QgsLineVectorLayerDirector director( layer, -1, QString(), QString(), QString(), 3 );
+  QgsGraphBuilder builder( layer->crs(), false, 0.01 );
+  QVector<QgsPoint> tiedPoints;
+  director.makeGraph( &builder, additionalPoints, tiedPoints );
+  QgsGraph* graph = builder.graph();
+
+  QCOMPARE( tiedPoints.size(), 4 );
+  QCOMPARE( tiedPoints.at( 0 ), QgsPoint( 50, 0 ) );
+  QCOMPARE( tiedPoints.at( 1 ), QgsPoint( 60, 0 ) );
+  QCOMPARE( tiedPoints.at( 2 ), QgsPoint( 0, 100 ) );
+  QCOMPARE( tiedPoints.at( 3 ), QgsPoint( 50, 0 ) );
+
+  // four vertices of the lines and two new vertices for the tie points
+  QCOMPARE( graph->vertexCount(), 6 );
+  QVERIFY( graph->findVertex( QgsPoint( 99.996, 99.997 ) ) < 0 );
+
+  // the first segment is split at the tie points, arcs run in both directions
+  QCOMPARE( graph->arcCount(), 10 );
+  QVERIFY( !hasArc( graph, QgsPoint( 0, 0 ), QgsPoint( 100, 0 ) ) );
+  QVERIFY( hasArc( graph, QgsPoint( 0, 0 ), QgsPoint( 50, 0 ) ) );
+  QVERIFY( hasArc( graph, QgsPoint( 50, 0 ), QgsPoint( 60, 0 ) ) );
+  QVERIFY( hasArc( graph, QgsPoint( 60, 0 ), QgsPoint( 100, 0 ) ) );
+  QVERIFY( hasArc( graph, QgsPoint( 100, 0 ), QgsPoint( 60, 0 ) ) );
+  QVERIFY( hasArc( graph, QgsPoint( 100, 0 ), QgsPoint( 100, 100 ) ) );
+  QVERIFY( hasArc( graph, QgsPoint( 0, 100 ), QgsPoint( 100, 100 ) ) );
+
+  delete graph;
+  delete layer;
+}
+
+QTEST_MAIN( TestQgsNetworkAnalysis )
+#include "testqgsnetworkanalysis.moc"
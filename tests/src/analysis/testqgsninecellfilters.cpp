@@ -0,0 +1,140 @@
+/***************************************************************************
+  testqgsninecellfilters.cpp
+  --------------------------------------
+  Date                 : November 2015
+  Copyright            : (C) 2015 by the QGIS Development Team
+  Email                : qgis-developer at lists dot osgeo dot org
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include <QtTest/QtTest>
+
+#include "qgsslopefilter.h"
+#include "qgsapplication.h"
+
+#include <QDir>
+#include <QVector>
+
+#include <gdal.h>
+
+static QString _tempFile( const QString& name )
+{
+  return QString( "%1/ninecelltest-%2.tif" ).arg( QDir::tempPath(), name );
+}
+
+/** Slope filter going through the default, cell by cell and single threaded, processing*/
+class SerialSlopeFilter : public QgsSlopeFilter
+{
+  public:
+    SerialSlopeFilter( const QString& inputFile, const QString& outputFile )
+        : QgsSlopeFilter( inputFile, outputFile, "GTiff" )
+    {}
+
+  protected:
+    void processNineCellRow( float* scanLine1, float* scanLine2, float* scanLine3, float* resultLine, int xSize ) override
+    {
+      QgsNineCellFilter::processNineCellRow( scanLine1, scanLine2, scanLine3, resultLine, xSize );
+    }
+    bool canProcessRowsInParallel() const override { return false; }
+};
+
+class TestQgsNineCellFilters : public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void slope();
+
+  private:
+    QVector<float> readRaster( const QString& fileName, int& xSize, int& ySize );
+
+    QString mInputFile;
+};
+
+void TestQgsNineCellFilters::initTestCase()
+{
+  QgsApplication::init();
+  GDALAllRegister();
+
+  // inclined plane (slope of 45 degrees in x direction) with a few nodata cells,
+  // large enough for several strips and tasks
+  int xSize = 300;
+  int ySize = 700;
+  mInputFile = _tempFile( "input" );
+  GDALDriverH driver = GDALGetDriverByName( "GTiff" );
+  GDALDatasetH dataset = GDALCreate( driver, mInputFile.toUtf8().constData(), xSize, ySize, 1, GDT_Float32, NULL );
+  QVERIFY( dataset );
+  double geoTransform[6] = { 0, 10, 0, 7000, 0, -10 };
+  GDALSetGeoTransform( dataset, geoTransform );
+  GDALRasterBandH band = GDALGetRasterBand( dataset, 1 );
+  GDALSetRasterNoDataValue( band, -9999 );
+
+  QVector<float> values( xSize * ySize );
+  for ( int row = 0; row < ySize; ++row )
+  {
+    for ( int col = 0; col < xSize; ++col )
+    {
+      values[row * xSize + col] = ( row % 97 == 13 && col % 31 == 7 ) ? -9999 : col * 10.0;
+    }
+  }
+  GDALRasterIO( band, GF_Write, 0, 0, xSize, ySize, values.data(), xSize, ySize, GDT_Float32, 0, 0 );
+  GDALClose( dataset );
+}
+
+void TestQgsNineCellFilters::cleanupTestCase()
+{
+  QFile::remove( mInputFile );
+  QFile::remove( _tempFile( "slope" ) );
+  QFile::remove( _tempFile( "slopeserial" ) );
+}
+
+QVector<float> TestQgsNineCellFilters::readRaster( const QString& fileName, int& xSize, int& ySize )
+{
+  QVector<float> values;
+  GDALDatasetH dataset = GDALOpen( fileName.toUtf8().constData(), GA_ReadOnly );
+  if ( !dataset )
+    return values;
+  xSize = GDALGetRasterXSize( dataset );
+  ySize = GDALGetRasterYSize( dataset );
+  values.resize( xSize * ySize );
+  GDALRasterIO( GDALGetRasterBand( dataset, 1 ), GF_Read, 0, 0, xSize, ySize, values.data(), xSize, ySize, GDT_Float32, 0, 0 );
+  GDALClose( dataset );
+  return values;
+}
+
+void TestQgsNineCellFilters::slope()
+{
+  QgsSlopeFilter filter( mInputFile, _tempFile( "slope" ), "GTiff" );
+  QCOMPARE( filter.processRaster( 0 ), 0 );
+  SerialSlopeFilter serialFilter( mInputFile, _tempFile( "slopeserial" ) );
+  QCOMPARE( serialFilter.processRaster( 0 ), 0 );
+
+  int xSize = 0, ySize = 0, serialXSize = 0, serialYSize = 0;
+  QVector<float> result = readRaster( _tempFile( "slope" ), xSize, ySize );
+  QVector<float> serialResult = readRaster( _tempFile( "slopeserial" ), serialXSize, serialYSize );
+  QCOMPARE( xSize, 300 );
+  QCOMPARE( ySize, 700 );
+  QCOMPARE( serialXSize, xSize );
+  QCOMPARE( serialYSize, ySize );
+
+  // the row based and parallel processing gives the same results as the cell by cell processing
+  QVERIFY( result == serialResult );
+
+  // inner cells of the plane away from nodata
+  QVERIFY( qgsDoubleNear( result[ 50 * xSize + 50 ], 45.0, 0.0001 ) );
+  QVERIFY( qgsDoubleNear( result[ 650 * xSize + 250 ], 45.0, 0.0001 ) );
+  // border cells are computed from the cells inside
+  QVERIFY( qgsDoubleNear( result[ 0 ], 45.0, 0.0001 ) );
+  QVERIFY( qgsDoubleNear( result[ ySize * xSize - 1 ], 45.0, 0.0001 ) );
+}
+
+QTEST_MAIN( TestQgsNineCellFilters )
+#include "testqgsninecellfilters.moc"
@@ -16,6 +16,7 @@ Email                : nyall dot dawson at gmail dot com
 
 #include "qgsrastercalculator.h"
 #include "qgsrastercalcnode.h"
+#include "qgsrastercalcprogram.h"
 #include "qgsrasterlayer.h"
 #include "qgsrastermatrix.h"
 #include "qgsapplication.h"
@@ -54,6 +55,9 @@ class TestQgsRasterCalculator : public QObject
     void rasterRefOp();
     void dualOpRasterRaster(); //test dual op on raster ref and raster ref
 
+    void compiledProgram_data();
+    void compiledProgram(); //test compiled formulas give the same results as the node tree
+
     void calcWithLayers();
     void calcWithReprojectedLayers();
 
@@ -417,6 +421,77 @@ void TestQgsRasterCalculator::dualOpRasterRaster()
   QCOMPARE( result.data()[5], -9999.0 );
 }
 
+void TestQgsRasterCalculator::compiledProgram_data()
+{
+  QTest::addColumn< QString >( "formula" );
+
+  QTest::newRow( "raster" ) << QString( "r@1" );
+  QTest::newRow( "number" ) << QString( "3.5" );
+  QTest::newRow( "ndvi" ) << QString( "(r@2 - r@1) / (r@2 + r@1)" );
+  QTest::newRow( "nested" ) << QString( "r@1 * 2 + (r@2 - 1) * (r@1 ^ 0.5) - 3 / r@2" );
+  QTest::newRow( "power" ) << QString( "r@1 ^ r@2" );
+  QTest::newRow( "functions" ) << QString( "sqrt( r@1 ) + ln( r@2 ) + log10( r@1 ) - sin( r@2 ) * cos( r@1 ) + atan( r@2 )" );
+  QTest::newRow( "sign" ) << QString( "-( r@1 ) + -( r@2 * 2 )" );
+  QTest::newRow( "comparisons" ) << QString( "( r@1 > r@2 ) + ( r@1 < 1 ) * 2 + ( r@1 >= r@2 ) * 4 + ( r@2 <= 0 ) * 8 + ( r@1 = r@2 ) * 16 + ( r@1 != 3 ) * 32" );
+  QTest::newRow( "logical" ) << QString( "( r@1 > 2 AND r@2 < 5 ) OR r@1 = 0" );
+}
+
+void TestQgsRasterCalculator::compiledProgram()
+{
+  QFETCH( QString, formula );
+
+  // more cells than a chunk of the program, with no data and invalid function arguments
+  int nCols = 37;
+  int nRows = 19;
+  QgsRasterBlock r1( QGis::Float32, nCols, nRows, -1.0 );
+  QgsRasterBlock r2( QGis::Float32, nCols, nRows, -2.0 );
+  for ( int i = 0; i < nCols * nRows; ++i )
+  {
+    r1.setValue( i, i % 23 == 0 ? -1.0 : ( i % 7 ) - 2.5 );
+    r2.setValue( i, i % 17 == 0 ? -2.0 : ( i % 5 ) * 0.75 );
+  }
+  QMap<QString, QgsRasterBlock*> rasterData;
+  rasterData.insert( "r@1", &r1 );
+  rasterData.insert( "r@2", &r2 );
+
+  QString errorString;
+  QgsRasterCalcNode* node = QgsRasterCalcNode::parseRasterCalcString( formula, errorString );
+  QVERIFY( node );
+
+  QgsRasterMatrix expected;
+  expected.setNodataValue( -9999 );
+  QVERIFY( node->calculate( rasterData, expected ) );
+
+  QgsRasterCalcProgram program( node, QStringList() << "r@2" << "r@1", -9999 );
+  QVERIFY( program.isValid() );
+
+  QVector<double> values1( nCols * nRows );
+  QVector<double> values2( nCols * nRows );
+  for ( int i = 0; i < nCols * nRows; ++i )
+  {
+    values1[i] = r1.isNoData( i ) ? -9999 : r1.value( i );
+    values2[i] = r2.isNoData( i ) ? -9999 : r2.value( i );
+  }
+  const double* inputs[2] = { values2.constData(), values1.constData() };
+  QVector<double> scratch( program.scratchSize() );
+  QVector<float> result( nCols * nRows );
+  program.evaluate( inputs, nCols * nRows, scratch.data(), result.data() );
+
+  for ( int i = 0; i < nCols * nRows; ++i )
+  {
+    float value = static_cast<float>( expected.isNumber() ? expected.number() : expected.data()[i] );
+    if ( qIsNaN( value ) )
+      QVERIFY( qIsNaN( result[i] ) );
+    else
+      QCOMPARE( result[i], value );
+  }
+
+  //unknown raster
+  QgsRasterCalcProgram invalidProgram( node, QStringList() << "r@3", -9999 );
+  QVERIFY( formula == "3.5" || !invalidProgram.isValid() );
+  delete node;
+}
+
 void TestQgsRasterCalculator::calcWithLayers()
 {
   QgsRasterCalculatorEntry entry1;
@@ -16,11 +16,16 @@
 #include <QDir>
 #include <QtTest/QtTest>
 
+#include "qgis.h"
 #include "qgsapplication.h"
+#include "qgsgeometry.h"
+#include "qgsvectordataprovider.h"
 #include "qgsvectorlayer.h"
 #include "qgszonalstatistics.h"
 #include "qgsmaplayerregistry.h"
 
+#include <gdal.h>
+
 /** \ingroup UnitTests
  * This is a unit test for the zonal statistics class
  */
@@ -38,6 +43,8 @@ class TestQgsZonalStatistics : public QObject
     void cleanup() {}
 
     void testStatistics();
+    void testSinglePass();
+    void testSinglePassStrips();
 
   private:
     QgsVectorLayer* mVectorLayer;
@@ -135,5 +142,124 @@ void TestQgsZonalStatistics::testStatistics()
   QCOMPARE( f.attribute( "myqgis2_me" ).toDouble(), 0.833333333333333 );
 }
 
+void TestQgsZonalStatistics::testSinglePass()
+{
+  // results of a single pass over the raster are the same as of the per polygon calculation
+  QgsZonalStatistics zs( mVectorLayer, mRasterPath, "sp_", 1 );
+  zs.setSinglePass( true );
+  QVERIFY( zs.singlePass() );
+  QCOMPARE( zs.calculateStatistics( NULL ), 0 );
+
+  QgsFeature f;
+  QgsFeatureRequest request;
+  request.setFilterFid( 0 );
+  bool fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "sp_count" ).toDouble(), 12.0 );
+  QCOMPARE( f.attribute( "sp_sum" ).toDouble(), 8.0 );
+  QCOMPARE( f.attribute( "sp_mean" ).toDouble(), 0.666666666666667 );
+
+  request.setFilterFid( 1 );
+  fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "sp_count" ).toDouble(), 9.0 );
+  QCOMPARE( f.attribute( "sp_sum" ).toDouble(), 5.0 );
+  QCOMPARE( f.attribute( "sp_mean" ).toDouble(), 0.555555555555556 );
+
+  request.setFilterFid( 2 );
+  fetched = mVectorLayer->getFeatures( request ).nextFeature( f );
+  QVERIFY( fetched );
+  QCOMPARE( f.attribute( "sp_count" ).toDouble(), 6.0 );
+  QCOMPARE( f.attribute( "sp_sum" ).toDouble(), 5.0 );
+  QCOMPARE( f.attribute( "sp_mean" ).toDouble(), 0.833333333333333 );
+}
+
+void TestQgsZonalStatistics::testSinglePassStrips()
+{
+  // a raster of 256 x 16384 cells is read in four strips of 4096 rows, polygons span several of them
+  const int nCols = 256;
+  const int nRows = 16384;
+  QString rasterPath = QDir::tempPath() + "/zonal_strips.tif";
+  GDALAllRegister();
+  GDALDriverH driver = GDALGetDriverByName( "GTiff" );
+  GDALDatasetH dataset = GDALCreate( driver, rasterPath.toUtf8().constData(), nCols, nRows, 1, GDT_Byte, NULL );
+  QVERIFY( dataset );
+  double geoTransform[6] = { 0, 1, 0, nRows, 0, -1 };
+  GDALSetGeoTransform( dataset, geoTransform );
+  GDALRasterBandH band = GDALGetRasterBand( dataset, 1 );
+  GDALSetRasterNoDataValue( band, 255 );
+  QVector<unsigned char> values( nCols * nRows );
+  for ( int row = 0; row < nRows; ++row )
+  {
+    for ( int col = 0; col < nCols; ++col )
+      values[row * nCols + col] = ( row + col ) % 97 == 0 ? 255 : ( row * 7 + col * 3 ) % 11;
+  }
+  QCOMPARE( GDALRasterIO( band, GF_Write, 0, 0, nCols, nRows, values.data(), nCols, nRows, GDT_Byte, 0, 0 ), CE_None );
+  GDALClose( dataset );
+
+  QgsVectorLayer* layer = new QgsVectorLayer( "Polygon", "zones", "memory" );
+  QVERIFY( layer->isValid() );
+  QStringList wkts;
+  wkts << "POLYGON((10 1000, 30 1000, 30 15000, 10 15000, 10 1000))" // in all four strips
+  << "POLYGON((40 500, 120 16000, 60 16300, 40 500))"
+  << "POLYGON((100 8000, 110 8000, 110 8010, 100 8010, 100 8000))" // within one strip
+  << "POLYGON((5 4000, 200 4000, 200 4200, 5 4200, 5 4000),(50 4050, 150 4050, 150 4150, 50 4150, 50 4050))"; // with a hole, overlapping the first
+  QgsFeatureList features;
+  Q_FOREACH ( const QString& wkt, wkts )
+  {
+    QgsFeature f;
+    f.setGeometry( QgsGeometry::fromWkt( wkt ) );
+    features << f;
+  }
+  QVERIFY( layer->dataProvider()->addFeatures( features ) );
+
+  QgsZonalStatistics zs( layer, rasterPath, "a_", 1, QgsZonalStatistics::All );
+  QCOMPARE( zs.calculateStatistics( NULL ), 0 );
+  int nStatistics = layer->pendingFields().count();
+  QVERIFY( nStatistics > 0 );
+
+  QgsZonalStatistics singlePass( layer, rasterPath, "b_", 1, QgsZonalStatistics::All );
+  singlePass.setSinglePass( true );
+  QCOMPARE( singlePass.calculateStatistics( NULL ), 0 );
+  QCOMPARE( layer->pendingFields().count(), 2 * nStatistics );
+
+  QgsFeature f;
+  QgsFeatureIterator it = layer->getFeatures();
+  int nFeatures = 0;
+  while ( it.nextFeature( f ) )
+  {
+    ++nFeatures;
+    for ( int i = 0; i < nStatistics; ++i )
+    {
+      double expected = f.attribute( i ).toDouble();
+      QVERIFY( qgsDoubleNear( f.attribute( nStatistics + i ).toDouble(), expected, 1e-9 * qMax( 1.0, qAbs( expected ) ) ) );
+    }
+  }
+  QCOMPARE( nFeatures, 4 );
+
+  // the cells of the rectangle are counted once, although it is in several strips
+  double count = 0;
+  double sum = 0;
+  for ( int row = nRows - 15000; row < nRows - 1000; ++row )
+  {
+    for ( int col = 10; col < 30; ++col )
+    {
+      unsigned char value = values.at( row * nCols + col );
+      if ( value == 255 )
+        continue;
+      ++count;
+      sum += value;
+    }
+  }
+  QgsFeatureRequest request;
+  request.setFilterFid( features.at( 0 ).id() );
+  QVERIFY( layer->getFeatures( request ).nextFeature( f ) );
+  QCOMPARE( f.attribute( "b_count" ).toDouble(), count );
+  QCOMPARE( f.attribute( "b_sum" ).toDouble(), sum );
+
+  delete layer;
+  QFile::remove( rasterPath );
+}
+
 QTEST_MAIN( TestQgsZonalStatistics )
 #include "testqgszonalstatistics.moc"
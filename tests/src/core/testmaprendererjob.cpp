@@ -28,6 +28,7 @@ class TestQgsMapRendererJob : public QObject
     void testErrors();
 
     void testCache();
+    void testCacheViews();
 
   private:
     QStringList mLayerIds;
@@ -274,6 +275,54 @@ void TestQgsMapRendererJob::testCache()
   QgsMapLayerRegistry::instance()->removeMapLayer( l->id() );
 }
 
+void TestQgsMapRendererJob::testCacheViews()
+{
+  QImage imgA( 64, 64, QImage::Format_ARGB32_Premultiplied );
+  imgA.fill( qRgb( 255, 0, 0 ) );
+  QImage imgB( 64, 64, QImage::Format_ARGB32_Premultiplied );
+  imgB.fill( qRgb( 0, 0, 255 ) );
+  QgsRectangle extentA( 0, 0, 10, 10 );
+  QgsRectangle extentB( 10, 0, 20, 10 );
+
+  QgsMapRendererCache cache;
+  QVERIFY( !cache.init( extentA, 1000 ) );
+  cache.setCacheImage( "layer", imgA );
+  QVERIFY( !cache.init( extentB, 1000 ) );
+  QVERIFY( cache.cacheImage( "layer" ).isNull() );
+  cache.setCacheImage( "layer", imgB );
+
+  // going back to the first view is a cache hit
+  QVERIFY( !cache.init( extentA, 1000 ) );
+  QCOMPARE( cache.cacheImage( "layer" ), imgA );
+  QVERIFY( !cache.init( extentA, 2000 ) );
+  QVERIFY( cache.cacheImage( "layer" ).isNull() );
+
+  // memory budget only fits one image, the other one is restored from disk
+  QTemporaryFile dirTemplate;
+  QVERIFY( dirTemplate.open() );
+  QString dir = dirTemplate.fileName() + "_cache";
+  cache.clear();
+  cache.setMaximumMemory( imgA.byteCount() );
+  cache.setCacheDirectory( dir );
+  cache.init( extentA, 1000 );
+  cache.setCacheImage( "layer", imgA );
+  cache.init( extentB, 1000 );
+  cache.setCacheImage( "layer", imgB );
+  cache.init( extentA, 1000 );
+  QCOMPARE( cache.cacheImage( "layer" ), imgA );
+  cache.init( extentB, 1000 );
+  QCOMPARE( cache.cacheImage( "layer" ), imgB );
+
+  // clearing the layer removes all views
+  cache.clearCacheImage( "layer" );
+  QVERIFY( cache.cacheImage( "layer" ).isNull() );
+  cache.init( extentA, 1000 );
+  QVERIFY( cache.cacheImage( "layer" ).isNull() );
+
+  cache.setCacheDirectory( QString() );
+  QDir().rmdir( dir );
+}
+
 
 QTEST_MAIN( TestQgsMapRendererJob )
 #include "testmaprendererjob.moc"
@@ -27,6 +27,7 @@ class TestQgsCoordinateTransform: public QObject
     void initTestCase();
     void cleanupTestCase();
     void transformBoundingBox();
+    void webMercatorFastPath();
 
   private:
 
@@ -73,5 +74,52 @@ void TestQgsCoordinateTransform::transformBoundingBox()
   QVERIFY( qgsDoubleNear( resultRect.yMaximum(), expectedRect.yMaximum(), 0.001 ) );
 }
 
+void TestQgsCoordinateTransform::webMercatorFastPath()
+{
+  // WGS 84 <-> EPSG:3857 is computed without PROJ.4, EPSG:900913 only differs by +over
+  // and goes through PROJ.4, so both have to give the same results
+  QgsCoordinateReferenceSystem wgs84;
+  wgs84.createFromSrid( 4326 );
+  QgsCoordinateReferenceSystem webMercator;
+  webMercator.createFromSrid( 3857 );
+  QgsCoordinateReferenceSystem googleMercator;
+  googleMercator.createFromSrid( 900913 );
+
+  QgsCoordinateTransform fastTr( wgs84, webMercator );
+  QgsCoordinateTransform projTr( wgs84, googleMercator );
+
+  QVector<double> x, y, z;
+  x << -180.0 << -122.4194 << 0.0 << 13.4050 << 151.2093 << 180.0;
+  y << -85.0511 << 37.7749 << 0.0 << 52.52 << -33.8688 << 85.0511;
+  z.fill( 0.0, x.size() );
+
+  QVector<double> fastX( x ), fastY( y ), fastZ( z );
+  QVector<double> projX( x ), projY( y ), projZ( z );
+  fastTr.transformInPlace( fastX, fastY, fastZ );
+  projTr.transformInPlace( projX, projY, projZ );
+  for ( int i = 0; i < x.size(); ++i )
+  {
+    QVERIFY( qgsDoubleNear( fastX[i], projX[i], 1e-6 ) );
+    QVERIFY( qgsDoubleNear( fastY[i], projY[i], 1e-6 ) );
+  }
+
+  // and back
+  fastTr.transformInPlace( fastX, fastY, fastZ, QgsCoordinateTransform::ReverseTransform );
+  projTr.transformInPlace( projX, projY, projZ, QgsCoordinateTransform::ReverseTransform );
+  for ( int i = 0; i < x.size(); ++i )
+  {
+    QVERIFY( qgsDoubleNear( fastX[i], projX[i], 1e-9 ) );
+    QVERIFY( qgsDoubleNear( fastY[i], projY[i], 1e-9 ) );
+    QVERIFY( qgsDoubleNear( fastX[i], x[i], 1e-9 ) );
+    QVERIFY( qgsDoubleNear( fastY[i], y[i], 1e-9 ) );
+  }
+
+  // longitudes beyond 180 degrees are wrapped by PROJ.4
+  QgsPoint wrapped = fastTr.transform( QgsPoint( 190, 10 ) );
+  QgsPoint expected = fastTr.transform( QgsPoint( -170, 10 ) );
+  QVERIFY( qgsDoubleNear( wrapped.x(), expected.x(), 1e-6 ) );
+  QVERIFY( qgsDoubleNear( wrapped.y(), expected.y(), 1e-6 ) );
+}
+
 QTEST_MAIN( TestQgsCoordinateTransform )
 #include "testqgscoordinatetransform.moc"
@@ -752,6 +752,135 @@ class TestQgsExpression: public QObject
       QCOMPARE( res2.type(), QVariant::Invalid );
     }
 
+    void eval_compiled_data()
+    {
+      QTest::addColumn<QString>( "string" );
+
+      QTest::newRow( "int arithmetic" ) << "foo + 1 - bar * 2";
+      QTest::newRow( "double arithmetic" ) << "dbl / 4 + foo % 3";
+      QTest::newRow( "int division" ) << "foo // 3";
+      QTest::newRow( "division by zero" ) << "dbl / (foo - foo)";
+      QTest::newRow( "power" ) << "foo ^ 2";
+      QTest::newRow( "unary minus" ) << "-foo + -dbl";
+      QTest::newRow( "comparison" ) << "foo > 5 AND dbl <= 2.5";
+      QTest::newRow( "comparison string" ) << "name = 'abc' OR name > 'b'";
+      QTest::newRow( "comparison numeric string" ) << "name = 12";
+      QTest::newRow( "is null" ) << "name IS NULL";
+      QTest::newRow( "is not" ) << "foo IS NOT bar";
+      QTest::newRow( "not" ) << "NOT (foo < bar)";
+      QTest::newRow( "like" ) << "name LIKE 'a%'";
+      QTest::newRow( "ilike" ) << "name ILIKE '_B_'";
+      QTest::newRow( "regexp" ) << "name ~ '^[a-c]+$'";
+      QTest::newRow( "concat" ) << "name || '-' || foo";
+      QTest::newRow( "string plus" ) << "name + 'x'";
+      QTest::newRow( "string plus null" ) << "(name + name) IS NULL";
+      QTest::newRow( "in" ) << "foo IN (1, 20, bar)";
+      QTest::newRow( "not in" ) << "name NOT IN ('abc', 'xyz')";
+      QTest::newRow( "in with null" ) << "foo IN (1, NULL)";
+      QTest::newRow( "case" ) << "CASE WHEN foo > 10 THEN name WHEN bar IS NULL THEN 'none' ELSE dbl END";
+      QTest::newRow( "case no else" ) << "CASE WHEN foo > 100 THEN 1 END";
+      QTest::newRow( "folded" ) << "foo * (2 + 3) > 10 * 2";
+      QTest::newRow( "function" ) << "sqrt(foo) + abs(dbl) > 2";
+      QTest::newRow( "function error" ) << "foo + to_int('x')";
+      QTest::newRow( "bool literal" ) << "foo > 1 AND TRUE";
+      QTest::newRow( "string arithmetic" ) << "name * 2";
+    }
+
+    void eval_compiled()
+    {
+      QFETCH( QString, string );
+
+      QgsFields fields;
+      fields.append( QgsField( "foo", QVariant::Int ) );
+      fields.append( QgsField( "bar", QVariant::Int ) );
+      fields.append( QgsField( "dbl", QVariant::Double ) );
+      fields.append( QgsField( "name", QVariant::String ) );
+
+      QList<QgsAttributes> rows;
+      rows << ( QgsAttributes() << QVariant( 20 ) << QVariant( 3 ) << QVariant( 2.5 ) << QVariant( "abc" ) );
+      rows << ( QgsAttributes() << QVariant( 1 ) << QVariant( QVariant::Int ) << QVariant( -7.25 ) << QVariant( "12" ) );
+      rows << ( QgsAttributes() << QVariant( QVariant::Int ) << QVariant( 8 ) << QVariant( QVariant::Double ) << QVariant( QVariant::String ) );
+      rows << ( QgsAttributes() << QVariant( 7 ) << QVariant( 7 ) << QVariant( 0.0 ) << QVariant( "xyz" ) );
+
+      QgsExpression compiled( string );
+      QgsExpression tree( string );
+      tree.setCompiledEvaluationEnabled( false );
+
+      Q_FOREACH ( const QgsAttributes& attrs, rows )
+      {
+        QgsFeature f( fields );
+        f.setAttributes( attrs );
+        QgsExpressionContext context = QgsExpressionContextUtils::createFeatureBasedContext( f, fields );
+
+        QVERIFY( compiled.prepare( &context ) );
+        QVERIFY( tree.prepare( &context ) );
+        QVERIFY( compiled.isCompiled() );
+        QVERIFY( !tree.isCompiled() );
+
+        QVariant resCompiled = compiled.evaluate( &context );
+        QVariant resTree = tree.evaluate( &context );
+        QCOMPARE( compiled.hasEvalError(), tree.hasEvalError() );
+        QCOMPARE( compiled.evalErrorString(), tree.evalErrorString() );
+        QCOMPARE( resCompiled.type(), resTree.type() );
+        QCOMPARE( resCompiled.isNull(), resTree.isNull() );
+        QCOMPARE( resCompiled, resTree );
+      }
+    }
+
+    void eval_batch_data()
+    {
+      QTest::addColumn<QString>( "string" );
+      QTest::addColumn<bool>( "evalError" );
+
+      QTest::newRow( "arithmetic" ) << "foo * 2 + dbl" << false;
+      QTest::newRow( "comparison" ) << "foo > 5 AND name LIKE 'a%'" << false;
+      QTest::newRow( "string arithmetic" ) << "name * 2" << true;
+      QTest::newRow( "function" ) << "sqrt(foo) + 1" << false;
+      QTest::newRow( "case" ) << "CASE WHEN foo > 10 THEN name ELSE foo || 'x' END" << false;
+      QTest::newRow( "constant" ) << "1 + 2" << false;
+    }
+
+    void eval_batch()
+    {
+      QFETCH( QString, string );
+      QFETCH( bool, evalError );
+
+      QgsFields fields;
+      fields.append( QgsField( "foo", QVariant::Int ) );
+      fields.append( QgsField( "dbl", QVariant::Double ) );
+      fields.append( QgsField( "name", QVariant::String ) );
+
+      QgsFeatureList features;
+      for ( int i = 0; i < 25; ++i )
+      {
+        QgsFeature f( fields, i );
+        f.setAttributes( QgsAttributes() << ( i % 7 == 0 ? QVariant( QVariant::Int ) : QVariant( i ) )
+                         << QVariant( i * 0.5 )
+                         << QVariant( i % 3 == 0 ? "abc" : QString::number( i ) ) );
+        features << f;
+      }
+
+      QgsExpressionContext context;
+      context.setFields( fields );
+
+      QgsExpression exp( string );
+      QVERIFY( exp.prepare( &context ) );
+      QVariantList results = exp.evaluateBatch( features, &context );
+      QCOMPARE( exp.hasEvalError(), evalError );
+      QCOMPARE( results.count(), features.count() );
+
+      QgsExpression tree( string );
+      tree.setCompiledEvaluationEnabled( false );
+      QVERIFY( tree.prepare( &context ) );
+      for ( int i = 0; i < features.count(); ++i )
+      {
+        context.setFeature( features.at( i ) );
+        QVariant expected = tree.evaluate( &context );
+        QCOMPARE( results.at( i ).type(), expected.type() );
+        QCOMPARE( results.at( i ), expected );
+      }
+    }
+
     void eval_rownum()
     {
       QgsExpression exp( "$rownum + 1" );
@@ -1409,6 +1538,15 @@ class TestQgsExpression: public QObject
       out = exp.evaluate( &context );
       QCOMPARE( exp.hasEvalError(), evalError );
       QCOMPARE( out.toInt(), result.toInt() );
+
+      // prepared expressions test the feature geometry against the prepared constant geometry
+      QVERIFY( exp.prepare( &context ) );
+      for ( int i = 0; i < 2; ++i )
+      {
+        out = exp.evaluate( &context );
+        QCOMPARE( exp.hasEvalError(), evalError );
+        QCOMPARE( out.toInt(), result.toInt() );
+      }
     }
 
     void eval_geometry_method_data()
@@ -31,6 +31,10 @@
 #include <qgspoint.h>
 #include "qgspointv2.h"
 #include "qgslinestringv2.h"
+#include "qgsgeometryengine.h"
+#include "qgsgeometryutils.h"
+#include "qgscoordinatekernels.h"
+#include "qgswkbview.h"
 
 //qgs unit test utility class
 #include "qgsrenderchecker.h"
@@ -86,6 +90,10 @@ class TestQgsGeometry : public QObject
     
     void exportToGeoJSON();
 
+    void prepareGeometryShared();
+    void coordinateKernels();
+    void fromWkbDeferred();
+
   private:
     /** A helper method to do a render check to see if the geometry op is as expected */
     bool renderCheck( const QString& theTestName, const QString& theComment = "", int mismatchCount = 0 );
@@ -1097,6 +1105,205 @@ void TestQgsGeometry::exportToGeoJSON()
   QCOMPARE( obtained, geojson );
 }
 
+void TestQgsGeometry::prepareGeometryShared()
+{
+  QScopedPointer<QgsGeometry> polygon( QgsGeometry::fromWkt( "Polygon ((0 0, 100 0, 100 100, 0 100, 0 0),(20 20, 40 20, 40 40, 20 40, 20 20))" ) );
+  QScopedPointer<QgsGeometry> inside( QgsGeometry::fromWkt( "Point (50 50)" ) );
+  QScopedPointer<QgsGeometry> inHole( QgsGeometry::fromWkt( "Point (30 30)" ) );
+  QScopedPointer<QgsGeometry> crossing( QgsGeometry::fromWkt( "LineString (50 50, 150 50)" ) );
+
+  // a geometry is prepared the second time it is requested
+  QScopedPointer<QgsGeometryEngine> engine( QgsGeometry::createGeometryEngine( polygon->geometry() ) );
+  QVERIFY( !engine->prepareGeometryShared() );
+  QScopedPointer<QgsGeometryEngine> engine2( QgsGeometry::createGeometryEngine( polygon->geometry() ) );
+  QVERIFY( engine2->prepareGeometryShared() );
+
+  // the prepared geometry is in use, another engine prepares its own one
+  QScopedPointer<QgsGeometryEngine> engine3( QgsGeometry::createGeometryEngine( polygon->geometry() ) );
+  QVERIFY( engine3->prepareGeometryShared() );
+
+  QVERIFY( engine2->intersects( *inside->geometry() ) );
+  QVERIFY( engine2->contains( *inside->geometry() ) );
+  QVERIFY( !engine2->intersects( *inHole->geometry() ) );
+  QVERIFY( engine2->disjoint( *inHole->geometry() ) );
+  QVERIFY( engine2->crosses( *crossing->geometry() ) );
+  QVERIFY( !engine2->contains( *crossing->geometry() ) );
+  QCOMPARE( engine3->intersects( *crossing->geometry() ), engine->intersects( *crossing->geometry() ) );
+
+  // prepared geometries are returned to the cache and reused
+  engine2.reset();
+  engine3.reset();
+  QScopedPointer<QgsGeometryEngine> engine4( QgsGeometry::createGeometryEngine( polygon->geometry() ) );
+  QVERIFY( engine4->prepareGeometryShared() );
+  QVERIFY( engine4->within( *QScopedPointer<QgsGeometry>( QgsGeometry::fromWkt( "Polygon ((-1 -1, 101 -1, 101 101, -1 101, -1 -1))" ) )->geometry() ) );
+
+  // a different geometry is not mixed up with the cached one
+  QScopedPointer<QgsGeometry> other( QgsGeometry::fromWkt( "Polygon ((200 200, 300 200, 300 300, 200 300, 200 200))" ) );
+  QScopedPointer<QgsGeometryEngine> otherEngine( QgsGeometry::createGeometryEngine( other->geometry() ) );
+  otherEngine->prepareGeometryShared();
+  QVERIFY( !otherEngine->intersects( *inside->geometry() ) );
+
+  // changing the geometry drops the prepared geometry
+  engine4->geometryChanged();
+  QVERIFY( engine4->intersects( *inside->geometry() ) );
+}
+
+void TestQgsGeometry::coordinateKernels()
+{
+  // odd and even numbers of coordinates, to cover the vectorized loops and the remainders
+  for ( int n = 0; n < 12; ++n )
+  {
+    QVector<double> x, y;
+    for ( int i = 0; i < n; ++i )
+    {
+      x << ( i * 37 % 11 ) - 5.5 + i * 0.25;
+      y << ( i * 23 % 7 ) - 3.0;
+    }
+    if ( n > 4 )
+    {
+      // degenerate segment
+      x[3] = x[2];
+      y[3] = y[2];
+    }
+
+    double xMin, yMin, xMax, yMax;
+    QgsCoordinateKernels::boundingBox( x.constData(), y.constData(), n, xMin, yMin, xMax, yMax );
+    double length = 0, area = 0;
+    for ( int i = 0; i < n; ++i )
+    {
+      QVERIFY( x[i] >= xMin && x[i] <= xMax && y[i] >= yMin && y[i] <= yMax );
+      if ( i > 0 )
+      {
+        length += sqrt(( x[i] - x[i - 1] ) * ( x[i] - x[i - 1] ) + ( y[i] - y[i - 1] ) * ( y[i] - y[i - 1] ) );
+        area += x[i - 1] * y[i] - y[i - 1] * x[i];
+      }
+    }
+    if ( n > 0 )
+    {
+      QVERIFY( x.contains( xMin ) && x.contains( xMax ) && y.contains( yMin ) && y.contains( yMax ) );
+    }
+    QVERIFY( qgsDoubleNear( QgsCoordinateKernels::length( x.constData(), y.constData(), n ), length, 1e-10 ) );
+    QVERIFY( qgsDoubleNear( QgsCoordinateKernels::shoelaceSum( x.constData(), y.constData(), n ), area, 1e-10 ) );
+
+    // same results as QgsGeometryUtils::sqrDistToLine for each segment
+    double sqrDist = 0;
+    int closest = QgsCoordinateKernels::closestSegment( x.constData(), y.constData(), n, 0.3, -0.7, 1e-8, sqrDist );
+    double expectedDist = std::numeric_limits<double>::max();
+    int expected = -1;
+    for ( int i = 1; i < n; ++i )
+    {
+      double segX, segY;
+      double dist = QgsGeometryUtils::sqrDistToLine( 0.3, -0.7, x[i - 1], y[i - 1], x[i], y[i], segX, segY, 1e-8 );
+      if ( dist < expectedDist )
+      {
+        expectedDist = dist;
+        expected = i;
+      }
+    }
+    QCOMPARE( closest, expected );
+    if ( expected > 0 )
+    {
+      QCOMPARE( sqrDist, expectedDist );
+    }
+
+    // transforms match QTransform::map
+    QList<QTransform> transforms;
+    transforms << QTransform() << QTransform::fromTranslate( 3, -2 ) << QTransform::fromScale( 2, -0.5 ).translate( 10, 20 )
+    << QTransform().rotate( 30 ).scale( 2, 3 ).translate( -4, 1 );
+    Q_FOREACH ( const QTransform& t, transforms )
+    {
+      QVector<double> tx = x, ty = y;
+      QVector<double> xy( 2 * n );
+      QgsCoordinateKernels::interleave( x.constData(), y.constData(), n, xy.data() );
+      QgsCoordinateKernels::transform( t, tx.data(), ty.data(), n );
+      QgsCoordinateKernels::transformInterleaved( t, xy.data(), n );
+      for ( int i = 0; i < n; ++i )
+      {
+        qreal mx, my;
+        t.map( x[i], y[i], &mx, &my );
+        QCOMPARE( tx[i], mx );
+        QCOMPARE( ty[i], my );
+        QCOMPARE( xy[2 * i], mx );
+        QCOMPARE( xy[2 * i + 1], my );
+      }
+    }
+  }
+
+  // line string methods use the kernels
+  QgsLineStringV2 line;
+  line.setPoints( QList<QgsPointV2>() << QgsPointV2( 0, 0 ) << QgsPointV2( 3, 4 ) << QgsPointV2( 3, 10 ) << QgsPointV2( -1, 10 ) << QgsPointV2( 0, 0 ) );
+  QCOMPARE( line.boundingBox(), QgsRectangle( -1, 0, 3, 10 ) );
+  QVERIFY( qgsDoubleNear( line.length(), 5 + 6 + 4 + sqrt( 101.0 ) ) );
+  QgsPointV2 segmentPt;
+  QgsVertexId after;
+  bool leftOf = false;
+  QVERIFY( qgsDoubleNear( line.closestSegment( QgsPointV2( 5, 7 ), segmentPt, after, &leftOf, 1e-8 ), 4.0 ) );
+  QCOMPARE( segmentPt, QgsPointV2( 3, 7 ) );
+  QCOMPARE( after.vertex, 2 );
+  QCOMPARE( line.asQPolygonF().at( 1 ), QPointF( 3, 4 ) );
+}
+
+void TestQgsGeometry::fromWkbDeferred()
+{
+  QStringList wkts;
+  wkts << "Point (1 2)"
+  << "LineString (0 0, 10 -5, 3 7)"
+  << "LineStringZ (0 0 1, 4 4 2)"
+  << "Polygon ((0 0, 10 0, 10 10, 0 10, 0 0),(2 2, 3 2, 3 3, 2 2))"
+  << "MultiPolygon (((0 0, 1 0, 1 1, 0 0)),((5 5, 8 5, 8 9, 5 5)))"
+  << "CircularString (0 0, 1 1, 2 0)";
+
+  Q_FOREACH ( const QString& wkt, wkts )
+  {
+    QScopedPointer<QgsGeometry> reference( QgsGeometry::fromWkt( wkt ) );
+    QVERIFY( reference.data() );
+    int size = reference->wkbSize();
+    unsigned char* wkb = new unsigned char[size];
+    memcpy( wkb, reference->asWkb(), size );
+
+    QgsWkbView view( wkb, size );
+    QVERIFY( view.isValid() );
+    QCOMPARE(( int )view.wkbType(), ( int )reference->wkbType() );
+    QgsRectangle rect;
+    bool curved = reference->geometry()->hasCurvedSegments();
+    QCOMPARE( view.boundingBox( rect ), !curved );
+    if ( !curved )
+      QCOMPARE( rect, reference->boundingBox() );
+    // truncated buffer
+    QVERIFY( !QgsWkbView( wkb, size - 1 ).boundingBox( rect ) );
+
+    // the WKB is kept and parsed on demand
+    QgsGeometry geom;
+    geom.fromWkb( wkb, size );
+    QVERIFY( !geom.isEmpty() );
+    QCOMPARE( geom.wkbType(), reference->wkbType() );
+    QCOMPARE( geom.boundingBox(), reference->boundingBox() );
+    QCOMPARE( geom.asWkb(), ( const unsigned char* )wkb );
+    QCOMPARE(( int )geom.wkbSize(), size );
+
+    // detached copies keep working after the original is changed
+    QgsGeometry copy( geom );
+    geom.translate( 100, 0 );
+    QCOMPARE( copy.exportToWkt(), reference->exportToWkt() );
+    QVERIFY( geom.exportToWkt() != reference->exportToWkt() );
+    QCOMPARE( geom.boundingBox().xMinimum(), reference->boundingBox().xMinimum() + 100 );
+  }
+
+  QPolygonF vertices;
+  QScopedPointer<QgsGeometry> line( QgsGeometry::fromWkt( "MultiLineString ((0 0, 1 1),(2 2, 3 3, 4 5))" ) );
+  QVERIFY( QgsWkbView( line->asWkb(), line->wkbSize() ).vertices( vertices ) );
+  QCOMPARE( vertices, QPolygonF() << QPointF( 0, 0 ) << QPointF( 1, 1 ) << QPointF( 2, 2 ) << QPointF( 3, 3 ) << QPointF( 4, 5 ) );
+
+  // invalid WKB is parsed right away, as before
+  unsigned char* invalid = new unsigned char[5];
+  memset( invalid, 0, 5 );
+  QVERIFY( !QgsWkbView( invalid, 5 ).isValid() );
+  QgsGeometry invalidGeom;
+  invalidGeom.fromWkb( invalid, 5 );
+  QVERIFY( invalidGeom.isEmpty() );
+  QCOMPARE( invalidGeom.wkbType(), QGis::WKBUnknown );
+}
+
 bool TestQgsGeometry::renderCheck( const QString& theTestName, const QString& theComment, int mismatchCount )
 {
   mReport += "<h2>" + theTestName + "</h2>\n";
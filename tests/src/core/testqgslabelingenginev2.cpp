@@ -16,16 +16,36 @@
 #include <QtTest/QtTest>
 
 #include <qgsapplication.h>
+#include <qgsgeometry.h>
+#include <qgslabelingcache.h>
 #include <qgslabelingenginev2.h>
 #include <qgsmaplayerregistry.h>
+#include <qgsmaprenderercache.h>
 #include <qgsmaprenderersequentialjob.h>
 #include <qgsrulebasedlabeling.h>
+#include <qgsvectordataprovider.h>
 #include <qgsvectorlayer.h>
 #include <qgsvectorlayerdiagramprovider.h>
 #include <qgsvectorlayerlabeling.h>
 #include <qgsvectorlayerlabelprovider.h>
 #include "qgsrenderchecker.h"
 #include "qgsfontutils.h"
+#include "pal/feature.h"
+#include "pal/labelposition.h"
+#include "pal/layer.h"
+#include "pal/pal.h"
+#include "pal/problem.h"
+
+#include <QSet>
+#include <QThreadPool>
+
+//! label provider for features registered directly with pal
+class TestLabelProvider : public QgsAbstractLabelProvider
+{
+  public:
+    QList<QgsLabelFeature*> labelFeatures( QgsRenderContext& context ) override { Q_UNUSED( context ); return QList<QgsLabelFeature*>(); }
+    void drawLabel( QgsRenderContext& context, pal::LabelPosition* label ) const override { Q_UNUSED( context ); Q_UNUSED( label ); }
+};
 
 class TestQgsLabelingEngineV2 : public QObject
 {
@@ -41,6 +61,9 @@ class TestQgsLabelingEngineV2 : public QObject
     void testBasic();
     void testDiagrams();
     void testRuleBased();
+    void testIndependentGroups();
+    void testLabelingCache();
+    void testParallelFeatureRendering();
 
   private:
     QgsVectorLayer* vl;
@@ -48,6 +71,9 @@ class TestQgsLabelingEngineV2 : public QObject
     QString mReport;
 
     void setDefaultLabelParams( QgsVectorLayer* layer );
+    QImage renderLabels( QgsVectorLayer* layer, const QgsMapSettings& mapSettings );
+    QMap<QgsFeatureId, QgsRectangle> labelRects( const QgsMapSettings& mapSettings, QgsMapRendererCache* cache );
+    QList<QgsFeatureId> labeledFeatures( const QgsMapSettings& mapSettings );
     bool imageCheck( const QString& testName, QImage &image, int mismatchCount );
 };
 
@@ -267,6 +293,319 @@ void TestQgsLabelingEngineV2::testRuleBased()
 
 }
 
+QImage TestQgsLabelingEngineV2::renderLabels( QgsVectorLayer* layer, const QgsMapSettings& mapSettings )
+{
+  QImage img( mapSettings.outputSize(), QImage::Format_ARGB32_Premultiplied );
+  img.fill( 0 );
+  QPainter p( &img );
+  QgsRenderContext context = QgsRenderContext::fromMapSettings( mapSettings );
+  context.setPainter( &p );
+
+  QgsLabelingEngineV2 engine;
+  engine.setMapSettings( mapSettings );
+  engine.addProvider( new QgsVectorLayerLabelProvider( layer ) );
+  engine.run( context );
+  p.end();
+  return img;
+}
+
+void TestQgsLabelingEngineV2::testIndependentGroups()
+{
+  // pairs of points with conflicting labels, far enough from other pairs
+  // that the problem splits into groups which are solved in parallel
+  QgsVectorLayer* layer = new QgsVectorLayer( "Point?field=name:string", "pairs", "memory" );
+  QVERIFY( layer->isValid() );
+  QgsFeatureList features;
+  for ( int row = 0; row < 8; ++row )
+  {
+    for ( int col = 0; col < 8; ++col )
+    {
+      for ( int i = 0; i < 2; ++i )
+      {
+        QgsFeature f( layer->pendingFields() );
+        f.setAttribute( 0, QString( "label %1" ).arg( row * 8 + col ) );
+        f.setGeometry( QgsGeometry::fromPoint( QgsPoint( 62.5 + col * 125 + i * 10, 62.5 + row * 125 ) ) );
+        features << f;
+      }
+    }
+  }
+  layer->dataProvider()->addFeatures( features );
+
+  layer->setCustomProperty( "labeling", "pal" );
+  layer->setCustomProperty( "labeling/enabled", true );
+  layer->setCustomProperty( "labeling/fieldName", "name" );
+  setDefaultLabelParams( layer );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setOutputSize( QSize( 800, 800 ) );
+  mapSettings.setExtent( QgsRectangle( 0, 0, 1000, 1000 ) );
+  mapSettings.setOutputDpi( 96 );
+
+  // the solution does not depend on the number of threads
+  int maxThreads = QThreadPool::globalInstance()->maxThreadCount();
+  QThreadPool::globalInstance()->setMaxThreadCount( 1 );
+  QImage serialImg = renderLabels( layer, mapSettings );
+  QThreadPool::globalInstance()->setMaxThreadCount( qMax( maxThreads, 4 ) );
+  QImage parallelImg = renderLabels( layer, mapSettings );
+  QImage parallelImg2 = renderLabels( layer, mapSettings );
+  QThreadPool::globalInstance()->setMaxThreadCount( maxThreads );
+
+  QVERIFY( serialImg == parallelImg );
+  QVERIFY( parallelImg == parallelImg2 );
+
+  delete layer;
+
+  // three clusters of four points with overlapping candidates, far apart from each other
+  TestLabelProvider provider;
+  QList<QgsLabelFeature*> labelFeatures;
+  QList<QgsPoint> clusters = QList<QgsPoint>() << QgsPoint( 100, 100 ) << QgsPoint( 1000, 100 ) << QgsPoint( 100, 1000 );
+  {
+    pal::Pal p;
+    pal::Layer* l = p.addLayer( &provider, "clusters", pal::P_POINT, 0.5, true, true );
+    for ( int c = 0; c < clusters.count(); ++c )
+    {
+      for ( int i = 0; i < 4; ++i )
+      {
+        QgsGeometry* point = QgsGeometry::fromPoint( QgsPoint( clusters[c].x() + i * 3, clusters[c].y() ) );
+        QgsLabelFeature* lf = new QgsLabelFeature( c * 4 + i, GEOSGeom_clone_r( QgsGeometry::getGEOSHandler(), point->asGeos() ), QSizeF( 10, 4 ) );
+        delete point;
+        labelFeatures << lf;
+        QVERIFY( l->registerFeature( lf ) );
+      }
+    }
+
+    double bbox[] = { 0, 0, 1100, 1100 };
+    pal::Problem* problem = p.extractProblem( bbox );
+    QVERIFY( problem );
+
+    // each cluster is a group of its own
+    QList< QList<int> > groups = problem->independentFeatureGroups( 1 );
+    QCOMPARE( groups.count(), 3 );
+    Q_FOREACH ( const QList<int>& group, groups )
+    {
+      QCOMPARE( group.count(), 4 );
+      QSet<int> groupClusters;
+      Q_FOREACH ( int feature, group )
+        groupClusters << problem->getFeatureCandidate( feature, 0 )->getFeaturePart()->feature()->id() / 4;
+      QCOMPARE( groupClusters.count(), 1 );
+    }
+
+    // small groups are merged with the following ones
+    groups = problem->independentFeatureGroups( 5 );
+    QCOMPARE( groups.count(), 2 );
+    QCOMPARE( groups[0].count(), 8 );
+    QCOMPARE( groups[1].count(), 4 );
+
+    groups = problem->independentFeatureGroups( 100 );
+    QCOMPARE( groups.count(), 1 );
+    QCOMPARE( groups[0].count(), 12 );
+
+    delete problem;
+  }
+  qDeleteAll( labelFeatures );
+}
+
+QMap<QgsFeatureId, QgsRectangle> TestQgsLabelingEngineV2::labelRects( const QgsMapSettings& mapSettings, QgsMapRendererCache* cache )
+{
+  QgsMapRendererSequentialJob job( mapSettings );
+  job.setCache( cache );
+  job.start();
+  job.waitForFinished();
+
+  QgsLabelingResults* results = job.takeLabelingResults();
+  QMap<QgsFeatureId, QgsRectangle> rects;
+  Q_FOREACH ( const QgsLabelPosition& pos, results->labelsWithinRect( mapSettings.visibleExtent() ) )
+    rects.insert( pos.featureId, pos.labelRect );
+  delete results;
+  return rects;
+}
+
+void TestQgsLabelingEngineV2::testLabelingCache()
+{
+  // grid of points with room for all labels
+  QgsVectorLayer* layer = new QgsVectorLayer( "Point?field=name:string", "grid", "memory" );
+  QVERIFY( layer->isValid() );
+  QgsFeatureList features;
+  for ( int row = 0; row < 10; ++row )
+  {
+    for ( int col = 0; col < 12; ++col )
+    {
+      QgsFeature f( layer->pendingFields() );
+      f.setAttribute( 0, QString( "label %1" ).arg( row * 12 + col ) );
+      f.setGeometry( QgsGeometry::fromPoint( QgsPoint( 50 + col * 100, 50 + row * 100 ) ) );
+      features << f;
+    }
+  }
+  layer->dataProvider()->addFeatures( features );
+
+  layer->setCustomProperty( "labeling", "pal" );
+  layer->setCustomProperty( "labeling/enabled", true );
+  layer->setCustomProperty( "labeling/fieldName", "name" );
+  setDefaultLabelParams( layer );
+  QgsMapLayerRegistry::instance()->addMapLayer( layer );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setOutputSize( QSize( 800, 800 ) );
+  mapSettings.setExtent( QgsRectangle( 0, 0, 1000, 1000 ) );
+  mapSettings.setLayers( QStringList() << layer->id() );
+  mapSettings.setOutputDpi( 96 );
+
+  QgsMapRendererCache cache;
+  QgsLabelingCache* labelingCache = cache.labelingCache();
+  QMap<QgsFeatureId, QgsRectangle> before = labelRects( mapSettings, &cache );
+  QVERIFY( !before.isEmpty() );
+
+  // the job stores the placements of the layer in the labeling cache
+  QgsRectangle cachedExtent;
+  QgsLabelingCache::Placements placements = labelingCache->placements( labelingCache->view(), cachedExtent );
+  QCOMPARE( placements.count(), 1 );
+  QString providerKey = placements.constBegin().key();
+  QVERIFY( providerKey.startsWith( layer->id() + '|' ) );
+
+  // labels of the points at (450, 450) and (550, 450), in the middle of the map
+  QgsFeatureId moved = 4 * 12 + 4 + 1;
+  QgsFeatureId neighbor = 4 * 12 + 5 + 1;
+  QVERIFY( before.contains( moved ) );
+  QVERIFY( before.contains( neighbor ) );
+  QVERIFY( placements[providerKey].contains( moved ) );
+  QVERIFY( placements[providerKey].contains( neighbor ) );
+
+  // move the cached placement of a label, the second render has to reuse
+  // it instead of placing the label again
+  QgsLabelingCache::Placement& placement = placements[providerKey][moved];
+  placement.x += 7;
+  placement.y += 3;
+  placement.rect = QgsRectangle( placement.rect.xMinimum() + 7, placement.rect.yMinimum() + 3,
+                                 placement.rect.xMaximum() + 7, placement.rect.yMaximum() + 3 );
+  labelingCache->setPlacements( labelingCache->view(), cachedExtent, placements );
+
+  QMap<QgsFeatureId, QgsRectangle> reused = labelRects( mapSettings, &cache );
+  QCOMPARE( reused.keys(), before.keys() );
+  QVERIFY( qgsDoubleNear( reused.value( moved ).xMinimum(), before.value( moved ).xMinimum() + 7, 1e-6 ) );
+  QVERIFY( qgsDoubleNear( reused.value( moved ).yMinimum(), before.value( moved ).yMinimum() + 3, 1e-6 ) );
+  QCOMPARE( reused.value( neighbor ), before.value( neighbor ) );
+
+  // put the cached placement of the label on top of its neighbor: the placement
+  // which loses the conflict falls back to all candidates of its feature
+  // instead of leaving the feature unlabeled
+  placements = labelingCache->placements( labelingCache->view(), cachedExtent );
+  QgsLabelingCache::Placement target = placements[providerKey][neighbor];
+  QgsLabelingCache::Placement& overlapping = placements[providerKey][moved];
+  overlapping.x = target.x;
+  overlapping.y = target.y;
+  overlapping.alpha = target.alpha;
+  overlapping.quadrant = target.quadrant;
+  overlapping.rect = target.rect;
+  labelingCache->setPlacements( labelingCache->view(), cachedExtent, placements );
+
+  QMap<QgsFeatureId, QgsRectangle> conflicting = labelRects( mapSettings, &cache );
+  QCOMPARE( conflicting.keys(), before.keys() );
+  QVERIFY( !conflicting.value( moved ).intersects( conflicting.value( neighbor ) ) );
+
+  // pan the map by a fifth of its width, labels in the middle keep their positions
+  mapSettings.setExtent( QgsRectangle( 200, 0, 1200, 1000 ) );
+  QMap<QgsFeatureId, QgsRectangle> after = labelRects( mapSettings, &cache );
+  QVERIFY( !after.isEmpty() );
+
+  QgsRectangle inner( 300, 100, 900, 900 );
+  int kept = 0;
+  for ( QMap<QgsFeatureId, QgsRectangle>::const_iterator it = conflicting.constBegin(); it != conflicting.constEnd(); ++it )
+  {
+    if ( !inner.contains( it.value() ) )
+      continue;
+
+    QVERIFY( after.contains( it.key() ) );
+    QCOMPARE( after.value( it.key() ), it.value() );
+    ++kept;
+  }
+  QVERIFY( kept > 0 );
+
+  // labels coming into view are placed
+  bool newLabels = false;
+  Q_FOREACH ( const QgsRectangle& rect, after )
+  {
+    if ( rect.xMinimum() > 1000 )
+      newLabels = true;
+  }
+  QVERIFY( newLabels );
+
+  // dropping the layer images keeps the placements, a repaint request drops them
+  cache.clearCacheImage( layer->id() );
+  QVERIFY( labelingCache->placements( labelingCache->view(), cachedExtent ).contains( providerKey ) );
+  layer->triggerRepaint();
+  QVERIFY( !labelingCache->placements( labelingCache->view(), cachedExtent ).contains( providerKey ) );
+
+  QgsMapLayerRegistry::instance()->removeMapLayer( layer->id() );
+}
+
+QList<QgsFeatureId> TestQgsLabelingEngineV2::labeledFeatures( const QgsMapSettings& mapSettings )
+{
+  QgsMapRendererSequentialJob job( mapSettings );
+  job.start();
+  job.waitForFinished();
+
+  QgsLabelingResults* results = job.takeLabelingResults();
+  QList<QgsFeatureId> ids;
+  Q_FOREACH ( const QgsLabelPosition& pos, results->labelsWithinRect( mapSettings.visibleExtent() ) )
+    ids << pos.featureId;
+  delete results;
+  qSort( ids );
+  return ids;
+}
+
+void TestQgsLabelingEngineV2::testParallelFeatureRendering()
+{
+  // more features than rendered by the threads of the pool in one batch
+  int maxThreads = QThreadPool::globalInstance()->maxThreadCount();
+  QThreadPool::globalInstance()->setMaxThreadCount( 2 );
+
+  QgsVectorLayer* layer = new QgsVectorLayer( "Point?field=id:integer", "dense", "memory" );
+  QVERIFY( layer->isValid() );
+  QgsFeatureList features;
+  for ( int i = 0; i < 20000; ++i )
+  {
+    QgsFeature f( layer->pendingFields() );
+    f.setAttribute( 0, i );
+    f.setGeometry( QgsGeometry::fromPoint( QgsPoint( 5 + ( i % 100 ) * 10, 5 + ( i / 100 ) * 5 ) ) );
+    features << f;
+  }
+  layer->dataProvider()->addFeatures( features );
+  QgsMapLayerRegistry::instance()->addMapLayer( layer );
+
+  layer->setCustomProperty( "labeling", "pal" );
+  layer->setCustomProperty( "labeling/enabled", true );
+  layer->setCustomProperty( "labeling/fieldName", "id" );
+  layer->setCustomProperty( "labeling/obstacle", false );
+  layer->setCustomProperty( "labeling/displayAll", true );
+  setDefaultLabelParams( layer );
+
+  // only every 500th feature is labeled, which requires the feature in the expression context
+  QgsPalLayerSettings settings;
+  settings.readFromLayer( layer );
+  settings.setDataDefinedProperty( QgsPalLayerSettings::Show, true, true, "\"id\" % 500 = 0", QString() );
+  settings.writeToLayer( layer );
+
+  QgsMapSettings mapSettings;
+  mapSettings.setOutputSize( QSize( 800, 800 ) );
+  mapSettings.setExtent( QgsRectangle( 0, 0, 1000, 1000 ) );
+  mapSettings.setLayers( QStringList() << layer->id() );
+  mapSettings.setOutputDpi( 96 );
+
+  QList<QgsFeatureId> expected;
+  Q_FOREACH ( const QgsFeature& f, features )
+  {
+    if ( f.attribute( 0 ).toInt() % 500 == 0 )
+      expected << f.id();
+  }
+
+  QCOMPARE( labeledFeatures( mapSettings ), expected );
+  mapSettings.setFlag( QgsMapSettings::ParallelFeatureRendering );
+  QCOMPARE( labeledFeatures( mapSettings ), expected );
+
+  QThreadPool::globalInstance()->setMaxThreadCount( maxThreads );
+  QgsMapLayerRegistry::instance()->removeMapLayer( layer->id() );
+}
+
 bool TestQgsLabelingEngineV2::imageCheck( const QString& testName, QImage &image, int mismatchCount )
 {
   //draw background
@@ -58,13 +58,14 @@ class TestQgsRenderers : public QObject
     void cleanup() {} // will be called after every testfunction.
 
     void singleSymbol();
+    void singleSymbolParallel();
 //    void uniqueValue();
 //    void graduatedSymbol();
 //    void continuousSymbol();
   private:
     bool mTestHasError;
     bool setQml( const QString& theType ); //uniquevalue / continuous / single /
-    bool imageCheck( const QString& theType ); //as above
+    bool imageCheck( const QString& theType, bool forceVectorOutput = true ); //as above
     QgsMapSettings *mMapSettings;
     QgsMapLayer * mpPointsLayer;
     QgsMapLayer * mpLinesLayer;
@@ -153,6 +154,17 @@ void TestQgsRenderers::singleSymbol()
   QVERIFY( imageCheck( "single" ) );
 }
 
+void TestQgsRenderers::singleSymbolParallel()
+{
+  mReport += "<h2>Single symbol renderer test with parallel feature rendering</h2>\n";
+  QVERIFY( setQml( "single" ) );
+  // raster output is required for rendering features on multiple threads
+  mMapSettings->setFlag( QgsMapSettings::ParallelFeatureRendering );
+  bool result = imageCheck( "single", false );
+  mMapSettings->setFlag( QgsMapSettings::ParallelFeatureRendering, false );
+  QVERIFY( result );
+}
+
 // TODO: update tests and enable
 /*
 void TestQgsRenderers::uniqueValue()
@@ -216,7 +228,7 @@ bool TestQgsRenderers::setQml( const QString& theType )
   return myStyleFlag;
 }
 
-bool TestQgsRenderers::imageCheck( const QString& theTestType )
+bool TestQgsRenderers::imageCheck( const QString& theTestType, bool forceVectorOutput )
 {
   //use the QgsRenderChecker test utility class to
   //ensure the rendered output matches our control image
@@ -226,7 +238,7 @@ bool TestQgsRenderers::imageCheck( const QString& theTestType )
   // gives correct extent. Forced to fixed extend however to avoid problems in future.
   QgsRectangle extent( -118.8888888888887720, 22.8002070393376783, -83.3333333333331581, 46.8719806763287536 );
   mMapSettings->setExtent( extent );
-  mMapSettings->setFlag( QgsMapSettings::ForceVectorOutput );
+  mMapSettings->setFlag( QgsMapSettings::ForceVectorOutput, forceVectorOutput );
   mMapSettings->setOutputDpi( 96 );
   QgsMultiRenderChecker myChecker;
   myChecker.setControlName( "expected_" + theTestType );
@@ -117,6 +117,132 @@ class TestQgsSpatialIndex : public QObject
       QVERIFY( fids[0] == 1 );
     }
 
+    void testNearestNeighbor()
+    {
+      QgsSpatialIndex index;
+      Q_FOREACH ( const QgsFeature& f, _pointFeatures() )
+        index.insertFeature( f );
+
+      QList<QgsFeatureId> fids = index.nearestNeighbor( QgsPoint( 2, 2 ), 1 );
+      QCOMPARE( fids, QList<QgsFeatureId>() << 1 );
+
+      // neighbors with the same distance as the last one are returned too
+      QList<QgsFeatureId> fids2 = index.nearestNeighbor( QgsPoint( 0, 1 ), 1 );
+      QCOMPARE( fids2.count(), 2 );
+      QVERIFY( fids2.contains( 1 ) );
+      QVERIFY( fids2.contains( 2 ) );
+    }
+
+    void testManyFeatures()
+    {
+      // enough features to merge inserted entries into the packed tree several times
+      QgsSpatialIndex index;
+      for ( int i = 0; i < 5000; ++i )
+        index.insertFeature( _pointFeature( i, i % 100, i / 100 ) );
+      for ( int i = 0; i < 5000; i += 2 )
+        QVERIFY( index.deleteFeature( _pointFeature( i, i % 100, i / 100 ) ) );
+      QVERIFY( !index.deleteFeature( _pointFeature( 0, 0, 0 ) ) );
+
+      QList<QgsFeatureId> fids = index.intersects( QgsRectangle( 9.5, 9.5, 12.5, 10.5 ) );
+      qSort( fids );
+      QCOMPARE( fids, QList<QgsFeatureId>() << 1011 );
+
+      QList<QgsFeatureId> nearest = index.nearestNeighbor( QgsPoint( 50.9, 20 ), 1 );
+      QCOMPARE( nearest, QList<QgsFeatureId>() << 2051 );
+    }
+
+    void testIncrementalUpdates()
+    {
+      // inserts and deletes interleaved with queries, checked against a brute force search
+      QgsSpatialIndex index;
+      QMap<QgsFeatureId, QgsPoint> points;
+      for ( int i = 0; i < 3000; ++i )
+      {
+        QgsPoint p( ( i * 37 ) % 101, ( i * 53 ) % 97 + i / 1000 * 0.5 );
+        index.insertFeature( _pointFeature( i, p.x(), p.y() ) );
+        points.insert( i, p );
+
+        if ( i % 3 == 2 )
+        {
+          QgsFeatureId removed = i - 1 - ( i % 7 );
+          if ( points.contains( removed ) )
+          {
+            QVERIFY( index.deleteFeature( _pointFeature( removed, points[removed].x(), points[removed].y() ) ) );
+            points.remove( removed );
+          }
+        }
+
+        if ( i % 250 == 0 )
+        {
+          QgsRectangle rect( i % 60, i % 50, i % 60 + 30, i % 50 + 25 );
+          QList<QgsFeatureId> expected;
+          for ( QMap<QgsFeatureId, QgsPoint>::const_iterator it = points.constBegin(); it != points.constEnd(); ++it )
+          {
+            if ( rect.contains( it.value() ) )
+              expected << it.key();
+          }
+          QList<QgsFeatureId> fids = index.intersects( rect );
+          qSort( fids );
+          QCOMPARE( fids, expected );
+        }
+      }
+
+      // the index is written and read in parts from several trees
+      QByteArray data;
+      QDataStream out( &data, QIODevice::WriteOnly );
+      out << index;
+      QgsSpatialIndex restored;
+      QDataStream in( data );
+      in >> restored;
+      QCOMPARE( in.status(), QDataStream::Ok );
+
+      QgsRectangle all( -1, -1, 200, 200 );
+      QList<QgsFeatureId> fids = restored.intersects( all );
+      qSort( fids );
+      QCOMPARE( fids, points.keys() );
+
+      QList<QgsFeatureId> nearest = restored.nearestNeighbor( QgsPoint( 50.2, 40.1 ), 3 );
+      QList<QgsFeatureId> expectedNearest = index.nearestNeighbor( QgsPoint( 50.2, 40.1 ), 3 );
+      qSort( nearest );
+      qSort( expectedNearest );
+      QCOMPARE( nearest, expectedNearest );
+    }
+
+    void testStream()
+    {
+      QgsSpatialIndex index;
+      Q_FOREACH ( const QgsFeature& f, _pointFeatures() )
+        index.insertFeature( f );
+
+      QByteArray data;
+      QDataStream out( &data, QIODevice::WriteOnly );
+      out << index;
+
+      QgsSpatialIndex restored;
+      QDataStream in( data );
+      in >> restored;
+      QCOMPARE( in.status(), QDataStream::Ok );
+
+      QList<QgsFeatureId> fids = restored.intersects( QgsRectangle( -10, -10, 0, 10 ) );
+      qSort( fids );
+      QCOMPARE( fids, QList<QgsFeatureId>() << 2 << 3 );
+
+      // garbage is rejected
+      QgsSpatialIndex invalid;
+      QDataStream in2( QByteArray( "garbage data" ) );
+      in2 >> invalid;
+      QVERIFY( in2.status() != QDataStream::Ok );
+
+      // a truncated stream claiming a huge number of entries
+      QByteArray truncated;
+      QDataStream out3( &truncated, QIODevice::WriteOnly );
+      out3 << quint32( 0x51534958 ) << quint32( 1 ) << quint32( 0 ) << quint32( 0xfffffff0 ) << 1.0;
+      QgsSpatialIndex invalid2;
+      QDataStream in3( truncated );
+      in3 >> invalid2;
+      QVERIFY( in3.status() != QDataStream::Ok );
+    }
+
     void benchmarkIntersect()
     {
       // add 50K features to the index
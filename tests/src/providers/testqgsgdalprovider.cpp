@@ -26,6 +26,10 @@
 #include <qgsproviderregistry.h>
 #include <qgsrasterdataprovider.h>
 #include <qgsrectangle.h>
+#include <qgsrasterblock.h>
+
+#include <gdal.h>
+#include <cpl_string.h>
 
 /** \ingroup UnitTests
  * This is a unit test for the gdal provider
@@ -42,6 +46,7 @@ class TestQgsGdalProvider : public QObject
 
     void scaleDataType(); //test resultant data types for int raster with float scale (#11573)
     void warpedVrt(); //test loading raster which requires a warped vrt
+    void tiledRead(); //test reading a tiled raster by blocks
 
   private:
     QString mTestDataDir;
@@ -104,5 +109,57 @@ void TestQgsGdalProvider::warpedVrt()
   delete provider;
 }
 
+void TestQgsGdalProvider::tiledRead()
+{
+  // tiled raster with partial blocks at the right and bottom border
+  QString raster = QDir::tempPath() + "/qgis_tiled_read_test.tif";
+  GDALAllRegister();
+  GDALDriverH driver = GDALGetDriverByName( "GTiff" );
+  QVERIFY( driver );
+  char** options = 0;
+  options = CSLSetNameValue( options, "TILED", "YES" );
+  options = CSLSetNameValue( options, "BLOCKXSIZE", "64" );
+  options = CSLSetNameValue( options, "BLOCKYSIZE", "64" );
+  GDALDatasetH dataset = GDALCreate( driver, raster.toUtf8().constData(), 300, 200, 1, GDT_Int32, options );
+  CSLDestroy( options );
+  QVERIFY( dataset );
+  double geoTransform[6] = { 0, 1, 0, 200, 0, -1 };
+  GDALSetGeoTransform( dataset, geoTransform );
+  QVector<qint32> values( 300 * 200 );
+  for ( int row = 0; row < 200; ++row )
+    for ( int col = 0; col < 300; ++col )
+      values[row * 300 + col] = col * 1000 + row;
+  QCOMPARE( GDALRasterIO( GDALGetRasterBand( dataset, 1 ), GF_Write, 0, 0, 300, 200, values.data(), 300, 200, GDT_Int32, 0, 0 ), CE_None );
+  GDALClose( dataset );
+
+  QgsDataProvider* provider = QgsProviderRegistry::instance()->provider( "gdal", raster );
+  QgsRasterDataProvider* rp = dynamic_cast< QgsRasterDataProvider* >( provider );
+  QVERIFY( rp );
+
+  typedef int blockCacheHits_t();
+  blockCacheHits_t* blockCacheHits = ( blockCacheHits_t* ) cast_to_fptr( QgsProviderRegistry::instance()->function( "gdal", "blockCacheHits" ) );
+  QVERIFY( blockCacheHits );
+
+  // the window covers 5 x 4 blocks, the second read is served from the block cache
+  for ( int i = 0; i < 2; ++i )
+  {
+    int hits = blockCacheHits();
+    QgsRasterBlock* block = rp->block( 1, QgsRectangle( 10, 5, 290, 180 ), 280, 175 );
+    QVERIFY( block );
+    QCOMPARE( block->width(), 280 );
+    QCOMPARE( block->height(), 175 );
+    bool ok = true;
+    for ( int row = 0; row < 175 && ok; ++row )
+      for ( int col = 0; col < 280 && ok; ++col )
+        ok = qgsDoubleNear( block->value( row, col ), ( col + 10 ) * 1000 + row + 20 );
+    QVERIFY( ok );
+    delete block;
+    QCOMPARE( blockCacheHits() - hits, i == 0 ? 0 : 20 );
+  }
+
+  delete provider;
+  QFile::remove( raster );
+}
+
 QTEST_MAIN( TestQgsGdalProvider )
 #include "testqgsgdalprovider.moc"
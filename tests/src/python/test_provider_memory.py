@@ -18,7 +18,7 @@ import shutil
 import glob
 
 from qgis.core import QGis, QgsField, QgsPoint, QgsVectorLayer, QgsFeatureRequest, QgsFeature, QgsProviderRegistry, \
-    QgsGeometry, NULL
+    QgsGeometry, QgsRectangle, NULL
 from PyQt4.QtCore import QSettings
 from utilities import (unitTestDataPath,
                        getQgisTestApp,
@@ -33,6 +33,29 @@ QGISAPP, CANVAS, IFACE, PARENT = getQgisTestApp()
 TEST_DATA_DIR = unitTestDataPath()
 
 
+def addTestFeatures(provider):
+    f1 = QgsFeature()
+    f1.setAttributes([5, -200, NULL, 'NuLl'])
+    f1.setGeometry(QgsGeometry.fromWkt('Point (-71.123 78.23)'))
+
+    f2 = QgsFeature()
+    f2.setAttributes([3, 300, 'Pear', 'PEaR'])
+
+    f3 = QgsFeature()
+    f3.setAttributes([1, 100, 'Orange', 'oranGe'])
+    f3.setGeometry(QgsGeometry.fromWkt('Point (-70.332 66.33)'))
+
+    f4 = QgsFeature()
+    f4.setAttributes([2, 200, 'Apple', 'Apple'])
+    f4.setGeometry(QgsGeometry.fromWkt('Point (-68.2 70.8)'))
+
+    f5 = QgsFeature()
+    f5.setAttributes([4, 400, 'Honey', 'Honey'])
+    f5.setGeometry(QgsGeometry.fromWkt('Point (-65.32 78.3)'))
+
+    provider.addFeatures([f1, f2, f3, f4, f5])
+
+
 class TestPyQgsMemoryProvider(TestCase, ProviderTestCase):
 
     @classmethod
@@ -44,26 +67,7 @@ class TestPyQgsMemoryProvider(TestCase, ProviderTestCase):
         assert (cls.vl.isValid())
         cls.provider = cls.vl.dataProvider()
 
-        f1 = QgsFeature()
-        f1.setAttributes([5, -200, NULL, 'NuLl'])
-        f1.setGeometry(QgsGeometry.fromWkt('Point (-71.123 78.23)'))
-
-        f2 = QgsFeature()
-        f2.setAttributes([3, 300, 'Pear', 'PEaR'])
-
-        f3 = QgsFeature()
-        f3.setAttributes([1, 100, 'Orange', 'oranGe'])
-        f3.setGeometry(QgsGeometry.fromWkt('Point (-70.332 66.33)'))
-
-        f4 = QgsFeature()
-        f4.setAttributes([2, 200, 'Apple', 'Apple'])
-        f4.setGeometry(QgsGeometry.fromWkt('Point (-68.2 70.8)'))
-
-        f5 = QgsFeature()
-        f5.setAttributes([4, 400, 'Honey', 'Honey'])
-        f5.setGeometry(QgsGeometry.fromWkt('Point (-65.32 78.3)'))
-
-        cls.provider.addFeatures([f1, f2, f3, f4, f5])
+        addTestFeatures(cls.provider)
 
     @classmethod
     def tearDownClass(cls):
@@ -172,5 +176,58 @@ class TestPyQgsMemoryProvider(TestCase, ProviderTestCase):
         assert myProvider is not None
 
 
+class TestPyQgsMemoryProviderColumnar(TestCase, ProviderTestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        """Run before all tests"""
+        # Create test layer
+        cls.vl = QgsVectorLayer(u'Point?crs=epsg:4326&field=pk:integer&field=cnt:integer&field=name:string(0)&field=name2:string(0)&key=pk&storage=columnar',
+                                u'test', u'memory')
+        assert (cls.vl.isValid())
+        cls.provider = cls.vl.dataProvider()
+        addTestFeatures(cls.provider)
+
+    def testUri(self):
+        uri = self.provider.dataSourceUri()
+        assert 'storage=columnar' in uri, uri
+        assert 'index=yes' in uri, uri
+
+    def testEditing(self):
+        layer = QgsVectorLayer('Point?field=name:string&field=age:integer&storage=columnar', 'test', 'memory')
+        provider = layer.dataProvider()
+
+        features = []
+        for i in range(3000):
+            f = QgsFeature()
+            f.setAttributes(['f%d' % i, i])
+            f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i, i)))
+            features.append(f)
+        res, features = provider.addFeatures(features)
+        assert res
+        self.assertEqual(provider.featureCount(), 3000)
+
+        # drop most features, the storage gets compacted
+        assert provider.deleteFeatures([f.id() for f in features[:2000]])
+        self.assertEqual(provider.featureCount(), 1000)
+        self.assertEqual(provider.extent().xMinimum(), 2000)
+
+        fid = features[2500].id()
+        assert provider.changeAttributeValues({fid: {0: 'changed', 1: NULL}})
+        assert provider.changeGeometryValues({fid: QgsGeometry.fromPoint(QgsPoint(-5, -5))})
+
+        f = provider.getFeatures(QgsFeatureRequest(fid)).next()
+        self.assertEqual(f.attributes(), ['changed', NULL])
+        assert compareWkt(f.geometry().exportToWkt(), 'Point (-5 -5)')
+
+        ids = [f.id() for f in provider.getFeatures(QgsFeatureRequest().setFilterRect(QgsRectangle(-10, -10, 2001, 2001)))]
+        self.assertEqual(set(ids), set([fid, features[2000].id(), features[2001].id()]))
+
+        assert provider.addAttributes([QgsField('size', QVariant.Double)])
+        assert provider.deleteAttributes([0])
+        f = provider.getFeatures(QgsFeatureRequest(fid)).next()
+        self.assertEqual(f.attributes(), [NULL, NULL])
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -18,7 +18,7 @@ import sys
 from qgis.core import NULL
 
 from qgis.core import QgsVectorLayer, QgsFeatureRequest, QgsFeature, QgsProviderRegistry
-from PyQt4.QtCore import QSettings
+from PyQt4.QtCore import QSettings, QThreadPool
 from utilities import (unitTestDataPath,
                        getQgisTestApp,
                        unittest,
@@ -93,5 +93,38 @@ class TestPyQgsPostgresProvider(TestCase, ProviderTestCase):
         test_table(self.dbconn, 'mls2d', 'MultiLineString ((0 0, 1 1),(2 2, 3 3))')
         test_table(self.dbconn, 'mls3d', 'MultiLineStringZ ((0 0 0, 1 1 1),(2 2 2, 3 3 3))')
 
+    def testParallelDecoding(self):
+        """Features decoded in parallel blocks are the same as the serially decoded ones"""
+        query = ('(SELECT id, id * 10000000000 AS big, (id % 300)::int2 AS small, id / 7.0::float8 AS dbl, '
+                 'id / 3.0::float4 AS flt, CASE WHEN id % 5 = 0 THEN NULL ELSE md5(id::text) END AS txt, '
+                 'CASE WHEN id % 11 = 0 THEN NULL ELSE id % 17 END AS nullable, '
+                 'ST_SetSRID(ST_MakePoint(id, id / 2.0), 4326)::geometry(Point, 4326) AS geom '
+                 'FROM generate_series(1, 3000) AS id)')
+        vl = QgsVectorLayer('%s srid=4326 table="%s" (geom) key=\'id\' sql=' % (self.dbconn, query), 'parallel', 'postgres')
+        assert vl.isValid()
+
+        def fetch(request):
+            return [(f.id(), f.attributes(), f.geometry().exportToWkt() if f.geometry() else None)
+                    for f in vl.getFeatures(request)]
+
+        maxThreads = QThreadPool.globalInstance().maxThreadCount()
+        subset = QgsFeatureRequest().setSubsetOfAttributes([0, 3, 5])
+        try:
+            QThreadPool.globalInstance().setMaxThreadCount(1)
+            serial = fetch(QgsFeatureRequest())
+            serialSubset = fetch(subset)
+            QThreadPool.globalInstance().setMaxThreadCount(max(maxThreads, 4))
+            parallel = fetch(QgsFeatureRequest())
+            parallelSubset = fetch(subset)
+        finally:
+            QThreadPool.globalInstance().setMaxThreadCount(maxThreads)
+
+        self.assertEqual(len(serial), 3000)
+        self.assertEqual(parallel, serial)
+        self.assertEqual(parallelSubset, serialSubset)
+        self.assertEqual(serial[41][0], 42)
+        self.assertEqual(serial[41][1][0], 42)
+        self.assertEqual(serial[41][1][1], 420000000000)
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,238 @@
+# -*- coding: utf-8 -*-
+"""QGIS Unit tests for the WMS provider tile cache.
+
+.. note:: This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+"""
+__author__ = 'QGIS Development Team'
+__date__ = '11/11/2015'
+__copyright__ = 'Copyright 2015, The QGIS Project'
+# This will get replaced with a git SHA1 when you do a git archive
+__revision__ = '$Format:%H$'
+
+import qgis
+import re
+import threading
+import BaseHTTPServer
+import SocketServer
+
+from PyQt4.QtCore import QBuffer, QByteArray, QIODevice, QSettings
+from PyQt4.QtGui import QImage, QColor
+
+from qgis.core import QgsRasterLayer, QgsRectangle
+from utilities import (getQgisTestApp,
+                       TestCase,
+                       unittest
+                       )
+
+QGISAPP, CANVAS, IFACE, PARENT = getQgisTestApp()
+
+# two tile matrices of 256x256 pixel tiles covering the square 0,0 - 71.68,71.68:
+# "0" with 2x2 tiles of 0.14 map units per pixel, "1" with 4x4 tiles of 0.07 map units per pixel
+CAPABILITIES = """<?xml version="1.0" encoding="UTF-8"?>
+<Capabilities xmlns="http://www.opengis.net/wmts/1.0" xmlns:ows="http://www.opengis.net/ows/1.1" version="1.0.0">
+  <ows:ServiceIdentification>
+    <ows:Title>Tile cache test</ows:Title>
+    <ows:ServiceType>OGC WMTS</ows:ServiceType>
+    <ows:ServiceTypeVersion>1.0.0</ows:ServiceTypeVersion>
+  </ows:ServiceIdentification>
+  <Contents>
+    <Layer>
+      <ows:Identifier>test</ows:Identifier>
+      <ows:Title>test</ows:Title>
+      <ows:BoundingBox crs="urn:ogc:def:crs:EPSG::3857">
+        <ows:LowerCorner>0 0</ows:LowerCorner>
+        <ows:UpperCorner>71.68 71.68</ows:UpperCorner>
+      </ows:BoundingBox>
+      <Style isDefault="true">
+        <ows:Identifier>default</ows:Identifier>
+      </Style>
+      <Format>image/png</Format>
+      <TileMatrixSetLink>
+        <TileMatrixSet>test</TileMatrixSet>
+      </TileMatrixSetLink>
+      <ResourceURL format="image/png" resourceType="tile" template="http://localhost:%(port)d/tiles/{TileMatrix}/{TileRow}/{TileCol}.png"/>
+    </Layer>
+    <TileMatrixSet>
+      <ows:Identifier>test</ows:Identifier>
+      <ows:SupportedCRS>urn:ogc:def:crs:EPSG::3857</ows:SupportedCRS>
+      <TileMatrix>
+        <ows:Identifier>0</ows:Identifier>
+        <ScaleDenominator>500</ScaleDenominator>
+        <TopLeftCorner>0 71.68</TopLeftCorner>
+        <TileWidth>256</TileWidth>
+        <TileHeight>256</TileHeight>
+        <MatrixWidth>2</MatrixWidth>
+        <MatrixHeight>2</MatrixHeight>
+      </TileMatrix>
+      <TileMatrix>
+        <ows:Identifier>1</ows:Identifier>
+        <ScaleDenominator>250</ScaleDenominator>
+        <TopLeftCorner>0 71.68</TopLeftCorner>
+        <TileWidth>256</TileWidth>
+        <TileHeight>256</TileHeight>
+        <MatrixWidth>4</MatrixWidth>
+        <MatrixHeight>4</MatrixHeight>
+      </TileMatrix>
+    </TileMatrixSet>
+  </Contents>
+</Capabilities>
+"""
+
+TILE_COLORS = {'0': QColor(255, 0, 0), '1': QColor(0, 0, 255)}
+
+
+def tileData(color):
+    image = QImage(256, 256, QImage.Format_ARGB32)
+    image.fill(color.rgba())
+    data = QByteArray()
+    buf = QBuffer(data)
+    buf.open(QIODevice.WriteOnly)
+    image.save(buf, 'PNG')
+    return str(data)
+
+
+class TileHandler(BaseHTTPServer.BaseHTTPRequestHandler):
+
+    """Serves the capabilities and plain colored tiles, which must not be kept in the network cache"""
+
+    # paths of the tile requests received
+    tileRequests = []
+    # tile matrices for which tile requests fail
+    failingMatrices = set()
+
+    def do_GET(self):
+        path = self.path.split('?')[0]
+        if path.endswith('/WMTSCapabilities.xml'):
+            self.reply(200, 'text/xml', CAPABILITIES % {'port': self.server.server_address[1]})
+            return
+
+        m = re.match(r'/tiles/(\d)/\d+/\d+\.png$', path)
+        if not m:
+            self.reply(404, 'text/plain', 'not found')
+            return
+
+        TileHandler.tileRequests.append(path)
+        if m.group(1) in TileHandler.failingMatrices:
+            self.reply(404, 'text/plain', 'not found')
+        else:
+            self.reply(200, 'image/png', tileData(TILE_COLORS[m.group(1)]))
+
+    def reply(self, status, contentType, data):
+        self.send_response(status)
+        self.send_header('Content-Type', contentType)
+        self.send_header('Content-Length', str(len(data)))
+        self.send_header('Cache-Control', 'no-store')
+        self.end_headers()
+        self.wfile.write(data)
+
+    def log_message(self, format, *args):
+        pass
+
+
+class TestQgsWmsTileCache(TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        # Bring up a local tile server
+        cls.httpd = SocketServer.ThreadingTCPServer(('localhost', 0), TileHandler)
+        cls.port = cls.httpd.server_address[1]
+
+        cls.httpd_thread = threading.Thread(target=cls.httpd.serve_forever)
+        cls.httpd_thread.setDaemon(True)
+        cls.httpd_thread.start()
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.httpd.shutdown()
+
+    def setUp(self):
+        TileHandler.tileRequests = []
+        TileHandler.failingMatrices = set()
+
+    def createLayer(self, name):
+        # tiles are cached by data source URI, so each test uses a URI of its own
+        uri = ('contextualWMSLegend=0&crs=EPSG:3857&dpiMode=7&featureCount=10&format=image/png'
+               '&layers=test&styles=default&tileMatrixSet=test'
+               '&url=http://localhost:%d/%s/WMTSCapabilities.xml' % (self.port, name))
+        layer = QgsRasterLayer(uri, name, 'wms')
+        assert layer.isValid(), 'WMTS layer not loaded: %s' % uri
+        return layer
+
+    def render(self, layer, size):
+        block = layer.dataProvider().block(1, QgsRectangle(0, 0, 71.68, 71.68), size, size)
+        return block.image()
+
+    def testSecondRenderFromCache(self):
+        first = self.render(self.createLayer('cached'), 512)
+        self.assertEqual(len(TileHandler.tileRequests), 4)
+        self.assertEqual(QColor(first.pixel(100, 100)), TILE_COLORS['0'])
+
+        # a new layer of the same service does not reuse the image of the first one,
+        # only the tile cache
+        TileHandler.tileRequests = []
+        second = self.render(self.createLayer('cached'), 512)
+        self.assertEqual(len(TileHandler.tileRequests), 0)
+        self.assertEqual(first, second)
+
+    def testReloadRequestsTiles(self):
+        layer = self.createLayer('reload')
+        self.render(layer, 512)
+        self.assertEqual(len(TileHandler.tileRequests), 4)
+
+        # a refresh drops the cached tiles of the service
+        TileHandler.tileRequests = []
+        layer.dataProvider().reloadData()
+        self.render(layer, 512)
+        self.assertEqual(len(TileHandler.tileRequests), 4)
+
+        # the tiles of other services stay cached
+        other = self.createLayer('reload-other')
+        self.render(other, 512)
+        TileHandler.tileRequests = []
+        layer.dataProvider().reloadData()
+        self.render(self.createLayer('reload-other'), 512)
+        self.assertEqual(len(TileHandler.tileRequests), 0)
+
+    def testExpiredTiles(self):
+        # the server sends no expiry, the tiles expire after the default expiry
+        settings = QSettings()
+        expiry = settings.value('/qgis/defaultTileExpiry', '24')
+        settings.setValue('/qgis/defaultTileExpiry', '-1')
+        try:
+            self.render(self.createLayer('expired'), 512)
+            self.assertEqual(len(TileHandler.tileRequests), 4)
+        finally:
+            settings.setValue('/qgis/defaultTileExpiry', expiry)
+
+        TileHandler.tileRequests = []
+        self.render(self.createLayer('expired'), 512)
+        self.assertEqual(len(TileHandler.tileRequests), 4)
+
+    def testPlaceholder(self):
+        layer = self.createLayer('placeholder')
+        self.render(layer, 512)
+        self.assertEqual(len(TileHandler.tileRequests), 4)
+
+        # the tiles of the finer tile matrix cannot be downloaded,
+        # the cached tiles of the coarser one stay in their place
+        TileHandler.tileRequests = []
+        TileHandler.failingMatrices = set(['1'])
+        image = self.render(layer, 1024)
+        self.assertTrue(len(TileHandler.tileRequests) >= 16)
+        for x, y in [(100, 100), (600, 300), (900, 900)]:
+            self.assertEqual(QColor(image.pixel(x, y)), TILE_COLORS['0'])
+
+        # downloaded tiles replace their placeholder
+        TileHandler.tileRequests = []
+        TileHandler.failingMatrices = set()
+        image = self.render(self.createLayer('placeholder'), 1024)
+        self.assertEqual(len(TileHandler.tileRequests), 16)
+        for x, y in [(100, 100), (600, 300), (900, 900)]:
+            self.assertEqual(QColor(image.pixel(x, y)), TILE_COLORS['1'])
+
+
+if __name__ == '__main__':
+    unittest.main()
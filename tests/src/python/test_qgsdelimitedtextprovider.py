@@ -371,6 +371,34 @@ class TestQgsDelimitedTextProviderWKT(TestCase, ProviderTestCase):
         """Run after all tests"""
 
 
+class TestQgsDelimitedTextProviderMapped(TestCase, ProviderTestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        """Run before all tests"""
+        # Create test layer read through a memory map
+        srcpath = os.path.join(TEST_DATA_DIR, 'provider')
+        cls.basetestfile = os.path.join(srcpath, 'delimited_xy.csv')
+
+        url = QUrl.fromLocalFile(cls.basetestfile)
+        url.addQueryItem("crs", "epsg:4326")
+        url.addQueryItem("type", "csv")
+        url.addQueryItem("xField", "X")
+        url.addQueryItem("yField", "Y")
+        url.addQueryItem("spatialIndex", "yes")
+        url.addQueryItem("subsetIndex", "yes")
+        url.addQueryItem("watchFile", "no")
+        url.addQueryItem("mapFile", "yes")
+
+        cls.vl = QgsVectorLayer(url.toString(), u'test', u'delimitedtext')
+        assert cls.vl.isValid(), "{} is invalid".format(cls.basetestfile)
+        cls.provider = cls.vl.dataProvider()
+
+    @classmethod
+    def tearDownClass(cls):
+        """Run after all tests"""
+
+
 class TestQgsDelimitedTextProviderOther(TestCase):
 
     def test_001_provider_defined(self):
@@ -741,6 +769,26 @@ class TestQgsDelimitedTextProviderOther(TestCase):
         requests = None
         runTest(filename, requests, **params)
 
+    def test_040_memory_mapped_parsing(self):
+        # Records split from the memory mapped file match those read through a text stream
+        tests = [
+            ('test.csv', {'geomType': 'none', 'type': 'csv'}),
+            ('testfields.csv', {'geomType': 'none', 'maxFields': '7', 'type': 'csv'}),
+            ('test.pipe', {'geomType': 'none', 'quote': '"', 'delimiter': '|', 'escape': '\\'}),
+            ('test.quote', {'geomType': 'none', 'quote': '\'"', 'type': 'csv', 'escape': '"\''}),
+            ('test.badquote', {'geomType': 'none', 'quote': '"', 'type': 'csv', 'escape': '"'}),
+            ('test2.csv', {'geomType': 'none', 'useHeader': 'no', 'type': 'csv', 'skipLines': '2'}),
+            ('testutf8.csv', {'geomType': 'none', 'delimiter': '|', 'type': 'csv', 'encoding': 'utf-8'}),
+            ('testlatin1.csv', {'geomType': 'none', 'delimiter': '|', 'type': 'csv', 'encoding': 'latin1'}),
+            ('testpt.csv', {'yField': 'geom_y', 'xField': 'geom_x', 'type': 'csv'}),
+        ]
+        for filename, params in tests:
+            streamed = delimitedTextData('stream', filename, [{}, {'fid': 3}], False, **params)
+            params['mapFile'] = 'yes'
+            mapped = delimitedTextData('mapped', filename, [{}, {'fid': 3}], False, **params)
+            for key in ('fields', 'fieldTypes', 'data', 'log', 'geometryType'):
+                assert mapped[key] == streamed[key], "{} of memory mapped {} differ: {} versus {}".format(key, filename, mapped[key], streamed[key])
+
 
 if __name__ == '__main__':
     unittest.main()
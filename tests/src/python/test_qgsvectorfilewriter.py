@@ -13,17 +13,25 @@ __copyright__ = 'Copyright 2012, The QGIS Project'
 __revision__ = '$Format:%H$'
 
 import qgis
+import os
+
+from PyQt4.QtCore import QDir
 
 from qgis.core import (QgsVectorLayer,
+                       QgsVectorFileWriter,
                        QgsFeature,
+                       QgsFeatureRequest,
                        QgsGeometry,
-                       QgsPoint
+                       QgsPoint,
+                       QgsCoordinateReferenceSystem,
+                       QgsCoordinateTransform
                        )
 
 from utilities import (getQgisTestApp,
                        TestCase,
                        unittest,
-                       writeShape
+                       writeShape,
+                       doubleNear
                        )
 QGISAPP, CANVAS, IFACE, PARENT = getQgisTestApp()
 
@@ -53,5 +61,58 @@ class TestQgsVectorLayer(TestCase):
 
         writeShape(self.mMemoryLayer, 'writetest.shp')
 
+    def testWriteReprojectedGeoPackage(self):
+        """Check features keep their order over several batches and transactions."""
+        layer = QgsVectorLayer('Point?crs=epsg:4326&field=idx:integer', 'test', 'memory')
+        assert layer.isValid()
+
+        # more features than reprojected in one batch (1000) and committed in one transaction (700)
+        features = []
+        for i in range(2500):
+            ft = QgsFeature()
+            ft.setGeometry(QgsGeometry.fromPoint(QgsPoint(-170 + i * 0.13, -80 + i * 0.06)))
+            ft.setAttributes([i])
+            features.append(ft)
+        myResult, myFeatures = layer.dataProvider().addFeatures(features)
+        assert myResult
+
+        fileName = os.path.join(str(QDir.tempPath()), 'writetest_reprojected.gpkg')
+        if os.path.exists(fileName):
+            os.remove(fileName)
+        destCrs = QgsCoordinateReferenceSystem()
+        destCrs.createFromId(3857, QgsCoordinateReferenceSystem.EpsgCrsId)
+        myResult = QgsVectorFileWriter.writeAsVectorFormat(
+            layer,
+            fileName,
+            'utf-8',
+            destCrs,
+            'GPKG',
+            False,
+            '',
+            [],
+            [],
+            False,
+            None,
+            QgsVectorFileWriter.NoSymbology,
+            1.0,
+            None,
+            700)
+        self.assertEqual(myResult, QgsVectorFileWriter.NoError)
+
+        written = QgsVectorLayer(fileName, 'written', 'ogr')
+        assert written.isValid()
+        self.assertEqual(written.featureCount(), 2500)
+
+        transform = QgsCoordinateTransform(layer.crs(), destCrs)
+        i = 0
+        for ft in written.getFeatures(QgsFeatureRequest()):
+            self.assertEqual(ft['idx'], i)
+            expected = transform.transform(features[i].geometry().asPoint())
+            point = ft.geometry().asPoint()
+            assert doubleNear(point.x(), expected.x(), 1e-3), 'feature %d: %f != %f' % (i, point.x(), expected.x())
+            assert doubleNear(point.y(), expected.y(), 1e-3), 'feature %d: %f != %f' % (i, point.y(), expected.y())
+            i += 1
+        self.assertEqual(i, 2500)
+
 if __name__ == '__main__':
     unittest.main()